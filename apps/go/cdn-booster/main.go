@@ -93,6 +93,10 @@ func createCache() ybc.Cacher {
 	config := ybc.Config{
 		MaxItemsCount: ybc.SizeT(*maxItemsCount),
 		DataFileSize:  ybc.SizeT(*cacheSize) * ybc.SizeT(1024*1024),
+
+		// All the items are stored with MaxTtl, so the default eviction
+		// by expiration time is arbitrary.
+		ClockEviction: true,
 	}
 
 	var err error
@@ -105,6 +109,7 @@ func createCache() ybc.Cacher {
 		if cacheFilesPath_[0] != "" {
 			config.DataFile = cacheFilesPath_[0] + ".cdn-booster.data"
 			config.IndexFile = cacheFilesPath_[0] + ".cdn-booster.index"
+			config.MapCacheFile = cacheFilesPath_[0] + ".cdn-booster.map_cache"
 		}
 		cache, err = config.OpenCache(true)
 		if err != nil {
@@ -119,6 +124,7 @@ func createCache() ybc.Cacher {
 			cfg := config
 			cfg.DataFile = cacheFilesPath_[i] + ".cdn-booster.data"
 			cfg.IndexFile = cacheFilesPath_[i] + ".cdn-booster.index"
+			cfg.MapCacheFile = cacheFilesPath_[i] + ".cdn-booster.map_cache"
 			configs[i] = &cfg
 		}
 		cache, err = configs.OpenCluster(true)
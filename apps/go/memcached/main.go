@@ -36,18 +36,23 @@ var (
 			"Enumerate multiple files delimited by comma for creating a cluster of caches.\n"+
 			"This can increase performance only if frequently accessed items don't fit RAM\n"+
 			"and each cache file is located on a distinct physical storage.")
-	cacheSize         = flag.Uint64("cacheSize", 64, "Total cache capacity in Megabytes")
-	deHashtableSize   = flag.Int("deHashtableSize", 16, "Dogpile effect hashtable size")
-	goMaxProcs        = flag.Int("goMaxProcs", defaultMaxProcs, "Maximum number of simultaneous Go threads")
-	hotDataSize       = flag.Uint64("hotDataSize", 0, "Hot data size in bytes. 0 disables hot data optimization")
-	hotItemsCount     = flag.Uint64("hotItemsCount", 0, "The number of hot items. 0 disables hot items optimization")
-	listenAddr        = flag.String("listenAddr", ":11211", "TCP address the server will listen to")
-	maxItemsCount     = flag.Uint64("maxItemsCount", 1000*1000, "Maximum number of items the server can cache")
-	syncInterval      = flag.Duration("syncInterval", time.Second*10, "Interval for data syncing. 0 disables data syncing")
-	osReadBufferSize  = flag.Int("osReadBufferSize", 224*1024, "Buffer size in bytes for incoming requests in OS")
-	osWriteBufferSize = flag.Int("osWriteBufferSize", 224*1024, "Buffer size in bytes for outgoing responses in OS")
-	readBufferSize    = flag.Int("readBufferSize", 56*1024, "Buffer size in bytes for incoming requests")
-	writeBufferSize   = flag.Int("writeBufferSize", 56*1024, "Buffer size in bytes for outgoing responses")
+	cacheSize             = flag.Uint64("cacheSize", 64, "Total cache capacity in Megabytes")
+	deHashtableSize       = flag.Int("deHashtableSize", 1024, "Dogpile effect hashtable size")
+	goMaxProcs            = flag.Int("goMaxProcs", defaultMaxProcs, "Maximum number of simultaneous Go threads")
+	hotDataSize           = flag.Uint64("hotDataSize", 0, "Hot data size in bytes. 0 disables hot data optimization")
+	hotDataPrefetch       = flag.Bool("hotDataPrefetch", false, "Whether to prefetch hot data in background on startup")
+	hotItemsCount         = flag.Uint64("hotItemsCount", 0, "The number of hot items. 0 disables hot items optimization")
+	indexWarmupThreads    = flag.Int("indexWarmupThreads", 1, "The number of threads reading index files into RAM on startup")
+	backgroundIndexWarmup = flag.Bool("backgroundIndexWarmup", false, "Whether to start serving requests before index files are read into RAM")
+	listenAddr            = flag.String("listenAddr", ":11211", "TCP address the server will listen to")
+	maxItemsCount         = flag.Uint64("maxItemsCount", 1000*1000, "Maximum number of items the server can cache")
+	maxHotDataSize        = flag.Uint64("maxHotDataSize", 0, "Maximum hot data size in bytes for runtime auto-sizing. 0 disables auto-sizing")
+	maxHotItemsCount      = flag.Uint64("maxHotItemsCount", 0, "Maximum number of hot items for runtime auto-sizing. 0 disables auto-sizing")
+	syncInterval          = flag.Duration("syncInterval", time.Second*10, "Interval for data syncing. 0 disables data syncing")
+	osReadBufferSize      = flag.Int("osReadBufferSize", 224*1024, "Buffer size in bytes for incoming requests in OS")
+	osWriteBufferSize     = flag.Int("osWriteBufferSize", 224*1024, "Buffer size in bytes for outgoing responses in OS")
+	readBufferSize        = flag.Int("readBufferSize", 56*1024, "Buffer size in bytes for incoming requests")
+	writeBufferSize       = flag.Int("writeBufferSize", 56*1024, "Buffer size in bytes for outgoing responses")
 )
 
 func main() {
@@ -66,6 +71,12 @@ func main() {
 		HotDataSize:     ybc.SizeT(*hotDataSize),
 		DeHashtableSize: *deHashtableSize,
 		SyncInterval:    syncInterval_,
+
+		IndexWarmupThreadsCount: *indexWarmupThreads,
+		BackgroundIndexWarmup:   *backgroundIndexWarmup,
+		HotDataPrefetch:         *hotDataPrefetch,
+		MaxHotItemsCount:        ybc.SizeT(*maxHotItemsCount),
+		MaxHotDataSize:          ybc.SizeT(*maxHotDataSize),
 	}
 
 	var cache ybc.Cacher
@@ -78,6 +89,7 @@ func main() {
 		if cacheFilesPath_[0] != "" {
 			config.DataFile = cacheFilesPath_[0] + ".go-memcached.data"
 			config.IndexFile = cacheFilesPath_[0] + ".go-memcached.index"
+			config.MapCacheFile = cacheFilesPath_[0] + ".go-memcached.map_cache"
 		}
 		cache, err = config.OpenCache(true)
 		if err != nil {
@@ -92,6 +104,7 @@ func main() {
 			cfg := config
 			cfg.DataFile = cacheFilesPath_[i] + ".go-memcached.data"
 			cfg.IndexFile = cacheFilesPath_[i] + ".go-memcached.index"
+			cfg.MapCacheFile = cacheFilesPath_[i] + ".go-memcached.map_cache"
 			configs[i] = &cfg
 		}
 		cache, err = configs.OpenCluster(true)
@@ -17,12 +17,93 @@
 
 #define C_CONFIG_DEFAULT_HOT_DATA_SIZE (1024 * 1024)
 
-#define C_CONFIG_DEFAULT_DE_HASHTABLE_SIZE 16
+#define C_CONFIG_DEFAULT_DE_HASHTABLE_SIZE 1024
 
 #define C_CONFIG_MAX_DE_HASHTABLE_SIZE (1024 * 1024)
 
 #define C_CONFIG_DEFAULT_SYNC_INTERVAL (10 * 1000)
 
+#define C_CONFIG_DEFAULT_SYNC_BANDWIDTH 0
+
+#define C_CONFIG_DEFAULT_STORAGE_ARENAS_COUNT 1
+
+/*
+ * The maximum number of independently locked storage arenas.
+ *
+ * Each arena requires a separate cursor in the index file and a separate
+ * lock, so there is no sense in having more arenas than CPU cores
+ * concurrently writing into the cache.
+ */
+#define C_CONFIG_MAX_STORAGE_ARENAS_COUNT 1024
+
+#define C_CONFIG_DEFAULT_ITEM_SLOTS_COUNT 0
+
+/*
+ * The maximum number of per-arena slots for lock-free registration
+ * of acquired items.
+ *
+ * Each slot occupies C_ITEM_SLOT_SIZE bytes. Writers scan all the used slots
+ * in the arena on each item allocation, so there is no sense in having more
+ * slots than the maximum number of concurrently acquired items.
+ */
+#define C_CONFIG_MAX_ITEM_SLOTS_COUNT (64 * 1024)
+
+#define C_CONFIG_DEFAULT_INDEX_WARMUP_THREADS_COUNT 1
+
+/*
+ * The maximum number of threads reading the index file into RAM on open.
+ *
+ * More threads than the storage device's queue depth don't speed up
+ * the warm-up.
+ */
+#define C_CONFIG_MAX_INDEX_WARMUP_THREADS_COUNT 64
+
+#define C_CONFIG_DEFAULT_HOT_DATA_PREFETCH_BANDWIDTH (64 * 1024 * 1024)
+
+/*
+ * The size of a slot for lock-free registration of acquired items.
+ *
+ * It should be equal to CPU cache line size, so threads registering acquired
+ * items in distinct slots don't suffer from false sharing.
+ */
+#define C_ITEM_SLOT_SIZE 64
+
+/*
+ * CPU cache line size. Used for prefetching data structures spanning
+ * multiple cache lines.
+ */
+#define C_CACHE_LINE_SIZE 64
+
+/*
+ * The maximum number of keys ybc_item_get_multi() looks up simultaneously.
+ *
+ * Memory for map buckets and storage metadata of all the keys in the batch
+ * is prefetched before validating the items. So too low value reduces
+ * the number of overlapped memory loads, while too high value may evict
+ * prefetched data from CPU cache before it is used.
+ */
+#define C_ITEM_GET_MULTI_BATCH_SIZE 16
+
+/*
+ * The maximum number of items ybc_item_set_multi() stores under a single
+ * storage arena lock hold.
+ *
+ * Too high value may increase latency for concurrent writers waiting
+ * for the arena lock, since overwrite protection checks for the whole
+ * batch are performed under the lock.
+ */
+#define C_ITEM_SET_MULTI_BATCH_SIZE 64
+
+/*
+ * The number of per-thread shards for cache statistics counters.
+ *
+ * Counters are updated with relaxed atomic operations. Threads are mapped
+ * to shards by their indexes, so threads don't contend on cache lines
+ * with counters unless there are more than C_STATS_SHARDS_COUNT threads.
+ * Must be a power of 2.
+ */
+#define C_STATS_SHARDS_COUNT 64
+
 /*
  * The height of a skiplist embedded into ybc_item.
  *
@@ -49,7 +130,10 @@
  * For instance, 16 slots per bucket result in ~0.9% eviction rate for half-full
  * cache - quite cool number ;).
  * See tests/eviction_rate_estimator.py for details.
- * C_MAP_BUCKET_SIZE must be a power of 2.
+ * C_MAP_BUCKET_SIZE must be a power of 2 not exceeding 32, since reference
+ * bits for CLOCK eviction of all the slots in a bucket must fit a single
+ * size_t on 32-bit platforms. Buckets with at least 4 slots are probed
+ * with SIMD instructions if available.
  */
 #define C_MAP_BUCKET_SIZE 16
 
@@ -78,16 +162,166 @@
 #define C_WS_MAX_MOVABLE_ITEM_SIZE (64 * 1024)
 
 /*
- * The probability of item defragmentation if it lays outside of hot data space.
+ * The probability of item defragmentation per estimated access if it lays
+ * outside of hot data space. I.e. an item accessed N times recently
+ * is defragmented with N*C_WS_DEFRAGMENT_PROBABILITY percent probability.
  *
  * The probability must be in the range [0..99].
  * 0 disables the defragmentation, while 99 leads to aggressive defragmentation.
  *
- * Lower probability results in smaller number of m_ws_defragment() calls
+ * Lower probability results in smaller number of defragmented items
  * at the cost of probably higher hot data fragmentation.
  */
 #define C_WS_DEFRAGMENT_PROBABILITY 10
 
+/*
+ * The minimum number of recent accesses to an item outside of hot data space
+ * required for its' defragmentation.
+ *
+ * This prevents from moving one-off items (i.e. items requested only once)
+ * into hot data space.
+ */
+#define C_WS_MIN_ACCESS_COUNT 2
+
+/*
+ * Bounds for the number of counters in the access frequency sketch used
+ * for estimating the number of recent accesses to items outside of hot data
+ * space. Each counter occupies 4 bits.
+ *
+ * The actual number of counters is derived from the maximum number of items
+ * in the cache.
+ */
+#define C_WS_SKETCH_MIN_COUNTERS_COUNT 1024
+#define C_WS_SKETCH_MAX_COUNTERS_COUNT (16 * 1024 * 1024)
+
+/*
+ * Counters in the access frequency sketch are halved after the number
+ * of accesses exceeding C_WS_SKETCH_AGING_FACTOR times the number of counters.
+ *
+ * Lower value makes the sketch forget old accesses faster.
+ */
+#define C_WS_SKETCH_AGING_FACTOR 10
+
+/*
+ * Only every C_WS_SKETCH_UPDATES_SAMPLING_RATE-th access to the frequency
+ * sketch is counted for aging purposes. Must be a power of 2.
+ *
+ * The access counter is shared among all the threads, so too low value
+ * results in cache line ping-pong between CPUs reading items.
+ *
+ * Too high value makes aging less precise.
+ */
+#define C_WS_SKETCH_UPDATES_SAMPLING_RATE 64
+
+/*
+ * The maximum number of items waiting for deferred defragmentation.
+ *
+ * Must be a power of 2. Defragmentation candidates are dropped
+ * if the queue is full. They are queued again on subsequent accesses.
+ */
+#define C_WS_QUEUE_SIZE 1024
+
+/*
+ * Items with keys larger than the given value aren't defragmented.
+ *
+ * Keys are copied into the deferred defragmentation queue, so too high value
+ * increases memory occupied by the queue.
+ */
+#define C_WS_QUEUE_MAX_KEY_SIZE 256
+
+/*
+ * The delay in milliseconds between queueing the first candidate
+ * for deferred defragmentation and the defragmentation run.
+ *
+ * The defragmentation thread sleeps while there are no candidates.
+ *
+ * Too high value delays moving frequently accessed items into hot data space.
+ *
+ * Too low value results in small defragmentation batches and frequent
+ * wakeups of the defragmentation thread.
+ */
+#define C_WS_QUEUE_DRAIN_INTERVAL 10
+
+/*
+ * The maximum number of bytes written back to the data file at once
+ * during data syncing.
+ *
+ * Too high value may result in latency spikes for page faults in the data
+ * file, since they compete for the storage device with huge write-back
+ * requests. It also makes sync bandwidth throttling coarser.
+ *
+ * Too low value increases the number of syscalls per sync.
+ */
+#define C_SYNC_CHUNK_SIZE (1024 * 1024)
+
+/*
+ * The size of index file chunks read by warm-up threads.
+ *
+ * Too low value increases synchronization overhead between warm-up threads
+ * and breaks sequential reads into small pieces.
+ *
+ * Too high value limits parallelism for small index files.
+ */
+#define C_WARMUP_CHUNK_SIZE (16 * 1024 * 1024)
+
+/*
+ * The number of bytes read from the storage file at once during hot data
+ * prefetch.
+ *
+ * Too high value makes prefetch bandwidth throttling coarser and may result
+ * in latency spikes for concurrent page faults in the storage file.
+ *
+ * Too low value increases the number of syscalls.
+ */
+#define C_PREFETCH_CHUNK_SIZE (1024 * 1024)
+
+/*
+ * The interval in milliseconds between runtime adjustments of the map cache
+ * size and the hot data size.
+ *
+ * Too low value makes adjustments noisy, since they are based on statistics
+ * gathered during the interval.
+ *
+ * Too high value slows down adaptation to workload changes.
+ */
+#define C_AUTOSIZE_INTERVAL 1000
+
+/*
+ * The map cache is grown if its hit ratio in percents drops below this value.
+ */
+#define C_AUTOSIZE_MAP_CACHE_GROW_HIT_RATIO 90
+
+/*
+ * The map cache is shrunk if its hit ratio in percents exceeds this value
+ * and less than a quarter of its slots is occupied.
+ */
+#define C_AUTOSIZE_MAP_CACHE_SHRINK_HIT_RATIO 99
+
+/*
+ * Hot data size is grown if the number of defragmentation moves per 1000
+ * get hits exceeds this value. Frequent moves mean hot items often drop out
+ * of the hot data space.
+ */
+#define C_AUTOSIZE_HOT_DATA_GROW_MOVES_RATIO 10
+
+/*
+ * Hot data size is shrunk if the number of defragmentation moves per 1000
+ * get hits drops below this value.
+ */
+#define C_AUTOSIZE_HOT_DATA_SHRINK_MOVES_RATIO 1
+
+/*
+ * The minimum number of get hits during C_AUTOSIZE_INTERVAL required
+ * for adjusting hot data size.
+ */
+#define C_AUTOSIZE_MIN_GET_HITS 1000
+
+/*
+ * The minimum hot data size per storage arena, which may be set
+ * by runtime adjustments.
+ */
+#define C_AUTOSIZE_MIN_HOT_DATA_SIZE (64 * 1024)
+
 /*
  * Minimum grace ttl in milliseconds, which can be passed to ybc_item_get_de().
  *
@@ -101,28 +335,39 @@
  * Too low maximum grace ttl won't prevent from dogpile effect, when multiple
  * threads are busy with creation of the same item.
  *
- * Too high maximum grace ttl may result in too large m_de->pending_items
- * hashtable if many distinct items are requested via ybc_item_get_de()
- * with high grace ttls. So the maximum grace ttl effectively limits the size
- * of m_de->pending_items hashtable.
+ * Too high maximum grace ttl may result in m_de->slots overflow if many
+ * distinct items are requested via ybc_item_get_de() with high grace ttls,
+ * since each pending item occupies a slot until its' grace ttl expires.
  *
  * 10 minutes should be enough for any practical purposes ;)
  */
 #define C_DE_ITEM_MAX_GRACE_TTL (10 * 60 * 1000)
 
 /*
- * Time to sleep in milliseconds before the next try on obtaining
- * not-yet-existing item.
+ * The maximum number of m_de->slots probed when looking up or registering
+ * a pending item.
+ *
+ * A pending item is spilled into a locked list if all the probed slots
+ * are occupied by other pending items.
+ *
+ * Too low value may result in spilled items and lock contention even if
+ * the dogpile effect hashtable isn't full.
  *
- * The amount of sleep time should be enough for creating an average item,
- * which is subject to dogpile effect.
+ * Too high value may result in CPU time waste on looking up pending items.
+ */
+#define C_DE_MAX_PROBES_COUNT 16
+
+/*
+ * The interval in milliseconds between checks for expired waiters registered
+ * via ybc_item_get_de_notify(). No checks are performed while there are
+ * no registered waiters.
  *
- * Too low sleep time may result in many unsuccessful tries on obtaining
- * not-yet-existing item, i.e. CPU time waste.
+ * Too high value delays notifications for waiters of items, which weren't
+ * added during grace ttl.
  *
- * Too high sleep time may result in high ybc_item_get_de() latencies.
+ * Too low value wastes CPU time on checks.
  */
-#define C_DE_ITEM_SLEEP_TIME 100
+#define C_DE_NOTIFY_INTERVAL 10
 
 #define C_CLUSTER_INITIAL_HASH_SEED 0xDEADBEEFDEADBEEF
 
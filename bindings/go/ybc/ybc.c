@@ -5,9 +5,16 @@
 #include <assert.h>  /* assert */
 #include <stddef.h>  /* size_t */
 #include <stdint.h>  /* uint*_t */
-#include <stdlib.h>  /* rand */
 #include <string.h>  /* memcpy, memcmp, memset */
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>  /* _mm*_* */
+#define M_HAS_X86_INTRINSICS
+#elif defined(__GNUC__) && defined(__aarch64__)
+#include <arm_neon.h>   /* v*q_u64 */
+#define M_HAS_NEON_INTRINSICS
+#endif
+
 
 /*******************************************************************************
  * Cache implementation.
@@ -36,19 +43,55 @@
  ******************************************************************************/
 
 /*
- * Calculates hash for size bytes starting from ptr using
- * the given seed.
+ * Identifiers of hash algorithms used for calculating key digests.
+ *
+ * Key digests are persisted in the index file, so the identifier
+ * of the algorithm used is persisted in the index file too.
+ * See m_index_get_hash_seed() for details.
+ *
+ * Never change existing identifiers, since this will break existing
+ * index files!
+ */
+#define M_HASH_ALGORITHM_JENKINS 0
+#define M_HASH_ALGORITHM_STRIPED 1
+
+/*
+ * The algorithm used for newly created and cleared caches.
+ */
+#define M_HASH_ALGORITHM_LATEST M_HASH_ALGORITHM_STRIPED
+
+/*
+ * The number of upper bits in the hash seed stored in index file, which
+ * are occupied by hash algorithm identifier.
+ */
+#define M_INDEX_HASH_ALGORITHM_BITS 8
+#define M_INDEX_HASH_ALGORITHM_SHIFT (64 - M_INDEX_HASH_ALGORITHM_BITS)
+#define M_INDEX_HASH_SEED_MASK ((~(uint64_t)0) >> M_INDEX_HASH_ALGORITHM_BITS)
+
+/*
+ * Packs the hash seed and hash algorithm identifier into a single word
+ * in the format stored in index file.
+ */
+static uint64_t m_hash_seed_pack(const uint64_t hash_seed,
+    const int hash_algorithm)
+{
+  return (hash_seed & M_INDEX_HASH_SEED_MASK) |
+      ((uint64_t)hash_algorithm << M_INDEX_HASH_ALGORITHM_SHIFT);
+}
+
+/*
+ * Calculates Jenkin's one-at-a-time hash for size bytes starting from ptr
+ * using the given seed.
+ *
+ * This hash is slow, since it processes a byte at a time. It is used only
+ * for index files created before M_HASH_ALGORITHM_STRIPED introduction.
  */
-static uint64_t m_hash_get(const uint64_t seed, const void *const ptr,
+static uint64_t m_hash_jenkins(const uint64_t seed, const void *const ptr,
     const size_t size)
 {
   /*
    * Simple Jenkin's hash.
    * See http://en.wikipedia.org/wiki/Jenkins_hash_function .
-   *
-   * TODO: use SpookyHash instead. It could be faster and have better
-   * output distribution.
-   * See http://www.burtleburtle.net/bob/hash/spooky.html .
    */
 
   const unsigned char *const v = ptr;
@@ -66,6 +109,259 @@ static uint64_t m_hash_get(const uint64_t seed, const void *const ptr,
   return hash;
 }
 
+/*
+ * Magic constants for the striped hash.
+ *
+ * These constants are stolen from wyhash
+ * ( https://github.com/wangyi-fudan/wyhash ) and xxHash
+ * ( https://github.com/Cyan4973/xxHash ).
+ */
+static const uint64_t M_HASH_P0 = 0xa0761d6478bd642fULL;
+static const uint64_t M_HASH_P1 = 0xe7037ed1a0b428dbULL;
+static const uint64_t M_HASH_P2 = 0x8ebc6af09c88c6e3ULL;
+static const uint64_t M_HASH_P3 = 0x589965cc75374cc3ULL;
+static const uint64_t M_HASH_SCRAMBLE_PRIME = 0x9e3779b1ULL;
+
+/*
+ * Stripes are processed by 4 independent 64-bit lanes.
+ */
+#define M_HASH_LANES_COUNT 4
+#define M_HASH_STRIPE_SIZE (M_HASH_LANES_COUNT * sizeof(uint64_t))
+
+/*
+ * Lanes are scrambled after each block of M_HASH_BLOCK_STRIPES_COUNT stripes.
+ */
+#define M_HASH_BLOCK_STRIPES_COUNT 16
+
+/*
+ * Per-lane keys for the first stripe in a block. Keys for subsequent stripes
+ * are obtained by adding M_HASH_STRIPE_KEY_STEPS, so the hash depends
+ * on stripes' order.
+ */
+static const uint64_t M_HASH_STRIPE_KEYS[M_HASH_LANES_COUNT] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL,
+    0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+};
+static const uint64_t M_HASH_STRIPE_KEY_STEPS[M_HASH_LANES_COUNT] = {
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL,
+    0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+};
+static const uint64_t M_HASH_SCRAMBLE_KEYS[M_HASH_LANES_COUNT] = {
+    0xcb00c391bb52283cULL, 0xa32e531b8b65d088ULL,
+    0x4ef90da297486471ULL, 0xd8acdea946ef1938ULL,
+};
+
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 m_uint128_t;
+#endif
+
+/*
+ * Multiplies a by b and folds 128-bit product into 64 bits.
+ */
+static uint64_t m_hash_mum(const uint64_t a, const uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+  const m_uint128_t r = (m_uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+  const uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+  const uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+  const uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi;
+  const uint64_t hl = a_hi * b_lo, hh = a_hi * b_hi;
+  const uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+  const uint64_t lo = (mid << 32) | (uint32_t)ll;
+  const uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  return lo ^ hi;
+#endif
+}
+
+static uint64_t m_hash_read64(const unsigned char *const p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t m_hash_read32(const unsigned char *const p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static void m_hash_accumulate_scalar(uint64_t *const acc,
+    const unsigned char *p, const size_t stripes_count)
+{
+  uint64_t keys[M_HASH_LANES_COUNT];
+
+  for (size_t i = 0; i < stripes_count; ++i) {
+    const size_t stripe_index = i % M_HASH_BLOCK_STRIPES_COUNT;
+    if (stripe_index == 0) {
+      memcpy(keys, M_HASH_STRIPE_KEYS, sizeof(keys));
+    }
+
+    for (size_t j = 0; j < M_HASH_LANES_COUNT; ++j) {
+      const uint64_t v = m_hash_read64(p + j * sizeof(uint64_t));
+      const uint64_t k = v ^ keys[j];
+      acc[j] += (k & 0xffffffff) * (k >> 32);
+      acc[j ^ 1] += v;
+      keys[j] += M_HASH_STRIPE_KEY_STEPS[j];
+    }
+    p += M_HASH_STRIPE_SIZE;
+
+    if (stripe_index == M_HASH_BLOCK_STRIPES_COUNT - 1) {
+      for (size_t j = 0; j < M_HASH_LANES_COUNT; ++j) {
+        acc[j] ^= acc[j] >> 47;
+        acc[j] ^= M_HASH_SCRAMBLE_KEYS[j];
+        acc[j] *= M_HASH_SCRAMBLE_PRIME;
+      }
+    }
+  }
+}
+
+#ifdef M_HAS_X86_INTRINSICS
+
+/*
+ * AVX2 version of m_hash_accumulate_scalar().
+ *
+ * Must return exactly the same results as m_hash_accumulate_scalar().
+ */
+__attribute__((target("avx2")))
+static void m_hash_accumulate_avx2(uint64_t *const acc,
+    const unsigned char *p, const size_t stripes_count)
+{
+  const __m256i initial_keys = _mm256_loadu_si256(
+      (const __m256i *)M_HASH_STRIPE_KEYS);
+  const __m256i key_steps = _mm256_loadu_si256(
+      (const __m256i *)M_HASH_STRIPE_KEY_STEPS);
+  const __m256i scramble_keys = _mm256_loadu_si256(
+      (const __m256i *)M_HASH_SCRAMBLE_KEYS);
+  const __m256i scramble_prime = _mm256_set1_epi32(
+      (int)M_HASH_SCRAMBLE_PRIME);
+
+  __m256i a = _mm256_loadu_si256((const __m256i *)acc);
+  __m256i keys = initial_keys;
+
+  for (size_t i = 0; i < stripes_count; ++i) {
+    const size_t stripe_index = i % M_HASH_BLOCK_STRIPES_COUNT;
+    if (stripe_index == 0) {
+      keys = initial_keys;
+    }
+
+    const __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    const __m256i k = _mm256_xor_si256(v, keys);
+    const __m256i product = _mm256_mul_epu32(k, _mm256_srli_epi64(k, 32));
+    /* Swap adjacent 64-bit lanes, i.e. acc[j ^ 1] += v[j]. */
+    const __m256i v_swapped = _mm256_shuffle_epi32(v, 0x4e);
+    a = _mm256_add_epi64(a, _mm256_add_epi64(product, v_swapped));
+    keys = _mm256_add_epi64(keys, key_steps);
+    p += M_HASH_STRIPE_SIZE;
+
+    if (stripe_index == M_HASH_BLOCK_STRIPES_COUNT - 1) {
+      a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+      a = _mm256_xor_si256(a, scramble_keys);
+      /* 64x32-bit multiplication. */
+      const __m256i lo = _mm256_mul_epu32(a, scramble_prime);
+      const __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32),
+          scramble_prime);
+      a = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+    }
+  }
+
+  _mm256_storeu_si256((__m256i *)acc, a);
+}
+
+#endif
+
+static void m_hash_accumulate(uint64_t *const acc,
+    const unsigned char *const p, const size_t stripes_count)
+{
+#ifdef M_HAS_X86_INTRINSICS
+  if (p_cpu_has_avx2()) {
+#ifndef NDEBUG
+    uint64_t acc_scalar[M_HASH_LANES_COUNT];
+    memcpy(acc_scalar, acc, sizeof(acc_scalar));
+    m_hash_accumulate_scalar(acc_scalar, p, stripes_count);
+#endif
+    m_hash_accumulate_avx2(acc, p, stripes_count);
+    assert(memcmp(acc, acc_scalar, sizeof(acc_scalar)) == 0);
+    return;
+  }
+#endif
+  m_hash_accumulate_scalar(acc, p, stripes_count);
+}
+
+/*
+ * Calculates hash for size bytes starting from ptr using the given seed.
+ *
+ * Short inputs are hashed in 16-byte chunks a-la wyhash. Long inputs
+ * are split into 32-byte stripes, which are processed by 4 independent lanes
+ * a-la xxHash3. Lanes are processed with AVX2 instructions if the CPU
+ * supports them.
+ */
+static uint64_t m_hash_striped(const uint64_t seed, const void *const ptr,
+    const size_t size)
+{
+  const unsigned char *p = ptr;
+  size_t n = size;
+  uint64_t h = seed ^ m_hash_mum(seed ^ M_HASH_P0, M_HASH_P1);
+
+  if (n >= M_HASH_STRIPE_SIZE) {
+    uint64_t acc[M_HASH_LANES_COUNT] = {
+        h ^ M_HASH_P0, h ^ M_HASH_P1, h ^ M_HASH_P2, h ^ M_HASH_P3,
+    };
+    const size_t stripes_count = n / M_HASH_STRIPE_SIZE;
+    m_hash_accumulate(acc, p, stripes_count);
+    p += stripes_count * M_HASH_STRIPE_SIZE;
+    n -= stripes_count * M_HASH_STRIPE_SIZE;
+
+    h = m_hash_mum(acc[0] ^ M_HASH_P0, acc[1] ^ h) ^
+        m_hash_mum(acc[2] ^ M_HASH_P1, acc[3] ^ h);
+  }
+
+  while (n > 16) {
+    h = m_hash_mum(m_hash_read64(p) ^ M_HASH_P1, m_hash_read64(p + 8) ^ h);
+    p += 16;
+    n -= 16;
+  }
+
+  uint64_t a, b;
+  if (n >= 8) {
+    a = m_hash_read64(p);
+    b = m_hash_read64(p + n - 8);
+  }
+  else if (n >= 4) {
+    a = m_hash_read32(p);
+    b = m_hash_read32(p + n - 4);
+  }
+  else if (n > 0) {
+    a = ((uint64_t)p[0] << 16) | ((uint64_t)p[n >> 1] << 8) | p[n - 1];
+    b = 0;
+  }
+  else {
+    a = 0;
+    b = 0;
+  }
+
+  h = m_hash_mum(a ^ M_HASH_P1, b ^ h);
+  return m_hash_mum(h ^ M_HASH_P0, (uint64_t)size ^ M_HASH_P1);
+}
+
+/*
+ * Calculates hash for size bytes starting from ptr using
+ * the given seed and the given hash algorithm.
+ */
+static uint64_t m_hash_get(const int hash_algorithm, const uint64_t seed,
+    const void *const ptr, const size_t size)
+{
+  if (hash_algorithm == M_HASH_ALGORITHM_JENKINS) {
+    return m_hash_jenkins(seed, ptr, size);
+  }
+
+  assert(hash_algorithm == M_HASH_ALGORITHM_STRIPED);
+  return m_hash_striped(seed, ptr, size);
+}
+
 
 /*******************************************************************************
  * File API.
@@ -150,6 +446,159 @@ static int m_file_open_or_create(struct p_file *const file,
 }
 
 
+/*******************************************************************************
+ * Statistics API.
+ *
+ * Counters are sharded per thread and updated with relaxed atomic operations,
+ * so hot paths rarely bounce cache lines between CPU cores. Readers sum
+ * the shards while writes may be in progress, so the sums are approximate.
+ ******************************************************************************/
+
+enum m_stats_counter
+{
+  M_STATS_GET_HITS,
+  M_STATS_GET_MISSES,
+  M_STATS_PAYLOAD_CHECK_FAILURES,
+  M_STATS_METADATA_CHECK_FAILURES,
+  M_STATS_MAP_VICTIM_OVERWRITES,
+  M_STATS_MAP_CACHE_HITS,
+  M_STATS_MAP_CACHE_MISSES,
+  M_STATS_STORAGE_WRAPS,
+  M_STATS_DEFRAGMENTATION_MOVES,
+  M_STATS_DE_WAITS,
+  M_STATS_SYNCS,
+  M_STATS_SYNC_BYTES,
+  M_STATS_SYNC_TIME_NS,
+  M_STATS_LOCK_CONTENTIONS,
+  M_STATS_LOCK_WAIT_TIME_NS,
+  M_STATS_COUNTERS_COUNT,
+};
+
+struct m_stats_shard
+{
+  uint64_t counters[M_STATS_COUNTERS_COUNT];
+};
+
+struct m_stats
+{
+  /*
+   * A buffer for shards. Shards are aligned to C_CACHE_LINE_SIZE inside
+   * the buffer.
+   */
+  char *buf;
+
+  /*
+   * C_STATS_SHARDS_COUNT shards, each occupying shard_size bytes.
+   */
+  char *shards;
+
+  /*
+   * Shard size rounded up to C_CACHE_LINE_SIZE, so distinct shards
+   * don't share cache lines.
+   */
+  size_t shard_size;
+};
+
+static void m_stats_init(struct m_stats *const stats)
+{
+  const size_t alignment = C_CACHE_LINE_SIZE;
+  stats->shard_size = (sizeof(struct m_stats_shard) + alignment - 1) &
+      ~(alignment - 1);
+
+  const size_t buf_size = stats->shard_size * C_STATS_SHARDS_COUNT + alignment;
+  stats->buf = p_malloc(buf_size);
+  memset(stats->buf, 0, buf_size);
+
+  const uintptr_t addr = (uintptr_t)stats->buf;
+  stats->shards = (char *)((addr + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+static void m_stats_destroy(struct m_stats *const stats)
+{
+  p_free(stats->buf);
+}
+
+static struct m_stats_shard *m_stats_get_shard(
+    const struct m_stats *const stats, const size_t shard_index)
+{
+  assert(shard_index < C_STATS_SHARDS_COUNT);
+  return (struct m_stats_shard *)(stats->shards +
+      stats->shard_size * shard_index);
+}
+
+/*
+ * Adds the given value to the given counter in the current thread's shard.
+ *
+ * Thread indexes aren't reused, so many threads may share a shard.
+ * The counter is updated atomically in order to avoid data race between them.
+ * The update is cheap while the shard's cache line isn't contended.
+ */
+static void m_stats_add(const struct m_stats *const stats,
+    const enum m_stats_counter counter, const uint64_t value)
+{
+  const size_t shard_index = p_thread_get_self_index() &
+      (C_STATS_SHARDS_COUNT - 1);
+  struct m_stats_shard *const shard = m_stats_get_shard(stats, shard_index);
+  p_atomic_counter_add(&shard->counters[counter], value);
+}
+
+static void m_stats_inc(const struct m_stats *const stats,
+    const enum m_stats_counter counter)
+{
+  m_stats_add(stats, counter, 1);
+}
+
+/*
+ * Locks the given lock, accounting the time spent waiting for it.
+ *
+ * The time is measured only if the lock is contended, so uncontended locking
+ * is almost free.
+ */
+static void m_stats_lock(const struct m_stats *const stats,
+    struct p_lock *const lock)
+{
+  if (p_lock_trylock(lock)) {
+    return;
+  }
+
+  const uint64_t start_time = p_get_monotonic_time_ns();
+  p_lock_lock(lock);
+  const uint64_t end_time = p_get_monotonic_time_ns();
+
+  m_stats_inc(stats, M_STATS_LOCK_CONTENTIONS);
+  m_stats_add(stats, M_STATS_LOCK_WAIT_TIME_NS, end_time - start_time);
+}
+
+static void m_stats_get(const struct m_stats *const stats,
+    struct ybc_stats *const dst)
+{
+  uint64_t counters[M_STATS_COUNTERS_COUNT] = {0};
+
+  for (size_t i = 0; i < C_STATS_SHARDS_COUNT; ++i) {
+    const struct m_stats_shard *const shard = m_stats_get_shard(stats, i);
+    for (size_t j = 0; j < M_STATS_COUNTERS_COUNT; ++j) {
+      counters[j] += p_atomic_counter_load(&shard->counters[j]);
+    }
+  }
+
+  dst->get_hits = counters[M_STATS_GET_HITS];
+  dst->get_misses = counters[M_STATS_GET_MISSES];
+  dst->payload_check_failures = counters[M_STATS_PAYLOAD_CHECK_FAILURES];
+  dst->metadata_check_failures = counters[M_STATS_METADATA_CHECK_FAILURES];
+  dst->map_victim_overwrites = counters[M_STATS_MAP_VICTIM_OVERWRITES];
+  dst->map_cache_hits = counters[M_STATS_MAP_CACHE_HITS];
+  dst->map_cache_misses = counters[M_STATS_MAP_CACHE_MISSES];
+  dst->storage_wraps = counters[M_STATS_STORAGE_WRAPS];
+  dst->defragmentation_moves = counters[M_STATS_DEFRAGMENTATION_MOVES];
+  dst->de_waits = counters[M_STATS_DE_WAITS];
+  dst->syncs = counters[M_STATS_SYNCS];
+  dst->sync_bytes = counters[M_STATS_SYNC_BYTES];
+  dst->sync_time_ns = counters[M_STATS_SYNC_TIME_NS];
+  dst->lock_contentions = counters[M_STATS_LOCK_CONTENTIONS];
+  dst->lock_wait_time_ns = counters[M_STATS_LOCK_WAIT_TIME_NS];
+}
+
+
 /*******************************************************************************
  * Storage API.
  ******************************************************************************/
@@ -201,9 +650,23 @@ struct m_storage_payload
 struct m_storage
 {
   /*
-   * A pointer to the next free memory in the storage.
+   * Storage arenas.
+   *
+   * Each arena is a circular buffer with its' own pointer to the next free
+   * memory. See m_storage_arena for details.
    */
-  struct m_storage_cursor *next_cursor;
+  struct m_storage_arena *arenas;
+
+  /*
+   * The number of storage arenas.
+   */
+  size_t arenas_count;
+
+  /*
+   * The size of each arena in bytes except the last arena, which may be
+   * a bit larger.
+   */
+  size_t arena_size;
 
   /*
    * Storage size in bytes.
@@ -211,10 +674,15 @@ struct m_storage
   size_t size;
 
   /*
-   * A copy of hash seed from index file.
+   * A copy of hash seed from index file packed together with hash algorithm
+   * identifier used for key digests calculation (see m_hash_seed_pack()).
    *
    * Each item contains a copy of hash seed in its' metadata for validation
    * purposes. See m_storage_metadata_check() for details.
+   *
+   * ybc_clear() changes both the hash seed and hash algorithm concurrently
+   * with readers, so they are kept in a single word, which must be read
+   * via m_storage_get_hash_seed().
    */
   uint64_t hash_seed;
 
@@ -244,7 +712,8 @@ struct ybc_item
 
   /*
    * All acquired items are organized into doubly linked skiplist with a head
-   * at ybc->acquired_items_head and a tail at ybc->acquired_items_tail.
+   * at m_storage_arena->acquired_items_head and a tail at
+   * m_storage_arena->acquired_items_tail. Each storage arena has its own list.
    *
    * The skiplist helps quickly (in O(ln(n)) time, where n is the number
    * of currently acquired items) determining the location for newly added item
@@ -260,6 +729,16 @@ struct ybc_item
   struct ybc_item *next[C_ITEM_SKIPLIST_HEIGHT];
   struct ybc_item *prev[C_ITEM_SKIPLIST_HEIGHT];
 
+  /*
+   * A slot the item is registered in if it has been acquired without locking.
+   *
+   * Items registered in a slot aren't registered in the skiplist,
+   * i.e. next and prev pointers are unused for such items.
+   *
+   * NULL if the item isn't registered in a slot.
+   */
+  struct m_item_slot *slot;
+
   /*
    * Item's value location.
    */
@@ -272,86 +751,321 @@ struct ybc_item
   int is_set_txn;
 };
 
-static void m_item_assert_less_equal(const struct ybc_item *const a,
-    const struct ybc_item *const b)
+/*
+ * A slot for lock-free registration of an acquired item.
+ *
+ * A thread acquiring an item publishes the range occupied by the item
+ * in a slot, so concurrent writers don't overwrite the item. This resembles
+ * hazard pointers ( http://en.wikipedia.org/wiki/Hazard_pointer ), but
+ * offset ranges are published instead of pointers.
+ */
+struct m_item_slot
 {
-  (void)a;
-  (void)b;
-  assert(a != b);
-  assert(a->payload.cursor.offset <= b->payload.cursor.offset);
-}
+  /*
+   * The range [start_offset ... end_offset) occupied by the acquired item.
+   *
+   * end_offset is set to M_ITEM_SLOT_FREE for free slots
+   * and to M_ITEM_SLOT_CLAIMED for slots, which are claimed by a thread,
+   * but don't contain a published range yet.
+   */
+  size_t start_offset;
+  size_t end_offset;
 
-static void m_item_skiplist_init(struct ybc_item *const acquired_items_head,
-    struct ybc_item *const acquired_items_tail, const size_t storage_size)
-{
-  acquired_items_head->payload.cursor.offset = 0;
-  acquired_items_head->payload.size = 0;
-  acquired_items_tail->payload.cursor.offset = storage_size;
-  acquired_items_tail->payload.size = 0;
+  /*
+   * Padding for preventing false sharing between threads, which use
+   * adjacent slots.
+   */
+  char padding[C_ITEM_SLOT_SIZE - 2 * sizeof(size_t)];
+};
 
-  for (size_t i = 0; i < C_ITEM_SKIPLIST_HEIGHT; ++i) {
-    acquired_items_head->next[i] = acquired_items_tail;
-    acquired_items_head->prev[i] = NULL;
-    acquired_items_tail->next[i] = NULL;
-    acquired_items_tail->prev[i] = acquired_items_head;
-  }
-}
+#define M_ITEM_SLOT_FREE ((size_t)0)
+#define M_ITEM_SLOT_CLAIMED ((size_t)1)
 
-static void m_item_skiplist_destroy(struct ybc_item *const acquired_items_head,
-    struct ybc_item *const acquired_items_tail, const size_t storage_size)
+/*
+ * Slots for lock-free registration of acquired items.
+ */
+struct m_item_slots
 {
-  (void)acquired_items_head;
-  (void)acquired_items_tail;
-  (void)storage_size;
+  /*
+   * Unaligned memory block holding slots.
+   */
+  void *buf;
 
-  assert(acquired_items_head->payload.cursor.offset == 0);
-  assert(acquired_items_head->payload.size == 0);
-  assert(acquired_items_tail->payload.cursor.offset == storage_size);
-  assert(acquired_items_tail->payload.size == 0);
+  /*
+   * Slots array aligned to C_ITEM_SLOT_SIZE.
+   */
+  struct m_item_slot *slots;
 
-  for (size_t i = 0; i < C_ITEM_SKIPLIST_HEIGHT; ++i) {
-    assert(acquired_items_head->next[i] == acquired_items_tail);
-    assert(acquired_items_head->prev[i] == NULL);
-    assert(acquired_items_tail->next[i] == NULL);
-    assert(acquired_items_tail->prev[i] == acquired_items_head);
-  }
-}
+  /*
+   * The number of slots. Zero if lock-free registration is disabled.
+   */
+  size_t count;
 
-static void m_item_skiplist_assert_valid(const struct ybc_item *const item,
-    const size_t i)
+  /*
+   * Slots with indexes greater or equal to used_count have never been used,
+   * so writers may skip them when looking for acquired items.
+   */
+  size_t used_count;
+};
+
+static void m_item_slots_init(struct m_item_slots *const item_slots,
+    const size_t count)
 {
-  if (item->next[i] != NULL) {
-    assert(item == item->next[i]->prev[i]);
-    m_item_assert_less_equal(item, item->next[i]);
-  }
-  if (item->prev[i] != NULL) {
-    assert(item == item->prev[i]->next[i]);
-    m_item_assert_less_equal(item->prev[i], item);
+  assert(count <= C_CONFIG_MAX_ITEM_SLOTS_COUNT);
+
+  item_slots->count = count;
+  item_slots->used_count = 0;
+  if (count == 0) {
+    item_slots->buf = NULL;
+    item_slots->slots = NULL;
+    return;
   }
+
+  const size_t buf_size = (count + 1) * sizeof(item_slots->slots[0]);
+  item_slots->buf = p_malloc(buf_size);
+  memset(item_slots->buf, 0, buf_size);
+
+  const uintptr_t alignment = C_ITEM_SLOT_SIZE;
+  const uintptr_t addr = (uintptr_t)item_slots->buf;
+  item_slots->slots = (struct m_item_slot *)
+      ((addr + alignment - 1) & ~(alignment - 1));
 }
 
-static void m_item_skiplist_get_prevs(
-    struct ybc_item *const acquired_items_head, struct ybc_item **const prevs,
-    const size_t offset)
+static void m_item_slots_destroy(struct m_item_slots *const item_slots)
 {
-  struct ybc_item *prev = acquired_items_head;
-
-  for (size_t i = 0; i < C_ITEM_SKIPLIST_HEIGHT; ++i) {
-    assert(prev->payload.cursor.offset <= offset);
-    struct ybc_item *next = prev->next[i];
-    while (offset > next->payload.cursor.offset) {
-      m_item_skiplist_assert_valid(next, i);
-      prev = next;
-      next = next->next[i];
-    }
-    m_item_skiplist_assert_valid(next, i);
-    prevs[i] = prev;
+#ifndef NDEBUG
+  for (size_t i = 0; i < item_slots->count; ++i) {
+    assert(item_slots->slots[i].end_offset == M_ITEM_SLOT_FREE);
   }
-}
+#endif
 
-static void m_item_skiplist_add(struct ybc_item *const item) {
-  const size_t offset = item->payload.cursor.offset;
-  uint64_t h = m_hash_get(0, &offset, sizeof(offset));
+  p_free(item_slots->buf);
+  item_slots->buf = NULL;
+  item_slots->slots = NULL;
+}
+
+/*
+ * Publishes the range [start_offset ... end_offset) in a free slot.
+ *
+ * The caller must re-validate the item occupying the range after the call,
+ * because concurrent writers may overwrite the range before it is published.
+ *
+ * Returns the slot on success. Returns NULL if all the slots are busy.
+ */
+static struct m_item_slot *m_item_slots_acquire(
+    struct m_item_slots *const item_slots, const size_t start_offset,
+    const size_t end_offset)
+{
+  const size_t count = item_slots->count;
+  assert(count > 0);
+  assert(start_offset < end_offset);
+  assert(end_offset > M_ITEM_SLOT_CLAIMED);
+
+  /*
+   * Start looking for a free slot from the slot 'owned' by the current thread.
+   * This minimizes contention on slots among threads.
+   */
+  size_t idx = p_thread_get_self_index() % count;
+  for (size_t i = 0; i < count; ++i) {
+    struct m_item_slot *const slot = &item_slots->slots[idx];
+    if (p_atomic_load(&slot->end_offset) == M_ITEM_SLOT_FREE &&
+        p_atomic_cas(&slot->end_offset, M_ITEM_SLOT_FREE,
+            M_ITEM_SLOT_CLAIMED)) {
+      size_t used_count = p_atomic_load(&item_slots->used_count);
+      while (used_count <= idx) {
+        (void)p_atomic_cas(&item_slots->used_count, used_count, idx + 1);
+        used_count = p_atomic_load(&item_slots->used_count);
+      }
+
+      p_atomic_store(&slot->start_offset, start_offset);
+      p_atomic_store(&slot->end_offset, end_offset);
+
+      /*
+       * Make sure concurrent writers see the published range before
+       * the caller re-validates the item.
+       * See m_storage_allocate() for details.
+       */
+      p_memory_barrier();
+      return slot;
+    }
+    if (++idx == count) {
+      idx = 0;
+    }
+  }
+
+  return NULL;
+}
+
+static void m_item_slots_release(struct m_item_slot *const slot)
+{
+  assert(slot->end_offset > M_ITEM_SLOT_CLAIMED);
+  p_atomic_store(&slot->end_offset, M_ITEM_SLOT_FREE);
+}
+
+/*
+ * Looks for published ranges overlapping [start_offset ... end_offset).
+ *
+ * Returns the maximum end offset among overlapping ranges.
+ * Returns 0 if there are no overlapping ranges.
+ */
+static size_t m_item_slots_find_overlap(
+    const struct m_item_slots *const item_slots, const size_t start_offset,
+    const size_t end_offset)
+{
+  size_t max_end_offset = 0;
+  const size_t used_count = p_atomic_load(&item_slots->used_count);
+  assert(used_count <= item_slots->count);
+
+  for (size_t i = 0; i < used_count; ++i) {
+    const struct m_item_slot *const slot = &item_slots->slots[i];
+    const size_t slot_end_offset = p_atomic_load(&slot->end_offset);
+    if (slot_end_offset <= M_ITEM_SLOT_CLAIMED) {
+      continue;
+    }
+
+    /*
+     * The slot may be concurrently released and re-acquired, so
+     * slot_start_offset may belong to a distinct range than slot_end_offset.
+     * This is OK, because the range owner re-validates the item after
+     * publishing the range.
+     */
+    const size_t slot_start_offset = p_atomic_load(&slot->start_offset);
+    if (slot_start_offset < end_offset && start_offset < slot_end_offset &&
+        slot_end_offset > max_end_offset) {
+      max_end_offset = slot_end_offset;
+    }
+  }
+
+  return max_end_offset;
+}
+
+/*
+ * Storage arena.
+ *
+ * The storage is split into arenas_count adjacent arenas. Each arena is
+ * a circular buffer on its' own with a separate next_cursor, a separate lock
+ * and a separate skiplist of acquired items. So threads adding items
+ * into distinct arenas don't contend for a single lock.
+ *
+ * New items are appended in the front of the arena, so writes remain
+ * sequential inside each arena.
+ */
+struct m_storage_arena
+{
+  /*
+   * A lock protecting next_cursor and acquired items' skiplist.
+   */
+  struct p_lock lock;
+
+  /*
+   * A pointer to the next free memory in the arena.
+   *
+   * This pointer points to the corresponding location in index file.
+   */
+  struct m_storage_cursor *next_cursor;
+
+  /*
+   * Arena's bounds in the storage - [start_offset ... end_offset).
+   */
+  size_t start_offset;
+  size_t end_offset;
+
+  /*
+   * Head and tail for skiplist of items acquired from the arena.
+   */
+  struct ybc_item acquired_items_head;
+  struct ybc_item acquired_items_tail;
+
+  /*
+   * Slots for items acquired from the arena without locking.
+   */
+  struct m_item_slots item_slots;
+};
+
+static void m_item_assert_less_equal(const struct ybc_item *const a,
+    const struct ybc_item *const b)
+{
+  (void)a;
+  (void)b;
+  assert(a != b);
+  assert(a->payload.cursor.offset <= b->payload.cursor.offset);
+}
+
+static void m_item_skiplist_init(struct ybc_item *const acquired_items_head,
+    struct ybc_item *const acquired_items_tail, const size_t start_offset,
+    const size_t end_offset)
+{
+  acquired_items_head->payload.cursor.offset = start_offset;
+  acquired_items_head->payload.size = 0;
+  acquired_items_tail->payload.cursor.offset = end_offset;
+  acquired_items_tail->payload.size = 0;
+
+  for (size_t i = 0; i < C_ITEM_SKIPLIST_HEIGHT; ++i) {
+    acquired_items_head->next[i] = acquired_items_tail;
+    acquired_items_head->prev[i] = NULL;
+    acquired_items_tail->next[i] = NULL;
+    acquired_items_tail->prev[i] = acquired_items_head;
+  }
+}
+
+static void m_item_skiplist_destroy(struct ybc_item *const acquired_items_head,
+    struct ybc_item *const acquired_items_tail, const size_t start_offset,
+    const size_t end_offset)
+{
+  (void)acquired_items_head;
+  (void)acquired_items_tail;
+  (void)start_offset;
+  (void)end_offset;
+
+  assert(acquired_items_head->payload.cursor.offset == start_offset);
+  assert(acquired_items_head->payload.size == 0);
+  assert(acquired_items_tail->payload.cursor.offset == end_offset);
+  assert(acquired_items_tail->payload.size == 0);
+
+  for (size_t i = 0; i < C_ITEM_SKIPLIST_HEIGHT; ++i) {
+    assert(acquired_items_head->next[i] == acquired_items_tail);
+    assert(acquired_items_head->prev[i] == NULL);
+    assert(acquired_items_tail->next[i] == NULL);
+    assert(acquired_items_tail->prev[i] == acquired_items_head);
+  }
+}
+
+static void m_item_skiplist_assert_valid(const struct ybc_item *const item,
+    const size_t i)
+{
+  if (item->next[i] != NULL) {
+    assert(item == item->next[i]->prev[i]);
+    m_item_assert_less_equal(item, item->next[i]);
+  }
+  if (item->prev[i] != NULL) {
+    assert(item == item->prev[i]->next[i]);
+    m_item_assert_less_equal(item->prev[i], item);
+  }
+}
+
+static void m_item_skiplist_get_prevs(
+    struct ybc_item *const acquired_items_head, struct ybc_item **const prevs,
+    const size_t offset)
+{
+  struct ybc_item *prev = acquired_items_head;
+
+  for (size_t i = 0; i < C_ITEM_SKIPLIST_HEIGHT; ++i) {
+    assert(prev->payload.cursor.offset <= offset);
+    struct ybc_item *next = prev->next[i];
+    while (offset > next->payload.cursor.offset) {
+      m_item_skiplist_assert_valid(next, i);
+      prev = next;
+      next = next->next[i];
+    }
+    m_item_skiplist_assert_valid(next, i);
+    prevs[i] = prev;
+  }
+}
+
+static void m_item_skiplist_add(struct ybc_item *const item) {
+  const size_t offset = item->payload.cursor.offset;
+  uint64_t h = m_hash_get(M_HASH_ALGORITHM_LATEST, 0, &offset,
+      sizeof(offset));
 
   for (size_t i = C_ITEM_SKIPLIST_HEIGHT; i > 0; ) {
     --i;
@@ -411,6 +1125,95 @@ static void m_storage_fix_size(size_t *const size)
   }
 }
 
+static void m_storage_fix_arenas_count(size_t *const arenas_count,
+    const size_t storage_size)
+{
+  if (*arenas_count == 0) {
+    *arenas_count = 1;
+  }
+
+  if (*arenas_count > C_CONFIG_MAX_STORAGE_ARENAS_COUNT) {
+    *arenas_count = C_CONFIG_MAX_STORAGE_ARENAS_COUNT;
+  }
+
+  /*
+   * Each arena must be at least C_STORAGE_MIN_SIZE bytes.
+   */
+  assert(storage_size >= C_STORAGE_MIN_SIZE);
+  if (storage_size / *arenas_count < C_STORAGE_MIN_SIZE) {
+    *arenas_count = storage_size / C_STORAGE_MIN_SIZE;
+  }
+}
+
+/*
+ * Initializes storage arenas.
+ *
+ * The first arena uses next_cursor, while the remaining arenas use
+ * (storage->arenas_count - 1) cursors from extra_next_cursors.
+ */
+static void m_storage_arenas_init(struct m_storage *const storage,
+    struct m_storage_cursor *const next_cursor,
+    struct m_storage_cursor *const extra_next_cursors,
+    const size_t item_slots_count)
+{
+  const size_t arenas_count = storage->arenas_count;
+  assert(arenas_count > 0);
+  assert(arenas_count <= C_CONFIG_MAX_STORAGE_ARENAS_COUNT);
+
+  storage->arena_size = storage->size / arenas_count;
+  storage->arenas = p_malloc(arenas_count * sizeof(storage->arenas[0]));
+
+  for (size_t i = 0; i < arenas_count; ++i) {
+    struct m_storage_arena *const arena = &storage->arenas[i];
+
+    arena->start_offset = i * storage->arena_size;
+    arena->end_offset = (i == arenas_count - 1) ? storage->size :
+        (arena->start_offset + storage->arena_size);
+
+    arena->next_cursor = (i == 0) ? next_cursor : &extra_next_cursors[i - 1];
+    if (arena->next_cursor->offset < arena->start_offset ||
+        arena->next_cursor->offset > arena->end_offset) {
+      arena->next_cursor->offset = arena->start_offset;
+    }
+
+    m_item_skiplist_init(&arena->acquired_items_head,
+        &arena->acquired_items_tail, arena->start_offset, arena->end_offset);
+    m_item_slots_init(&arena->item_slots, item_slots_count);
+    p_lock_init(&arena->lock);
+  }
+}
+
+static void m_storage_arenas_destroy(struct m_storage *const storage)
+{
+  for (size_t i = 0; i < storage->arenas_count; ++i) {
+    struct m_storage_arena *const arena = &storage->arenas[i];
+
+    m_item_skiplist_destroy(&arena->acquired_items_head,
+        &arena->acquired_items_tail, arena->start_offset, arena->end_offset);
+    m_item_slots_destroy(&arena->item_slots);
+    p_lock_destroy(&arena->lock);
+  }
+
+  p_free(storage->arenas);
+  storage->arenas = NULL;
+}
+
+/*
+ * Returns an arena containing the given offset.
+ *
+ * The offset may be broken (see m_map description for details), so the
+ * function always returns a valid arena.
+ */
+static struct m_storage_arena *m_storage_get_arena(
+    const struct m_storage *const storage, const size_t offset)
+{
+  size_t idx = offset / storage->arena_size;
+  if (idx >= storage->arenas_count) {
+    idx = storage->arenas_count - 1;
+  }
+  return &storage->arenas[idx];
+}
+
 static int m_storage_open(struct m_storage *const storage,
     struct p_file *const storage_file,
     const char *const filename, const int force, int *const is_file_created)
@@ -425,7 +1228,8 @@ static int m_storage_open(struct m_storage *const storage,
   /*
    * Do not cache storage file contents into RAM at the moment, because it can
    * be much bigger than RAM size. Allow the OS dealing with storage file
-   * caching.
+   * caching. Only recently written data may be prefetched in background,
+   * see m_prefetch_start().
    */
 
   p_memory_map(&ptr, storage_file, storage->size);
@@ -477,9 +1281,40 @@ static void m_storage_payload_assert_valid(
   assert(payload->cursor.offset <= storage_size - payload->size);
 }
 
+/*
+ * Stores src cursor to dst cursor, which may be concurrently read
+ * by m_storage_cursor_load().
+ */
+static void m_storage_cursor_store(struct m_storage_cursor *const dst,
+    const struct m_storage_cursor *const src)
+{
+  /*
+   * The order of stores is important. See m_storage_cursor_load() for details.
+   */
+  p_atomic_store(&dst->wrap_count, src->wrap_count);
+  p_atomic_store(&dst->offset, src->offset);
+}
+
+/*
+ * Loads a copy of src cursor, which may be concurrently updated
+ * by m_storage_cursor_store().
+ *
+ * The copy may contain the new wrap_count with the old offset if src is
+ * concurrently wrapped. This is safe for m_storage_payload_check(), since such
+ * a copy may only invalidate items, which are valid for the new cursor.
+ * Items with the new wrap_count located after the old offset are impossible,
+ * because they haven't been allocated yet.
+ */
+static void m_storage_cursor_load(struct m_storage_cursor *const dst,
+    const struct m_storage_cursor *const src)
+{
+  dst->offset = p_atomic_load(&src->offset);
+  dst->wrap_count = p_atomic_load(&src->wrap_count);
+}
+
 static int m_storage_find_free_hole(struct ybc_item *const acquired_items_head,
     struct ybc_item *const item, struct m_storage_cursor *const next_cursor,
-    const size_t item_size, const size_t storage_size)
+    const size_t item_size, const size_t end_offset)
 {
   m_item_skiplist_get_prevs(acquired_items_head, item->next,
       next_cursor->offset);
@@ -489,13 +1324,13 @@ static int m_storage_find_free_hole(struct ybc_item *const acquired_items_head,
    * It is expected that item's properties are already verified
    * in ybc_item_get(), so use only assertions here.
    */
-  m_storage_payload_assert_valid(&tmp->payload, storage_size);
+  m_storage_payload_assert_valid(&tmp->payload, end_offset);
 
   if (next_cursor->offset >= tmp->payload.cursor.offset + tmp->payload.size) {
     tmp = tmp->next[N];
-    m_storage_payload_assert_valid(&tmp->payload, storage_size);
+    m_storage_payload_assert_valid(&tmp->payload, end_offset);
 
-    assert(next_cursor->offset <= storage_size - item_size);
+    assert(next_cursor->offset <= end_offset - item_size);
 
     if (next_cursor->offset + item_size <= tmp->payload.cursor.offset) {
       return 1;
@@ -507,50 +1342,115 @@ static int m_storage_find_free_hole(struct ybc_item *const acquired_items_head,
 }
 
 /*
- * Allocates storage space for the given item with the given item->payload.size.
+ * Checks whether the space for the item of the given size at next_cursor
+ * overlaps items acquired without locking.
+ *
+ * Items are registered in arena->item_slots without locking in the following
+ * order:
+ * - the item's range is published in a slot;
+ * - memory barrier;
+ * - the item is validated against arena->next_cursor.
+ *
+ * So the function performs the mirrored steps:
+ * - arena->next_cursor is moved past the space for the item;
+ * - memory barrier;
+ * - the space is checked against published ranges.
+ *
+ * This guarantees that either the item's owner discovers the item is being
+ * overwritten, or the writer discovers the item in a slot.
+ *
+ * Returns 0 if there is no overlap. Otherwise moves next_cursor past
+ * overlapping items and returns non-zero.
+ */
+static int m_storage_find_slots_overlap(struct m_storage_arena *const arena,
+    struct m_storage_cursor *const next_cursor, const size_t item_size)
+{
+  if (arena->item_slots.count == 0) {
+    return 0;
+  }
+
+  const size_t start_offset = next_cursor->offset;
+  assert(start_offset <= arena->end_offset - item_size);
+  const size_t end_offset = start_offset + item_size;
+
+  const struct m_storage_cursor tmp_cursor = {
+      .wrap_count = next_cursor->wrap_count,
+      .offset = end_offset,
+  };
+  m_storage_cursor_store(arena->next_cursor, &tmp_cursor);
+  p_memory_barrier();
+
+  const size_t overlap_end_offset = m_item_slots_find_overlap(
+      &arena->item_slots, start_offset, end_offset);
+  if (overlap_end_offset == 0) {
+    return 0;
+  }
+
+  assert(overlap_end_offset > start_offset);
+  next_cursor->offset = overlap_end_offset;
+  return 1;
+}
+
+/*
+ * Allocates space in the given storage arena for the given item with the given
+ * item->payload.size.
+ *
+ * The caller must hold arena->lock.
+ *
+ * Arena wraps are accounted in the given stats.
  *
  * On success returns non-zero, sets up item->cursor to point to the allocated
  * space in the storage.
- * Registers the item in acquired_items skiplist if has_overwrite_protection
- * is set.
+ * Registers the item in arena's acquired_items skiplist
+ * if has_overwrite_protection is set.
  *
  * On failure returns zero.
  */
-static int m_storage_allocate(struct m_storage *const storage,
-    struct ybc_item *const acquired_items_head, struct ybc_item *const item,
-    const int has_overwrite_protection)
+static int m_storage_allocate(const struct m_storage *const storage,
+    const struct m_stats *const stats, struct m_storage_arena *const arena,
+    struct ybc_item *const item, const int has_overwrite_protection)
 {
   const size_t item_size = item->payload.size;
   assert(item_size > 0);
 
-  const size_t storage_size = storage->size;
-  if (item_size > storage_size) {
+  const size_t start_offset = arena->start_offset;
+  const size_t end_offset = arena->end_offset;
+  assert(start_offset < end_offset);
+  assert(end_offset <= storage->size);
+  if (item_size > end_offset - start_offset) {
     return 0;
   }
 
-  struct m_storage_cursor next_cursor = *storage->next_cursor;
-  assert(next_cursor.offset <= storage_size);
+  const struct m_storage_cursor initial_cursor = *arena->next_cursor;
+  assert(initial_cursor.offset >= start_offset);
+  assert(initial_cursor.offset <= end_offset);
 
-  const size_t initial_offset = next_cursor.offset;
+  struct m_storage_cursor next_cursor = initial_cursor;
   int is_storage_wrapped = 0;
   for (;;) {
-    if (next_cursor.offset > storage_size - item_size) {
-      /* Hit the end of storage. Wrap the cursor. */
+    if (next_cursor.offset > end_offset - item_size) {
+      /* Hit the end of arena. Wrap the cursor. */
       ++next_cursor.wrap_count;
-      next_cursor.offset = 0;
+      next_cursor.offset = start_offset;
       is_storage_wrapped = 1;
     }
 
     if (!has_overwrite_protection) {
       break;
     }
-    if (m_storage_find_free_hole(acquired_items_head, item, &next_cursor,
-        item_size, storage_size)) {
+    if (m_storage_find_free_hole(&arena->acquired_items_head, item,
+        &next_cursor, item_size, end_offset) &&
+        !m_storage_find_slots_overlap(arena, &next_cursor, item_size)) {
       break;
     }
 
-    if (is_storage_wrapped && next_cursor.offset >= initial_offset) {
-      /* Couldn't find a hole with appropriate size in the storage. */
+    if (is_storage_wrapped && next_cursor.offset >= initial_cursor.offset) {
+      /*
+       * Couldn't find a hole with appropriate size in the arena.
+       * m_storage_find_slots_overlap() may have already advanced
+       * arena->next_cursor, so restore it, since nothing has been allocated.
+       */
+      m_storage_cursor_store(arena->next_cursor, &initial_cursor);
       return 0;
     }
   }
@@ -559,31 +1459,44 @@ static int m_storage_allocate(struct m_storage *const storage,
    * Set up item->payload.cursor and register the item
    * in acquired_items skiplist.
    */
-  assert(next_cursor.offset < storage_size);
+  assert(next_cursor.offset < end_offset);
   item->payload.cursor = next_cursor;
 
   if (has_overwrite_protection) {
     m_item_skiplist_add(item);
   }
 
-  /* Update storage->next_cursor */
-  assert(next_cursor.offset <= storage_size - item_size);
+  /* Update arena->next_cursor */
+  assert(next_cursor.offset <= end_offset - item_size);
   next_cursor.offset += item_size;
-  *storage->next_cursor = next_cursor;
+  m_storage_cursor_store(arena->next_cursor, &next_cursor);
+
+  if (is_storage_wrapped) {
+    m_stats_inc(stats, M_STATS_STORAGE_WRAPS);
+  }
 
 
   /*
    * Optimization trick: touch the first byte of the item in the allocated space
-   * under the cache->lock, so the OS pre-fetches this memory
+   * under the arena->lock, so the OS pre-fetches this memory
    * from the underlying file in-order.
    */
   char *const ptr = m_storage_get_ptr(storage, item->payload.cursor.offset);
-  assert(ptr < storage->data + storage_size);
+  assert(ptr < storage->data + end_offset);
   ptr[0] = 0;
 
   return 1;
 }
 
+static int m_storage_payload_equal(const struct m_storage_payload *const a,
+    const struct m_storage_payload *const b)
+{
+  return a->cursor.wrap_count == b->cursor.wrap_count &&
+      a->cursor.offset == b->cursor.offset &&
+      a->expiration_time == b->expiration_time &&
+      a->size == b->size;
+}
+
 /*
  * Checks payload correctness.
  *
@@ -594,7 +1507,7 @@ static int m_storage_allocate(struct m_storage *const storage,
  *
  * Returns non-zero on successful check, zero on failure.
  */
-static int m_storage_payload_check(const struct m_storage *const storage,
+static int m_storage_payload_check(const struct m_storage_arena *const arena,
     const struct m_storage_cursor *const next_cursor,
     const struct m_storage_payload *const payload, const uint64_t current_time)
 {
@@ -616,7 +1529,12 @@ static int m_storage_payload_check(const struct m_storage *const storage,
       return 0;
     }
 
-    max_offset = storage->size;
+    max_offset = arena->end_offset;
+  }
+
+  if (payload->cursor.offset < arena->start_offset) {
+    /* The item has invalid offset. */
+    return 0;
   }
 
   if (payload->cursor.offset > max_offset) {
@@ -644,6 +1562,23 @@ static size_t m_storage_metadata_get_size(const size_t key_size) {
   return key_size + const_metadata_size;
 }
 
+/*
+ * Returns the hash seed and stores hash algorithm identifier
+ * into hash_algorithm unless it is NULL.
+ *
+ * Both values are read from a single word, so they always match each other.
+ */
+static uint64_t m_storage_get_hash_seed(const struct m_storage *const storage,
+    int *const hash_algorithm)
+{
+  const uint64_t v = p_atomic_counter_load(&storage->hash_seed);
+
+  if (hash_algorithm != NULL) {
+    *hash_algorithm = (int)(v >> M_INDEX_HASH_ALGORITHM_SHIFT);
+  }
+  return v & M_INDEX_HASH_SEED_MASK;
+}
+
 static size_t m_storage_metadata_get_digest(const uint64_t hash_seed,
     const size_t key_size, const size_t payload_size)
 {
@@ -660,7 +1595,8 @@ static void m_storage_metadata_save(
   assert(((uintptr_t)ptr) <= UINTPTR_MAX - metadata_size);
   (void)metadata_size;
 
-  const size_t digest = m_storage_metadata_get_digest(storage->hash_seed,
+  const size_t digest = m_storage_metadata_get_digest(
+      m_storage_get_hash_seed(storage, NULL),
       key->size, payload->size);
   memcpy(ptr, &digest, sizeof(digest));
 
@@ -709,7 +1645,8 @@ static int m_storage_metadata_check(const struct m_storage *const storage,
   const char *ptr = m_storage_get_ptr(storage, payload->cursor.offset);
   assert(((uintptr_t)ptr) <= UINTPTR_MAX - metadata_size);
 
-  const size_t digest = m_storage_metadata_get_digest(storage->hash_seed,
+  const size_t digest = m_storage_metadata_get_digest(
+      m_storage_get_hash_seed(storage, NULL),
       key->size, payload->size);
 
   if (memcmp(ptr, &digest, sizeof(digest))) {
@@ -727,6 +1664,31 @@ static int m_storage_metadata_check(const struct m_storage *const storage,
 }
 
 
+/*
+ * Prefetches storage metadata for the given payload into CPU cache.
+ *
+ * The payload may be invalid, so the prefetch is skipped for payloads
+ * pointing outside the storage.
+ */
+static void m_storage_metadata_prefetch(const struct m_storage *const storage,
+    const struct m_storage_payload *const payload, const size_t key_size)
+{
+  const size_t offset = payload->cursor.offset;
+  if (offset >= storage->size) {
+    return;
+  }
+
+  const char *const ptr = m_storage_get_ptr(storage, offset);
+  size_t metadata_size = m_storage_metadata_get_size(key_size);
+  if (metadata_size > storage->size - offset) {
+    metadata_size = storage->size - offset;
+  }
+  for (size_t i = 0; i < metadata_size; i += C_CACHE_LINE_SIZE) {
+    p_memory_prefetch(ptr + i);
+  }
+}
+
+
 /*******************************************************************************
  * Working set defragmentation API.
  *
@@ -748,8 +1710,7 @@ static int m_storage_metadata_check(const struct m_storage *const storage,
  * The defragmentation won't help for caches containing a lot of large items
  * with sizes much larger than VM page size (hundreds of KBs or larger).
  *
- * TODO: automatically adjust estimated working set size in runtime. Currently
- * it can be set only at cache opening.
+ * The estimated working set size may be adjusted in runtime by m_autosize.
  ******************************************************************************/
 
 static void m_ws_fix_hot_data_size(size_t *const hot_data_size,
@@ -761,46 +1722,496 @@ static void m_ws_fix_hot_data_size(size_t *const hot_data_size,
 }
 
 /*
- * Defragments the given item, i.e. moves it into the front of storage's
- * free space.
+ * Access frequency sketch for items outside of hot data space.
  *
- * There is a race condition possible when another thread adds new item
- * with the given key before the defragmentation for this item is complete.
- * In this case new item will become overwritten by the old item after
- * the defragmentation is complete. But since this is a cache, not a persistent
- * storage, this should be OK - subsequent readers should notice old value
- * and overwrite it with new value.
+ * This is a count-min sketch with 4-bit counters similar to the one used
+ * in TinyLFU ( http://arxiv.org/abs/1512.00727 ). Counters are periodically
+ * halved, so the sketch estimates the number of recent accesses.
  *
- * Since this operation can be quite costly, avoid performing it in hot paths.
+ * Counters are updated via CAS, so they never exceed M_WS_SKETCH_COUNTER_MAX
+ * and never overflow into neighbour counters. Accesses are counted for aging
+ * purposes only occasionally, so readers don't contend for a shared
+ * cache line. Counters are halved by the deferred defragmentation thread,
+ * so readers don't pay for aging.
  */
-static void m_ws_defragment(struct ybc *const cache,
-    const struct ybc_item *const item, const struct ybc_key *const key)
+struct m_ws_sketch
 {
-  struct ybc_value value;
+  /*
+   * Counters packed into 64-bit words, 16 counters per word.
+   */
+  uint64_t *words;
 
-  ybc_item_get_value(item, &value);
-  (void)ybc_item_set(cache, key, &value);
-}
+  /*
+   * The number of counters minus 1. The number of counters is a power of 2.
+   */
+  size_t counters_mask;
+
+  /*
+   * The estimated number of counter updates since the last aging.
+   */
+  size_t updates_count;
+
+  /*
+   * Counters are halved when updates_count reaches this value.
+   */
+  size_t aging_threshold;
+
+  /*
+   * Set when counters should be halved by m_ws_sketch_age().
+   */
+  size_t is_aging_requested;
+};
 
 /*
- * Checks whether the item pointed by the given payload should be defragmented.
+ * The number of counters updated per access.
+ */
+#define M_WS_SKETCH_HASHES_COUNT 4
+
+#define M_WS_SKETCH_COUNTER_MAX 15
+
+static void m_ws_sketch_init(struct m_ws_sketch *const sketch,
+    const size_t items_count)
+{
+  size_t counters_count = C_WS_SKETCH_MIN_COUNTERS_COUNT;
+  while (counters_count < items_count &&
+      counters_count < C_WS_SKETCH_MAX_COUNTERS_COUNT) {
+    counters_count *= 2;
+  }
+
+  /*
+   * Physical memory is attached lazily to the sketch, so it doesn't occupy
+   * RAM if the defragmentation is disabled.
+   */
+  sketch->words = p_memory_alloc_anonymous(counters_count / 2);
+  sketch->counters_mask = counters_count - 1;
+  sketch->updates_count = 0;
+  sketch->aging_threshold = counters_count * C_WS_SKETCH_AGING_FACTOR;
+  sketch->is_aging_requested = 0;
+}
+
+static void m_ws_sketch_destroy(struct m_ws_sketch *const sketch)
+{
+  p_memory_unmap(sketch->words, (sketch->counters_mask + 1) / 2);
+}
+
+static uint64_t m_ws_sketch_hash(const struct m_storage_payload *const payload)
+{
+  /*
+   * An item is identified by its' location in the storage.
+   * Mix location bits with MurmurHash3 finalizer.
+   */
+  uint64_t h = payload->cursor.offset ^
+      ((uint64_t)payload->cursor.wrap_count << 48);
+  h = (h ^ (h >> 33)) * 0xff51afd7ed558ccd;
+  h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53;
+  return h ^ (h >> 33);
+}
+
+/*
+ * Halves all the counters in the sketch if aging has been requested.
+ *
+ * Must be called only by the deferred defragmentation thread.
+ */
+static void m_ws_sketch_age(struct m_ws_sketch *const sketch)
+{
+  if (!p_atomic_load(&sketch->is_aging_requested)) {
+    return;
+  }
+
+  const size_t words_count = (sketch->counters_mask + 1) / 16;
+
+  for (size_t i = 0; i < words_count; ++i) {
+    uint64_t *const word_ptr = &sketch->words[i];
+    uint64_t word = p_atomic_counter_load(word_ptr);
+
+    /* Zero words are skipped, so untouched pages aren't dirtied. */
+    while (word != 0 && !p_atomic_counter_cas(word_ptr, word,
+        (word >> 1) & 0x7777777777777777)) {
+      word = p_atomic_counter_load(word_ptr);
+    }
+  }
+
+  p_atomic_store(&sketch->is_aging_requested, 0);
+}
+
+/*
+ * Registers an access to the item with the given payload.
+ *
+ * Returns the estimated number of recent accesses to the item including
+ * the registered one.
+ */
+static size_t m_ws_sketch_add(struct m_ws_sketch *const sketch,
+    const struct m_storage_payload *const payload)
+{
+  const uint64_t h = m_ws_sketch_hash(payload);
+  const size_t h1 = (size_t)h;
+  const size_t h2 = (size_t)(h >> 32) | 1;
+  size_t indexes[M_WS_SKETCH_HASHES_COUNT];
+  size_t min_count = M_WS_SKETCH_COUNTER_MAX;
+
+  for (size_t i = 0; i < M_WS_SKETCH_HASHES_COUNT; ++i) {
+    indexes[i] = (h1 + i * h2) & sketch->counters_mask;
+    const size_t shift = (indexes[i] % 16) * 4;
+    const uint64_t word = p_atomic_counter_load(
+        &sketch->words[indexes[i] / 16]);
+    const size_t count = (word >> shift) & 0xf;
+    if (count < min_count) {
+      min_count = count;
+    }
+  }
+
+  if (min_count == M_WS_SKETCH_COUNTER_MAX) {
+    return min_count;
+  }
+
+  /*
+   * Conservative update: increment only the smallest counters. This reduces
+   * overestimation for rarely accessed items sharing counters
+   * with frequently accessed items.
+   *
+   * Counters incremented concurrently by other threads are skipped,
+   * so min_count + 1 never exceeds M_WS_SKETCH_COUNTER_MAX.
+   */
+  for (size_t i = 0; i < M_WS_SKETCH_HASHES_COUNT; ++i) {
+    const size_t shift = (indexes[i] % 16) * 4;
+    uint64_t *const word_ptr = &sketch->words[indexes[i] / 16];
+    uint64_t word = p_atomic_counter_load(word_ptr);
+    while (((word >> shift) & 0xf) == min_count) {
+      if (p_atomic_counter_cas(word_ptr, word,
+          word + ((uint64_t)1 << shift))) {
+        break;
+      }
+      word = p_atomic_counter_load(word_ptr);
+    }
+  }
+
+  return min_count + 1;
+}
+
+/*
+ * Counts an update of the sketch for aging purposes.
+ *
+ * Returns 1 if aging has been requested. In this case the caller must wake up
+ * the deferred defragmentation thread, which calls m_ws_sketch_age().
+ */
+static int m_ws_sketch_count_update(struct m_ws_sketch *const sketch)
+{
+  if ((p_rand() & (C_WS_SKETCH_UPDATES_SAMPLING_RATE - 1)) != 0) {
+    return 0;
+  }
+
+  const size_t updates_count = p_atomic_add(&sketch->updates_count,
+      C_WS_SKETCH_UPDATES_SAMPLING_RATE);
+  if (updates_count >= sketch->aging_threshold &&
+      p_atomic_cas(&sketch->updates_count, updates_count, 0)) {
+    p_atomic_store(&sketch->is_aging_requested, 1);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*
+ * A candidate for deferred defragmentation.
+ */
+struct m_ws_candidate
+{
+  /*
+   * Sequence number for synchronizing writers with the reader.
+   * See m_ws_queue_push() for details.
+   */
+  size_t seq;
+
+  /*
+   * The item's payload at the time it has been queued. The item is skipped
+   * if its' payload changes before the defragmentation.
+   */
+  struct m_storage_payload payload;
+
+  size_t key_size;
+  char key[C_WS_QUEUE_MAX_KEY_SIZE];
+};
+
+/*
+ * A bounded lock-free queue of defragmentation candidates.
+ *
+ * Threads reading items push candidates into the queue, while a background
+ * thread pops them and defragments them in batches. So readers don't wait
+ * for storage allocation and item copying.
+ *
+ * This is Dmitry Vyukov's bounded MPMC queue
+ * ( http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue )
+ * specialized for a single reader.
+ */
+struct m_ws_queue
+{
+  /*
+   * C_WS_QUEUE_SIZE candidates. NULL if the defragmentation is disabled.
+   */
+  struct m_ws_candidate *candidates;
+
+  /*
+   * Monotonically increasing positions for the next push and pop.
+   *
+   * pop_pos is accessed only by the background thread.
+   */
+  size_t push_pos;
+  size_t pop_pos;
+
+  /*
+   * The cache to defragment.
+   */
+  struct ybc *cache;
+
+  /*
+   * Access frequency sketch, which is aged by the background thread.
+   */
+  struct m_ws_sketch *sketch;
+
+  /*
+   * A wait word for the background thread. It is changed each time
+   * the thread is woken up.
+   */
+  uint32_t wake_word;
+
+  /*
+   * Set when the background thread is about to sleep or sleeps
+   * on wake_word, so it must be woken up by m_ws_queue_wake().
+   */
+  size_t is_sleeping;
+
+  /*
+   * Set when the background thread should be stopped.
+   */
+  size_t is_stopped;
+
+  struct p_thread defragment_thread;
+};
+
+/*
+ * Defined in the Cache API section, since it relies on item acquisition.
+ */
+static void m_ws_defragment_batch(struct ybc *cache,
+    const struct m_ws_candidate *candidates, size_t count);
+
+/*
+ * Wakes up the background thread if it sleeps.
+ *
+ * Must be called after publishing new work for the background thread.
+ */
+static void m_ws_queue_wake(struct m_ws_queue *const queue)
+{
+  /*
+   * The published work must become visible before checking is_sleeping.
+   * This pairs with p_memory_barrier() in m_ws_queue_thread_func().
+   */
+  p_memory_barrier();
+  if (p_atomic_load(&queue->is_sleeping) &&
+      p_atomic_cas(&queue->is_sleeping, 1, 0)) {
+    p_wait_word_wake_all(&queue->wake_word);
+  }
+}
+
+/*
+ * Pushes the item with the given key and payload into the queue.
+ *
+ * Returns 0 if the queue is full or the key is too large.
+ * Otherwise returns 1.
+ */
+static int m_ws_queue_push(struct m_ws_queue *const queue,
+    const struct ybc_key *const key,
+    const struct m_storage_payload *const payload)
+{
+  if (key->size > C_WS_QUEUE_MAX_KEY_SIZE) {
+    return 0;
+  }
+
+  size_t pos = p_atomic_load(&queue->push_pos);
+  for (;;) {
+    struct m_ws_candidate *const candidate =
+        &queue->candidates[pos & (C_WS_QUEUE_SIZE - 1)];
+
+    /*
+     * The candidate's seq equals to pos if it is free for the push at pos.
+     * It is smaller than pos if it still contains a candidate pushed
+     * at pos - C_WS_QUEUE_SIZE, i.e. the queue is full.
+     */
+    const size_t seq = p_atomic_load(&candidate->seq);
+    if (seq == pos) {
+      if (p_atomic_cas(&queue->push_pos, pos, pos + 1)) {
+        candidate->payload = *payload;
+        candidate->key_size = key->size;
+        memcpy(candidate->key, key->ptr, key->size);
+
+        /* Publish the candidate to the reader. */
+        p_atomic_store(&candidate->seq, pos + 1);
+        m_ws_queue_wake(queue);
+        return 1;
+      }
+    }
+    else if ((ptrdiff_t)(seq - pos) < 0) {
+      return 0;
+    }
+    pos = p_atomic_load(&queue->push_pos);
+  }
+}
+
+/*
+ * Pops a candidate from the queue into dst.
+ *
+ * Must be called only by the background thread.
+ *
+ * Returns 0 if the queue is empty. Otherwise returns 1.
+ */
+static int m_ws_queue_pop(struct m_ws_queue *const queue,
+    struct m_ws_candidate *const dst)
+{
+  const size_t pos = queue->pop_pos;
+  struct m_ws_candidate *const candidate =
+      &queue->candidates[pos & (C_WS_QUEUE_SIZE - 1)];
+
+  if (p_atomic_load(&candidate->seq) != pos + 1) {
+    /* The queue is empty or the candidate is being pushed. */
+    return 0;
+  }
+
+  *dst = *candidate;
+
+  /* Free the candidate for the push at pos + C_WS_QUEUE_SIZE. */
+  p_atomic_store(&candidate->seq, pos + C_WS_QUEUE_SIZE);
+  queue->pop_pos = pos + 1;
+  return 1;
+}
+
+/*
+ * Returns 1 if the queue contains candidates ready for popping.
+ *
+ * Must be called only by the background thread.
+ */
+static int m_ws_queue_has_candidates(struct m_ws_queue *const queue)
+{
+  const size_t pos = queue->pop_pos;
+  const struct m_ws_candidate *const candidate =
+      &queue->candidates[pos & (C_WS_QUEUE_SIZE - 1)];
+
+  return p_atomic_load(&candidate->seq) == pos + 1;
+}
+
+static void m_ws_queue_thread_func(void *const ctx)
+{
+  struct m_ws_queue *const queue = ctx;
+  struct m_ws_candidate batch[C_ITEM_SET_MULTI_BATCH_SIZE];
+
+  for (;;) {
+    /*
+     * Sleep until new candidates are pushed or aging is requested.
+     * The re-check after setting is_sleeping pairs with m_ws_queue_wake(),
+     * so wakeups aren't lost.
+     */
+    uint32_t wake_word = p_wait_word_get(&queue->wake_word);
+    p_atomic_store(&queue->is_sleeping, 1);
+    p_memory_barrier();
+    if (!p_atomic_load(&queue->is_stopped) &&
+        !m_ws_queue_has_candidates(queue) &&
+        !p_atomic_load(&queue->sketch->is_aging_requested)) {
+      p_wait_word_wait(&queue->wake_word, wake_word, UINT64_MAX);
+    }
+    p_atomic_store(&queue->is_sleeping, 0);
+
+    /*
+     * Give readers a chance to push more candidates, so they are
+     * defragmented in larger batches.
+     */
+    wake_word = p_wait_word_get(&queue->wake_word);
+    if (!p_atomic_load(&queue->is_stopped)) {
+      p_wait_word_wait(&queue->wake_word, wake_word,
+          C_WS_QUEUE_DRAIN_INTERVAL);
+    }
+    if (p_atomic_load(&queue->is_stopped)) {
+      break;
+    }
+
+    for (;;) {
+      size_t count = 0;
+      while (count < C_ITEM_SET_MULTI_BATCH_SIZE &&
+          m_ws_queue_pop(queue, &batch[count])) {
+        ++count;
+      }
+      if (count == 0) {
+        break;
+      }
+      m_ws_defragment_batch(queue->cache, batch, count);
+    }
+
+    m_ws_sketch_age(queue->sketch);
+  }
+}
+
+/*
+ * Initializes the queue and starts the background thread if is_enabled
+ * is set.
+ */
+static void m_ws_queue_init(struct m_ws_queue *const queue,
+    struct ybc *const cache, struct m_ws_sketch *const sketch,
+    const int is_enabled)
+{
+  queue->push_pos = 0;
+  queue->pop_pos = 0;
+  queue->cache = cache;
+  queue->sketch = sketch;
+
+  if (!is_enabled) {
+    queue->candidates = NULL;
+    return;
+  }
+
+  queue->candidates = p_malloc(sizeof(queue->candidates[0]) * C_WS_QUEUE_SIZE);
+  for (size_t i = 0; i < C_WS_QUEUE_SIZE; ++i) {
+    queue->candidates[i].seq = i;
+  }
+
+  queue->wake_word = 0;
+  queue->is_sleeping = 0;
+  queue->is_stopped = 0;
+  p_thread_init_and_start(&queue->defragment_thread, &m_ws_queue_thread_func,
+      queue);
+}
+
+/*
+ * Stops the background thread. Candidates remaining in the queue
+ * are dropped.
+ */
+static void m_ws_queue_destroy(struct m_ws_queue *const queue)
+{
+  if (queue->candidates != NULL) {
+    p_atomic_store(&queue->is_stopped, 1);
+    p_wait_word_wake_all(&queue->wake_word);
+    p_thread_join_and_destroy(&queue->defragment_thread);
+    p_free(queue->candidates);
+  }
+}
+
+/*
+ * Checks whether the item pointed by the given payload should be defragmented.
  *
  * Returns 1 if the item should be defragmented, i.e. should be moved
  * to the front of the storage. Otherwise returns 0.
  */
-static int m_ws_should_defragment(const struct m_storage *const storage,
+static int m_ws_should_defragment(const struct m_storage_arena *const arena,
     const struct m_storage_cursor *const next_cursor,
-    const struct m_storage_payload *const payload, const size_t hot_data_size)
+    const struct m_storage_payload *const payload, const size_t hot_data_size,
+    struct m_ws_queue *const queue)
 {
   if (hot_data_size == 0) {
     /* Defragmentation is disabled. */
     return 0;
   }
 
+  const size_t arena_size = arena->end_offset - arena->start_offset;
   const size_t distance =
       (next_cursor->offset >= payload->cursor.offset) ?
       (next_cursor->offset - payload->cursor.offset) :
-      (storage->size - (payload->cursor.offset - next_cursor->offset));
+      (arena_size - (payload->cursor.offset - next_cursor->offset));
 
   if (distance < hot_data_size) {
     /* Do not defragment recently added or defragmented items. */
@@ -812,16 +2223,21 @@ static int m_ws_should_defragment(const struct m_storage *const storage,
     return 0;
   }
 
-  /*
-   * It is OK using non-thread-safe and non-reentrant rand() here,
-   * since we do not need reproducible sequence of random values.
-   */
-  if ((rand() % 100) >= C_WS_DEFRAGMENT_PROBABILITY) {
+  const size_t access_count = m_ws_sketch_add(queue->sketch, payload);
+  if (m_ws_sketch_count_update(queue->sketch)) {
+    m_ws_queue_wake(queue);
+  }
+
+  if (access_count < C_WS_MIN_ACCESS_COUNT) {
+    /* Do not defragment one-off items. */
+    return 0;
+  }
+
+  if ((p_rand() % 100) >= access_count * C_WS_DEFRAGMENT_PROBABILITY) {
     /*
      * Probabalistically skip items to be defragmented.
-     * This way one-off items (i.e. items requested only once) are likely
-     * to be skipped, while frequently accessed items will be eventually
-     * defragmented.
+     * This spreads defragmentation of frequently accessed items over time,
+     * while the most frequently accessed items are defragmented first.
      */
     return 0;
   }
@@ -865,14 +2281,25 @@ static void m_key_digest_clear(struct m_key_digest *const key_digest)
 }
 
 static void m_key_digest_get(struct m_key_digest *const key_digest,
-    const uint64_t hash_seed, const struct ybc_key *const key)
+    const int hash_algorithm, const uint64_t hash_seed,
+    const struct ybc_key *const key)
 {
-  key_digest->digest = m_hash_get(hash_seed, key->ptr, key->size);
+  key_digest->digest = m_hash_get(hash_algorithm, hash_seed, key->ptr,
+      key->size);
   if (m_key_digest_is_empty(key_digest)) {
     ++key_digest->digest;
   }
 }
 
+static void m_storage_key_digest_get(const struct m_storage *const storage,
+    struct m_key_digest *const key_digest, const struct ybc_key *const key)
+{
+  int hash_algorithm;
+  const uint64_t hash_seed = m_storage_get_hash_seed(storage, &hash_algorithm);
+
+  m_key_digest_get(key_digest, hash_algorithm, hash_seed, key);
+}
+
 static size_t m_key_digest_mod(const struct m_key_digest *const key_digest,
     const size_t n)
 {
@@ -890,6 +2317,15 @@ static size_t m_key_digest_mod(const struct m_key_digest *const key_digest,
  */
 static const size_t M_MAP_BUCKET_MASK = C_MAP_BUCKET_SIZE - 1;
 
+/*
+ * Reference bits for all slots in a bucket must fit a single size_t
+ * on all supported platforms. This is the only upper limit
+ * for C_MAP_BUCKET_SIZE.
+ */
+#if C_MAP_BUCKET_SIZE > 32
+#error "C_MAP_BUCKET_SIZE mustn't exceed 32"
+#endif
+
 /*
  * The size of a compound map item, which consists of key digest
  * and storage payload.
@@ -898,29 +2334,61 @@ static const size_t M_MAP_BUCKET_MASK = C_MAP_BUCKET_SIZE - 1;
     sizeof(struct m_storage_payload))
 
 /*
- * The size of aux data in the map file.
+ * The size of aux data in the map file for the given number of storage arenas.
  *
  * Aux data consists of the following items:
  * - m_storage_cursor
  * - hash_seed
+ * - (arenas_count - 1) m_storage_cursor items for the remaining
+ *   storage arenas. See m_storage_arena for details.
  */
-#define M_MAP_AUX_DATA_SIZE (sizeof(struct m_storage_cursor) + sizeof(uint64_t))
+#define M_MAP_AUX_DATA_SIZE(arenas_count) \
+    (sizeof(struct m_storage_cursor) * (arenas_count) + sizeof(uint64_t))
 
 /*
  * The maximum allowed number of slots in the map.
  */
-static const size_t M_MAP_SLOTS_COUNT_LIMIT = (SIZE_MAX - M_MAP_AUX_DATA_SIZE) /
-    M_MAP_ITEM_SIZE;
+static const size_t M_MAP_SLOTS_COUNT_LIMIT = (SIZE_MAX -
+    M_MAP_AUX_DATA_SIZE(C_CONFIG_MAX_STORAGE_ARENAS_COUNT)) / M_MAP_ITEM_SIZE;
+
+/*
+ * CLOCK ( http://en.wikipedia.org/wiki/Page_replacement_algorithm#Clock )
+ * state for a map bucket.
+ *
+ * Like sequence counters, CLOCK state isn't persisted in the index file.
+ * All items start unreferenced after the cache is opened.
+ */
+struct m_map_clock
+{
+  /*
+   * A bitmask of slots accessed since the hand passed them the last time.
+   *
+   * Readers set bits concurrently, so the bitmask must be modified only
+   * via atomic operations.
+   */
+  size_t refs;
+
+  /*
+   * The offset of the next slot to check in the bucket.
+   *
+   * It is modified only by the writer owning the bucket.
+   */
+  size_t hand;
+};
 
 /*
  * Hash map, which maps key digests to cache items from the storage.
  *
- * The code below intentionally omits serialization of concurrent access
- * to key_digests and payloads, i.e. it intentially allows race conditions,
- * which may lead to broken key_digest and/or payload values.
- * Such breakage is expected - it is automatically recovered by clearing broken
- * slots. m_storage_payload_check() and m_storage_metadata_check() are used
- * for detecting broken slots in the map.
+ * Concurrent access to buckets is serialized via per-bucket sequence
+ * counters ( http://en.wikipedia.org/wiki/Seqlock ). Writers exclusively own
+ * a bucket while its' sequence counter is odd. Readers don't write shared
+ * memory - they just retry reading the bucket if its' sequence counter
+ * has been changed during the read. So readers always obtain consistent
+ * key_digest and payload pairs.
+ *
+ * Slots still may be broken after program crash or may point to overwritten
+ * storage space. m_storage_payload_check() and m_storage_metadata_check()
+ * are used for detecting such slots.
  */
 struct m_map
 {
@@ -938,6 +2406,23 @@ struct m_map
    * Slots' payloads.
    */
   struct m_storage_payload *payloads;
+
+  /*
+   * Per-bucket sequence counters. The counter is odd while the bucket
+   * is being modified.
+   *
+   * Counters aren't persisted in the index file, since they are meaningful
+   * only for threads concurrently accessing the map.
+   */
+  size_t *bucket_seqs;
+
+  /*
+   * Per-bucket CLOCK state used for victim selection in full buckets.
+   *
+   * NULL if CLOCK eviction is disabled. In this case the slot expiring
+   * first is evicted.
+   */
+  struct m_map_clock *bucket_clocks;
 };
 
 static void m_map_fix_slots_count(size_t *const slots_count,
@@ -973,7 +2458,7 @@ static void m_map_fix_slots_count(size_t *const slots_count,
 
 static void m_map_init(struct m_map *const map, const size_t slots_count,
     struct m_key_digest *const key_digests,
-    struct m_storage_payload *const payloads)
+    struct m_storage_payload *const payloads, const int has_clock_eviction)
 {
   assert(C_MAP_BUCKET_SIZE == M_MAP_BUCKET_MASK + 1);
   assert((C_MAP_BUCKET_SIZE & M_MAP_BUCKET_MASK) == 0);
@@ -981,42 +2466,263 @@ static void m_map_init(struct m_map *const map, const size_t slots_count,
   map->slots_count = slots_count;
   map->key_digests = key_digests;
   map->payloads = payloads;
+  map->bucket_clocks = NULL;
+
+  if (slots_count == 0) {
+    /* The map is disabled. */
+    map->bucket_seqs = NULL;
+    return;
+  }
+
+  const size_t buckets_count = slots_count / C_MAP_BUCKET_SIZE;
+  const size_t bucket_seqs_size = buckets_count * sizeof(map->bucket_seqs[0]);
+  map->bucket_seqs = p_malloc(bucket_seqs_size);
+  memset(map->bucket_seqs, 0, bucket_seqs_size);
+
+  if (has_clock_eviction) {
+    const size_t bucket_clocks_size = buckets_count *
+        sizeof(map->bucket_clocks[0]);
+    map->bucket_clocks = p_malloc(bucket_clocks_size);
+    memset(map->bucket_clocks, 0, bucket_clocks_size);
+  }
 }
 
 static void m_map_destroy(struct m_map *const map)
 {
+  p_free(map->bucket_clocks);
+  map->bucket_clocks = NULL;
+  p_free(map->bucket_seqs);
+  map->bucket_seqs = NULL;
   map->slots_count = 0;
   map->key_digests = NULL;
   map->payloads = NULL;
 }
 
+static size_t *m_map_get_bucket_seq(const struct m_map *const map,
+    const size_t start_index)
+{
+  assert(start_index % C_MAP_BUCKET_SIZE == 0);
+  assert(start_index < map->slots_count);
+  return &map->bucket_seqs[start_index / C_MAP_BUCKET_SIZE];
+}
+
 /*
- * Looks up slot index for the given key digest.
+ * Obtains exclusive access to the bucket with the given start_index.
  *
- * Sets start_index to the index of the first slot in the bucket,
- * which contains the given key digest.
+ * The odd sequence counter acts as a per-bucket spinlock: concurrent writers
+ * spin with p_thread_yield() until it becomes even, while readers retry
+ * until it becomes even. So a writer preempted between this call and
+ * m_map_bucket_write_end() stalls all the readers and writers of the bucket
+ * until it is scheduled again. The critical section must be kept short -
+ * it mustn't block, allocate memory or touch the storage.
  *
- * Sets slot_index to the index of the slot containing the given key.
- *
- * Return non-zero on success. Returns 0 if the given key cannot be found
- * in the map.
+ * Returns the bucket's sequence counter value, which must be passed
+ * to m_map_bucket_write_end().
  */
-static int m_map_lookup_slot_index(const struct m_map *const map,
-    const struct m_key_digest *const key_digest, size_t *const start_index,
-    size_t *const slot_index)
+static size_t m_map_bucket_write_begin(const struct m_map *const map,
+    const size_t start_index)
 {
-  assert(map->slots_count % C_MAP_BUCKET_SIZE == 0);
-  assert(map->slots_count >= C_MAP_BUCKET_SIZE);
-
-  *start_index = (m_key_digest_mod(key_digest, map->slots_count) &
-      ~M_MAP_BUCKET_MASK);
+  size_t *const seq_ptr = m_map_get_bucket_seq(map, start_index);
 
-  for (size_t i = 0; i < C_MAP_BUCKET_SIZE; ++i) {
-    const size_t current_index = *start_index + i;
-    assert(current_index < map->slots_count);
+  for (;;) {
+    const size_t seq = p_atomic_load(seq_ptr);
+    if ((seq & 1) == 0 && p_atomic_cas(seq_ptr, seq, seq + 1)) {
+      /*
+       * Bucket modifications mustn't become visible before the odd
+       * sequence counter.
+       */
+      p_memory_release_barrier();
+      return seq;
+    }
+    /* Another writer owns the bucket. */
+    p_thread_yield();
+  }
+}
+
+static void m_map_bucket_write_end(const struct m_map *const map,
+    const size_t start_index, const size_t seq)
+{
+  size_t *const seq_ptr = m_map_get_bucket_seq(map, start_index);
+
+  assert(*seq_ptr == seq + 1);
+  p_atomic_store(seq_ptr, seq + 2);
+}
+
+static struct m_map_clock *m_map_get_bucket_clock(
+    const struct m_map *const map, const size_t start_index)
+{
+  assert(map->bucket_clocks != NULL);
+  assert(start_index % C_MAP_BUCKET_SIZE == 0);
+  assert(start_index < map->slots_count);
+  return &map->bucket_clocks[start_index / C_MAP_BUCKET_SIZE];
+}
+
+/*
+ * Sets or clears the reference bit for the given slot.
+ *
+ * May be called concurrently by readers and the writer owning the bucket.
+ */
+static void m_map_clock_set_ref(const struct m_map *const map,
+    const size_t start_index, const size_t slot_index, const int is_referenced)
+{
+  if (map->bucket_clocks == NULL) {
+    /* CLOCK eviction is disabled. */
+    return;
+  }
+
+  assert(slot_index >= start_index);
+  assert(slot_index - start_index < C_MAP_BUCKET_SIZE);
+
+  struct m_map_clock *const clock = m_map_get_bucket_clock(map, start_index);
+  const size_t bit = (size_t)1 << (slot_index - start_index);
+
+  for (;;) {
+    const size_t refs = p_atomic_load(&clock->refs);
+
+    /*
+     * Avoid dirtying the cache line shared among CPUs if the bit
+     * is already in the required state. This is the common case
+     * for frequently accessed items.
+     */
+    if (((refs & bit) != 0) == is_referenced) {
+      return;
+    }
+
+    const size_t new_refs = is_referenced ? (refs | bit) : (refs & ~bit);
+    if (p_atomic_cas(&clock->refs, refs, new_refs)) {
+      return;
+    }
+  }
+}
+
+/*
+ * Selects a victim slot in the full bucket with the given start_index
+ * using CLOCK algorithm.
+ *
+ * The caller must own the bucket.
+ */
+static size_t m_map_clock_select_victim(const struct m_map *const map,
+    const size_t start_index)
+{
+  struct m_map_clock *const clock = m_map_get_bucket_clock(map, start_index);
+  size_t hand = clock->hand;
+
+  /*
+   * The hand clears all the reference bits during the first pass
+   * over the bucket, so the victim is found during the second pass unless
+   * readers concurrently set bits back. Limit the number of passes
+   * in order to avoid starvation in this case.
+   */
+  for (size_t i = 0; i < 2 * C_MAP_BUCKET_SIZE; ++i) {
+    const size_t refs = p_atomic_load(&clock->refs);
+    const size_t bit = (size_t)1 << hand;
+
+    if ((refs & bit) == 0) {
+      break;
+    }
+
+    /* Give the slot the second chance. */
+    if (p_atomic_cas(&clock->refs, refs, refs & ~bit)) {
+      hand = (hand + 1) & M_MAP_BUCKET_MASK;
+    }
+  }
+
+  clock->hand = (hand + 1) & M_MAP_BUCKET_MASK;
+  return start_index + hand;
+}
+
+/*
+ * Vectorized bucket probes compare key digests as 64-bit integers, so they
+ * require m_key_digest to be a plain 64-bit digest. They also process
+ * 4 digests at a time, so smaller buckets are probed by the scalar code.
+ */
+#if C_MAP_BUCKET_SIZE >= 4
+
+#ifdef M_HAS_X86_INTRINSICS
+#define M_MAP_HAS_X86_PROBE
+#endif
+
+#ifdef M_HAS_NEON_INTRINSICS
+#define M_MAP_HAS_NEON_PROBE
+#endif
+
+#endif
+
+#ifdef M_MAP_HAS_X86_PROBE
+
+/*
+ * Returns a mask of slots in the bucket matching the given digest.
+ * The i-th bit of the mask corresponds to the i-th slot in the bucket.
+ */
+__attribute__((target("avx2")))
+static uint64_t m_map_bucket_match_avx2(const struct m_key_digest *const bucket,
+    const uint64_t digest)
+{
+  const __m256i d = _mm256_set1_epi64x((long long)digest);
+  uint64_t mask = 0;
+
+  for (size_t i = 0; i < C_MAP_BUCKET_SIZE; i += 4) {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)&bucket[i]);
+    const __m256i eq = _mm256_cmpeq_epi64(v, d);
+    const uint64_t m = (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(eq));
+    mask |= m << i;
+  }
+
+  return mask;
+}
 
-    if (m_key_digest_equal(&map->key_digests[current_index], key_digest)) {
-      *slot_index = current_index;
+/*
+ * SSE4.1 version of m_map_bucket_match_avx2().
+ */
+__attribute__((target("sse4.1")))
+static uint64_t m_map_bucket_match_sse41(
+    const struct m_key_digest *const bucket, const uint64_t digest)
+{
+  const __m128i d = _mm_set1_epi64x((long long)digest);
+  uint64_t mask = 0;
+
+  for (size_t i = 0; i < C_MAP_BUCKET_SIZE; i += 2) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)&bucket[i]);
+    const __m128i eq = _mm_cmpeq_epi64(v, d);
+    const uint64_t m = (unsigned int)_mm_movemask_pd(_mm_castsi128_pd(eq));
+    mask |= m << i;
+  }
+
+  return mask;
+}
+
+#endif
+
+#ifdef M_MAP_HAS_NEON_PROBE
+
+/*
+ * NEON version of m_map_bucket_match_avx2().
+ */
+static uint64_t m_map_bucket_match_neon(const struct m_key_digest *const bucket,
+    const uint64_t digest)
+{
+  const uint64x2_t d = vdupq_n_u64(digest);
+  uint64_t mask = 0;
+
+  for (size_t i = 0; i < C_MAP_BUCKET_SIZE; i += 2) {
+    const uint64x2_t v = vld1q_u64(&bucket[i].digest);
+    const uint64x2_t eq = vceqq_u64(v, d);
+    const uint64_t m = (vgetq_lane_u64(eq, 0) & 1) |
+        ((vgetq_lane_u64(eq, 1) & 1) << 1);
+    mask |= m << i;
+  }
+
+  return mask;
+}
+
+#endif
+
+static int m_map_bucket_find_scalar(const struct m_key_digest *const bucket,
+    const struct m_key_digest *const key_digest, size_t *const index)
+{
+  for (size_t i = 0; i < C_MAP_BUCKET_SIZE; ++i) {
+    if (m_key_digest_equal(&bucket[i], key_digest)) {
+      *index = i;
       return 1;
     }
   }
@@ -1024,14 +2730,112 @@ static int m_map_lookup_slot_index(const struct m_map *const map,
   return 0;
 }
 
+#if defined(M_MAP_HAS_X86_PROBE) || defined(M_MAP_HAS_NEON_PROBE)
+
+static int m_map_bucket_mask_to_index(const uint64_t mask,
+    size_t *const index)
+{
+  if (mask == 0) {
+    return 0;
+  }
+
+  /*
+   * The lowest set bit corresponds to the first matching slot,
+   * like in m_map_bucket_find_scalar().
+   */
+  *index = (size_t)__builtin_ctzll(mask);
+  return 1;
+}
+
+static int m_map_bucket_find_simd(const struct m_key_digest *const bucket,
+    const struct m_key_digest *const key_digest, size_t *const index)
+{
+#ifdef M_MAP_HAS_X86_PROBE
+  if (p_cpu_has_avx2()) {
+    return m_map_bucket_mask_to_index(
+        m_map_bucket_match_avx2(bucket, key_digest->digest), index);
+  }
+  if (p_cpu_has_sse41()) {
+    return m_map_bucket_mask_to_index(
+        m_map_bucket_match_sse41(bucket, key_digest->digest), index);
+  }
+  return m_map_bucket_find_scalar(bucket, key_digest, index);
+#else
+  return m_map_bucket_mask_to_index(
+      m_map_bucket_match_neon(bucket, key_digest->digest), index);
+#endif
+}
+
+#endif
+
+/*
+ * Looks up the given key digest in the bucket with C_MAP_BUCKET_SIZE slots.
+ *
+ * Compares the whole bucket at once with SIMD instructions if they are
+ * available. Falls back to scalar comparisons otherwise.
+ *
+ * On success stores the index of the first matching slot in the bucket
+ * into *index and returns 1. Otherwise returns 0.
+ */
+static int m_map_bucket_find(const struct m_key_digest *const bucket,
+    const struct m_key_digest *const key_digest, size_t *const index)
+{
+#if defined(M_MAP_HAS_X86_PROBE) || defined(M_MAP_HAS_NEON_PROBE)
+  return m_map_bucket_find_simd(bucket, key_digest, index);
+#else
+  return m_map_bucket_find_scalar(bucket, key_digest, index);
+#endif
+}
+
+static size_t m_map_get_start_index(const struct m_map *const map,
+    const struct m_key_digest *const key_digest)
+{
+  assert(map->slots_count % C_MAP_BUCKET_SIZE == 0);
+  assert(map->slots_count >= C_MAP_BUCKET_SIZE);
+
+  const size_t start_index = (m_key_digest_mod(key_digest, map->slots_count) &
+      ~M_MAP_BUCKET_MASK);
+  assert(start_index <= map->slots_count - C_MAP_BUCKET_SIZE);
+  return start_index;
+}
+
+/*
+ * Looks up slot index for the given key digest in the bucket
+ * with the given start_index.
+ *
+ * The caller must serialize access to the bucket.
+ */
+static int m_map_lookup_slot_index(const struct m_map *const map,
+    const struct m_key_digest *const key_digest, size_t *const start_index,
+    size_t *const slot_index)
+{
+  *start_index = m_map_get_start_index(map, key_digest);
+
+  size_t index;
+  if (!m_map_bucket_find(&map->key_digests[*start_index], key_digest,
+      &index)) {
+    return 0;
+  }
+
+  *slot_index = *start_index + index;
+  return 1;
+}
+
 /*
  * Adds the given payload with the given key_digest into the map.
+ *
+ * Returns 1 if a slot occupied by another key has been overwritten, because
+ * the bucket was full. Otherwise returns 0.
  */
-static void m_map_set(const struct m_map *const map,
+static int m_map_set(const struct m_map *const map,
     const struct m_key_digest *const key_digest,
     const struct m_storage_payload *const payload)
 {
   size_t start_index, slot_index;
+  int is_victim_overwritten = 0;
+
+  const size_t seq = m_map_bucket_write_begin(map,
+      m_map_get_start_index(map, key_digest));
 
   if (!m_map_lookup_slot_index(map, key_digest, &start_index, &slot_index)) {
     /* Try occupying the first empty slot in the bucket. */
@@ -1053,7 +2857,8 @@ static void m_map_set(const struct m_map *const map,
 
       /*
        * This code determines 'victim' slot, which will be overwritten
-       * in the case all slots in the bucket are occupied.
+       * in the case all slots in the bucket are occupied and CLOCK eviction
+       * is disabled.
        *
        * 'victim' slot has minimum expiration time, i.e. it contains an item,
        * which would expire first in the given bucket. We just 'accelerate' its'
@@ -1068,14 +2873,25 @@ static void m_map_set(const struct m_map *const map,
     if (i == C_MAP_BUCKET_SIZE) {
       /*
        * Couldn't find empty slot.
-       * Overwrite slot, which will expire sooner than other slots.
+       * Overwrite slot, which wasn't accessed recently if CLOCK eviction
+       * is enabled. Otherwise overwrite slot, which will expire sooner
+       * than other slots.
        */
-      slot_index = victim_index;
+      slot_index = (map->bucket_clocks == NULL) ? victim_index :
+          m_map_clock_select_victim(map, start_index);
+      is_victim_overwritten = 1;
     }
 
     map->key_digests[slot_index] = *key_digest;
+
+    /* The new item must earn its' reference bit via reads. */
+    m_map_clock_set_ref(map, start_index, slot_index, 0);
   }
   map->payloads[slot_index] = *payload;
+
+  m_map_bucket_write_end(map, start_index, seq);
+
+  return is_victim_overwritten;
 }
 
 static int m_map_remove(const struct m_map *const map,
@@ -1083,11 +2899,18 @@ static int m_map_remove(const struct m_map *const map,
 {
   size_t start_index, slot_index;
 
-  if (m_map_lookup_slot_index(map, key_digest, &start_index, &slot_index)) {
+  const size_t seq = m_map_bucket_write_begin(map,
+      m_map_get_start_index(map, key_digest));
+
+  const int is_found = m_map_lookup_slot_index(map, key_digest, &start_index,
+      &slot_index);
+  if (is_found) {
     m_key_digest_clear(&map->key_digests[slot_index]);
-    return 1;
   }
-  return 0;
+
+  m_map_bucket_write_end(map, start_index, seq);
+
+  return is_found;
 }
 
 /*
@@ -1100,22 +2923,64 @@ static int m_map_get(const struct m_map *const map,
     const struct m_key_digest *const key_digest,
     struct m_storage_payload *const payload)
 {
-  size_t start_index_unused, slot_index;
+  size_t start_index, slot_index;
 
-  if (!m_map_lookup_slot_index(map, key_digest, &start_index_unused,
-      &slot_index)) {
-    return 0;
+  const size_t *const seq_ptr = m_map_get_bucket_seq(map,
+      m_map_get_start_index(map, key_digest));
+
+  for (;;) {
+    const size_t seq = p_atomic_load(seq_ptr);
+    if (seq & 1) {
+      /* A writer is modifying the bucket. */
+      p_thread_yield();
+      continue;
+    }
+
+    const int is_found = m_map_lookup_slot_index(map, key_digest,
+        &start_index, &slot_index);
+    if (is_found) {
+      *payload = map->payloads[slot_index];
+    }
+
+    /*
+     * Bucket reads above mustn't be reordered with the sequence counter
+     * re-check below.
+     */
+    p_memory_acquire_barrier();
+    if (p_atomic_load(seq_ptr) == seq) {
+      if (is_found) {
+        m_map_clock_set_ref(map, start_index, slot_index, 1);
+      }
+      return is_found;
+    }
   }
-  *payload = map->payloads[slot_index];
+}
 
-  return 1;
+/*
+ * Prefetches the bucket for the given key_digest into CPU cache.
+ *
+ * This allows overlapping memory latencies when looking up multiple keys.
+ */
+static void m_map_prefetch(const struct m_map *const map,
+    const struct m_key_digest *const key_digest)
+{
+  const size_t start_index = (m_key_digest_mod(key_digest, map->slots_count) &
+      ~M_MAP_BUCKET_MASK);
+  const char *const bucket = (const char *)&map->key_digests[start_index];
+  const size_t bucket_size = C_MAP_BUCKET_SIZE * sizeof(struct m_key_digest);
+
+  for (size_t i = 0; i < bucket_size; i += C_CACHE_LINE_SIZE) {
+    p_memory_prefetch(bucket + i);
+  }
 }
 
 /*******************************************************************************
  * Map cache API.
  *
- * TODO: automatically adjust map cache size in runtime. Currently it can be set
- * only at cache opening.
+ * The map cache size may be adjusted in runtime by m_autosize. The memory
+ * for the maximum map cache size is reserved at cache opening, while only
+ * slots_count slots are in use. Physical memory is attached lazily
+ * to the reserved region, so unused slots don't occupy RAM.
  ******************************************************************************/
 
 static void m_map_cache_fix_slots_count(size_t *const slots_count,
@@ -1133,41 +2998,127 @@ static void m_map_cache_fix_slots_count(size_t *const slots_count,
   m_map_fix_slots_count(slots_count, SIZE_MAX);
 }
 
+/*
+ * Initializes the map_cache with slots_count slots, which may be grown
+ * up to max_slots_count slots in runtime.
+ */
 static void m_map_cache_init(struct m_map *const map_cache,
-    const size_t slots_count)
+    const size_t slots_count, const size_t max_slots_count,
+    const int has_clock_eviction, const int has_huge_pages)
 {
-  if (slots_count == 0) {
+  assert(slots_count <= max_slots_count);
+
+  if (max_slots_count == 0) {
     /* Map cache is disabled. */
-    m_map_init(map_cache, 0, NULL, NULL);
+    m_map_init(map_cache, 0, NULL, NULL, 0);
     return;
   }
 
-  assert(slots_count <= SIZE_MAX / M_MAP_ITEM_SIZE);
-  const size_t map_cache_size = slots_count * M_MAP_ITEM_SIZE;
+  assert(max_slots_count <= SIZE_MAX / M_MAP_ITEM_SIZE);
+  const size_t map_cache_size = max_slots_count * M_MAP_ITEM_SIZE;
 
-  struct m_key_digest *const key_digests = p_malloc(map_cache_size);
+  struct m_key_digest *const key_digests = has_huge_pages ?
+      p_memory_alloc_huge(map_cache_size) :
+      p_memory_alloc_anonymous(map_cache_size);
   struct m_storage_payload *const payloads = (struct m_storage_payload *)
-      (key_digests + slots_count);
+      (key_digests + max_slots_count);
 
   /*
-   * Though the code can gracefully handle invalid key digests and payloads,
-   * let's fill them with zeroes. This has the following benefits:
-   * - It will shut up valgrind regarding comparison with uninitialized memory.
-   * - It will force the OS attaching physical RAM to the allocated region
-   *   of memory. This eliminates possible minor pagefaults during the cache
-   *   warm-up ( http://en.wikipedia.org/wiki/Page_fault#Minor ).
+   * The allocated memory is already zeroed, but let's touch slots in use.
+   * This forces the OS attaching physical RAM to them, which eliminates
+   * possible minor pagefaults during the cache warm-up
+   * ( http://en.wikipedia.org/wiki/Page_fault#Minor ).
    */
-  memset(key_digests, 0, map_cache_size);
+  memset(key_digests, 0, slots_count * sizeof(key_digests[0]));
+  memset(payloads, 0, slots_count * sizeof(payloads[0]));
 
-  m_map_init(map_cache, slots_count, key_digests, payloads);
+  /*
+   * Per-bucket state is allocated for the maximum number of slots,
+   * so it remains valid after the map cache is grown.
+   */
+  m_map_init(map_cache, max_slots_count, key_digests, payloads,
+      has_clock_eviction);
+  map_cache->slots_count = slots_count;
 }
 
-static void m_map_cache_destroy(struct m_map *const map_cache)
+static void m_map_cache_destroy(struct m_map *const map_cache,
+    const size_t max_slots_count, const int has_huge_pages)
 {
-  p_free(map_cache->key_digests);
+  if (max_slots_count > 0) {
+    const size_t map_cache_size = max_slots_count * M_MAP_ITEM_SIZE;
+    if (has_huge_pages) {
+      p_memory_free_huge(map_cache->key_digests, map_cache_size);
+    }
+    else {
+      p_memory_unmap(map_cache->key_digests, map_cache_size);
+    }
+  }
   m_map_destroy(map_cache);
 }
 
+/*
+ * Changes the number of slots in use for the map_cache.
+ *
+ * Items' locations depend on the number of slots, so the remaining items
+ * may end up at wrong locations. The map_cache may be also concurrently
+ * accessed via the previous number of slots. This is OK, since items
+ * at wrong locations are eventually overwritten, and items obtained from
+ * the map cache are validated by the caller anyway.
+ */
+static void m_map_cache_resize(struct m_map *const map_cache,
+    const size_t slots_count, const size_t max_slots_count)
+{
+  assert(slots_count >= C_MAP_BUCKET_SIZE);
+  assert(slots_count <= max_slots_count);
+  assert(slots_count % C_MAP_BUCKET_SIZE == 0);
+  (void)max_slots_count;
+
+  const size_t prev_slots_count = p_atomic_load(&map_cache->slots_count);
+  p_atomic_store(&map_cache->slots_count, slots_count);
+
+  if (slots_count < prev_slots_count) {
+    /*
+     * Return memory for slots, which are no longer in use, to the OS
+     * after the new number of slots is published.
+     */
+    const size_t discarded_slots_count = prev_slots_count - slots_count;
+    p_memory_discard(&map_cache->key_digests[slots_count],
+        discarded_slots_count * sizeof(map_cache->key_digests[0]));
+    p_memory_discard(&map_cache->payloads[slots_count],
+        discarded_slots_count * sizeof(map_cache->payloads[0]));
+  }
+}
+
+/*
+ * Returns the number of occupied slots in the map_cache.
+ */
+static size_t m_map_cache_get_used_slots_count(
+    const struct m_map *const map_cache)
+{
+  const size_t slots_count = p_atomic_load(&map_cache->slots_count);
+  size_t used_slots_count = 0;
+
+  for (size_t i = 0; i < slots_count; ++i) {
+    if (!m_key_digest_is_empty(&map_cache->key_digests[i])) {
+      ++used_slots_count;
+    }
+  }
+  return used_slots_count;
+}
+
+/*
+ * Copies the map_cache into dst for a single operation.
+ *
+ * The map cache may be concurrently resized, so its slots_count must be read
+ * only once per operation.
+ */
+static void m_map_cache_load(struct m_map *const dst,
+    const struct m_map *const map_cache)
+{
+  *dst = *map_cache;
+  dst->slots_count = p_atomic_load(&map_cache->slots_count);
+}
+
 /*
  * Obtains a payload for the given key_digest in the map_cache and/or map.
  *
@@ -1175,11 +3126,14 @@ static void m_map_cache_destroy(struct m_map *const map_cache)
  * in the map_cache and/or map. Otherwise returns 0.
  */
 static int m_map_cache_get(const struct m_map *const map,
-    const struct m_map *const map_cache,
+    const struct m_map *const map_cache, const struct m_stats *const stats,
     const struct m_key_digest *const key_digest,
     struct m_storage_payload *const payload)
 {
-  if (map_cache->slots_count == 0) {
+  struct m_map mc;
+  m_map_cache_load(&mc, map_cache);
+
+  if (mc.slots_count == 0) {
     /* The map cache is disabled. Look up the item via map. */
     return m_map_get(map, key_digest, payload);
   }
@@ -1187,7 +3141,8 @@ static int m_map_cache_get(const struct m_map *const map,
   /*
    * Fast path: look up the item via the map cache.
    */
-  if (m_map_get(map_cache, key_digest, payload)) {
+  if (m_map_get(&mc, key_digest, payload)) {
+    m_stats_inc(stats, M_STATS_MAP_CACHE_HITS);
     return 1;
   }
 
@@ -1201,30 +3156,55 @@ static int m_map_cache_get(const struct m_map *const map,
   /*
    * Add the found item to the map cache.
    */
-  m_map_set(map_cache, key_digest, payload);
+  m_stats_inc(stats, M_STATS_MAP_CACHE_MISSES);
+  (void)m_map_set(&mc, key_digest, payload);
   return 1;
 }
 
+/*
+ * Prefetches map_cache and map buckets for the given key_digest.
+ */
+static void m_map_cache_prefetch(const struct m_map *const map,
+    const struct m_map *const map_cache,
+    const struct m_key_digest *const key_digest)
+{
+  struct m_map mc;
+  m_map_cache_load(&mc, map_cache);
+
+  if (mc.slots_count != 0) {
+    m_map_prefetch(&mc, key_digest);
+  }
+  m_map_prefetch(map, key_digest);
+}
+
 /*
  * Adds the given payload with the given key_digest into the map_cache and map.
+ *
+ * Returns 1 if another item has been evicted from the map. Otherwise returns 0.
  */
-static void m_map_cache_set(const struct m_map *const map,
+static int m_map_cache_set(const struct m_map *const map,
     const struct m_map *const map_cache,
     const struct m_key_digest *const key_digest,
     const struct m_storage_payload *const payload)
 {
-  if (map_cache->slots_count != 0) {
-    (void)m_map_remove(map_cache, key_digest);
+  struct m_map mc;
+  m_map_cache_load(&mc, map_cache);
+
+  if (mc.slots_count != 0) {
+    (void)m_map_remove(&mc, key_digest);
   }
-  m_map_set(map, key_digest, payload);
+  return m_map_set(map, key_digest, payload);
 }
 
 static int m_map_cache_remove(const struct m_map *const map,
     const struct m_map *const map_cache,
     const struct m_key_digest *const key_digest)
 {
-  if (map_cache->slots_count != 0) {
-    (void)m_map_remove(map_cache, key_digest);
+  struct m_map mc;
+  m_map_cache_load(&mc, map_cache);
+
+  if (mc.slots_count != 0) {
+    (void)m_map_remove(&mc, key_digest);
   }
   return m_map_remove(map, key_digest);
 }
@@ -1257,6 +3237,12 @@ struct m_index
    */
   struct m_map map_cache;
 
+  /*
+   * The maximum number of slots in the map_cache. The map_cache may be grown
+   * up to this number of slots in runtime.
+   */
+  size_t map_cache_max_slots_count;
+
   /*
    * A pointer to hash seed.
    *
@@ -1267,11 +3253,25 @@ struct m_index
    * - Security. It reduces chances for successful hash table collision attack.
    *   (Though this attack is harmless for the current m_map implementation)
    * - Fast cache data invalidation. See ybc_clear().
+   *
+   * The upper M_INDEX_HASH_ALGORITHM_BITS bits contain hash algorithm
+   * identifier. See m_index_get_hash_seed() for details.
    */
   uint64_t *hash_seed_ptr;
+
+  /*
+   * The number of storage arenas, which cursors are stored in index file.
+   */
+  size_t arenas_count;
+
+  /*
+   * Whether the map and the map_cache are backed by huge pages.
+   */
+  int has_huge_pages;
 };
 
-static size_t m_index_get_file_size(const size_t slots_count)
+static size_t m_index_get_file_size(const size_t slots_count,
+    const size_t arenas_count)
 {
   /*
    * Index file consists of the following items:
@@ -1279,19 +3279,66 @@ static size_t m_index_get_file_size(const size_t slots_count)
    * - slots_count items.
    */
   assert(slots_count <= M_MAP_SLOTS_COUNT_LIMIT);
+  assert(arenas_count > 0);
+  assert(arenas_count <= C_CONFIG_MAX_STORAGE_ARENAS_COUNT);
+
+  return slots_count * M_MAP_ITEM_SIZE + M_MAP_AUX_DATA_SIZE(arenas_count);
+}
+
+static void m_index_set_hash_seed(struct m_index *const index,
+    const uint64_t hash_seed, const int hash_algorithm)
+{
+  *index->hash_seed_ptr = m_hash_seed_pack(hash_seed, hash_algorithm);
+}
+
+/*
+ * Reads hash seed and hash algorithm identifier from index file.
+ *
+ * Hash algorithm identifier is stored in the upper bits of the hash seed,
+ * so index files containing the identifier have the same layout as index
+ * files created before hash algorithm identifier introduction.
+ * Hash seeds in such files were initialized with the current time
+ * in milliseconds, so their upper bits are zero,
+ * i.e. M_HASH_ALGORITHM_JENKINS.
+ *
+ * Index files with unknown hash algorithm are switched to
+ * M_HASH_ALGORITHM_LATEST. This invalidates all the items in the cache.
+ */
+static void m_index_get_hash_seed(struct m_index *const index,
+    uint64_t *const hash_seed, int *const hash_algorithm)
+{
+  const uint64_t v = *index->hash_seed_ptr;
 
-  return slots_count * M_MAP_ITEM_SIZE + M_MAP_AUX_DATA_SIZE;
+  *hash_seed = v & M_INDEX_HASH_SEED_MASK;
+  *hash_algorithm = (int)(v >> M_INDEX_HASH_ALGORITHM_SHIFT);
+  if (*hash_algorithm != M_HASH_ALGORITHM_JENKINS &&
+      *hash_algorithm != M_HASH_ALGORITHM_STRIPED) {
+    *hash_algorithm = M_HASH_ALGORITHM_LATEST;
+    m_index_set_hash_seed(index, *hash_seed, *hash_algorithm);
+  }
 }
 
+/*
+ * Opens index file.
+ *
+ * Sets next_cursor to a pointer to the first arena's cursor
+ * and extra_next_cursors to a pointer to (arenas_count - 1) cursors
+ * for the remaining arenas.
+ */
 static int m_index_open(struct m_index *const index,
     struct p_file *const index_file,
     const size_t map_slots_count, const size_t map_cache_slots_count,
-    const char *const filename, const int force, int *const is_file_created,
-    struct m_storage_cursor **const next_cursor)
+    const size_t map_cache_max_slots_count, const size_t arenas_count,
+    const int has_clock_eviction, const int has_huge_pages,
+    const char *const filename, const int force,
+    int *const is_file_created,
+    struct m_storage_cursor **const next_cursor,
+    struct m_storage_cursor **const extra_next_cursors)
 {
   void *ptr;
 
-  const size_t file_size = m_index_get_file_size(map_slots_count);
+  const size_t file_size = m_index_get_file_size(map_slots_count,
+      arenas_count);
 
   if (!m_file_open_or_create(index_file, filename, file_size, force,
       is_file_created)) {
@@ -1299,20 +3346,8 @@ static int m_index_open(struct m_index *const index,
   }
 
   /*
-   * Cache index file contents in RAM in order to minimize random I/O during
-   * cache warm-up.
+   * Index file contents is cached in RAM by m_warmup_start().
    *
-   * Since index file is usually not too big, it can be quickly cached into RAM
-   * with sustained speed at hundreds MB/s (which is equivalent to millions
-   * of key slots per second) on modern HDDs and SSDs. Of course, this is true
-   * only if the index file's fragmentation is low. The code tries hard
-   * achieving low fragmentation by pre-allocating file contents
-   * at creation time.
-   * See m_file_open_or_create() for details.
-   */
-  p_file_cache_in_ram(index_file);
-
-  /*
    * Hint the OS about random access pattern to index file contents.
    */
   p_file_advise_random_access(index_file, file_size);
@@ -1320,6 +3355,15 @@ static int m_index_open(struct m_index *const index,
   p_memory_map(&ptr, index_file, file_size);
   assert((uintptr_t)file_size <= UINTPTR_MAX - (uintptr_t)ptr);
 
+  /*
+   * Random lookups over a large map thrash TLB when the map is backed
+   * by regular pages. This is just a hint - most filesystems ignore it
+   * for file mappings. Only tmpfs mounted with huge=advise honors it.
+   */
+  if (has_huge_pages) {
+    p_memory_advise_huge_pages(ptr, file_size);
+  }
+
   /*
    * Key digests must be aligned to CPU cache line size for faster lookups.
    * Assume the ptr is VM page-aligned, so there are high chances it is aligned
@@ -1330,20 +3374,27 @@ static int m_index_open(struct m_index *const index,
   struct m_key_digest *const key_digests = ptr;
   struct m_storage_payload *const payloads = (struct m_storage_payload *)
       (key_digests + map_slots_count);
-  m_map_init(&index->map, map_slots_count, key_digests, payloads);
+  m_map_init(&index->map, map_slots_count, key_digests, payloads,
+      has_clock_eviction);
 
   *next_cursor = (struct m_storage_cursor *)(payloads + map_slots_count);
   index->hash_seed_ptr = (uint64_t *)(*next_cursor + 1);
   if (*is_file_created) {
-    *index->hash_seed_ptr = p_get_current_time();
+    m_index_set_hash_seed(index, p_get_current_time(),
+        M_HASH_ALGORITHM_LATEST);
   }
+  *extra_next_cursors = (struct m_storage_cursor *)(index->hash_seed_ptr + 1);
+  index->arenas_count = arenas_count;
+  index->has_huge_pages = has_huge_pages;
 
   /*
    * Do not verify correctness of loaded index file now, because the cache
    * discovers and fixes errors in the index file on the fly.
    */
 
-  m_map_cache_init(&index->map_cache, map_cache_slots_count);
+  index->map_cache_max_slots_count = map_cache_max_slots_count;
+  m_map_cache_init(&index->map_cache, map_cache_slots_count,
+      map_cache_max_slots_count, has_clock_eviction, has_huge_pages);
 
   return 1;
 }
@@ -1351,9 +3402,11 @@ static int m_index_open(struct m_index *const index,
 static void m_index_close(struct m_index *const index,
     struct p_file *const index_file)
 {
-  m_map_cache_destroy(&index->map_cache);
+  m_map_cache_destroy(&index->map_cache, index->map_cache_max_slots_count,
+      index->has_huge_pages);
 
-  const size_t file_size = m_index_get_file_size(index->map.slots_count);
+  const size_t file_size = m_index_get_file_size(index->map.slots_count,
+      index->arenas_count);
   p_memory_unmap(index->map.key_digests, file_size);
 
   m_map_destroy(&index->map);
@@ -1361,31 +3414,858 @@ static void m_index_close(struct m_index *const index,
 }
 
 /*******************************************************************************
- * Sync API.
+ * Map cache snapshot API.
  *
- * Syncing is performed by a separate thread in order to avoid latency spikes
- * during cache accesses.
+ * The map cache lives in RAM only, so it starts empty after restart and loses
+ * frequently accessed items gathered by m_map_cache_get(). The map cache
+ * contents may be saved into a snapshot file when the cache is closed
+ * and loaded back when the cache is opened.
+ *
+ * The snapshot file consists of the following items:
+ * - struct m_map_cache_snapshot_header.
+ * - next_cursor for each storage arena at the time the snapshot was saved.
+ * - map cache key digests and payloads.
+ *
+ * The snapshot is discarded if the hash seed or any next_cursor has been
+ * changed since it was saved, i.e. if the cache has been cleared or
+ * modified without saving a new snapshot. Each loaded item is verified
+ * against the storage and the map, so the map cache never contains items,
+ * which cannot be found via the map.
  ******************************************************************************/
 
 /*
- * Data related to storage syncing.
+ * 'ybcmapca' in ASCII.
  */
-struct m_sync
+#define M_MAP_CACHE_SNAPSHOT_MAGIC ((uint64_t)0x79626d6d61706361)
+
+struct m_map_cache_snapshot_header
 {
-  /*
-   * Interval between data syncs.
-   */
-  uint64_t sync_interval;
+  uint64_t magic;
 
   /*
-   * A copy of ybc->has_overwrite_protection.
+   * A copy of hash seed from index file including hash algorithm identifier.
    */
-  int has_overwrite_protection;
+  uint64_t hash_seed;
 
-  /*
-   * Start pointer for unsynced storage data.
-   */
-  struct m_storage_cursor sync_cursor;
+  uint64_t slots_count;
+  uint64_t arenas_count;
+};
+
+static size_t m_map_cache_snapshot_get_size(const size_t slots_count,
+    const size_t arenas_count)
+{
+  return sizeof(struct m_map_cache_snapshot_header) +
+      arenas_count * sizeof(struct m_storage_cursor) +
+      slots_count * M_MAP_ITEM_SIZE;
+}
+
+/*
+ * Clears map cache items, which are invalid or don't match items in the map.
+ */
+static void m_map_cache_snapshot_verify(struct m_index *const index,
+    const struct m_storage *const storage)
+{
+  const struct m_map *const map_cache = &index->map_cache;
+  const uint64_t current_time = p_get_current_time();
+  struct m_storage_payload map_payload;
+
+  for (size_t i = 0; i < map_cache->slots_count; ++i) {
+    struct m_key_digest *const key_digest = &map_cache->key_digests[i];
+    if (m_key_digest_is_empty(key_digest)) {
+      continue;
+    }
+
+    const struct m_storage_payload *const payload = &map_cache->payloads[i];
+    const struct m_storage_arena *const arena = m_storage_get_arena(storage,
+        payload->cursor.offset);
+    if (!m_storage_payload_check(arena, arena->next_cursor, payload,
+            current_time) ||
+        !m_map_get(&index->map, key_digest, &map_payload) ||
+        !m_storage_payload_equal(payload, &map_payload)) {
+      m_key_digest_clear(key_digest);
+    }
+  }
+}
+
+/*
+ * Loads the map cache from the given snapshot file and removes the file.
+ *
+ * The file is removed, so stale snapshot isn't loaded after unexpected
+ * process termination.
+ */
+static void m_map_cache_snapshot_load(struct m_index *const index,
+    const struct m_storage *const storage, const char *const filename)
+{
+  struct m_map *const map_cache = &index->map_cache;
+  const size_t max_slots_count = index->map_cache_max_slots_count;
+  const size_t arenas_count = storage->arenas_count;
+  struct p_file file;
+  size_t file_size;
+  void *ptr;
+
+  if (filename == NULL || map_cache->slots_count == 0 ||
+      !p_file_exists(filename)) {
+    return;
+  }
+
+  p_file_open(&file, filename);
+  p_file_get_size(&file, &file_size);
+
+  /*
+   * The snapshot may contain distinct number of slots if the map cache
+   * has been resized in runtime. Accept it only if the map cache
+   * may be resized to this number of slots.
+   */
+  const size_t aux_size = m_map_cache_snapshot_get_size(0, arenas_count);
+  size_t slots_count = 0;
+  if (file_size > aux_size && (file_size - aux_size) % M_MAP_ITEM_SIZE == 0) {
+    slots_count = (file_size - aux_size) / M_MAP_ITEM_SIZE;
+  }
+  if (slots_count != map_cache->slots_count &&
+      (map_cache->slots_count == max_slots_count ||
+          slots_count < C_MAP_BUCKET_SIZE ||
+          slots_count % C_MAP_BUCKET_SIZE != 0 ||
+          slots_count > max_slots_count)) {
+    p_file_close(&file);
+    p_file_remove(filename);
+    return;
+  }
+
+  p_memory_map(&ptr, &file, file_size);
+
+  const struct m_map_cache_snapshot_header *const header = ptr;
+  const struct m_storage_cursor *const cursors =
+      (const struct m_storage_cursor *)(header + 1);
+
+  int is_valid = (header->magic == M_MAP_CACHE_SNAPSHOT_MAGIC &&
+      header->hash_seed == *index->hash_seed_ptr &&
+      header->slots_count == slots_count &&
+      header->arenas_count == arenas_count);
+  for (size_t i = 0; is_valid && i < arenas_count; ++i) {
+    const struct m_storage_cursor *const next_cursor =
+        storage->arenas[i].next_cursor;
+    is_valid = (cursors[i].wrap_count == next_cursor->wrap_count &&
+        cursors[i].offset == next_cursor->offset);
+  }
+
+  if (is_valid) {
+    /*
+     * The map cache isn't accessed concurrently yet.
+     */
+    const struct m_key_digest *const key_digests =
+        (const struct m_key_digest *)(cursors + arenas_count);
+    map_cache->slots_count = slots_count;
+    memcpy(map_cache->key_digests, key_digests,
+        slots_count * sizeof(key_digests[0]));
+    memcpy(map_cache->payloads, key_digests + slots_count,
+        slots_count * sizeof(map_cache->payloads[0]));
+    m_map_cache_snapshot_verify(index, storage);
+  }
+
+  p_memory_unmap(ptr, file_size);
+  p_file_close(&file);
+  p_file_remove(filename);
+}
+
+/*
+ * Saves the map cache into the given snapshot file.
+ */
+static void m_map_cache_snapshot_save(const struct m_index *const index,
+    const struct m_storage *const storage, const char *const filename)
+{
+  const struct m_map *const map_cache = &index->map_cache;
+  const size_t arenas_count = storage->arenas_count;
+  struct p_file file;
+  int is_file_created;
+  void *ptr;
+
+  if (filename == NULL || map_cache->slots_count == 0) {
+    return;
+  }
+
+  const size_t file_size = m_map_cache_snapshot_get_size(
+      map_cache->slots_count, arenas_count);
+  if (!m_file_open_or_create(&file, filename, file_size, 1,
+      &is_file_created)) {
+    return;
+  }
+
+  p_memory_map(&ptr, &file, file_size);
+
+  struct m_map_cache_snapshot_header *const header = ptr;
+  struct m_storage_cursor *const cursors =
+      (struct m_storage_cursor *)(header + 1);
+
+  header->magic = M_MAP_CACHE_SNAPSHOT_MAGIC;
+  header->hash_seed = *index->hash_seed_ptr;
+  header->slots_count = map_cache->slots_count;
+  header->arenas_count = arenas_count;
+  for (size_t i = 0; i < arenas_count; ++i) {
+    cursors[i] = *storage->arenas[i].next_cursor;
+  }
+
+  struct m_key_digest *const key_digests =
+      (struct m_key_digest *)(cursors + arenas_count);
+  memcpy(key_digests, map_cache->key_digests,
+      map_cache->slots_count * sizeof(key_digests[0]));
+  memcpy(key_digests + map_cache->slots_count, map_cache->payloads,
+      map_cache->slots_count * sizeof(map_cache->payloads[0]));
+
+  p_memory_unmap(ptr, file_size);
+  p_file_close(&file);
+}
+
+
+/*******************************************************************************
+ * Warm-up API.
+ *
+ * Index file contents is cached in RAM in order to minimize random I/O during
+ * cache warm-up.
+ *
+ * Since index file is usually not too big, it can be quickly cached into RAM
+ * with sustained speed at hundreds MB/s (which is equivalent to millions
+ * of key slots per second) on modern HDDs and SSDs. Of course, this is true
+ * only if the index file's fragmentation is low. The code tries hard
+ * achieving low fragmentation by pre-allocating file contents
+ * at creation time.
+ * See m_file_open_or_create() for details.
+ *
+ * Large index files are read in chunks by multiple threads, since SSDs
+ * and RAIDs serve concurrent reads much faster than a single sequential
+ * reader.
+ *
+ * Optionally hot data, i.e. the last hot_data_size bytes written to each
+ * storage arena, is prefetched from the storage file in background.
+ * Frequently accessed items are kept in this area by working set
+ * defragmentation, so requests for hot items don't suffer from major page
+ * faults after restart.
+ ******************************************************************************/
+
+struct m_warmup
+{
+  /*
+   * A pointer to ybc->index_file.
+   */
+  const struct p_file *index_file;
+
+  /*
+   * The size of the index file.
+   */
+  size_t file_size;
+
+  /*
+   * The offset of the next chunk to read. Chunks are claimed by warm-up
+   * threads via atomic compare-and-swap.
+   *
+   * Warm-up is stopped by setting the offset to file_size.
+   */
+  size_t next_offset;
+
+  /*
+   * The number of bytes already read into RAM.
+   */
+  size_t warmed_size;
+
+  /*
+   * Optional progress callback and its' context.
+   */
+  ybc_warmup_progress_func progress_func;
+  void *progress_ctx;
+
+  /*
+   * Serializes progress_func calls.
+   */
+  struct p_lock progress_lock;
+
+  /*
+   * warmed_size passed to the last progress_func call. Protected
+   * by progress_lock.
+   */
+  size_t reported_size;
+
+  /*
+   * Warm-up threads. threads_count is 0 after the threads are joined.
+   */
+  struct p_thread *threads;
+  size_t threads_count;
+};
+
+/*
+ * Claims the next chunk for reading.
+ *
+ * Returns 0 if there are no more chunks to read.
+ */
+static int m_warmup_claim_chunk(struct m_warmup *const wu,
+    size_t *const offset, size_t *const size)
+{
+  for (;;) {
+    const size_t next_offset = p_atomic_load(&wu->next_offset);
+    if (next_offset >= wu->file_size) {
+      return 0;
+    }
+
+    size_t chunk_size = wu->file_size - next_offset;
+    if (chunk_size > C_WARMUP_CHUNK_SIZE) {
+      chunk_size = C_WARMUP_CHUNK_SIZE;
+    }
+    if (p_atomic_cas(&wu->next_offset, next_offset,
+        next_offset + chunk_size)) {
+      *offset = next_offset;
+      *size = chunk_size;
+      return 1;
+    }
+  }
+}
+
+static void m_warmup_thread_func(void *const ctx)
+{
+  struct m_warmup *const wu = ctx;
+  size_t offset, size;
+
+  while (m_warmup_claim_chunk(wu, &offset, &size)) {
+    p_file_cache_in_ram(wu->index_file, offset, size);
+    (void)p_atomic_add(&wu->warmed_size, size);
+
+    if (wu->progress_func != NULL) {
+      /*
+       * Read warmed_size under the lock, so progress_func observes
+       * monotonically increasing values even if threads reach the lock
+       * out of order.
+       */
+      p_lock_lock(&wu->progress_lock);
+      const size_t warmed_size = p_atomic_load(&wu->warmed_size);
+      if (warmed_size > wu->reported_size) {
+        wu->reported_size = warmed_size;
+        wu->progress_func(wu->progress_ctx, warmed_size, wu->file_size);
+      }
+      p_lock_unlock(&wu->progress_lock);
+    }
+  }
+}
+
+static void m_warmup_join(struct m_warmup *const wu)
+{
+  for (size_t i = 0; i < wu->threads_count; ++i) {
+    p_thread_join_and_destroy(&wu->threads[i]);
+  }
+  wu->threads_count = 0;
+}
+
+/*
+ * Starts caching index file contents in RAM with the given number of threads.
+ *
+ * Waits until the warm-up completes unless is_background is set.
+ * Warm-up is disabled if threads_count is 0.
+ */
+static void m_warmup_start(struct m_warmup *const wu,
+    const struct p_file *const index_file, const size_t threads_count,
+    const int is_background, const ybc_warmup_progress_func progress_func,
+    void *const progress_ctx)
+{
+  wu->index_file = index_file;
+  p_file_get_size(index_file, &wu->file_size);
+  wu->next_offset = 0;
+  wu->warmed_size = 0;
+  wu->reported_size = 0;
+  wu->progress_func = progress_func;
+  wu->progress_ctx = progress_ctx;
+  p_lock_init(&wu->progress_lock);
+  wu->threads = NULL;
+  wu->threads_count = 0;
+
+  if (threads_count == 0) {
+    p_atomic_store(&wu->next_offset, wu->file_size);
+    return;
+  }
+
+  /*
+   * There is no sense in running more threads than chunks.
+   */
+  const size_t chunks_count = (wu->file_size + C_WARMUP_CHUNK_SIZE - 1) /
+      C_WARMUP_CHUNK_SIZE;
+  wu->threads_count = threads_count < chunks_count ?
+      threads_count : chunks_count;
+  wu->threads = p_malloc(sizeof(wu->threads[0]) * wu->threads_count);
+  for (size_t i = 0; i < wu->threads_count; ++i) {
+    p_thread_init_and_start(&wu->threads[i], &m_warmup_thread_func, wu);
+  }
+
+  if (!is_background) {
+    m_warmup_join(wu);
+  }
+}
+
+/*
+ * Stops background warm-up if it is still in progress.
+ */
+static void m_warmup_stop(struct m_warmup *const wu)
+{
+  p_atomic_store(&wu->next_offset, wu->file_size);
+  m_warmup_join(wu);
+  p_free(wu->threads);
+  p_lock_destroy(&wu->progress_lock);
+}
+
+/*
+ * Returns the size of the index file, which isn't cached in RAM yet.
+ *
+ * Stopped warm-up leaves nothing pending.
+ */
+static size_t m_warmup_get_pending_size(const struct m_warmup *const wu)
+{
+  if (p_atomic_load(&wu->next_offset) >= wu->file_size &&
+      wu->threads_count == 0) {
+    return 0;
+  }
+  return wu->file_size - p_atomic_load(&wu->warmed_size);
+}
+
+
+/*
+ * A range in the storage file to prefetch - [start_offset ... end_offset).
+ */
+struct m_prefetch_range
+{
+  size_t start_offset;
+  size_t end_offset;
+};
+
+struct m_prefetch
+{
+  /*
+   * A pointer to ybc->storage_file.
+   */
+  const struct p_file *storage_file;
+
+  /*
+   * Ranges to prefetch. Each arena has up to two ranges, since hot data
+   * may wrap the end of the arena.
+   */
+  struct m_prefetch_range *ranges;
+  size_t ranges_count;
+
+  /*
+   * The total size of ranges and the size of already prefetched data.
+   */
+  size_t total_size;
+  size_t prefetched_size;
+
+  /*
+   * The maximum read bandwidth in bytes per second. 0 means unlimited.
+   */
+  uint64_t bandwidth;
+
+  /*
+   * An event for indicating when the prefetch thread should be stopped.
+   */
+  struct p_event stop_event;
+
+  /*
+   * A thread responsible for prefetching. It is started only if there is
+   * something to prefetch.
+   */
+  struct p_thread prefetch_thread;
+};
+
+static void m_prefetch_add_range(struct m_prefetch *const pf,
+    const size_t start_offset, const size_t end_offset)
+{
+  assert(start_offset <= end_offset);
+
+  if (start_offset == end_offset) {
+    return;
+  }
+  pf->ranges[pf->ranges_count].start_offset = start_offset;
+  pf->ranges[pf->ranges_count].end_offset = end_offset;
+  ++pf->ranges_count;
+  pf->total_size += end_offset - start_offset;
+}
+
+/*
+ * Prefetches the given range, starting from the most recently written data.
+ *
+ * Returns 0 if the prefetch thread should be stopped.
+ */
+static int m_prefetch_range(struct m_prefetch *const pf,
+    const struct m_prefetch_range *const range, const uint64_t start_time)
+{
+  size_t offset = range->end_offset;
+
+  while (offset > range->start_offset) {
+    size_t chunk_size = offset - range->start_offset;
+    if (chunk_size > C_PREFETCH_CHUNK_SIZE) {
+      chunk_size = C_PREFETCH_CHUNK_SIZE;
+    }
+    offset -= chunk_size;
+
+    p_file_cache_in_ram(pf->storage_file, offset, chunk_size);
+    const size_t prefetched_size = p_atomic_add(&pf->prefetched_size,
+        chunk_size);
+
+    uint64_t timeout = 0;
+    if (pf->bandwidth != 0) {
+      const uint64_t expected_time = prefetched_size * 1000 / pf->bandwidth;
+      const uint64_t elapsed_time = (p_get_monotonic_time_ns() - start_time) /
+          (1000 * 1000);
+      if (expected_time > elapsed_time) {
+        timeout = expected_time - elapsed_time;
+      }
+    }
+    if (p_event_wait_with_timeout(&pf->stop_event, timeout)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void m_prefetch_thread_func(void *const ctx)
+{
+  struct m_prefetch *const pf = ctx;
+  const uint64_t start_time = p_get_monotonic_time_ns();
+
+  for (size_t i = 0; i < pf->ranges_count; ++i) {
+    if (!m_prefetch_range(pf, &pf->ranges[i], start_time)) {
+      break;
+    }
+  }
+}
+
+/*
+ * Starts prefetching the last hot_data_size bytes before next_cursor
+ * in each storage arena if is_enabled is set.
+ *
+ * hot_data_size is the size of hot data per storage arena.
+ */
+static void m_prefetch_start(struct m_prefetch *const pf,
+    const struct p_file *const storage_file,
+    const struct m_storage *const storage, const size_t hot_data_size,
+    const uint64_t bandwidth, const int is_enabled)
+{
+  const size_t arenas_count = storage->arenas_count;
+
+  pf->storage_file = storage_file;
+  pf->ranges = p_malloc(sizeof(pf->ranges[0]) * arenas_count * 2);
+  pf->ranges_count = 0;
+  pf->total_size = 0;
+  pf->prefetched_size = 0;
+  pf->bandwidth = bandwidth;
+
+  if (!is_enabled) {
+    return;
+  }
+
+  /*
+   * Arenas aren't accessed concurrently yet, so their next_cursors may be read
+   * without locking.
+   */
+  for (size_t i = 0; i < arenas_count; ++i) {
+    const struct m_storage_arena *const arena = &storage->arenas[i];
+    const struct m_storage_cursor *const next_cursor = arena->next_cursor;
+
+    assert(next_cursor->offset >= arena->start_offset);
+    assert(next_cursor->offset <= arena->end_offset);
+
+    const size_t head_size = next_cursor->offset - arena->start_offset;
+    if (head_size >= hot_data_size) {
+      m_prefetch_add_range(pf, next_cursor->offset - hot_data_size,
+          next_cursor->offset);
+      continue;
+    }
+    m_prefetch_add_range(pf, arena->start_offset, next_cursor->offset);
+    if (next_cursor->wrap_count > 0) {
+      /* Hot data wraps the end of the arena. */
+      m_prefetch_add_range(pf,
+          arena->end_offset - (hot_data_size - head_size), arena->end_offset);
+    }
+  }
+
+  if (pf->ranges_count > 0) {
+    p_event_init(&pf->stop_event);
+    p_thread_init_and_start(&pf->prefetch_thread, &m_prefetch_thread_func,
+        pf);
+  }
+}
+
+/*
+ * Stops prefetching if it is still in progress.
+ */
+static void m_prefetch_stop(struct m_prefetch *const pf)
+{
+  if (pf->ranges_count > 0) {
+    p_event_set(&pf->stop_event);
+    p_thread_join_and_destroy(&pf->prefetch_thread);
+    p_event_destroy(&pf->stop_event);
+  }
+  p_free(pf->ranges);
+}
+
+/*
+ * Returns the size of hot data, which isn't prefetched yet.
+ */
+static size_t m_prefetch_get_pending_size(const struct m_prefetch *const pf)
+{
+  return pf->total_size - p_atomic_load(&pf->prefetched_size);
+}
+
+
+/*******************************************************************************
+ * Auto-sizing API.
+ *
+ * The optimal map cache size and hot data size depend on the workload,
+ * which may change over time. Auto-sizing periodically adjusts them
+ * in runtime within configured bounds according to statistics gathered
+ * since the previous adjustment:
+ * - The map cache is grown if its hit ratio is low and shrunk if its hit
+ *   ratio is high while the most of its slots are empty.
+ * - Hot data size is grown if hot items often drop out of the hot data space,
+ *   i.e. if defragmentation moves are frequent. It is shrunk if defragmentation
+ *   moves are rare.
+ ******************************************************************************/
+
+struct m_autosize
+{
+  /*
+   * A pointer to ybc->index.map_cache.
+   */
+  struct m_map *map_cache;
+
+  /*
+   * The maximum number of slots in the map_cache. The map_cache isn't resized
+   * if it already has the maximum number of slots at startup.
+   */
+  size_t map_cache_max_slots_count;
+
+  /*
+   * A pointer to ybc->hot_data_size.
+   */
+  size_t *hot_data_size;
+
+  /*
+   * Bounds for hot data size per storage arena. Hot data size isn't adjusted
+   * if the maximum size is zero.
+   */
+  size_t min_hot_data_size;
+  size_t max_hot_data_size;
+
+  /*
+   * A pointer to ybc->stats.
+   */
+  const struct m_stats *stats;
+
+  /*
+   * Statistics obtained at the previous adjustment.
+   */
+  struct ybc_stats prev_stats;
+
+  /*
+   * Whether the next map cache adjustment should be skipped. The map cache
+   * is empty after resizing, so its hit ratio is meaningless until it is
+   * filled with hot items.
+   */
+  int should_skip_map_cache;
+
+  /*
+   * An event for indicating when the auto-sizing thread should be stopped.
+   */
+  struct p_event stop_event;
+
+  /*
+   * A thread responsible for auto-sizing. It is started only if there is
+   * something to adjust.
+   */
+  struct p_thread autosize_thread;
+  int is_started;
+};
+
+static void m_autosize_map_cache(struct m_autosize *const as,
+    const uint64_t hits, const uint64_t misses)
+{
+  struct m_map *const map_cache = as->map_cache;
+  const size_t max_slots_count = as->map_cache_max_slots_count;
+  const size_t slots_count = map_cache->slots_count;
+  const uint64_t lookups_count = hits + misses;
+
+  if (as->should_skip_map_cache) {
+    as->should_skip_map_cache = 0;
+    return;
+  }
+
+  if (lookups_count < slots_count) {
+    /* Too few lookups for making a decision. */
+    return;
+  }
+
+  size_t new_slots_count = slots_count;
+  if (hits * 100 < lookups_count * C_AUTOSIZE_MAP_CACHE_GROW_HIT_RATIO) {
+    if (slots_count <= max_slots_count / 2) {
+      new_slots_count = slots_count * 2;
+    }
+    else {
+      new_slots_count = max_slots_count;
+    }
+  }
+  else if (hits * 100 > lookups_count * C_AUTOSIZE_MAP_CACHE_SHRINK_HIT_RATIO &&
+      slots_count >= 2 * C_MAP_BUCKET_SIZE &&
+      m_map_cache_get_used_slots_count(map_cache) < slots_count / 4) {
+    new_slots_count = slots_count / 2;
+    m_map_fix_slots_count(&new_slots_count, SIZE_MAX);
+  }
+
+  if (new_slots_count != slots_count) {
+    m_map_cache_resize(map_cache, new_slots_count, max_slots_count);
+    as->should_skip_map_cache = 1;
+  }
+}
+
+static void m_autosize_hot_data(struct m_autosize *const as,
+    const uint64_t get_hits, const uint64_t moves)
+{
+  const size_t hot_data_size = *as->hot_data_size;
+
+  if (get_hits < C_AUTOSIZE_MIN_GET_HITS) {
+    /* Too few hits for making a decision. */
+    return;
+  }
+
+  size_t new_hot_data_size = hot_data_size;
+  if (moves * 1000 > get_hits * C_AUTOSIZE_HOT_DATA_GROW_MOVES_RATIO) {
+    if (hot_data_size <= as->max_hot_data_size / 2) {
+      new_hot_data_size = hot_data_size * 2;
+    }
+    else {
+      new_hot_data_size = as->max_hot_data_size;
+    }
+  }
+  else if (moves * 1000 < get_hits * C_AUTOSIZE_HOT_DATA_SHRINK_MOVES_RATIO) {
+    new_hot_data_size = hot_data_size / 2;
+    if (new_hot_data_size < as->min_hot_data_size) {
+      new_hot_data_size = as->min_hot_data_size;
+    }
+  }
+
+  if (new_hot_data_size != hot_data_size) {
+    p_atomic_store(as->hot_data_size, new_hot_data_size);
+  }
+}
+
+static void m_autosize_thread_func(void *const ctx)
+{
+  struct m_autosize *const as = ctx;
+  struct ybc_stats stats;
+
+  while (!p_event_wait_with_timeout(&as->stop_event, C_AUTOSIZE_INTERVAL)) {
+    m_stats_get(as->stats, &stats);
+
+    if (as->map_cache_max_slots_count > 0) {
+      m_autosize_map_cache(as,
+          stats.map_cache_hits - as->prev_stats.map_cache_hits,
+          stats.map_cache_misses - as->prev_stats.map_cache_misses);
+    }
+    if (as->max_hot_data_size > 0) {
+      m_autosize_hot_data(as, stats.get_hits - as->prev_stats.get_hits,
+          stats.defragmentation_moves - as->prev_stats.defragmentation_moves);
+    }
+
+    as->prev_stats = stats;
+  }
+}
+
+/*
+ * Starts auto-sizing for the map_cache and hot_data_size.
+ *
+ * The map_cache is auto-sized if it has less than map_cache_max_slots_count
+ * slots. hot_data_size is auto-sized if max_hot_data_size is greater
+ * than hot_data_size. hot_data_size must be accessed via p_atomic_load()
+ * while auto-sizing is running.
+ */
+static void m_autosize_start(struct m_autosize *const as,
+    struct m_map *const map_cache, const size_t map_cache_max_slots_count,
+    size_t *const hot_data_size, const size_t max_hot_data_size,
+    const struct m_stats *const stats)
+{
+  as->map_cache = map_cache;
+  as->map_cache_max_slots_count =
+      (map_cache->slots_count < map_cache_max_slots_count) ?
+      map_cache_max_slots_count : 0;
+  as->hot_data_size = hot_data_size;
+  as->min_hot_data_size = *hot_data_size;
+  as->max_hot_data_size = (*hot_data_size < max_hot_data_size) ?
+      max_hot_data_size : 0;
+  as->stats = stats;
+  as->should_skip_map_cache = 0;
+  as->is_started = (as->map_cache_max_slots_count > 0 ||
+      as->max_hot_data_size > 0);
+
+  if (as->min_hot_data_size > C_AUTOSIZE_MIN_HOT_DATA_SIZE) {
+    as->min_hot_data_size = C_AUTOSIZE_MIN_HOT_DATA_SIZE;
+  }
+
+  if (as->is_started) {
+    m_stats_get(stats, &as->prev_stats);
+    p_event_init(&as->stop_event);
+    p_thread_init_and_start(&as->autosize_thread, &m_autosize_thread_func,
+        as);
+  }
+}
+
+static void m_autosize_stop(struct m_autosize *const as)
+{
+  if (as->is_started) {
+    p_event_set(&as->stop_event);
+    p_thread_join_and_destroy(&as->autosize_thread);
+    p_event_destroy(&as->stop_event);
+  }
+}
+
+
+/*******************************************************************************
+ * Sync API.
+ *
+ * Syncing is performed by a separate thread in order to avoid latency spikes
+ * during cache accesses.
+ ******************************************************************************/
+
+/*
+ * Data related to storage syncing.
+ */
+struct m_sync
+{
+  /*
+   * Interval between data syncs.
+   */
+  uint64_t sync_interval;
+
+  /*
+   * The maximum write-back bandwidth in bytes per second. 0 means unlimited.
+   */
+  uint64_t sync_bandwidth;
+
+  /*
+   * A copy of ybc->has_overwrite_protection.
+   */
+  int has_overwrite_protection;
+
+  /*
+   * Start pointers for unsynced data in each storage arena.
+   *
+   * A cursor is advanced before the data behind it is written back,
+   * so the data being written back is accounted in backlog_size.
+   */
+  struct m_storage_cursor *sync_cursors;
+
+  /*
+   * The number of bytes scheduled for write-back during the current sync
+   * round, which aren't written back yet.
+   */
+  size_t backlog_size;
+
+  /*
+   * The start time of the current sync round in nanoseconds and the number
+   * of bytes written back since then. Used for bandwidth throttling.
+   */
+  uint64_t round_start_time;
+  uint64_t round_written_size;
 
   /*
    * A pointer to ybc->storage.
@@ -1393,14 +4273,14 @@ struct m_sync
   struct m_storage *storage;
 
   /*
-   * A pointer to ybc->acquired_items_head.
+   * A pointer to ybc->storage_file.
    */
-  struct ybc_item *acquired_items_head;
+  const struct p_file *storage_file;
 
   /*
-   * A pointer to ybc->lock.
+   * A pointer to ybc->stats.
    */
-  struct p_lock *cache_lock;
+  const struct m_stats *stats;
 
   /*
    * An event for indicating when the sync_thread should be stopped.
@@ -1440,9 +4320,84 @@ static void m_sync_adjust_next_cursor(
   }
 }
 
-static void m_sync_commit(const struct m_storage *const storage,
-    const size_t start_offset, const size_t end_offset)
+/*
+ * Returns the number of bytes in the range [start_offset ... end_offset),
+ * which are subject to syncing.
+ */
+static size_t m_sync_get_range_size(const size_t start_offset,
+    const size_t end_offset)
+{
+  assert(start_offset <= end_offset);
+
+  /*
+   * There is no need in syncing the last page, which has unwritten data.
+   */
+  const size_t end_offset_adjusted = end_offset & ~p_memory_page_mask();
+
+  if (end_offset_adjusted > start_offset) {
+    return end_offset_adjusted - start_offset;
+  }
+  return 0;
+}
+
+/*
+ * Returns the size of unsynced data in the given arena between sync_cursor
+ * and next_cursor.
+ */
+static size_t m_sync_get_unsynced_size(
+    const struct m_storage_arena *const arena,
+    const struct m_storage_cursor *const sync_cursor,
+    const struct m_storage_cursor *const next_cursor)
+{
+  const size_t arena_size = arena->end_offset - arena->start_offset;
+
+  if (next_cursor->wrap_count == sync_cursor->wrap_count) {
+    if (next_cursor->offset < sync_cursor->offset) {
+      /* Cursors were loaded in the middle of an update. */
+      return 0;
+    }
+    return next_cursor->offset - sync_cursor->offset;
+  }
+
+  if (next_cursor->wrap_count - 1 == sync_cursor->wrap_count &&
+      next_cursor->offset < sync_cursor->offset) {
+    return (arena->end_offset - sync_cursor->offset) +
+        (next_cursor->offset - arena->start_offset);
+  }
+
+  return arena_size;
+}
+
+/*
+ * Sleeps if the data written back during the current sync round exceeds
+ * sync_bandwidth.
+ *
+ * Returns immediately if the cache is being closed, so close isn't delayed
+ * by throttling.
+ */
+static void m_sync_throttle(struct m_sync *const sc, const size_t written_size)
+{
+  if (sc->sync_bandwidth == 0) {
+    return;
+  }
+
+  sc->round_written_size += written_size;
+
+  const uint64_t expected_time = sc->round_written_size * 1000 /
+      sc->sync_bandwidth;
+  const uint64_t elapsed_time = (p_get_monotonic_time_ns() -
+      sc->round_start_time) / (1000 * 1000);
+  if (expected_time > elapsed_time) {
+    (void)p_event_wait_with_timeout(&sc->stop_event,
+        expected_time - elapsed_time);
+  }
+}
+
+static void m_sync_commit(struct m_sync *const sc, const size_t start_offset,
+    const size_t end_offset)
 {
+  const struct m_storage *const storage = sc->storage;
+
   assert(start_offset <= end_offset);
   assert(end_offset <= storage->size);
 
@@ -1460,85 +4415,147 @@ static void m_sync_commit(const struct m_storage *const storage,
    * corruptions by clearing corrupted slots.
    */
 
+  const size_t size = m_sync_get_range_size(start_offset, end_offset);
+  if (size == 0) {
+    return;
+  }
+
   /*
-   * There is no need in syncing the last page, which has unwritten data.
+   * Write back dirty pages in bounded chunks, so the write-back bandwidth
+   * may be throttled and the I/O queue isn't flooded with a single huge
+   * request. Storage is mapped at the beginning of the storage file,
+   * so storage offsets match file offsets.
    */
-  const size_t end_offset_adjusted = end_offset & ~p_memory_page_mask();
+  size_t offset = start_offset;
+  while (offset < start_offset + size) {
+    size_t chunk_size = start_offset + size - offset;
+    if (chunk_size > C_SYNC_CHUNK_SIZE) {
+      chunk_size = C_SYNC_CHUNK_SIZE;
+    }
 
-  if (end_offset_adjusted > start_offset) {
-    void *const ptr = m_storage_get_ptr(storage, start_offset);
-    p_memory_sync(ptr, end_offset_adjusted - start_offset);
+    p_file_writeback(sc->storage_file, offset, chunk_size);
+    offset += chunk_size;
+
+    p_atomic_store(&sc->backlog_size,
+        p_atomic_load(&sc->backlog_size) - chunk_size);
+    m_stats_add(sc->stats, M_STATS_SYNC_BYTES, chunk_size);
+    m_sync_throttle(sc, chunk_size);
   }
+
+  /*
+   * Pages are already clean, so msync() only flushes file metadata
+   * and disk write caches here.
+   */
+  void *const ptr = m_storage_get_ptr(storage, start_offset);
+  p_memory_sync(ptr, size);
 }
 
-static void m_sync_flush_data(struct p_lock *const cache_lock,
-    const struct m_storage *const storage,
-    struct ybc_item *const acquired_items_head,
-    struct m_storage_cursor *const sync_cursor,
-    const int has_overwrite_protection)
+static void m_sync_flush_data(struct m_sync *const sc,
+    struct m_storage_arena *const arena,
+    struct m_storage_cursor *const sync_cursor)
 {
-  p_lock_lock(cache_lock);
-  struct m_storage_cursor next_cursor = *storage->next_cursor;
-  if (has_overwrite_protection) {
+  const size_t start_offset = arena->start_offset;
+  const size_t end_offset = arena->end_offset;
+
+  m_stats_lock(sc->stats, &arena->lock);
+  struct m_storage_cursor next_cursor = *arena->next_cursor;
+  if (sc->has_overwrite_protection) {
     if (next_cursor.offset < sync_cursor->offset) {
 
         assert(next_cursor.wrap_count != sync_cursor->wrap_count);
 
-        next_cursor.offset = storage->size;
-        m_sync_adjust_next_cursor(acquired_items_head, sync_cursor, &next_cursor);
-        if (next_cursor.offset == storage->size) {
-          next_cursor = *storage->next_cursor;
-          struct m_storage_cursor zero_cursor = next_cursor;
-          zero_cursor.offset = 0;
-          m_sync_adjust_next_cursor(acquired_items_head, &zero_cursor, &next_cursor);
+        next_cursor.offset = end_offset;
+        m_sync_adjust_next_cursor(&arena->acquired_items_head, sync_cursor,
+            &next_cursor);
+        if (next_cursor.offset == end_offset) {
+          next_cursor = *arena->next_cursor;
+          struct m_storage_cursor start_cursor = next_cursor;
+          start_cursor.offset = start_offset;
+          m_sync_adjust_next_cursor(&arena->acquired_items_head, &start_cursor,
+              &next_cursor);
         }
     } else {
-      m_sync_adjust_next_cursor(acquired_items_head, sync_cursor, &next_cursor);
+      m_sync_adjust_next_cursor(&arena->acquired_items_head, sync_cursor,
+          &next_cursor);
     }
   }
-  p_lock_unlock(cache_lock);
+  p_lock_unlock(&arena->lock);
+
+  /*
+   * Figure out which parts of the arena need to be synced.
+   * The arena lock isn't held during I/O, so writers aren't blocked
+   * by syncing.
+   */
+  size_t ranges[2][2];
+  size_t ranges_count;
 
   if (next_cursor.wrap_count == sync_cursor->wrap_count) {
     /*
-     * Storage didn't wrap since the previous sync.
+     * Arena didn't wrap since the previous sync.
      * Let's sync data till next_cursor.
      */
 
     assert(sync_cursor->offset <= next_cursor.offset);
 
-    m_sync_commit(storage, sync_cursor->offset, next_cursor.offset);
+    ranges[0][0] = sync_cursor->offset;
+    ranges[0][1] = next_cursor.offset;
+    ranges_count = 1;
+  }
+  else if (next_cursor.wrap_count - 1 == sync_cursor->wrap_count &&
+      next_cursor.offset < sync_cursor->offset) {
+    /*
+     * Arena wrapped once since the previous sync.
+     * Let's sync data in two steps:
+     * - from sync_cursor till the end of the arena.
+     * - from the beginning of the arena till next_cursor.
+     */
+
+    assert(sync_cursor->offset <= end_offset);
+
+    ranges[0][0] = sync_cursor->offset;
+    ranges[0][1] = end_offset;
+    ranges[1][0] = start_offset;
+    ranges[1][1] = next_cursor.offset;
+    ranges_count = 2;
   }
   else {
     /*
-     * Storage wrapped at least once since the previous sync.
-     * Figure out which parts of storage need to be synced.
+     * Arena wrapped more than once since the previous sync, i.e. it is full
+     * of unsynced data. Let's sync the whole arena.
      */
 
-    if (next_cursor.wrap_count - 1 == sync_cursor->wrap_count &&
-        next_cursor.offset < sync_cursor->offset) {
-      /*
-       * Storage wrapped once since the previous sync.
-       * Let's sync data in two steps:
-       * - from sync_cursor till the end of the storage.
-       * - from the beginning of the storage till next_cursor.
-       */
+    ranges[0][0] = start_offset;
+    ranges[0][1] = end_offset;
+    ranges_count = 1;
+  }
+
+  size_t backlog_size = p_atomic_load(&sc->backlog_size);
+  for (size_t i = 0; i < ranges_count; ++i) {
+    backlog_size += m_sync_get_range_size(ranges[i][0], ranges[i][1]);
+  }
+  p_atomic_store(&sc->backlog_size, backlog_size);
+  m_storage_cursor_store(sync_cursor, &next_cursor);
 
-      assert(sync_cursor->offset <= storage->size);
+  for (size_t i = 0; i < ranges_count; ++i) {
+    m_sync_commit(sc, ranges[i][0], ranges[i][1]);
+  }
+}
 
-      m_sync_commit(storage, sync_cursor->offset, storage->size);
-      m_sync_commit(storage, 0, next_cursor.offset);
-    }
-    else {
-      /*
-       * Storage wrapped more than once since the previous sync, i.e. it is full
-       * of unsynced data. Let's sync the whole storage.
-       */
+static void m_sync_flush_arenas(struct m_sync *const sc)
+{
+  struct m_storage *const storage = sc->storage;
+  const uint64_t start_time = p_get_monotonic_time_ns();
 
-      m_sync_commit(storage, 0, storage->size);
-    }
+  sc->round_start_time = start_time;
+  sc->round_written_size = 0;
+
+  for (size_t i = 0; i < storage->arenas_count; ++i) {
+    m_sync_flush_data(sc, &storage->arenas[i], &sc->sync_cursors[i]);
   }
 
-  *sync_cursor = next_cursor;
+  const uint64_t end_time = p_get_monotonic_time_ns();
+  m_stats_inc(sc->stats, M_STATS_SYNCS);
+  m_stats_add(sc->stats, M_STATS_SYNC_TIME_NS, end_time - start_time);
 }
 
 static void m_sync_thread_func(void *const ctx)
@@ -1546,27 +4563,33 @@ static void m_sync_thread_func(void *const ctx)
   struct m_sync *const sc = ctx;
 
   while (!p_event_wait_with_timeout(&sc->stop_event, sc->sync_interval)) {
-    m_sync_flush_data(sc->cache_lock, sc->storage, sc->acquired_items_head,
-        &sc->sync_cursor, sc->has_overwrite_protection);
+    m_sync_flush_arenas(sc);
   }
 
-  m_sync_flush_data(sc->cache_lock, sc->storage, sc->acquired_items_head,
-      &sc->sync_cursor, sc->has_overwrite_protection);
+  m_sync_flush_arenas(sc);
 }
 
 static void m_sync_init(struct m_sync *const sc,
-    const uint64_t sync_interval, const struct m_storage_cursor sync_cursor,
-    struct m_storage *const storage,
-    struct ybc_item *const acquired_items_head,
-    struct p_lock *const cache_lock,
-    const int has_overwrite_protection)
+    const uint64_t sync_interval, const uint64_t sync_bandwidth,
+    struct m_storage *const storage, const struct p_file *const storage_file,
+    const struct m_stats *const stats, const int has_overwrite_protection)
 {
+  const size_t arenas_count = storage->arenas_count;
+
   sc->sync_interval = sync_interval;
+  sc->sync_bandwidth = sync_bandwidth;
   sc->has_overwrite_protection = has_overwrite_protection;
-  sc->sync_cursor = sync_cursor;
+  sc->backlog_size = 0;
+  sc->round_start_time = 0;
+  sc->round_written_size = 0;
   sc->storage = storage;
-  sc->acquired_items_head = acquired_items_head;
-  sc->cache_lock = cache_lock;
+  sc->storage_file = storage_file;
+  sc->stats = stats;
+
+  sc->sync_cursors = p_malloc(arenas_count * sizeof(sc->sync_cursors[0]));
+  for (size_t i = 0; i < arenas_count; ++i) {
+    sc->sync_cursors[i] = *storage->arenas[i].next_cursor;
+  }
 
   if (sync_interval > 0) {
     p_event_init(&sc->stop_event);
@@ -1581,170 +4604,831 @@ static void m_sync_destroy(struct m_sync *const sc)
     p_thread_join_and_destroy(&sc->sync_thread);
     p_event_destroy(&sc->stop_event);
   }
+
+  p_free(sc->sync_cursors);
+}
+
+/*
+ * Returns the size of data, which isn't synced yet.
+ *
+ * The returned value is approximate, since it is calculated without
+ * holding arena locks.
+ */
+static size_t m_sync_get_backlog_size(struct m_sync *const sc)
+{
+  const struct m_storage *const storage = sc->storage;
+  size_t backlog_size = p_atomic_load(&sc->backlog_size);
+
+  for (size_t i = 0; i < storage->arenas_count; ++i) {
+    const struct m_storage_arena *const arena = &storage->arenas[i];
+    struct m_storage_cursor sync_cursor, next_cursor;
+
+    m_storage_cursor_load(&sync_cursor, &sc->sync_cursors[i]);
+    m_storage_cursor_load(&next_cursor, arena->next_cursor);
+    backlog_size += m_sync_get_unsynced_size(arena, &sync_cursor,
+        &next_cursor);
+  }
+
+  return backlog_size;
+}
+
+
+/*******************************************************************************
+ * Dogpile effect API.
+ ******************************************************************************/
+
+/*
+ * Dogpile effect slot, which tracks an item pending to be added or updated
+ * in the cache.
+ */
+struct m_de_slot
+{
+  /*
+   * Sequence number for synchronizing readers with the writer.
+   *
+   * Odd value means the writer is modifying the slot. Writers claim the slot
+   * by atomically incrementing even seq via CAS, so no locks are required.
+   */
+  size_t seq;
+
+  /*
+   * Key digest for pending item.
+   */
+  struct m_key_digest key_digest;
+
+  /*
+   * Expiration time for the item.
+   *
+   * The slot is free if the expiration time is in the past. Zero expiration
+   * time means the slot has never been used.
+   */
+  uint64_t expiration_time;
+};
+
+/*
+ * Waiter for pending item registered via ybc_item_get_de_notify().
+ */
+struct ybc_de_waiter
+{
+  /*
+   * The next waiter in the waiters list.
+   */
+  struct ybc_de_waiter *next;
+
+  /*
+   * Key digest for the pending item the waiter waits for.
+   */
+  struct m_key_digest key_digest;
+
+  /*
+   * The waiter is notified after this time even if the item isn't added
+   * into the cache.
+   */
+  uint64_t expiration_time;
+
+  ybc_de_notify_func notify_func;
+  void *notify_ctx;
+};
+
+/*
+ * Pending item, which didn't fit m_de->slots.
+ */
+struct m_de_spill_item
+{
+  /*
+   * The next item in the spill list.
+   */
+  struct m_de_spill_item *next;
+
+  /*
+   * Key digest for pending item.
+   */
+  struct m_key_digest key_digest;
+
+  /*
+   * Expiration time for the item.
+   */
+  uint64_t expiration_time;
+};
+
+/*
+ * A fixed-capacity open-addressed hashtable of items, which are pending
+ * to be added or updated in the cache.
+ *
+ * The hashtable requires neither locks nor memory allocations, so concurrent
+ * misses on distinct keys don't serialize on each other. Items, which don't
+ * fit the hashtable, are spilled into a locked list, so they remain protected
+ * from dogpile effect.
+ */
+struct m_de
+{
+  /*
+   * The number of slots in the hashtable.
+   */
+  size_t slots_count;
+
+  struct m_de_slot *slots;
+
+  /*
+   * A list of pending items, which didn't fit slots.
+   */
+  struct m_de_spill_item *spill_head;
+
+  /*
+   * Protects spill_head.
+   */
+  struct p_lock spill_lock;
+
+  /*
+   * The number of items in spill_head plus the number of threads, which are
+   * about to add items into spill_head.
+   *
+   * This allows skipping spill_head lookup when registering pending items
+   * if the spill list is empty.
+   */
+  size_t spill_count;
+
+  /*
+   * Wait words for threads waiting for pending items in ybc_item_get_de().
+   *
+   * There are slots_count wait words. Items are mapped to wait words
+   * by their key digests, so only threads waiting for items with the same
+   * wait word are woken up when an item is added into the cache.
+   */
+  uint32_t *wait_words;
+
+  /*
+   * The number of threads blocked on each wait word.
+   *
+   * There are slots_count counters. This allows skipping wait word wakeups
+   * when adding items into the cache if nobody waits on the corresponding
+   * wait word.
+   */
+  size_t *waiters_counts;
+
+  /*
+   * Lists of waiters registered via ybc_item_get_de_notify().
+   *
+   * There are slots_count lists. Waiters are mapped to lists the same way
+   * as threads are mapped to wait words.
+   */
+  struct ybc_de_waiter **waiter_heads;
+
+  /*
+   * Protects waiter_heads.
+   */
+  struct p_lock waiters_lock;
+
+  /*
+   * The number of waiters in waiter_heads.
+   *
+   * This allows skipping waiters lookup when adding items into the cache
+   * if nobody waits for them.
+   */
+  size_t async_waiters_count;
+
+  /*
+   * A wait word for notify_thread. It is changed each time the thread
+   * is woken up.
+   */
+  uint32_t wake_word;
+
+  /*
+   * Set when notify_thread is about to sleep or sleeps on wake_word
+   * until the first waiter is registered.
+   */
+  size_t is_sleeping;
+
+  /*
+   * Set when notify_thread should be stopped.
+   */
+  size_t is_stopped;
+
+  /*
+   * Set when notify_thread has been started. The thread is started lazily
+   * on the first waiter registration, so caches, which don't use
+   * ybc_item_get_de_notify(), don't pay for it.
+   *
+   * Protected by waiters_lock.
+   */
+  int is_notify_thread_started;
+
+  /*
+   * A thread, which notifies waiters for pending items, which weren't added
+   * into the cache during grace ttl.
+   */
+  struct p_thread notify_thread;
+};
+
+static size_t m_de_get_waiters_index(const struct m_de *const de,
+    const struct m_key_digest *const key_digest)
+{
+  return m_key_digest_mod(key_digest, de->slots_count);
+}
+
+/*
+ * Removes the first waiter from the list at the given index, which waits
+ * for the item with the given key_digest or which expires
+ * until current_time. Then notifies the removed waiter.
+ *
+ * key_digest may be NULL if only expired waiters must be notified.
+ *
+ * Returns 0 if there are no such waiters.
+ */
+static int m_de_waiters_notify_one(struct m_de *const de, const size_t index,
+    const struct m_key_digest *const key_digest, const uint64_t current_time)
+{
+  struct ybc_de_waiter *waiter;
+
+  p_lock_lock(&de->waiters_lock);
+  struct ybc_de_waiter **prev_next = &de->waiter_heads[index];
+  for (;;) {
+    waiter = *prev_next;
+    if (waiter == NULL) {
+      p_lock_unlock(&de->waiters_lock);
+      return 0;
+    }
+    if (waiter->expiration_time <= current_time || (key_digest != NULL &&
+        m_key_digest_equal(&waiter->key_digest, key_digest))) {
+      break;
+    }
+    prev_next = &waiter->next;
+  }
+  *prev_next = waiter->next;
+  (void)p_atomic_add(&de->async_waiters_count, (size_t)-1);
+
+  /*
+   * The waiter may be reused by the caller as soon as notify_func is called,
+   * so read the callback before calling it. The callback is called without
+   * the lock, since it may register new waiters.
+   */
+  const ybc_de_notify_func notify_func = waiter->notify_func;
+  void *const notify_ctx = waiter->notify_ctx;
+  p_lock_unlock(&de->waiters_lock);
+
+  notify_func(notify_ctx);
+  return 1;
+}
+
+/*
+ * Notifies all the waiters expiring until current_time.
+ */
+static void m_de_waiters_notify_expired(struct m_de *const de,
+    const uint64_t current_time)
+{
+  for (size_t i = 0; i < de->slots_count; ++i) {
+    if (p_atomic_load(&de->async_waiters_count) == 0) {
+      break;
+    }
+    while (m_de_waiters_notify_one(de, i, NULL, current_time)) {
+      /* Notify all the expired waiters in the list. */
+    }
+  }
 }
 
+static void m_de_notify_thread_func(void *const ctx)
+{
+  struct m_de *const de = ctx;
+
+  for (;;) {
+    /*
+     * Sleep while there are no waiters. The re-check after setting
+     * is_sleeping pairs with m_de_notify_thread_wake(), so wakeups aren't
+     * lost.
+     */
+    uint32_t wake_word = p_wait_word_get(&de->wake_word);
+    p_atomic_store(&de->is_sleeping, 1);
+    p_memory_barrier();
+    if (!p_atomic_load(&de->is_stopped) &&
+        p_atomic_load(&de->async_waiters_count) == 0) {
+      p_wait_word_wait(&de->wake_word, wake_word, UINT64_MAX);
+    }
+    p_atomic_store(&de->is_sleeping, 0);
+
+    wake_word = p_wait_word_get(&de->wake_word);
+    if (!p_atomic_load(&de->is_stopped)) {
+      p_wait_word_wait(&de->wake_word, wake_word, C_DE_NOTIFY_INTERVAL);
+    }
+    if (p_atomic_load(&de->is_stopped)) {
+      break;
+    }
 
-/*******************************************************************************
- * Dogpile effect API.
- ******************************************************************************/
+    m_de_waiters_notify_expired(de, p_get_current_time());
+  }
+}
 
 /*
- * Dogpile effect item, which is pending to be added or updated in the cache.
+ * Wakes up notify_thread if it sleeps.
+ *
+ * Must be called after registering a waiter.
  */
-struct m_de_item
+static void m_de_notify_thread_wake(struct m_de *const de)
 {
   /*
-   * Pointer to the next item in the list.
-   *
-   * List's header is located in the m_de->pending_items hashtable.
+   * The registered waiter must become visible before checking is_sleeping.
+   * This pairs with p_memory_barrier() in m_de_notify_thread_func().
    */
-  struct m_de_item *next;
+  p_memory_barrier();
+  if (p_atomic_load(&de->is_sleeping) &&
+      p_atomic_cas(&de->is_sleeping, 1, 0)) {
+    p_wait_word_wake_all(&de->wake_word);
+  }
+}
 
-  /*
-   * Key digest for pending item.
-   */
-  struct m_key_digest key_digest;
+static void m_de_init(struct m_de *const de, const size_t slots_count)
+{
+  assert(slots_count > 0);
+
+  const size_t slot_size = sizeof(de->slots[0]) + sizeof(de->wait_words[0]) +
+      sizeof(de->waiters_counts[0]) + sizeof(de->waiter_heads[0]);
+  assert(slots_count <= SIZE_MAX / slot_size);
 
   /*
-   * Expiration time for the item.
-   *
-   * The item is automatically removed from the list after it is expired.
+   * Waiter heads and waiters counts are placed before wait words in order
+   * to keep them aligned.
    */
-  uint64_t expiration_time;
-};
+  de->slots_count = slots_count;
+  de->slots = p_malloc(slots_count * slot_size);
+  de->waiter_heads = (struct ybc_de_waiter **)(de->slots + slots_count);
+  de->waiters_counts = (size_t *)(de->waiter_heads + slots_count);
+  de->wait_words = (uint32_t *)(de->waiters_counts + slots_count);
+  de->spill_head = NULL;
+  de->spill_count = 0;
+  de->async_waiters_count = 0;
+
+  for (size_t i = 0; i < slots_count; ++i) {
+    struct m_de_slot *const slot = &de->slots[i];
+    slot->seq = 0;
+    m_key_digest_clear(&slot->key_digest);
+    slot->expiration_time = 0;
+    de->wait_words[i] = 0;
+    de->waiters_counts[i] = 0;
+    de->waiter_heads[i] = NULL;
+  }
 
-struct m_de
+  p_lock_init(&de->spill_lock);
+  p_lock_init(&de->waiters_lock);
+  de->wake_word = 0;
+  de->is_sleeping = 0;
+  de->is_stopped = 0;
+  de->is_notify_thread_started = 0;
+}
+
+static void m_de_destroy(struct m_de *const de)
 {
-  /*
-   * The number of buckets in pending_items hash table.
-   */
-  size_t buckets_count;
+  if (de->is_notify_thread_started) {
+    p_atomic_store(&de->is_stopped, 1);
+    p_wait_word_wake_all(&de->wake_word);
+    p_thread_join_and_destroy(&de->notify_thread);
+  }
 
   /*
-   * Locks for pending_items buckets.
+   * Notify the remaining waiters registered via ybc_item_get_de_notify(),
+   * since their items will never be added into the cache.
    */
-  struct p_lock *locks;
+  m_de_waiters_notify_expired(de, UINT64_MAX);
+  assert(de->async_waiters_count == 0);
+  p_lock_destroy(&de->waiters_lock);
 
   /*
-   * A hash table of buckets with items, which are pending to be added
-   * or updated in the cache.
+   * de->slots can contain not-yet-expired items at destruction time.
+   * It is safe dropping them now.
+   *
+   * There are no blocked threads, since the cache is closed only after all
+   * the threads stop using it.
    */
-  struct m_de_item **pending_items;
-};
+  for (size_t i = 0; i < de->slots_count; ++i) {
+    assert(de->waiters_counts[i] == 0);
+  }
+
+  struct m_de_spill_item *spill_item = de->spill_head;
+  while (spill_item != NULL) {
+    struct m_de_spill_item *const next = spill_item->next;
+    p_free(spill_item);
+    spill_item = next;
+  }
+  p_lock_destroy(&de->spill_lock);
+
+  p_free(de->slots);
+}
 
-static void m_de_init(struct m_de *const de, const size_t buckets_count)
+/*
+ * Reads the slot contents into key_digest and expiration_time.
+ *
+ * Returns the slot's seq corresponding to the contents read.
+ * Returns odd value if the slot is being modified by a writer.
+ */
+static size_t m_de_slot_read(struct m_de_slot *const slot,
+    struct m_key_digest *const key_digest, uint64_t *const expiration_time)
 {
-  assert(buckets_count > 0);
-  de->buckets_count = buckets_count;
+  for (;;) {
+    const size_t seq = p_atomic_load(&slot->seq);
+    if (seq & 1) {
+      return seq;
+    }
 
-  const size_t item_with_lock_size = sizeof(*de->locks) +
-      sizeof(*de->pending_items);
-  assert(buckets_count <= SIZE_MAX / item_with_lock_size);
-  de->locks = p_malloc(buckets_count * item_with_lock_size);
-  de->pending_items = (struct m_de_item **)(de->locks + buckets_count);
+    *key_digest = slot->key_digest;
+    *expiration_time = slot->expiration_time;
 
-  for (size_t i = 0; i < buckets_count; ++i) {
-    p_lock_init(&de->locks[i]);
-    de->pending_items[i] = NULL;
+    /*
+     * Slot reads above mustn't be reordered with the sequence counter
+     * re-check below.
+     */
+    p_memory_acquire_barrier();
+    if (p_atomic_load(&slot->seq) == seq) {
+      return seq;
+    }
   }
 }
 
-static void m_de_item_destroy_all(struct m_de_item *const de_item)
+/*
+ * Looks up the pending item with the given key_digest in the spill list
+ * and removes expired items from the list on the way.
+ *
+ * Returns the expiration time for the found item or 0 if the item is missing.
+ *
+ * The caller must hold de->spill_lock.
+ */
+static uint64_t m_de_spill_lookup(struct m_de *const de,
+    const struct m_key_digest *const key_digest, const uint64_t current_time)
 {
-  struct m_de_item *tmp = de_item;
+  uint64_t found_expiration_time = 0;
+  struct m_de_spill_item **prev_next = &de->spill_head;
+
+  for (;;) {
+    struct m_de_spill_item *const spill_item = *prev_next;
+    if (spill_item == NULL) {
+      return found_expiration_time;
+    }
+
+    if (spill_item->expiration_time <= current_time) {
+      *prev_next = spill_item->next;
+      p_free(spill_item);
+      (void)p_atomic_add(&de->spill_count, (size_t)-1);
+      continue;
+    }
 
-  while (tmp != NULL) {
-    struct m_de_item *const next = tmp->next;
-    p_free(tmp);
-    tmp = next;
+    if (m_key_digest_equal(&spill_item->key_digest, key_digest)) {
+      found_expiration_time = spill_item->expiration_time;
+    }
+    prev_next = &spill_item->next;
   }
 }
 
-static void m_de_destroy(struct m_de *const de)
+/*
+ * Looks up the pending item with the given key_digest in the probed slots.
+ *
+ * Returns the expiration time for the found item, UINT64_MAX if one of
+ * the probed slots is being modified by a writer or 0 if the item is missing.
+ */
+static uint64_t m_de_slots_lookup(struct m_de *const de,
+    const struct m_key_digest *const key_digest, const size_t start_index,
+    const size_t probes_count, const uint64_t current_time)
+{
+  for (size_t i = 0; i < probes_count; ++i) {
+    struct m_de_slot *const slot =
+        &de->slots[(start_index + i) % de->slots_count];
+    struct m_key_digest slot_key_digest;
+    uint64_t expiration_time;
+
+    const size_t seq = m_de_slot_read(slot, &slot_key_digest,
+        &expiration_time);
+    if (seq & 1) {
+      return UINT64_MAX;
+    }
+
+    if (expiration_time > current_time &&
+        m_key_digest_equal(&slot_key_digest, key_digest)) {
+      return expiration_time;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Registers the item with the given key_digest as pending in the spill list.
+ *
+ * This function is called when all the probed slots are occupied by other
+ * pending items.
+ *
+ * Returns the same values as m_de_item_register().
+ */
+static int m_de_spill_register(struct m_de *const de,
+    const struct m_key_digest *const key_digest, const size_t start_index,
+    const size_t probes_count, const uint64_t grace_ttl,
+    const uint64_t current_time, uint64_t *const wait_time)
 {
+  p_lock_lock(&de->spill_lock);
+
   /*
-   * de->pending_items can contain not-yet-expired items at destruction time.
-   * It is safe removing them now.
+   * Announce the upcoming spill item before re-checking the slots,
+   * so a concurrent m_de_item_register() either publishes its slot before
+   * the re-check below or notices non-zero spill_count after publishing
+   * the slot.
    */
-  for (size_t i = 0; i < de->buckets_count; ++i) {
-    m_de_item_destroy_all(de->pending_items[i]);
-    p_lock_destroy(&de->locks[i]);
+  (void)p_atomic_add(&de->spill_count, 1);
+  p_memory_barrier();
+
+  uint64_t expiration_time = m_de_spill_lookup(de, key_digest, current_time);
+  if (expiration_time == 0) {
+    expiration_time = m_de_slots_lookup(de, key_digest, start_index,
+        probes_count, current_time);
+  }
+
+  if (expiration_time != 0) {
+    (void)p_atomic_add(&de->spill_count, (size_t)-1);
+    p_lock_unlock(&de->spill_lock);
+
+    /*
+     * UINT64_MAX means the writer may be registering the same item right
+     * now, so the caller will retry shortly.
+     */
+    *wait_time = (expiration_time == UINT64_MAX) ?
+        C_DE_ITEM_MIN_GRACE_TTL : expiration_time - current_time;
+    return 0;
   }
 
-  p_free(de->locks);
+  struct m_de_spill_item *const spill_item = p_malloc(sizeof(*spill_item));
+  spill_item->next = de->spill_head;
+  spill_item->key_digest = *key_digest;
+  spill_item->expiration_time = grace_ttl + current_time;
+  de->spill_head = spill_item;
+
+  p_lock_unlock(&de->spill_lock);
+  return 1;
 }
 
-static struct m_de_item *m_de_item_get(
-    struct m_de_item **const pending_items_ptr,
-    const struct m_key_digest *const key_digest, const uint64_t current_time)
+/*
+ * Registers the item with the given key_digest as pending for grace_ttl
+ * milliseconds.
+ *
+ * Returns 1 if the item has been registered, i.e. the caller is responsible
+ * for adding the item into the cache.
+ * Returns 0 if the item is already pending. In this case stores
+ * the number of milliseconds remaining until the pending item expires
+ * into wait_time.
+ */
+static int m_de_item_register(struct m_de *const de,
+    const struct m_key_digest *const key_digest, const uint64_t grace_ttl,
+    uint64_t *const wait_time)
 {
-  struct m_de_item **prev_ptr = pending_items_ptr;
+  assert(grace_ttl >= C_DE_ITEM_MIN_GRACE_TTL);
+  assert(grace_ttl <= C_DE_ITEM_MAX_GRACE_TTL);
+
+  const uint64_t current_time = p_get_current_time();
+
+  /* This assertion may break in very far future. */
+  assert(grace_ttl <= UINT64_MAX - current_time);
+
+  const size_t start_index = m_key_digest_mod(key_digest, de->slots_count);
+  size_t probes_count = C_DE_MAX_PROBES_COUNT;
+  if (probes_count > de->slots_count) {
+    probes_count = de->slots_count;
+  }
 
   for (;;) {
-    struct m_de_item *const de_item = *prev_ptr;
+    struct m_de_slot *free_slot = NULL;
+    size_t free_slot_seq = 0;
+
+    for (size_t i = 0; i < probes_count; ++i) {
+      struct m_de_slot *const slot =
+          &de->slots[(start_index + i) % de->slots_count];
+      struct m_key_digest slot_key_digest;
+      uint64_t expiration_time;
+
+      const size_t seq = m_de_slot_read(slot, &slot_key_digest,
+          &expiration_time);
+      if (seq & 1) {
+        /*
+         * The writer may be registering the same item right now,
+         * so treat it as pending. The caller will retry shortly.
+         */
+        *wait_time = C_DE_ITEM_MIN_GRACE_TTL;
+        return 0;
+      }
+
+      if (expiration_time <= current_time) {
+        if (free_slot == NULL) {
+          free_slot = slot;
+          free_slot_seq = seq;
+        }
+        continue;
+      }
 
-    if (de_item == NULL) {
-      return NULL;
+      if (m_key_digest_equal(&slot_key_digest, key_digest)) {
+        *wait_time = expiration_time - current_time;
+        return 0;
+      }
+    }
+
+    if (free_slot == NULL) {
+      /*
+       * All the probed slots are occupied by other pending items.
+       * Spill the item instead of waiting for a free slot.
+       */
+      return m_de_spill_register(de, key_digest, start_index, probes_count,
+          grace_ttl, current_time, wait_time);
     }
 
-    if (de_item->expiration_time <= current_time) {
-      /* Remove expired items. */
-      *prev_ptr = de_item->next;
-      p_free(de_item);
+    if (!p_atomic_cas(&free_slot->seq, free_slot_seq, free_slot_seq + 1)) {
+      /* Somebody else has just claimed the slot. Start over. */
       continue;
     }
 
-    if (m_key_digest_equal(&de_item->key_digest, key_digest)) {
-      return de_item;
+    free_slot->key_digest = *key_digest;
+    free_slot->expiration_time = grace_ttl + current_time;
+    p_atomic_store(&free_slot->seq, free_slot_seq + 2);
+
+    /*
+     * The item may have been spilled by a concurrent thread, which didn't
+     * see free_slot claimed above. The barrier guarantees that spill_count
+     * is read after the slot has been published.
+     */
+    p_memory_barrier();
+    if (p_atomic_load(&de->spill_count) == 0) {
+      return 1;
+    }
+
+    p_lock_lock(&de->spill_lock);
+    const uint64_t expiration_time = m_de_spill_lookup(de, key_digest,
+        current_time);
+    p_lock_unlock(&de->spill_lock);
+
+    if (expiration_time == 0) {
+      return 1;
+    }
+
+    /* The item is already pending in the spill list. Release the slot. */
+    if (p_atomic_cas(&free_slot->seq, free_slot_seq + 2, free_slot_seq + 3)) {
+      free_slot->expiration_time = 0;
+      p_atomic_store(&free_slot->seq, free_slot_seq + 4);
     }
 
-    prev_ptr = &de_item->next;
+    *wait_time = expiration_time - current_time;
+    return 0;
   }
+}
 
-  return NULL;
+static size_t m_de_get_wait_word_index(const struct m_de *const de,
+    const struct m_key_digest *const key_digest)
+{
+  return m_key_digest_mod(key_digest, de->slots_count);
 }
 
-static void m_de_item_set(struct m_de_item **const pending_items_ptr,
-    const struct m_key_digest *const key_digest, const uint64_t expiration_time)
+/*
+ * Registers the current thread as a waiter for the pending item with
+ * the given key_digest.
+ *
+ * The item must be looked up in the cache after this call and before
+ * m_de_item_wait() call, otherwise the wakeup may be lost.
+ *
+ * Returns the wait word value, which must be passed to m_de_item_wait().
+ */
+static uint32_t m_de_item_wait_begin(struct m_de *const de,
+    const struct m_key_digest *const key_digest)
 {
-  struct m_de_item *const de_item = p_malloc(sizeof(*de_item));
+  const size_t index = m_de_get_wait_word_index(de, key_digest);
+  (void)p_atomic_add(&de->waiters_counts[index], 1);
+  return p_wait_word_get(&de->wait_words[index]);
+}
 
-  de_item->next = *pending_items_ptr;
-  de_item->key_digest = *key_digest;
-  de_item->expiration_time = expiration_time;
+/*
+ * Waits until the item with the given key_digest is added into the cache,
+ * but no longer than wait_time milliseconds.
+ *
+ * Spurious wakeups are possible.
+ */
+static void m_de_item_wait(const struct m_de *const de,
+    const struct m_key_digest *const key_digest, const uint32_t wait_word,
+    const uint64_t wait_time)
+{
+  const size_t index = m_de_get_wait_word_index(de, key_digest);
+  p_wait_word_wait(&de->wait_words[index], wait_word, wait_time);
+}
 
-  *pending_items_ptr = de_item;
+static void m_de_item_wait_end(struct m_de *const de,
+    const struct m_key_digest *const key_digest)
+{
+  const size_t index = m_de_get_wait_word_index(de, key_digest);
+  (void)p_atomic_add(&de->waiters_counts[index], (size_t)-1);
 }
 
-static int m_de_item_register(struct m_de *const de,
-    const struct m_key_digest *const key_digest, const uint64_t grace_ttl)
+/*
+ * Wakes up threads waiting for the item with the given key_digest.
+ *
+ * Must be called after the item is added into the cache.
+ */
+static void m_de_item_notify(struct m_de *const de,
+    const struct m_key_digest *const key_digest)
 {
-  assert(grace_ttl >= C_DE_ITEM_MIN_GRACE_TTL);
-  assert(grace_ttl <= C_DE_ITEM_MAX_GRACE_TTL);
+  /*
+   * The item must become visible before checking for waiters.
+   * This pairs with p_atomic_add() in m_de_item_wait_begin().
+   */
+  p_memory_barrier();
+  const size_t index = m_de_get_wait_word_index(de, key_digest);
+  if (p_atomic_load(&de->waiters_counts[index]) != 0) {
+    p_wait_word_wake_all(&de->wait_words[index]);
+  }
+
+  /*
+   * This pairs with p_atomic_add() in m_de_waiter_register().
+   */
+  if (p_atomic_load(&de->async_waiters_count) != 0) {
+    const size_t waiters_index = m_de_get_waiters_index(de, key_digest);
+    while (m_de_waiters_notify_one(de, waiters_index, key_digest, 0)) {
+      /* Notify all the waiters for the item. */
+    }
+  }
+}
 
+/*
+ * Registers the given waiter for the pending item with the given key_digest.
+ *
+ * The waiter is notified after the item is added into the cache or after
+ * wait_time milliseconds.
+ *
+ * The item must be looked up in the cache after this call, otherwise
+ * the notification may be lost.
+ */
+static void m_de_waiter_register(struct m_de *const de,
+    struct ybc_de_waiter *const waiter,
+    const struct m_key_digest *const key_digest, const uint64_t wait_time,
+    const ybc_de_notify_func notify_func, void *const notify_ctx)
+{
   const uint64_t current_time = p_get_current_time();
 
-  const size_t idx = m_key_digest_mod(key_digest, de->buckets_count);
-  struct m_de_item **const pending_items_ptr = &de->pending_items[idx];
+  /* This assertion may break in very far future. */
+  assert(wait_time <= UINT64_MAX - current_time);
 
-  p_lock_lock(&de->locks[idx]);
+  const size_t index = m_de_get_waiters_index(de, key_digest);
 
-  struct m_de_item *const de_item = m_de_item_get(pending_items_ptr, key_digest,
-      current_time);
+  /*
+   * The waiter is filled under the lock, since ybc_de_waiter_cancel() may
+   * read it concurrently.
+   */
+  p_lock_lock(&de->waiters_lock);
+  waiter->key_digest = *key_digest;
+  waiter->expiration_time = current_time + wait_time;
+  waiter->notify_func = notify_func;
+  waiter->notify_ctx = notify_ctx;
+  waiter->next = de->waiter_heads[index];
+  de->waiter_heads[index] = waiter;
+  (void)p_atomic_add(&de->async_waiters_count, 1);
+  if (!de->is_notify_thread_started) {
+    de->is_notify_thread_started = 1;
+    p_thread_init_and_start(&de->notify_thread, &m_de_notify_thread_func, de);
+  }
+  p_lock_unlock(&de->waiters_lock);
 
-  if (de_item == NULL) {
-    /* This assertion may break in very far future. */
-    assert(grace_ttl <= UINT64_MAX - current_time);
+  m_de_notify_thread_wake(de);
+}
 
-    m_de_item_set(pending_items_ptr, key_digest, grace_ttl + current_time);
+/*
+ * Removes the given waiter from the waiters list at the given index.
+ *
+ * The waiter is compared by pointer only, so its' contents aren't read
+ * unless it is found in the list. The caller must hold de->waiters_lock.
+ *
+ * Returns 0 if the waiter has been already removed by notifier.
+ */
+static int m_de_waiter_remove(struct m_de *const de,
+    struct ybc_de_waiter *const waiter, const size_t index)
+{
+  struct ybc_de_waiter **prev_next = &de->waiter_heads[index];
+  while (*prev_next != NULL) {
+    if (*prev_next == waiter) {
+      *prev_next = waiter->next;
+      (void)p_atomic_add(&de->async_waiters_count, (size_t)-1);
+      return 1;
+    }
+    prev_next = &(*prev_next)->next;
   }
+  return 0;
+}
+
+/*
+ * Removes the given waiter registered for the item with the given key_digest
+ * from waiters list.
+ *
+ * The waiter may be already notified and reused by its' owner, so the index
+ * is calculated from the caller's key_digest instead of the waiter contents.
+ *
+ * Returns 0 if the waiter has been already removed by notifier.
+ */
+static int m_de_waiter_cancel(struct m_de *const de,
+    struct ybc_de_waiter *const waiter,
+    const struct m_key_digest *const key_digest)
+{
+  const size_t index = m_de_get_waiters_index(de, key_digest);
 
-  p_lock_unlock(&de->locks[idx]);
+  p_lock_lock(&de->waiters_lock);
+  const int is_found = m_de_waiter_remove(de, waiter, index);
+  p_lock_unlock(&de->waiters_lock);
 
-  return (de_item == NULL);
+  return is_found;
 }
 
-
 /*******************************************************************************
  * Config API.
  ******************************************************************************/
@@ -1756,10 +5440,24 @@ struct ybc_config
   size_t map_slots_count;
   size_t data_file_size;
   size_t map_cache_slots_count;
+  size_t map_cache_max_slots_count;
   size_t hot_data_size;
+  size_t max_hot_data_size;
   size_t de_hashtable_size;
+  size_t storage_arenas_count;
+  size_t item_slots_count;
   uint64_t sync_interval;
+  uint64_t sync_bandwidth;
   int has_overwrite_protection;
+  int has_clock_eviction;
+  int has_huge_pages;
+  size_t index_warmup_threads_count;
+  int has_background_index_warmup;
+  ybc_warmup_progress_func index_warmup_progress_func;
+  void *index_warmup_progress_ctx;
+  uint64_t hot_data_prefetch_bandwidth;
+  int has_hot_data_prefetch;
+  char *map_cache_file;
 };
 
 size_t ybc_config_get_size(void)
@@ -1774,16 +5472,33 @@ void ybc_config_init(struct ybc_config *const config)
   config->map_slots_count = C_CONFIG_DEFAULT_MAP_SLOTS_COUNT;
   config->data_file_size = C_CONFIG_DEFAULT_DATA_SIZE;
   config->map_cache_slots_count = C_CONFIG_DEFAULT_MAP_CACHE_SLOTS_COUNT;
+  config->map_cache_max_slots_count = 0;
   config->hot_data_size = C_CONFIG_DEFAULT_HOT_DATA_SIZE;
+  config->max_hot_data_size = 0;
   config->de_hashtable_size = C_CONFIG_DEFAULT_DE_HASHTABLE_SIZE;
+  config->storage_arenas_count = C_CONFIG_DEFAULT_STORAGE_ARENAS_COUNT;
+  config->item_slots_count = C_CONFIG_DEFAULT_ITEM_SLOTS_COUNT;
   config->sync_interval = C_CONFIG_DEFAULT_SYNC_INTERVAL;
+  config->sync_bandwidth = C_CONFIG_DEFAULT_SYNC_BANDWIDTH;
   config->has_overwrite_protection = 1;
+  config->has_clock_eviction = 0;
+  config->has_huge_pages = 0;
+  config->index_warmup_threads_count =
+      C_CONFIG_DEFAULT_INDEX_WARMUP_THREADS_COUNT;
+  config->has_background_index_warmup = 0;
+  config->index_warmup_progress_func = NULL;
+  config->index_warmup_progress_ctx = NULL;
+  config->hot_data_prefetch_bandwidth =
+      C_CONFIG_DEFAULT_HOT_DATA_PREFETCH_BANDWIDTH;
+  config->has_hot_data_prefetch = 0;
+  config->map_cache_file = NULL;
 }
 
 void ybc_config_destroy(struct ybc_config *const config)
 {
   p_free(config->index_file);
   p_free(config->data_file);
+  p_free(config->map_cache_file);
 }
 
 void ybc_config_set_max_items_count(struct ybc_config *const config,
@@ -1804,6 +5519,12 @@ void ybc_config_set_index_file(struct ybc_config *const config,
   p_strdup(&config->index_file, filename);
 }
 
+void ybc_config_set_map_cache_file(struct ybc_config *const config,
+    const char *const filename)
+{
+  p_strdup(&config->map_cache_file, filename);
+}
+
 void ybc_config_set_data_file(struct ybc_config *const config,
     const char *const filename)
 {
@@ -1816,12 +5537,25 @@ void ybc_config_set_hot_items_count(struct ybc_config *const config,
   config->map_cache_slots_count = hot_items_count / C_MAP_OPTIMAL_FILL_RATIO;
 }
 
+void ybc_config_set_max_hot_items_count(struct ybc_config *const config,
+    const size_t max_hot_items_count)
+{
+  config->map_cache_max_slots_count = max_hot_items_count /
+      C_MAP_OPTIMAL_FILL_RATIO;
+}
+
 void ybc_config_set_hot_data_size(struct ybc_config *const config,
     const size_t hot_data_size)
 {
   config->hot_data_size = hot_data_size;
 }
 
+void ybc_config_set_max_hot_data_size(struct ybc_config *const config,
+    const size_t max_hot_data_size)
+{
+  config->max_hot_data_size = max_hot_data_size;
+}
+
 void ybc_config_set_de_hashtable_size(struct ybc_config *const config,
     const size_t de_hashtable_size)
 {
@@ -1838,11 +5572,77 @@ void ybc_config_set_sync_interval(struct ybc_config *const config,
   config->sync_interval = sync_interval;
 }
 
+void ybc_config_set_sync_bandwidth(struct ybc_config *const config,
+    const uint64_t sync_bandwidth)
+{
+  config->sync_bandwidth = sync_bandwidth;
+}
+
 void ybc_config_disable_overwrite_protection(struct ybc_config *const config)
 {
   config->has_overwrite_protection = 0;
 }
 
+void ybc_config_enable_clock_eviction(struct ybc_config *const config)
+{
+  config->has_clock_eviction = 1;
+}
+
+void ybc_config_enable_huge_pages(struct ybc_config *const config)
+{
+  config->has_huge_pages = 1;
+}
+
+void ybc_config_set_storage_arenas_count(struct ybc_config *const config,
+    const size_t storage_arenas_count)
+{
+  config->storage_arenas_count = storage_arenas_count;
+}
+
+void ybc_config_set_item_slots_count(struct ybc_config *const config,
+    const size_t item_slots_count)
+{
+  config->item_slots_count = item_slots_count;
+  if (config->item_slots_count > C_CONFIG_MAX_ITEM_SLOTS_COUNT) {
+    config->item_slots_count = C_CONFIG_MAX_ITEM_SLOTS_COUNT;
+  }
+}
+
+void ybc_config_set_index_warmup_threads_count(struct ybc_config *const config,
+    const size_t index_warmup_threads_count)
+{
+  config->index_warmup_threads_count = index_warmup_threads_count;
+  if (config->index_warmup_threads_count >
+      C_CONFIG_MAX_INDEX_WARMUP_THREADS_COUNT) {
+    config->index_warmup_threads_count =
+        C_CONFIG_MAX_INDEX_WARMUP_THREADS_COUNT;
+  }
+}
+
+void ybc_config_enable_background_index_warmup(struct ybc_config *const config)
+{
+  config->has_background_index_warmup = 1;
+}
+
+void ybc_config_set_index_warmup_progress_callback(
+    struct ybc_config *const config,
+    const ybc_warmup_progress_func progress_func, void *const progress_ctx)
+{
+  config->index_warmup_progress_func = progress_func;
+  config->index_warmup_progress_ctx = progress_ctx;
+}
+
+void ybc_config_enable_hot_data_prefetch(struct ybc_config *const config)
+{
+  config->has_hot_data_prefetch = 1;
+}
+
+void ybc_config_set_hot_data_prefetch_bandwidth(
+    struct ybc_config *const config, const uint64_t hot_data_prefetch_bandwidth)
+{
+  config->hot_data_prefetch_bandwidth = hot_data_prefetch_bandwidth;
+}
+
 
 /*******************************************************************************
  * Cache management API
@@ -1850,15 +5650,30 @@ void ybc_config_disable_overwrite_protection(struct ybc_config *const config)
 
 struct ybc
 {
-  struct p_lock lock;
   struct p_file index_file;
   struct p_file storage_file;
   struct m_index index;
   struct m_storage storage;
   struct m_sync sc;
   struct m_de de;
-  struct ybc_item acquired_items_head;
-  struct ybc_item acquired_items_tail;
+  struct m_stats stats;
+  struct m_warmup warmup;
+  struct m_prefetch prefetch;
+  struct m_autosize autosize;
+  struct m_ws_sketch ws_sketch;
+  struct m_ws_queue ws_queue;
+
+  /*
+   * A path to map cache snapshot file. NULL if snapshots are disabled.
+   */
+  char *map_cache_file;
+
+  /*
+   * The size of hot data per storage arena.
+   *
+   * It may be concurrently adjusted by auto-sizing, so it must be read
+   * via p_atomic_load().
+   */
   size_t hot_data_size;
   int has_overwrite_protection;
 };
@@ -1866,7 +5681,7 @@ struct ybc
 static int m_open(struct ybc *const cache,
     const struct ybc_config *const config, const int force)
 {
-  struct m_storage_cursor *next_cursor;
+  struct m_storage_cursor *next_cursor, *extra_next_cursors;
   int is_index_file_created, is_storage_file_created;
 
   p_memory_init();
@@ -1875,23 +5690,37 @@ static int m_open(struct ybc *const cache,
   cache->storage.size = config->data_file_size;
   m_storage_fix_size(&cache->storage.size);
 
+  cache->storage.arenas_count = config->storage_arenas_count;
+  m_storage_fix_arenas_count(&cache->storage.arenas_count, cache->storage.size);
+
   size_t map_slots_count = config->map_slots_count;
   m_map_fix_slots_count(&map_slots_count, cache->storage.size);
 
+  size_t map_cache_max_slots_count = config->map_cache_max_slots_count;
+  m_map_cache_fix_slots_count(&map_cache_max_slots_count, map_slots_count);
+
   size_t map_cache_slots_count = config->map_cache_slots_count;
+  if (map_cache_slots_count == 0 && map_cache_max_slots_count > 0) {
+    /* Auto-sizing starts with the smallest map cache. */
+    map_cache_slots_count = C_MAP_BUCKET_SIZE;
+  }
   m_map_cache_fix_slots_count(&map_cache_slots_count, map_slots_count);
+  if (map_cache_max_slots_count < map_cache_slots_count) {
+    map_cache_max_slots_count = map_cache_slots_count;
+  }
 
   if (!m_index_open(&cache->index, &cache->index_file, map_slots_count,
-      map_cache_slots_count, config->index_file, force, &is_index_file_created,
-      &next_cursor)) {
+      map_cache_slots_count, map_cache_max_slots_count,
+      cache->storage.arenas_count,
+      config->has_clock_eviction, config->has_huge_pages, config->index_file,
+      force, &is_index_file_created, &next_cursor, &extra_next_cursors)) {
     return 0;
   }
-  if (next_cursor->offset > cache->storage.size) {
-    next_cursor->offset = 0;
-  }
 
-  cache->storage.next_cursor = next_cursor;
-  cache->storage.hash_seed = *cache->index.hash_seed_ptr;
+  uint64_t hash_seed;
+  int hash_algorithm;
+  m_index_get_hash_seed(&cache->index, &hash_seed, &hash_algorithm);
+  cache->storage.hash_seed = m_hash_seed_pack(hash_seed, hash_algorithm);
 
   if (!m_storage_open(&cache->storage, &cache->storage_file, config->data_file,
       force, &is_storage_file_created)) {
@@ -1902,22 +5731,70 @@ static int m_open(struct ybc *const cache,
     return 0;
   }
 
-  m_item_skiplist_init(&cache->acquired_items_head,
-      &cache->acquired_items_tail, cache->storage.size);
-
   /*
-   * Do not move initialization of the lock above, because it must be destroyed
-   * in the error paths above, i.e. more lines of code is required.
+   * Do not move initialization of arenas above, because their locks must be
+   * destroyed in the error paths above, i.e. more lines of code is required.
    */
-  p_lock_init(&cache->lock);
-
-  m_sync_init(&cache->sc, config->sync_interval, *cache->storage.next_cursor, &cache->storage,
-      &cache->acquired_items_head, &cache->lock,
+  /*
+   * Acquired items need registration only if overwrite protection is enabled.
+   */
+  const size_t item_slots_count = cache->has_overwrite_protection ?
+      config->item_slots_count : 0;
+  m_storage_arenas_init(&cache->storage, next_cursor, extra_next_cursors,
+      item_slots_count);
+
+  m_stats_init(&cache->stats);
+  m_sync_init(&cache->sc, config->sync_interval, config->sync_bandwidth,
+      &cache->storage, &cache->storage_file, &cache->stats,
       cache->has_overwrite_protection);
   m_de_init(&cache->de, config->de_hashtable_size);
+  m_ws_sketch_init(&cache->ws_sketch, map_slots_count);
+
+  /*
+   * Hot data is spread among storage arenas, since each key always goes
+   * to the same arena.
+   */
+  cache->hot_data_size = config->hot_data_size / cache->storage.arenas_count;
+  m_ws_fix_hot_data_size(&cache->hot_data_size, cache->storage.arena_size);
+
+  size_t max_hot_data_size = config->max_hot_data_size /
+      cache->storage.arenas_count;
+  m_ws_fix_hot_data_size(&max_hot_data_size, cache->storage.arena_size);
+  if (cache->hot_data_size == 0 && max_hot_data_size > 0) {
+    /* Auto-sizing starts with the smallest hot data size. */
+    cache->hot_data_size = C_AUTOSIZE_MIN_HOT_DATA_SIZE;
+    if (cache->hot_data_size > max_hot_data_size) {
+      cache->hot_data_size = max_hot_data_size;
+    }
+  }
+
+  cache->map_cache_file = NULL;
+  p_strdup(&cache->map_cache_file, config->map_cache_file);
+  m_map_cache_snapshot_load(&cache->index, &cache->storage,
+      cache->map_cache_file);
+
+  m_warmup_start(&cache->warmup, &cache->index_file,
+      config->index_warmup_threads_count,
+      config->has_background_index_warmup,
+      config->index_warmup_progress_func, config->index_warmup_progress_ctx);
+
+  /*
+   * Newly created storage file contains no hot data.
+   */
+  m_prefetch_start(&cache->prefetch, &cache->storage_file, &cache->storage,
+      cache->hot_data_size, config->hot_data_prefetch_bandwidth,
+      config->has_hot_data_prefetch && !is_storage_file_created);
+
+  m_autosize_start(&cache->autosize, &cache->index.map_cache,
+      cache->index.map_cache_max_slots_count, &cache->hot_data_size,
+      max_hot_data_size, &cache->stats);
 
-  cache->hot_data_size = config->hot_data_size;
-  m_ws_fix_hot_data_size(&cache->hot_data_size, cache->storage.size);
+  /*
+   * Zero hot data size disables the defragmentation for good, since
+   * auto-sizing never starts from zero.
+   */
+  m_ws_queue_init(&cache->ws_queue, cache, &cache->ws_sketch,
+      cache->hot_data_size > 0);
 
   return 1;
 }
@@ -1943,14 +5820,27 @@ int ybc_open(struct ybc *const cache, const struct ybc_config *const config,
 
 void ybc_close(struct ybc *const cache)
 {
-  m_item_skiplist_destroy(&cache->acquired_items_head,
-      &cache->acquired_items_tail, cache->storage.size);
+  m_ws_queue_destroy(&cache->ws_queue);
+
+  m_autosize_stop(&cache->autosize);
+
+  m_prefetch_stop(&cache->prefetch);
+
+  m_warmup_stop(&cache->warmup);
 
   m_de_destroy(&cache->de);
 
+  m_ws_sketch_destroy(&cache->ws_sketch);
+
   m_sync_destroy(&cache->sc);
 
-  p_lock_destroy(&cache->lock);
+  m_map_cache_snapshot_save(&cache->index, &cache->storage,
+      cache->map_cache_file);
+  p_free(cache->map_cache_file);
+
+  m_stats_destroy(&cache->stats);
+
+  m_storage_arenas_destroy(&cache->storage);
 
   m_storage_close(&cache->storage, &cache->storage_file);
 
@@ -1961,16 +5851,48 @@ void ybc_clear(struct ybc *const cache)
 {
   /*
    * New hash seed automatically invalidates all the items stored in the cache.
+   *
+   * All the items are invalidated, so switch to the latest hash algorithm.
+   *
+   * Other threads may calculate key digests concurrently, so the hash seed
+   * and hash algorithm are published at once in a single word.
    */
+  uint64_t prev_hash_seed, hash_seed;
+  do {
+    prev_hash_seed = p_atomic_counter_load(&cache->storage.hash_seed);
+    hash_seed = m_hash_seed_pack(prev_hash_seed + 1, M_HASH_ALGORITHM_LATEST);
+  } while (!p_atomic_counter_cas(&cache->storage.hash_seed, prev_hash_seed,
+      hash_seed));
+
+  m_index_set_hash_seed(&cache->index, hash_seed, M_HASH_ALGORITHM_LATEST);
+}
+
+void ybc_get_stats(struct ybc *const cache, struct ybc_stats *const stats)
+{
+  m_stats_get(&cache->stats, stats);
+  stats->sync_backlog_bytes = m_sync_get_backlog_size(&cache->sc);
+  stats->index_warmup_pending_bytes = m_warmup_get_pending_size(
+      &cache->warmup);
+  stats->hot_data_prefetch_pending_bytes = m_prefetch_get_pending_size(
+      &cache->prefetch);
+}
+
+size_t ybc_get_hot_items_count(struct ybc *const cache)
+{
+  return p_atomic_load(&cache->index.map_cache.slots_count) *
+      C_MAP_OPTIMAL_FILL_RATIO;
+}
 
-  ++cache->storage.hash_seed;
-  *cache->index.hash_seed_ptr = cache->storage.hash_seed;
+size_t ybc_get_hot_data_size(struct ybc *const cache)
+{
+  return p_atomic_load(&cache->hot_data_size) * cache->storage.arenas_count;
 }
 
 void ybc_remove(const struct ybc_config *const config)
 {
   m_file_remove_if_exists(config->index_file);
   m_file_remove_if_exists(config->data_file);
+  m_file_remove_if_exists(config->map_cache_file);
 }
 
 
@@ -2024,18 +5946,52 @@ static void m_item_register(struct ybc_item *const item,
   m_item_skiplist_add(item);
 }
 
+/*
+ * Tries registering the item in arena->item_slots without locking.
+ *
+ * The caller must re-validate the item after successful registration,
+ * since the item could be overwritten by concurrent writers before
+ * the registration. See m_storage_find_slots_overlap() for details.
+ *
+ * Returns non-zero on success. Returns zero if there are no free slots,
+ * so the item must be registered in the arena's skiplist under the lock.
+ */
+static int m_item_register_lock_free(struct ybc_item *const item,
+    struct m_storage_arena *const arena)
+{
+  if (arena->item_slots.count == 0) {
+    return 0;
+  }
+
+  const size_t start_offset = item->payload.cursor.offset;
+  item->slot = m_item_slots_acquire(&arena->item_slots, start_offset,
+      start_offset + item->payload.size);
+  return item->slot != NULL;
+}
+
 static void m_item_deregister(struct ybc_item *const item)
 {
   m_item_skiplist_del(item);
 }
 
+static struct m_storage_arena *m_item_get_arena(
+    const struct ybc_item *const item)
+{
+  return m_storage_get_arena(&item->cache->storage,
+      item->payload.cursor.offset);
+}
+
 static void m_item_release(struct ybc_item *const item)
 {
-  if (item->cache->has_overwrite_protection) {
-    struct p_lock *const cache_lock = &item->cache->lock;
-    p_lock_lock(cache_lock);
+  if (item->slot != NULL) {
+    m_item_slots_release(item->slot);
+    item->slot = NULL;
+  }
+  else if (item->cache->has_overwrite_protection) {
+    struct p_lock *const arena_lock = &m_item_get_arena(item)->lock;
+    m_stats_lock(&item->cache->stats, arena_lock);
     m_item_deregister(item);
-    p_lock_unlock(cache_lock);
+    p_lock_unlock(arena_lock);
   }
   item->cache = NULL;
 }
@@ -2052,6 +6008,27 @@ static void m_item_relocate(struct ybc_item *const dst,
   m_item_skiplist_relocate(dst, src);
 }
 
+/*
+ * Adds the given payload with the given key_digest into the cache index.
+ */
+static void m_item_index_set(struct ybc *const cache,
+    const struct m_key_digest *const key_digest,
+    const struct m_storage_payload *const payload)
+{
+  if (m_map_cache_set(&cache->index.map, &cache->index.map_cache, key_digest,
+      payload)) {
+    m_stats_inc(&cache->stats, M_STATS_MAP_VICTIM_OVERWRITES);
+  }
+
+  m_de_item_notify(&cache->de, key_digest);
+}
+
+static uint64_t m_item_get_expiration_time(const uint64_t current_time,
+    const uint64_t ttl)
+{
+  return (ttl > UINT64_MAX - current_time) ? UINT64_MAX : (ttl + current_time);
+}
+
 size_t ybc_set_txn_get_size(void)
 {
   return sizeof(struct ybc_set_txn);
@@ -2065,24 +6042,31 @@ int ybc_set_txn_begin(struct ybc *const cache, struct ybc_set_txn *const txn,
     return 0;
   }
 
-  m_key_digest_get(&txn->key_digest, cache->storage.hash_seed, key);
+  m_storage_key_digest_get(&cache->storage, &txn->key_digest, key);
 
   txn->item.cache = cache;
   txn->item.key_size = key->size;
+  txn->item.slot = NULL;
   txn->item.is_set_txn = 1;
 
   const size_t metadata_size = m_storage_metadata_get_size(key->size);
   assert(value_size <= SIZE_MAX - metadata_size);
   txn->item.payload.size = metadata_size + value_size;
 
-  const uint64_t current_time = p_get_current_time();
-  txn->item.payload.expiration_time = (ttl > UINT64_MAX - current_time) ?
-      UINT64_MAX : (ttl + current_time);
+  txn->item.payload.expiration_time = m_item_get_expiration_time(
+      p_get_current_time(), ttl);
+
+  /*
+   * Items with the same key always go to the same storage arena.
+   */
+  const size_t arena_index = m_key_digest_mod(&txn->key_digest,
+      cache->storage.arenas_count);
+  struct m_storage_arena *const arena = &cache->storage.arenas[arena_index];
 
-  p_lock_lock(&cache->lock);
-  int is_success = m_storage_allocate(&cache->storage,
-      &cache->acquired_items_head, &txn->item, cache->has_overwrite_protection);
-  p_lock_unlock(&cache->lock);
+  m_stats_lock(&cache->stats, &arena->lock);
+  int is_success = m_storage_allocate(&cache->storage, &cache->stats, arena,
+      &txn->item, cache->has_overwrite_protection);
+  p_lock_unlock(&arena->lock);
 
   if (!is_success) {
     return 0;
@@ -2111,21 +6095,25 @@ void ybc_set_txn_update_value_size(struct ybc_set_txn *const txn,
       old_payload_size, key_size);
 
   // move next_cursor backwards if possible in order to conserve unused space.
-  struct m_storage_cursor *const next_cursor = cache->storage.next_cursor;
-  p_lock_lock(&cache->lock);
+  struct m_storage_arena *const arena = m_item_get_arena(&txn->item);
+  struct m_storage_cursor *const next_cursor = arena->next_cursor;
+  m_stats_lock(&cache->stats, &arena->lock);
   if (next_cursor->offset == payload->cursor.offset + old_payload_size &&
       next_cursor->wrap_count == payload->cursor.wrap_count) {
-    next_cursor->offset = payload->cursor.offset + payload->size;
+    const struct m_storage_cursor tmp_cursor = {
+        .wrap_count = next_cursor->wrap_count,
+        .offset = payload->cursor.offset + payload->size,
+    };
+    m_storage_cursor_store(next_cursor, &tmp_cursor);
   }
-  p_lock_unlock(&cache->lock);
+  p_lock_unlock(&arena->lock);
 }
 
 void ybc_set_txn_commit(struct ybc_set_txn *const txn)
 {
   struct ybc *const cache = txn->item.cache;
 
-  m_map_cache_set(&cache->index.map, &cache->index.map_cache, &txn->key_digest,
-      &txn->item.payload);
+  m_item_index_set(cache, &txn->key_digest, &txn->item.payload);
 
   m_item_release(&txn->item);
 }
@@ -2136,30 +6124,30 @@ void ybc_set_txn_commit_item(struct ybc_set_txn *const txn,
   struct ybc *const cache = txn->item.cache;
 
   if (cache->has_overwrite_protection) {
-    p_lock_lock(&cache->lock);
+    struct p_lock *const arena_lock = &m_item_get_arena(&txn->item)->lock;
+    m_stats_lock(&cache->stats, arena_lock);
     m_item_relocate(item, &txn->item);
-    p_lock_unlock(&cache->lock);
+    p_lock_unlock(arena_lock);
   } else {
     *item = txn->item;
   }
   item->is_set_txn = 0;
 
-  m_map_cache_set(&cache->index.map, &cache->index.map_cache, &txn->key_digest,
-      &item->payload);
+  m_item_index_set(cache, &txn->key_digest, &item->payload);
 }
 
 void ybc_set_txn_rollback(struct ybc_set_txn *const txn)
 {
   // move next_cursor backwards if possible in order to conserve unused space.
-  struct ybc *const cache = txn->item.cache;
   const struct m_storage_payload *const payload = &txn->item.payload;
-  struct m_storage_cursor *const next_cursor = cache->storage.next_cursor;
-  p_lock_lock(&cache->lock);
+  struct m_storage_arena *const arena = m_item_get_arena(&txn->item);
+  struct m_storage_cursor *const next_cursor = arena->next_cursor;
+  m_stats_lock(&txn->item.cache->stats, &arena->lock);
   if (next_cursor->offset == payload->cursor.offset + payload->size &&
       next_cursor->wrap_count == payload->cursor.wrap_count) {
-    next_cursor->offset = payload->cursor.offset;
+    m_storage_cursor_store(next_cursor, &payload->cursor);
   }
-  p_lock_unlock(&cache->lock);
+  p_lock_unlock(&arena->lock);
 
   m_item_release(&txn->item);
 }
@@ -2176,22 +6164,55 @@ void ybc_set_txn_get_value(const struct ybc_set_txn *const txn,
  * Cache API.
  ******************************************************************************/
 
-static int m_item_acquire(struct ybc *const cache, struct ybc_item *const item,
+/*
+ * Looks up the payload for the item with the given key_digest.
+ *
+ * The item isn't acquired yet. Call m_item_acquire_payload() for acquiring it.
+ *
+ * Returns 1 if the payload is found, otherwise returns 0.
+ */
+static int m_item_lookup(struct ybc *const cache, struct ybc_item *const item,
     const struct ybc_key *const key,
     const struct m_key_digest *const key_digest)
 {
   item->cache = cache;
   item->key_size = key->size;
+  item->slot = NULL;
   item->is_set_txn = 0;
 
   if (!m_map_cache_get(&cache->index.map, &cache->index.map_cache,
-      key_digest, &item->payload)) {
+      &cache->stats, key_digest, &item->payload)) {
+    m_stats_inc(&cache->stats, M_STATS_GET_MISSES);
     return 0;
   }
+  return 1;
+}
+
+static void m_item_count_failure(const struct ybc *const cache,
+    const enum m_stats_counter counter)
+{
+  m_stats_inc(&cache->stats, counter);
+  m_stats_inc(&cache->stats, M_STATS_GET_MISSES);
+}
 
+/*
+ * Validates and acquires the item with the payload obtained
+ * via m_item_lookup(). Doesn't update stats.
+ *
+ * On success stores arena's next_cursor copy into next_cursor.
+ * On failure stores the stats counter to increment into failure_counter.
+ *
+ * Returns 1 if the item is acquired, otherwise returns 0.
+ */
+static int m_item_validate_payload(struct ybc *const cache,
+    struct ybc_item *const item, const struct ybc_key *const key,
+    struct m_storage_cursor *const next_cursor,
+    enum m_stats_counter *const failure_counter)
+{
+  struct m_storage_arena *const arena = m_item_get_arena(item);
 
   /*
-   * Race condition is possible when making a copy of cache->storage.next_cursor
+   * Race condition is possible when making a copy of arena->next_cursor
    * if it is concurrently updated by other thread in m_storage_allocate().
    * In this case copied next_cursor may have corrupted value. This is OK.
    * Two innocent things may occur if next_cursor contains invalid value:
@@ -2201,32 +6222,81 @@ static int m_item_acquire(struct ybc *const cache, struct ybc_item *const item,
    * This racy copy significantly improves scalability of 'get item' operation
    * if overwrite protection is disabled ( cache->has_overwrite_protection = 0).
    */
-  const struct m_storage_cursor next_cursor = *cache->storage.next_cursor;
+  m_storage_cursor_load(next_cursor, arena->next_cursor);
 
   const uint64_t current_time = p_get_current_time();
-  if (!m_storage_payload_check(&cache->storage, &next_cursor, &item->payload,
+  if (!m_storage_payload_check(arena, next_cursor, &item->payload,
       current_time)) {
+    *failure_counter = M_STATS_PAYLOAD_CHECK_FAILURES;
     return 0;
   }
   if (cache->has_overwrite_protection) {
-    p_lock_lock(&cache->lock);
-    m_item_register(item, &cache->acquired_items_head);
-    p_lock_unlock(&cache->lock);
+    if (m_item_register_lock_free(item, arena)) {
+      m_storage_cursor_load(next_cursor, arena->next_cursor);
+      if (!m_storage_payload_check(arena, next_cursor, &item->payload,
+          current_time)) {
+        m_item_release(item);
+        *failure_counter = M_STATS_PAYLOAD_CHECK_FAILURES;
+        return 0;
+      }
+    }
+    else {
+      m_stats_lock(&cache->stats, &arena->lock);
+      m_item_register(item, &arena->acquired_items_head);
+      p_lock_unlock(&arena->lock);
+    }
   }
 
   if (!m_storage_metadata_check(&cache->storage, &item->payload, key)) {
     m_item_release(item);
+    *failure_counter = M_STATS_METADATA_CHECK_FAILURES;
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * Validates and acquires the item with the payload obtained
+ * via m_item_lookup().
+ *
+ * Returns 1 if the item is acquired, otherwise returns 0.
+ */
+static int m_item_acquire_payload(struct ybc *const cache,
+    struct ybc_item *const item, const struct ybc_key *const key)
+{
+  struct m_storage_cursor next_cursor;
+  enum m_stats_counter failure_counter;
+
+  if (!m_item_validate_payload(cache, item, key, &next_cursor,
+      &failure_counter)) {
+    m_item_count_failure(cache, failure_counter);
     return 0;
   }
 
-  if (m_ws_should_defragment(&cache->storage, &next_cursor, &item->payload,
-      cache->hot_data_size)) {
-    m_ws_defragment(cache, item, key);
+  /*
+   * The defragmentation is deferred to the background thread, so readers
+   * don't pay for storage allocation and item copying.
+   * The candidate is silently dropped if the queue is full.
+   */
+  if (m_ws_should_defragment(m_item_get_arena(item), &next_cursor,
+      &item->payload, p_atomic_load(&cache->hot_data_size),
+      &cache->ws_queue)) {
+    (void)m_ws_queue_push(&cache->ws_queue, key, &item->payload);
   }
 
+  m_stats_inc(&cache->stats, M_STATS_GET_HITS);
   return 1;
 }
 
+static int m_item_acquire(struct ybc *const cache, struct ybc_item *const item,
+    const struct ybc_key *const key,
+    const struct m_key_digest *const key_digest)
+{
+  return m_item_lookup(cache, item, key, key_digest) &&
+      m_item_acquire_payload(cache, item, key);
+}
+
 size_t ybc_item_get_size(void)
 {
   return sizeof(struct ybc_item);
@@ -2262,6 +6332,230 @@ int ybc_item_set_item(struct ybc *const cache, struct ybc_item *const item,
   return 1;
 }
 
+/*
+ * Stores items with the given indexes, which belong to the given arena,
+ * in a contiguous space allocated under a single arena lock hold.
+ *
+ * The space is reserved by a span item, which looks like an uncommitted
+ * 'set' transaction to concurrent writers and to the sync thread. So values
+ * are copied into the space and map slots are updated without holding
+ * the lock.
+ *
+ * Returns 0 if the space cannot be allocated for all the items at once.
+ * Otherwise returns 1.
+ */
+static int m_item_set_span(struct ybc *const cache,
+    struct m_storage_arena *const arena, const struct ybc_key *const keys,
+    const struct ybc_value *const values,
+    const struct m_key_digest *const key_digests,
+    const size_t *const indexes, const size_t count)
+{
+  size_t span_size = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const struct ybc_key *const key = &keys[indexes[i]];
+    const size_t value_size = values[indexes[i]].size;
+    const size_t metadata_size = m_storage_metadata_get_size(key->size);
+    if (value_size > SIZE_MAX - metadata_size ||
+        metadata_size + value_size > SIZE_MAX - span_size) {
+      return 0;
+    }
+    span_size += metadata_size + value_size;
+  }
+
+  struct ybc_item span_item = {
+      .cache = cache,
+      .slot = NULL,
+      .is_set_txn = 1,
+  };
+  span_item.payload.size = span_size;
+
+  m_stats_lock(&cache->stats, &arena->lock);
+  const int is_success = m_storage_allocate(&cache->storage, &cache->stats,
+      arena, &span_item, cache->has_overwrite_protection);
+  p_lock_unlock(&arena->lock);
+
+  if (!is_success) {
+    return 0;
+  }
+
+  const uint64_t current_time = p_get_current_time();
+  struct m_storage_payload payload = {
+      .cursor = span_item.payload.cursor,
+  };
+  for (size_t i = 0; i < count; ++i) {
+    const struct ybc_key *const key = &keys[indexes[i]];
+    const struct ybc_value *const value = &values[indexes[i]];
+    const size_t metadata_size = m_storage_metadata_get_size(key->size);
+
+    payload.size = metadata_size + value->size;
+    payload.expiration_time = m_item_get_expiration_time(current_time,
+        value->ttl);
+    m_storage_metadata_save(&cache->storage, &payload, key);
+
+    char *const dst = m_storage_get_ptr(&cache->storage,
+        payload.cursor.offset + metadata_size);
+    memcpy(dst, value->ptr, value->size);
+
+    m_item_index_set(cache, &key_digests[indexes[i]], &payload);
+
+    payload.cursor.offset += payload.size;
+  }
+
+  m_item_release(&span_item);
+  return 1;
+}
+
+size_t ybc_item_set_multi(struct ybc *const cache,
+    const struct ybc_key *const keys, const struct ybc_value *const values,
+    const size_t count)
+{
+  struct m_key_digest key_digests[C_ITEM_SET_MULTI_BATCH_SIZE];
+  size_t arena_indexes[C_ITEM_SET_MULTI_BATCH_SIZE];
+  size_t span_indexes[C_ITEM_SET_MULTI_BATCH_SIZE];
+  size_t stored_count = 0;
+
+  for (size_t start = 0; start < count; start += C_ITEM_SET_MULTI_BATCH_SIZE) {
+    size_t batch_size = count - start;
+    if (batch_size > C_ITEM_SET_MULTI_BATCH_SIZE) {
+      batch_size = C_ITEM_SET_MULTI_BATCH_SIZE;
+    }
+
+    const struct ybc_key *const batch_keys = &keys[start];
+    const struct ybc_value *const batch_values = &values[start];
+
+    for (size_t i = 0; i < batch_size; ++i) {
+      m_storage_key_digest_get(&cache->storage, &key_digests[i],
+          &batch_keys[i]);
+      arena_indexes[i] = m_key_digest_mod(&key_digests[i],
+          cache->storage.arenas_count);
+    }
+
+    /*
+     * Items with the same key always go to the same storage arena,
+     * so allocate a separate span in each arena touched by the batch.
+     * Processed items are marked with SIZE_MAX arena index.
+     */
+    for (size_t i = 0; i < batch_size; ++i) {
+      const size_t arena_index = arena_indexes[i];
+      if (arena_index == SIZE_MAX) {
+        continue;
+      }
+
+      size_t span_count = 0;
+      for (size_t j = i; j < batch_size; ++j) {
+        if (arena_indexes[j] == arena_index) {
+          span_indexes[span_count++] = j;
+          arena_indexes[j] = SIZE_MAX;
+        }
+      }
+
+      struct m_storage_arena *const arena =
+          &cache->storage.arenas[arena_index];
+      if (m_item_set_span(cache, arena, batch_keys, batch_values,
+          key_digests, span_indexes, span_count)) {
+        stored_count += span_count;
+        continue;
+      }
+
+      /*
+       * Fall back to storing items one by one, since some of them
+       * may still fit the arena.
+       */
+      for (size_t j = 0; j < span_count; ++j) {
+        const size_t k = span_indexes[j];
+        stored_count += ybc_item_set(cache, &batch_keys[k], &batch_values[k]) ?
+            1 : 0;
+      }
+    }
+  }
+
+  return stored_count;
+}
+
+/*
+ * Defragments the given candidates, i.e. moves them into the front of storage's
+ * free space. Candidates, which have been changed or removed since they
+ * were queued, are skipped.
+ *
+ * There is a race condition possible when another thread adds new item
+ * with the candidate's key before the defragmentation for this item is
+ * complete. In this case new item will become overwritten by the old item
+ * after the defragmentation is complete. But since this is a cache,
+ * not a persistent storage, this should be OK - subsequent readers should
+ * notice old value and overwrite it with new value.
+ *
+ * Candidates are stored via ybc_item_set_multi(), so items going into
+ * the same arena share a single storage allocation.
+ */
+static int m_ws_is_key_digest_in_batch(
+    const struct m_key_digest *const key_digests, const size_t count,
+    const struct m_key_digest *const key_digest)
+{
+  for (size_t i = 0; i < count; ++i) {
+    if (m_key_digest_equal(&key_digests[i], key_digest)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void m_ws_defragment_batch(struct ybc *const cache,
+    const struct m_ws_candidate *const candidates, const size_t count)
+{
+  struct ybc_item items[C_ITEM_SET_MULTI_BATCH_SIZE];
+  struct ybc_key keys[C_ITEM_SET_MULTI_BATCH_SIZE];
+  struct ybc_value values[C_ITEM_SET_MULTI_BATCH_SIZE];
+  struct m_key_digest key_digests[C_ITEM_SET_MULTI_BATCH_SIZE];
+  size_t acquired_count = 0;
+
+  assert(count <= C_ITEM_SET_MULTI_BATCH_SIZE);
+
+  for (size_t i = 0; i < count; ++i) {
+    const struct m_ws_candidate *const candidate = &candidates[i];
+    struct ybc_item *const item = &items[acquired_count];
+    struct ybc_key *const key = &keys[acquired_count];
+    struct m_key_digest *const key_digest = &key_digests[acquired_count];
+    struct m_storage_cursor next_cursor;
+    enum m_stats_counter failure_counter;
+
+    key->ptr = candidate->key;
+    key->size = candidate->key_size;
+    m_storage_key_digest_get(&cache->storage, key_digest, key);
+
+    /*
+     * The queue may contain the same item multiple times. Move it only once,
+     * so it isn't moved and accounted twice.
+     */
+    if (m_ws_is_key_digest_in_batch(key_digests, acquired_count, key_digest)) {
+      continue;
+    }
+
+    item->cache = cache;
+    item->key_size = key->size;
+    item->slot = NULL;
+    item->is_set_txn = 0;
+    if (!m_map_get(&cache->index.map, key_digest, &item->payload) ||
+        !m_storage_payload_equal(&item->payload, &candidate->payload)) {
+      continue;
+    }
+    if (!m_item_validate_payload(cache, item, key, &next_cursor,
+        &failure_counter)) {
+      continue;
+    }
+
+    ybc_item_get_value(item, &values[acquired_count]);
+    ++acquired_count;
+  }
+
+  const size_t moved_count = ybc_item_set_multi(cache, keys, values,
+      acquired_count);
+  m_stats_add(&cache->stats, M_STATS_DEFRAGMENTATION_MOVES, moved_count);
+
+  for (size_t i = 0; i < acquired_count; ++i) {
+    m_item_release(&items[i]);
+  }
+}
+
 int ybc_item_remove(struct ybc *const cache, const struct ybc_key *const key)
 {
   /*
@@ -2271,7 +6565,7 @@ int ybc_item_remove(struct ybc *const cache, const struct ybc_key *const key)
 
   struct m_key_digest key_digest;
 
-  m_key_digest_get(&key_digest, cache->storage.hash_seed, key);
+  m_storage_key_digest_get(&cache->storage, &key_digest, key);
   return m_map_cache_remove(&cache->index.map, &cache->index.map_cache,
       &key_digest);
 }
@@ -2281,10 +6575,66 @@ int ybc_item_get(struct ybc *const cache, struct ybc_item *const item,
 {
   struct m_key_digest key_digest;
 
-  m_key_digest_get(&key_digest, cache->storage.hash_seed, key);
+  m_storage_key_digest_get(&cache->storage, &key_digest, key);
   return m_item_acquire(cache, item, key, &key_digest);
 }
 
+size_t ybc_item_get_multi(struct ybc *const cache,
+    struct ybc_item *const items, int *const is_found,
+    const struct ybc_key *const keys, const size_t keys_count)
+{
+  struct m_key_digest key_digests[C_ITEM_GET_MULTI_BATCH_SIZE];
+  size_t found_count = 0;
+
+  for (size_t start = 0; start < keys_count;
+      start += C_ITEM_GET_MULTI_BATCH_SIZE) {
+    size_t batch_size = keys_count - start;
+    if (batch_size > C_ITEM_GET_MULTI_BATCH_SIZE) {
+      batch_size = C_ITEM_GET_MULTI_BATCH_SIZE;
+    }
+
+    const struct ybc_key *const batch_keys = &keys[start];
+    struct ybc_item *const batch_items = &items[start];
+    int *const batch_is_found = &is_found[start];
+
+    /*
+     * Hash all the keys and prefetch the corresponding index buckets,
+     * so bucket loads for distinct keys overlap.
+     */
+    for (size_t i = 0; i < batch_size; ++i) {
+      m_storage_key_digest_get(&cache->storage, &key_digests[i],
+          &batch_keys[i]);
+      m_map_cache_prefetch(&cache->index.map, &cache->index.map_cache,
+          &key_digests[i]);
+    }
+
+    /*
+     * Look up payloads and prefetch storage metadata for the found items.
+     */
+    for (size_t i = 0; i < batch_size; ++i) {
+      batch_is_found[i] = m_item_lookup(cache, &batch_items[i],
+          &batch_keys[i], &key_digests[i]);
+      if (batch_is_found[i]) {
+        m_storage_metadata_prefetch(&cache->storage,
+            &batch_items[i].payload, batch_keys[i].size);
+      }
+    }
+
+    /*
+     * Validate and acquire the found items.
+     */
+    for (size_t i = 0; i < batch_size; ++i) {
+      if (batch_is_found[i]) {
+        batch_is_found[i] = m_item_acquire_payload(cache, &batch_items[i],
+            &batch_keys[i]);
+        found_count += batch_is_found[i];
+      }
+    }
+  }
+
+  return found_count;
+}
+
 static uint64_t m_item_adjust_grace_ttl(const uint64_t grace_ttl)
 {
   uint64_t adjusted_grace_ttl = grace_ttl;
@@ -2297,9 +6647,18 @@ static uint64_t m_item_adjust_grace_ttl(const uint64_t grace_ttl)
   return adjusted_grace_ttl;
 }
 
+/*
+ * Stores the number of milliseconds to wait for the pending item into
+ * wait_time if YBC_DE_WOULDBLOCK is returned.
+ *
+ * If is_refresh_mode is set, then the item, which is about to expire,
+ * is returned together with YBC_DE_REFRESH status to the caller elected
+ * for refreshing it.
+ */
 static enum ybc_de_status m_item_acquire_de_async(struct ybc *const cache,
     struct ybc_item *const item, const struct ybc_key *const key,
-    const struct m_key_digest *const key_digest, const uint64_t grace_ttl)
+    const struct m_key_digest *const key_digest, const uint64_t grace_ttl,
+    const int is_refresh_mode, uint64_t *const wait_time)
 {
   if (!m_item_acquire(cache, item, key, key_digest)) {
     /*
@@ -2309,10 +6668,11 @@ static enum ybc_de_status m_item_acquire_de_async(struct ybc *const cache,
      * by returning YBC_DE_NOTFOUND. Otherwise suggest the caller waiting
      * for a while by returning YBC_DE_WOULDBLOCK.
      */
-    if (m_de_item_register(&cache->de, key_digest, grace_ttl)) {
+    if (m_de_item_register(&cache->de, key_digest, grace_ttl, wait_time)) {
       return YBC_DE_NOTFOUND;
     }
 
+    m_stats_inc(&cache->stats, M_STATS_DE_WAITS);
     return YBC_DE_WOULDBLOCK;
   }
 
@@ -2324,7 +6684,12 @@ static enum ybc_de_status m_item_acquire_de_async(struct ybc *const cache,
      * the item by returning YBC_DE_NOTFOUND. Otherwise return not-yet expired
      * item.
      */
-    if (m_de_item_register(&cache->de, key_digest, grace_ttl)) {
+    uint64_t tmp_wait_time;
+    if (m_de_item_register(&cache->de, key_digest, grace_ttl,
+        &tmp_wait_time)) {
+      if (is_refresh_mode) {
+        return YBC_DE_REFRESH;
+      }
       m_item_release(item);
       return YBC_DE_NOTFOUND;
     }
@@ -2338,40 +6703,134 @@ enum ybc_de_status ybc_item_get_de_async(struct ybc *const cache,
     const uint64_t grace_ttl)
 {
   struct m_key_digest key_digest;
+  uint64_t wait_time;
   const uint64_t adjusted_grace_ttl = m_item_adjust_grace_ttl(grace_ttl);
 
-  m_key_digest_get(&key_digest, cache->storage.hash_seed, key);
+  m_storage_key_digest_get(&cache->storage, &key_digest, key);
 
   return m_item_acquire_de_async(cache, item, key, &key_digest,
-      adjusted_grace_ttl);
+      adjusted_grace_ttl, 0, &wait_time);
+}
+
+static enum ybc_de_status m_item_acquire_de(struct ybc *const cache,
+    struct ybc_item *const item, const struct ybc_key *const key,
+    const uint64_t grace_ttl, const int is_refresh_mode)
+{
+  struct m_key_digest key_digest;
+  const uint64_t adjusted_grace_ttl = m_item_adjust_grace_ttl(grace_ttl);
+
+  m_storage_key_digest_get(&cache->storage, &key_digest, key);
+
+  uint64_t wait_time;
+  enum ybc_de_status status = m_item_acquire_de_async(cache, item, key,
+      &key_digest, adjusted_grace_ttl, is_refresh_mode, &wait_time);
+
+  while (status == YBC_DE_WOULDBLOCK) {
+    /*
+     * Re-check the item after the registration as a waiter, since it could
+     * be added after the previous check. Then wait until the item is added
+     * or its' pending registration expires, so one of waiters could build
+     * the item.
+     */
+    const uint32_t wait_word = m_de_item_wait_begin(&cache->de, &key_digest);
+    status = m_item_acquire_de_async(cache, item, key, &key_digest,
+        adjusted_grace_ttl, is_refresh_mode, &wait_time);
+    if (status == YBC_DE_WOULDBLOCK) {
+      m_de_item_wait(&cache->de, &key_digest, wait_word, wait_time);
+    }
+    m_de_item_wait_end(&cache->de, &key_digest);
+  }
+
+  return status;
 }
 
 enum ybc_de_status ybc_item_get_de(struct ybc *const cache,
     struct ybc_item *const item, const struct ybc_key *const key,
     const uint64_t grace_ttl)
+{
+  return m_item_acquire_de(cache, item, key, grace_ttl, 0);
+}
+
+enum ybc_de_status ybc_item_get_de_refresh(struct ybc *const cache,
+    struct ybc_item *const item, const struct ybc_key *const key,
+    const uint64_t grace_ttl)
+{
+  return m_item_acquire_de(cache, item, key, grace_ttl, 1);
+}
+
+enum ybc_de_status ybc_item_get_de_refresh_async(struct ybc *const cache,
+    struct ybc_item *const item, const struct ybc_key *const key,
+    const uint64_t grace_ttl)
 {
   struct m_key_digest key_digest;
+  uint64_t wait_time;
   const uint64_t adjusted_grace_ttl = m_item_adjust_grace_ttl(grace_ttl);
 
-  m_key_digest_get(&key_digest, cache->storage.hash_seed, key);
+  m_storage_key_digest_get(&cache->storage, &key_digest, key);
 
-  for (;;) {
-    enum ybc_de_status status = m_item_acquire_de_async(cache, item, key,
-        &key_digest, adjusted_grace_ttl);
-    if (status != YBC_DE_WOULDBLOCK) {
-      return status;
+  return m_item_acquire_de_async(cache, item, key, &key_digest,
+      adjusted_grace_ttl, 1, &wait_time);
+}
+
+size_t ybc_de_waiter_get_size(void)
+{
+  return sizeof(struct ybc_de_waiter);
+}
+
+enum ybc_de_status ybc_item_get_de_notify(struct ybc *const cache,
+    struct ybc_item *const item, const struct ybc_key *const key,
+    const uint64_t grace_ttl, struct ybc_de_waiter *const waiter,
+    const ybc_de_notify_func notify_func, void *const notify_ctx)
+{
+  struct m_key_digest key_digest;
+  uint64_t wait_time;
+  const uint64_t adjusted_grace_ttl = m_item_adjust_grace_ttl(grace_ttl);
+
+  m_storage_key_digest_get(&cache->storage, &key_digest, key);
+
+  const enum ybc_de_status status = m_item_acquire_de_async(cache, item, key,
+      &key_digest, adjusted_grace_ttl, 0, &wait_time);
+  if (status != YBC_DE_WOULDBLOCK) {
+    return status;
+  }
+
+  m_de_waiter_register(&cache->de, waiter, &key_digest, wait_time,
+      notify_func, notify_ctx);
+
+  /*
+   * Re-check the item after the waiter registration, since it could be added
+   * after the previous check.
+   */
+  if (m_item_acquire(cache, item, key, &key_digest)) {
+    if (m_de_waiter_cancel(&cache->de, waiter, &key_digest)) {
+      return YBC_DE_SUCCESS;
     }
 
     /*
-     * Though it looks like waiting on a condition (event) would be better
-     * than periodic sleeping for a fixed amount of time, this isn't true.
-     *
-     * Trust me - I tried using condition here, but the resulting code
-     * was uglier, more intrusive, slower and less robust than the code based
-     * on periodic sleepinig :)
+     * The waiter has been already notified, so the caller must be informed
+     * about this via YBC_DE_WOULDBLOCK.
      */
-    p_sleep(C_DE_ITEM_SLEEP_TIME);
+    m_item_release(item);
   }
+
+  return YBC_DE_WOULDBLOCK;
+}
+
+int ybc_de_waiter_cancel(struct ybc *const cache,
+    struct ybc_de_waiter *const waiter)
+{
+  struct m_de *const de = &cache->de;
+
+  /*
+   * The waiter's key digest is read under the lock, since it is filled
+   * under the same lock in m_de_waiter_register().
+   */
+  p_lock_lock(&de->waiters_lock);
+  const size_t index = m_de_get_waiters_index(de, &waiter->key_digest);
+  const int is_found = m_de_waiter_remove(de, waiter, index);
+  p_lock_unlock(&de->waiters_lock);
+
+  return is_found;
 }
 
 void ybc_item_release(struct ybc_item *const item)
@@ -2387,6 +6846,33 @@ void ybc_item_get_value(const struct ybc_item *const item,
   value->ttl = m_item_get_ttl(item);
 }
 
+int ybc_item_is_resident(const struct ybc_item *const item)
+{
+  return p_memory_is_resident(m_item_get_value_ptr(item),
+      m_item_get_size(item));
+}
+
+void ybc_item_prefetch_value(const struct ybc_item *const item)
+{
+  const size_t size = m_item_get_size(item);
+
+  if (size > 0) {
+    p_memory_advise_willneed(m_item_get_value_ptr(item), size);
+  }
+}
+
+void ybc_item_get_value_location(const struct ybc_item *const item,
+    struct ybc_value_location *const location)
+{
+  /*
+   * The data file is mapped into memory starting from zero offset,
+   * so storage offsets match data file offsets.
+   */
+  location->fd = p_file_get_descriptor(&item->cache->storage_file);
+  location->offset = m_item_get_offset(item);
+  location->size = m_item_get_size(item);
+}
+
 
 /*******************************************************************************
  * Cache cluster API.
@@ -2414,6 +6900,14 @@ struct ybc_cluster
    */
   uint64_t hash_seed;
 
+  /*
+   * Hash algorithm used for selecting a cache from the cluster.
+   *
+   * It is borrowed from the first cache in the cluster, so the selection
+   * remains stable while the first cache's index file persists.
+   */
+  int hash_algorithm;
+
   /*
    * The ybc_cluster structure contains also the following two 'virtual' arrays:
    *
@@ -2496,9 +6990,11 @@ int ybc_cluster_open(struct ybc_cluster *const cluster,
     total_slots_count += config->map_slots_count;
     max_slot_indexes[i] = total_slots_count;
 
-    cluster->hash_seed += cache->storage.hash_seed;
+    cluster->hash_seed += m_storage_get_hash_seed(&cache->storage, NULL);
   }
 
+  (void)m_storage_get_hash_seed(&caches[0].storage, &cluster->hash_algorithm);
+
   cluster->caches_count = caches_count;
   cluster->total_slots_count = total_slots_count;
 
@@ -2525,7 +7021,8 @@ struct ybc *ybc_cluster_get_cache(struct ybc_cluster *const cluster,
 
   struct m_key_digest key_digest;
 
-  m_key_digest_get(&key_digest, cluster->hash_seed, key);
+  m_key_digest_get(&key_digest, cluster->hash_algorithm, cluster->hash_seed,
+      key);
 
   const size_t slot_index = m_key_digest_mod(&key_digest,
       cluster->total_slots_count);
@@ -2564,16 +7061,21 @@ void ybc_cluster_clear(struct ybc_cluster *cluster)
  * Simple API.
  ******************************************************************************/
 
-static uint32_t m_simple_crc_get(const void *const ptr, const size_t size)
+static uint32_t m_simple_crc_get(const struct m_storage *const storage,
+    const void *const ptr, const size_t size)
 {
+  int hash_algorithm;
+  (void)m_storage_get_hash_seed(storage, &hash_algorithm);
+
   // TODO: use more appropriate functon here (for example, crc32).
-  return (uint32_t)m_hash_get(0, ptr, size);
+  return (uint32_t)m_hash_get(hash_algorithm, 0, ptr, size);
 }
 
 int ybc_simple_set(struct ybc *const cache, const struct ybc_key *const key,
     const struct ybc_value *const value)
 {
-  const uint32_t crc = m_simple_crc_get(value->ptr, value->size);
+  const uint32_t crc = m_simple_crc_get(&cache->storage,
+      value->ptr, value->size);
   const size_t crc_size = sizeof(crc);
   if (value->size > SIZE_MAX - crc_size) {
     return 0;
@@ -2623,6 +7125,7 @@ int ybc_simple_get(struct ybc *const cache, const struct ybc_key *const key,
   ybc_item_release(&item);
   value->size = actual_size;
 
-  const uint32_t expected_crc = m_simple_crc_get(value->ptr, actual_size);
+  const uint32_t expected_crc = m_simple_crc_get(
+      &cache->storage, value->ptr, actual_size);
   return (actual_crc == expected_crc);
 }
@@ -76,9 +76,11 @@ type Cacher interface {
 	GetDeAsync(key []byte, graceDuration time.Duration) (value []byte, err error)
 	SetItem(key []byte, value []byte, ttl time.Duration) (item *Item, err error)
 	GetItem(key []byte) (item *Item, err error)
+	GetItems(keys [][]byte) (items []*Item)
 	GetDeItem(key []byte, graceDuration time.Duration) (item *Item, err error)
 	GetDeAsyncItem(key []byte, graceDuration time.Duration) (item *Item, err error)
 	NewSetTxn(key []byte, valueSize int, ttl time.Duration) (txn *SetTxn, err error)
+	Stats() Stats
 }
 
 /*******************************************************************************
@@ -130,6 +132,16 @@ type Config struct {
 	// destroyed on application exit.
 	DataFile string
 
+	// Path to the file for hot items cache snapshots.
+	//
+	// Set this field if you want hot items to be quickly found right after
+	// application restart. The snapshot is saved on Cache.Close()
+	// and loaded on cache opening. It is used only if HotItemsCount
+	// is non-zero.
+	//
+	// Leave this field empty if you are in doubt.
+	MapCacheFile string
+
 	// The expected number of hot items in the cache.
 	//
 	// Setting HotItemsCount to non-zero value enables 'hot items'
@@ -145,6 +157,16 @@ type Config struct {
 	//   * if you are unsure :)
 	HotItemsCount SizeT
 
+	// The maximum number of hot items in the cache.
+	//
+	// Setting MaxHotItemsCount to non-zero value enables runtime auto-sizing
+	// of the 'hot items' optimization. The number of hot items is grown
+	// or shrunk according to the workload starting from HotItemsCount
+	// up to MaxHotItemsCount. See Cache.HotItemsCount().
+	//
+	// Leave this field empty if you are in doubt.
+	MaxHotItemsCount SizeT
+
 	// The expected size of hot data in the cache (in bytes).
 	//
 	// Setting HotDataSize to non-zero value enables 'hot data'
@@ -162,12 +184,23 @@ type Config struct {
 	//   * if you are unsure :)
 	HotDataSize SizeT
 
+	// The maximum size of hot data in the cache (in bytes).
+	//
+	// Setting MaxHotDataSize to non-zero value enables runtime auto-sizing
+	// of the 'hot data' optimization. Hot data size is grown or shrunk
+	// according to the workload starting from HotDataSize up to
+	// MaxHotDataSize. See Cache.HotDataSize().
+	//
+	// Leave this field empty if you are in doubt.
+	MaxHotDataSize SizeT
+
 	// The number of buckets in the hashtable used for tracking items
 	// affected by dogpile effect.
 	//
 	// Tune this value only if you plan using dogpile effect-aware
-	// functions. This value should be close to the average number
-	// of distinct pending items concurrently affected by dogpile effect.
+	// functions. This value should be a few times larger than the maximum
+	// number of distinct pending items concurrently affected by dogpile
+	// effect.
 	//
 	// Leave this field empty (set to 0) if you are in doubt.
 	//
@@ -187,6 +220,86 @@ type Config struct {
 	//
 	// Leave this field empty (set to 0) if you are in doubt.
 	SyncInterval time.Duration
+
+	// The maximum write-back bandwidth for cache syncing in bytes per second.
+	//
+	// Limiting the bandwidth spreads syncing over time, so it doesn't
+	// saturate the storage device. Each sync round is stretched over time
+	// until it is fully written back, while data written meanwhile waits
+	// for the next round, see Stats.SyncBacklogBytes.
+	//
+	// Leave this field empty (set to 0) if you are in doubt.
+	SyncBandwidth uint64
+
+	// The number of independently locked storage arenas.
+	//
+	// Multiple arenas reduce lock contention when the cache is accessed
+	// from many goroutines. The maximum item size is limited
+	// by DataFileSize / StorageArenasCount.
+	//
+	// Leave this field empty (set to 0) if you are in doubt.
+	StorageArenasCount int
+
+	// The number of slots per storage arena for lock-free registration
+	// of items obtained from the cache.
+	//
+	// Lock-free registration improves scalability of Cache.GetItem()
+	// and friends on multiple CPUs. The number should be close
+	// to the maximum number of concurrently obtained items per arena.
+	//
+	// Leave this field empty (set to 0) if you are in doubt.
+	ItemSlotsCount int
+
+	// Whether to evict items from the index using CLOCK algorithm.
+	//
+	// By default the item expiring first is evicted when the index bucket
+	// for a new item is full. This choice is arbitrary if items have
+	// the same ttl, for instance MaxTtl. CLOCK eviction gives recently read
+	// items the second chance, which usually results in higher hit ratio.
+	//
+	// Leave this field empty (set to false) if you are in doubt.
+	ClockEviction bool
+
+	// Whether to back the hot items cache with huge pages.
+	//
+	// Huge pages reduce TLB misses during lookups in large indexes.
+	// See ybc_config_enable_huge_pages() in ybc.h for details.
+	//
+	// Leave this field empty (set to false) if you are in doubt.
+	HugePages bool
+
+	// The number of threads reading the index file into RAM on open.
+	//
+	// Multiple threads speed up the warm-up of large index files
+	// on SSDs and RAIDs.
+	//
+	// Leave this field empty (set to 0) if you are in doubt.
+	IndexWarmupThreadsCount int
+
+	// Whether to warm up the index in background.
+	//
+	// If set, OpenCache() returns without waiting until the index file
+	// is read into RAM. See Stats.IndexWarmupPendingBytes for tracking
+	// the warm-up progress.
+	//
+	// Leave this field empty (set to false) if you are in doubt.
+	BackgroundIndexWarmup bool
+
+	// Whether to prefetch hot data in background after opening existing
+	// cache.
+	//
+	// Hot data is the last HotDataSize bytes written to the cache.
+	// Prefetching it avoids major page faults on the first requests
+	// to frequently accessed items after restart.
+	// See Stats.HotDataPrefetchPendingBytes for tracking the progress.
+	//
+	// Leave this field empty (set to false) if you are in doubt.
+	HotDataPrefetch bool
+
+	// The maximum read bandwidth for hot data prefetch in bytes per second.
+	//
+	// Leave this field empty (set to 0) if you are in doubt.
+	HotDataPrefetchBandwidth uint64
 }
 
 type configInternal struct {
@@ -313,8 +426,19 @@ func (cfg *Config) internal(isSimpleCache bool) *configInternal {
 		C.ybc_config_set_data_file(ctx, dataFileCStr)
 		c.cg.SetDataFile(cfg.DataFile)
 	}
+	if cfg.MapCacheFile != "" {
+		mapCacheFileCStr := C.CString(cfg.MapCacheFile)
+		defer C.free(unsafe.Pointer(mapCacheFileCStr))
+		C.ybc_config_set_map_cache_file(ctx, mapCacheFileCStr)
+	}
 	C.ybc_config_set_hot_items_count(ctx, C.size_t(cfg.HotItemsCount))
 	C.ybc_config_set_hot_data_size(ctx, C.size_t(cfg.HotDataSize))
+	if cfg.MaxHotItemsCount != 0 {
+		C.ybc_config_set_max_hot_items_count(ctx, C.size_t(cfg.MaxHotItemsCount))
+	}
+	if cfg.MaxHotDataSize != 0 {
+		C.ybc_config_set_max_hot_data_size(ctx, C.size_t(cfg.MaxHotDataSize))
+	}
 	if cfg.DeHashtableSize != 0 {
 		C.ybc_config_set_de_hashtable_size(ctx, C.size_t(cfg.DeHashtableSize))
 	}
@@ -325,6 +449,33 @@ func (cfg *Config) internal(isSimpleCache bool) *configInternal {
 		}
 		C.ybc_config_set_sync_interval(ctx, C.uint64_t(syncInterval/time.Millisecond))
 	}
+	if cfg.SyncBandwidth != 0 {
+		C.ybc_config_set_sync_bandwidth(ctx, C.uint64_t(cfg.SyncBandwidth))
+	}
+	if cfg.StorageArenasCount != 0 {
+		C.ybc_config_set_storage_arenas_count(ctx, C.size_t(cfg.StorageArenasCount))
+	}
+	if cfg.ItemSlotsCount != 0 {
+		C.ybc_config_set_item_slots_count(ctx, C.size_t(cfg.ItemSlotsCount))
+	}
+	if cfg.ClockEviction {
+		C.ybc_config_enable_clock_eviction(ctx)
+	}
+	if cfg.HugePages {
+		C.ybc_config_enable_huge_pages(ctx)
+	}
+	if cfg.IndexWarmupThreadsCount != 0 {
+		C.ybc_config_set_index_warmup_threads_count(ctx, C.size_t(cfg.IndexWarmupThreadsCount))
+	}
+	if cfg.BackgroundIndexWarmup {
+		C.ybc_config_enable_background_index_warmup(ctx)
+	}
+	if cfg.HotDataPrefetch {
+		C.ybc_config_enable_hot_data_prefetch(ctx)
+	}
+	if cfg.HotDataPrefetchBandwidth != 0 {
+		C.ybc_config_set_hot_data_prefetch_bandwidth(ctx, C.uint64_t(cfg.HotDataPrefetchBandwidth))
+	}
 	if isSimpleCache {
 		C.ybc_config_disable_overwrite_protection(ctx)
 	}
@@ -616,6 +767,61 @@ func (cache *Cache) GetItem(key []byte) (item *Item, err error) {
 	return
 }
 
+// Returns items for the given keys.
+//
+// items[i] is set to nil on cache miss for keys[i].
+//
+// This method is faster than calling Cache.GetItem() for each key,
+// since it overlaps memory accesses for distinct keys.
+//
+// Each non-nil returned item must be closed with item.Close() call!
+func (cache *Cache) GetItems(keys [][]byte) (items []*Item) {
+	cache.dg.CheckLive()
+	keysCount := len(keys)
+	items = make([]*Item, keysCount)
+	if keysCount == 0 {
+		return
+	}
+
+	keysSize := 0
+	for _, key := range keys {
+		keysSize += len(key)
+	}
+	// Reserve an extra byte, so keysBuf is non-empty even for empty keys.
+	keysBuf := make([]byte, keysSize+1)
+	keySizes := make([]C.size_t, keysCount)
+	n := 0
+	for i, key := range keys {
+		n += copy(keysBuf[n:], key)
+		keySizes[i] = C.size_t(len(key))
+	}
+
+	itemsBuf := make([]byte, keysCount*itemSize)
+	isFound := make([]C.int, keysCount)
+	values := make([]C.struct_ybc_value, keysCount)
+	foundCount := C.go_get_items(cache.ctx(), (*C.struct_ybc_item)(bufPtr(itemsBuf)),
+		&isFound[0], &values[0], (*C.char)(bufPtr(keysBuf)), &keySizes[0], C.size_t(keysCount))
+	if foundCount == 0 {
+		return
+	}
+
+	for i := 0; i < keysCount; i++ {
+		if isFound[i] == 0 {
+			continue
+		}
+		// Acquired items mustn't be moved, so they refer to itemsBuf.
+		start := i * itemSize
+		end := start + itemSize
+		item := &Item{
+			buf:   itemsBuf[start:end:end],
+			value: values[i],
+		}
+		item.dg.Init()
+		items[i] = item
+	}
+	return
+}
+
 // The same as Cache.GetDe(), but returns item instead of item's value.
 //
 // The returned item must be closed with item.Close() call!
@@ -672,6 +878,42 @@ func (cache *Cache) GetDeAsyncItem(key []byte, graceDuration time.Duration) (ite
 	panic("unreachable")
 }
 
+// The same as Cache.GetDeAsyncItem(), but returns the item, which is about
+// to expire, together with isRefresher set to true to the caller elected
+// for refreshing the item. Other callers receive the same item
+// with isRefresher set to false until the item is refreshed or expired.
+//
+// The returned item must be closed with item.Close() call!
+func (cache *Cache) GetDeRefreshAsyncItem(key []byte, graceDuration time.Duration) (item *Item, isRefresher bool, err error) {
+	cache.dg.CheckLive()
+	if graceDuration < 0 {
+		graceDuration = 0
+	}
+	item = acquireItem()
+	var k C.struct_ybc_key
+	initKey(&k, key)
+	mGraceTtl := C.uint64_t(graceDuration / time.Millisecond)
+	rv := C.go_get_item_and_value_de_refresh_async(cache.ctx(), item.ctx(), k.ptr, k.size, mGraceTtl)
+	switch rv.status {
+	case C.YBC_DE_WOULDBLOCK:
+		releaseItem(item)
+		err = ErrWouldBlock
+		return
+	case C.YBC_DE_NOTFOUND:
+		releaseItem(item)
+		err = ErrCacheMiss
+		return
+	case C.YBC_DE_REFRESH:
+		isRefresher = true
+		fallthrough
+	case C.YBC_DE_SUCCESS:
+		item.value = rv.value
+		item.dg.Init()
+		return
+	}
+	panic("unreachable")
+}
+
 // Starts new 'set transaction' for storing an item in the cache
 // with the given valueSize size, the given ttl and the given key.
 //
@@ -712,6 +954,100 @@ func (cache *Cache) Clear() {
 	C.ybc_clear(cache.ctx())
 }
 
+// Cache statistics.
+//
+// All the counters are accumulated since the cache has been opened.
+// See struct ybc_stats in ybc.h for details.
+type Stats struct {
+	GetHits                     uint64
+	GetMisses                   uint64
+	PayloadCheckFailures        uint64
+	MetadataCheckFailures       uint64
+	MapVictimOverwrites         uint64
+	MapCacheHits                uint64
+	MapCacheMisses              uint64
+	StorageWraps                uint64
+	DefragmentationMoves        uint64
+	DeWaits                     uint64
+	Syncs                       uint64
+	SyncBytes                   uint64
+	SyncDuration                time.Duration
+	LockContentions             uint64
+	LockWaitDuration            time.Duration
+	SyncBacklogBytes            uint64
+	IndexWarmupPendingBytes     uint64
+	HotDataPrefetchPendingBytes uint64
+}
+
+func (stats *Stats) add(other *Stats) {
+	stats.GetHits += other.GetHits
+	stats.GetMisses += other.GetMisses
+	stats.PayloadCheckFailures += other.PayloadCheckFailures
+	stats.MetadataCheckFailures += other.MetadataCheckFailures
+	stats.MapVictimOverwrites += other.MapVictimOverwrites
+	stats.MapCacheHits += other.MapCacheHits
+	stats.MapCacheMisses += other.MapCacheMisses
+	stats.StorageWraps += other.StorageWraps
+	stats.DefragmentationMoves += other.DefragmentationMoves
+	stats.DeWaits += other.DeWaits
+	stats.Syncs += other.Syncs
+	stats.SyncBytes += other.SyncBytes
+	stats.SyncDuration += other.SyncDuration
+	stats.LockContentions += other.LockContentions
+	stats.LockWaitDuration += other.LockWaitDuration
+	stats.SyncBacklogBytes += other.SyncBacklogBytes
+	stats.IndexWarmupPendingBytes += other.IndexWarmupPendingBytes
+	stats.HotDataPrefetchPendingBytes += other.HotDataPrefetchPendingBytes
+}
+
+// Returns cache statistics.
+//
+// Counters are sharded per thread and updated with relaxed atomic operations.
+// Shards are summed while other threads may update them, so the returned
+// values are approximate under concurrent access.
+func (cache *Cache) Stats() (stats Stats) {
+	cache.dg.CheckLive()
+	var s C.struct_ybc_stats
+	C.ybc_get_stats(cache.ctx(), &s)
+	stats = Stats{
+		GetHits:                     uint64(s.get_hits),
+		GetMisses:                   uint64(s.get_misses),
+		PayloadCheckFailures:        uint64(s.payload_check_failures),
+		MetadataCheckFailures:       uint64(s.metadata_check_failures),
+		MapVictimOverwrites:         uint64(s.map_victim_overwrites),
+		MapCacheHits:                uint64(s.map_cache_hits),
+		MapCacheMisses:              uint64(s.map_cache_misses),
+		StorageWraps:                uint64(s.storage_wraps),
+		DefragmentationMoves:        uint64(s.defragmentation_moves),
+		DeWaits:                     uint64(s.de_waits),
+		Syncs:                       uint64(s.syncs),
+		SyncBytes:                   uint64(s.sync_bytes),
+		SyncDuration:                time.Duration(s.sync_time_ns),
+		LockContentions:             uint64(s.lock_contentions),
+		LockWaitDuration:            time.Duration(s.lock_wait_time_ns),
+		SyncBacklogBytes:            uint64(s.sync_backlog_bytes),
+		IndexWarmupPendingBytes:     uint64(s.index_warmup_pending_bytes),
+		HotDataPrefetchPendingBytes: uint64(s.hot_data_prefetch_pending_bytes),
+	}
+	return
+}
+
+// Returns the current number of hot items.
+//
+// The number may change over time if Config.MaxHotItemsCount is set.
+func (cache *Cache) HotItemsCount() SizeT {
+	cache.dg.CheckLive()
+	return SizeT(C.ybc_get_hot_items_count(cache.ctx()))
+}
+
+// Returns the current size of hot data in bytes.
+//
+// The size may change over time if Config.MaxHotDataSize is set.
+func (cache *Cache) HotDataSize() SizeT {
+	cache.dg.CheckLive()
+	return SizeT(C.ybc_get_hot_data_size(cache.ctx()))
+}
+
 func (cache *Cache) ctx() *C.struct_ybc {
 	return (*C.struct_ybc)(bufPtr(cache.buf))
 }
@@ -899,6 +1235,39 @@ func (item *Item) Available() int {
 	return item.Size() - item.offset
 }
 
+// Returns true if the item's value is resident in RAM.
+//
+// Reading non-resident value blocks the goroutine together with the underlying
+// OS thread until the value is read from the data file. Use Prefetch
+// for reading the value into RAM in the background.
+func (item *Item) IsResident() bool {
+	item.dg.CheckLive()
+	return C.ybc_item_is_resident(item.ctx()) != 0
+}
+
+// Starts reading the item's value from the data file into RAM
+// in the background.
+//
+// The method returns immediately. Use IsResident for determining whether
+// the value has been read.
+func (item *Item) Prefetch() {
+	item.dg.CheckLive()
+	C.ybc_item_prefetch_value(item.ctx())
+}
+
+// Returns location of the item's value in the data file.
+//
+// This allows sending big values such as video files to sockets directly
+// from the data file via sendfile() or splice() without copying them
+// into Go buffers. The fd is owned by the cache, so it mustn't be closed.
+// The item must remain open until the value is sent.
+func (item *Item) ValueLocation() (fd uintptr, offset int64, size int) {
+	item.dg.CheckLive()
+	var location C.struct_ybc_value_location
+	C.ybc_item_get_value_location(item.ctx(), &location)
+	return uintptr(location.fd), int64(location.offset), int(location.size)
+}
+
 // Returns remaining ttl for the item.
 func (item *Item) Ttl() time.Duration {
 	item.dg.CheckLive()
@@ -1113,6 +1482,28 @@ func (cluster *Cluster) GetItem(key []byte) (item *Item, err error) {
 	return cluster.cache(key).GetItem(key)
 }
 
+// See Cache.GetItems()
+func (cluster *Cluster) GetItems(keys [][]byte) (items []*Item) {
+	items = make([]*Item, len(keys))
+
+	// Group keys by caches, so each cache obtains its' keys in one batch.
+	cacheKeyIndexes := make(map[*Cache][]int)
+	for i, key := range keys {
+		cache := cluster.cache(key)
+		cacheKeyIndexes[cache] = append(cacheKeyIndexes[cache], i)
+	}
+	for cache, keyIndexes := range cacheKeyIndexes {
+		cacheKeys := make([][]byte, len(keyIndexes))
+		for i, keyIndex := range keyIndexes {
+			cacheKeys[i] = keys[keyIndex]
+		}
+		for i, item := range cache.GetItems(cacheKeys) {
+			items[keyIndexes[i]] = item
+		}
+	}
+	return
+}
+
 // See Cache.GetDeItem()
 func (cluster *Cluster) GetDeItem(key []byte, graceDuration time.Duration) (item *Item, err error) {
 	return cluster.cache(key).GetDeItem(key, graceDuration)
@@ -1123,6 +1514,11 @@ func (cluster *Cluster) GetDeAsyncItem(key []byte, graceDuration time.Duration)
 	return cluster.cache(key).GetDeAsyncItem(key, graceDuration)
 }
 
+// See Cache.GetDeRefreshAsyncItem()
+func (cluster *Cluster) GetDeRefreshAsyncItem(key []byte, graceDuration time.Duration) (item *Item, isRefresher bool, err error) {
+	return cluster.cache(key).GetDeRefreshAsyncItem(key, graceDuration)
+}
+
 // See Cache.NewSetTxn()
 func (cluster *Cluster) NewSetTxn(key []byte, valueSize int, ttl time.Duration) (txn *SetTxn, err error) {
 	return cluster.cache(key).NewSetTxn(key, valueSize, ttl)
@@ -1135,6 +1531,17 @@ func (cluster *Cluster) Clear() {
 	}
 }
 
+// Returns statistics summed over all the caches in the cluster.
+//
+// See Cache.Stats()
+func (cluster *Cluster) Stats() (stats Stats) {
+	for _, cache := range cluster.caches {
+		cacheStats := cache.Stats()
+		stats.add(&cacheStats)
+	}
+	return
+}
+
 func (cluster *Cluster) cache(key []byte) *Cache {
 	cluster.dg.CheckLive()
 	h := fnv.New64a()
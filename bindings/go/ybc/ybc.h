@@ -137,6 +137,26 @@ YBC_API void ybc_config_set_index_file(struct ybc_config *config,
 YBC_API void ybc_config_set_data_file(struct ybc_config *config,
     const char *filename);
 
+/*
+ * Sets a path to the file for hot items cache snapshots.
+ *
+ * The hot items cache (see ybc_config_set_hot_items_count()) lives in RAM
+ * only, so it is empty after the cache is re-opened. If the path is set,
+ * the hot items cache is saved into the file on ybc_close() and loaded back
+ * on ybc_open(), so hot items are quickly found right after restart.
+ *
+ * The snapshot is ignored if the cache has been modified or cleared since
+ * the snapshot was saved, or if the number of hot items has been changed
+ * and cannot be restored by auto-sizing
+ * (see ybc_config_set_max_hot_items_count()).
+ * The file is removed after loading, so a stale snapshot isn't loaded after
+ * unexpected process termination.
+ *
+ * By default the path is NULL, i.e. snapshots are disabled.
+ */
+YBC_API void ybc_config_set_map_cache_file(struct ybc_config *config,
+    const char *filename);
+
 /*
  * Sets the expected number of hot (frequently requested) items in the cache.
  *
@@ -158,6 +178,26 @@ YBC_API void ybc_config_set_data_file(struct ybc_config *config,
 YBC_API void ybc_config_set_hot_items_count(struct ybc_config *config,
     size_t hot_items_count);
 
+/*
+ * Enables runtime auto-sizing of hot items' cache and sets the maximum number
+ * of hot items, which may be cached.
+ *
+ * The cache periodically grows hot items' cache if it misses too frequently
+ * and shrinks it if it is mostly empty. The number of hot items set
+ * via ybc_config_set_hot_items_count() is used as a starting point.
+ * If hot items' cache is disabled, then auto-sizing starts with the smallest
+ * hot items' cache.
+ *
+ * Memory for the maximum number of hot items is reserved at ybc_open(),
+ * but physical memory is used only for the current number of hot items.
+ * The current number may be obtained via ybc_get_hot_items_count().
+ *
+ * By default auto-sizing is disabled, i.e. the maximum number of hot items
+ * is 0.
+ */
+YBC_API void ybc_config_set_max_hot_items_count(struct ybc_config *config,
+    size_t max_hot_items_count);
+
 /*
  * Sets the expected size of hot (frequently requested) data in the cache.
  *
@@ -185,16 +225,35 @@ YBC_API void ybc_config_set_hot_data_size(struct ybc_config *config,
     size_t hot_data_size);
 
 /*
- * Sets the size of hashtable used for tracking pending items affected
- * by dogpile effect.
+ * Enables runtime auto-sizing of hot data and sets the maximum size of hot
+ * data in bytes.
  *
- * The hashtable size should be close to the average number of distinct pending
- * items concurrently affected by dogpile effect (N_de).
+ * The cache periodically grows hot data size if hot items are too frequently
+ * moved by hot data compaction and shrinks it if such moves are rare.
+ * The size set via ybc_config_set_hot_data_size() is used as a starting
+ * point. If hot data compaction is disabled, then auto-sizing starts
+ * with the smallest hot data size.
  *
- * If N_de is much larger than the hashtable size, then ybc_item_get_de*() may
- * waste a lot of CPU time looking up pending items affected by dogpile effect.
+ * The current hot data size may be obtained via ybc_get_hot_data_size().
  *
- * If N_de is smaller than the hashtable size, then the cache may waste
+ * By default auto-sizing is disabled, i.e. the maximum hot data size is 0.
+ */
+YBC_API void ybc_config_set_max_hot_data_size(struct ybc_config *config,
+    size_t max_hot_data_size);
+
+/*
+ * Sets the number of slots in hashtable used for tracking pending items
+ * affected by dogpile effect.
+ *
+ * Each slot may hold a single pending item, so the hashtable size should be
+ * a few times larger than the maximum number of distinct pending items
+ * concurrently affected by dogpile effect (N_de).
+ *
+ * If N_de approaches the hashtable size, then new pending items are tracked
+ * in a slower locked list, which serializes ybc_item_get_de*() calls
+ * for such items.
+ *
+ * If N_de is much smaller than the hashtable size, then the cache may waste
  * additional memory.
  *
  * Default value should work well for almost all cases, so tune this value only
@@ -233,6 +292,151 @@ YBC_API void ybc_config_set_de_hashtable_size(struct ybc_config *config,
 YBC_API void ybc_config_set_sync_interval(struct ybc_config *config,
     uint64_t sync_interval);
 
+/*
+ * Sets the maximum write-back bandwidth for data syncing in bytes per second.
+ *
+ * Data syncing writes back dirty pages in small chunks. Limiting its bandwidth
+ * spreads write-back over time, so it doesn't saturate the storage device
+ * and doesn't hurt latency of concurrent page faults in the data file.
+ * When the limit is reached, the sync thread sleeps between chunks, so a sync
+ * round is stretched over time instead of being cut short. The next round
+ * starts only after the current round is fully written back. Data written
+ * into the cache meanwhile waits for the next round,
+ * see ybc_stats.sync_backlog_bytes.
+ *
+ * The limit is ignored during ybc_close(), so the cache is always fully
+ * persisted on close.
+ *
+ * Setting sync bandwidth to 0 removes the limit. By default there is no limit.
+ */
+YBC_API void ybc_config_set_sync_bandwidth(struct ybc_config *config,
+    uint64_t sync_bandwidth);
+
+/*
+ * Sets the number of independent storage arenas.
+ *
+ * The data file is split into storage_arenas_count equal parts. Each arena
+ * has its own lock and its own write cursor, so writers and readers touching
+ * distinct arenas don't contend with each other. Each key is always stored
+ * in the same arena.
+ *
+ * The maximum item size is limited by data_file_size / storage_arenas_count.
+ * Hot data size (see ybc_config_set_hot_data_size()) is split evenly
+ * among arenas.
+ *
+ * Existing cache files can be opened with a different number of arenas
+ * only if force is set in ybc_open(). Some items may be lost in this case.
+ *
+ * Default value is 1, i.e. a single arena covering the whole data file.
+ */
+YBC_API void ybc_config_set_storage_arenas_count(struct ybc_config *config,
+    size_t storage_arenas_count);
+
+/*
+ * Sets the number of slots per storage arena for lock-free registration
+ * of acquired items.
+ *
+ * By default items acquired via ybc_item_get*() are registered in a shared
+ * list under a lock, so concurrent writers don't overwrite them. This may
+ * limit scalability of read operations on multiple CPUs.
+ *
+ * If this number is greater than 0, then acquired items are registered
+ * without locking in per-thread slots. Writers scan used slots on each
+ * item allocation, so the number should be close to the maximum number
+ * of concurrently acquired items per arena. Items are registered under
+ * the lock if all slots are busy.
+ *
+ * This setting is ignored if overwrite protection is disabled
+ * via ybc_config_disable_overwrite_protection().
+ *
+ * Default value is 0, i.e. lock-free registration is disabled.
+ */
+YBC_API void ybc_config_set_item_slots_count(struct ybc_config *config,
+    size_t item_slots_count);
+
+/*
+ * Sets the number of threads reading the index file into RAM on open.
+ *
+ * ybc_open() caches the whole index file in RAM, so lookups don't suffer
+ * from random I/O on a cold index. Large index files on SSDs and RAIDs
+ * are read much faster by multiple threads, each reading distinct chunks
+ * of the file.
+ *
+ * Setting the number of threads to 0 disables index warm-up, so the index
+ * is read on demand via page faults.
+ *
+ * Default value is 1.
+ */
+YBC_API void ybc_config_set_index_warmup_threads_count(
+    struct ybc_config *config, size_t index_warmup_threads_count);
+
+/*
+ * Enables background index warm-up.
+ *
+ * By default ybc_open() returns after the index file is cached in RAM.
+ * With background warm-up ybc_open() returns immediately, so the cache
+ * may serve requests while the index is being read. Lookups touching
+ * not yet cached parts of the index may be slow until the warm-up completes.
+ *
+ * Warm-up progress may be tracked via ybc_stats.index_warmup_pending_bytes
+ * or via ybc_config_set_index_warmup_progress_callback().
+ * ybc_close() stops unfinished warm-up.
+ */
+YBC_API void ybc_config_enable_background_index_warmup(
+    struct ybc_config *config);
+
+/*
+ * Index warm-up progress callback.
+ *
+ * warmed_size is the number of bytes already read from the index file,
+ * total_size is the size of the index file.
+ */
+typedef void (*ybc_warmup_progress_func)(void *ctx, size_t warmed_size,
+    size_t total_size);
+
+/*
+ * Sets the callback, which is called after each chunk of the index file
+ * is cached in RAM during warm-up.
+ *
+ * The callback is called from warm-up threads, but calls are serialized,
+ * so the callback doesn't need locking on its' own. It must not call
+ * ybc_close() for the cache being warmed up.
+ *
+ * ctx is passed to the callback as is.
+ */
+YBC_API void ybc_config_set_index_warmup_progress_callback(
+    struct ybc_config *config, ybc_warmup_progress_func progress_func,
+    void *ctx);
+
+/*
+ * Enables background prefetch of hot data after opening existing cache.
+ *
+ * Storage file contents isn't cached in RAM on open, so the first requests
+ * to frequently accessed items after restart result in major page faults.
+ * Working set defragmentation keeps frequently accessed items in the last
+ * hot_data_size bytes written to the storage (see
+ * ybc_config_set_hot_data_size()). This option reads that area into RAM
+ * in background, starting from the most recently written data.
+ *
+ * Prefetch progress may be tracked via
+ * ybc_stats.hot_data_prefetch_pending_bytes. ybc_close() stops unfinished
+ * prefetch.
+ *
+ * By default hot data prefetch is disabled.
+ */
+YBC_API void ybc_config_enable_hot_data_prefetch(struct ybc_config *config);
+
+/*
+ * Sets the maximum read bandwidth for hot data prefetch in bytes per second.
+ *
+ * Limiting the bandwidth leaves the storage device available for page faults
+ * caused by cache requests during prefetch.
+ *
+ * Setting the bandwidth to 0 removes the limit. Default value is 64MB/s.
+ */
+YBC_API void ybc_config_set_hot_data_prefetch_bandwidth(
+    struct ybc_config *config, uint64_t hot_data_prefetch_bandwidth);
+
 /*
  * Disables protection from items' overwrite corruption.
  *
@@ -254,6 +458,44 @@ YBC_API void ybc_config_set_sync_interval(struct ybc_config *config,
  */
 YBC_API void ybc_config_disable_overwrite_protection(struct ybc_config *config);
 
+/*
+ * Enables CLOCK eviction of items from the index.
+ *
+ * Items are evicted from the index when all the slots in the bucket
+ * corresponding to a new item are occupied. By default the item expiring
+ * first is evicted. This choice is arbitrary if items have the same
+ * expiration time, for instance YBC_MAX_TTL.
+ *
+ * If CLOCK eviction is enabled, then the cache keeps a reference bit per index
+ * slot. The bit is set on each item read, so recently read items get
+ * the second chance before eviction. This usually results in higher hit ratio
+ * for skewed workloads at the cost of a shared memory write on the first read
+ * of an item after its' reference bit has been cleared.
+ *
+ * Reference bits aren't persisted, so all items start unreferenced
+ * after the cache is opened.
+ */
+YBC_API void ybc_config_enable_clock_eviction(struct ybc_config *config);
+
+/*
+ * Enables huge pages for the hot items cache.
+ *
+ * Lookups access random locations in the index, so a large index backed
+ * by regular memory pages results in many TLB misses. Huge pages cover
+ * much more memory per TLB entry.
+ *
+ * The hot items cache (see ybc_config_set_hot_items_count()) is allocated
+ * from explicitly reserved huge pages if available, otherwise from
+ * transparent huge pages. The index file mapping itself is backed by regular
+ * pages, so only lookups served by the hot items cache benefit from huge
+ * pages. Index files mustn't be placed on hugetlbfs, since it doesn't support
+ * regular writes used for index file creation.
+ *
+ * The cache works as usual if huge pages are unavailable.
+ * By default huge pages are disabled.
+ */
+YBC_API void ybc_config_enable_huge_pages(struct ybc_config *config);
+
 
 /*******************************************************************************
  * Cache management API.
@@ -337,6 +579,148 @@ YBC_API void ybc_clear(struct ybc *cache);
  */
 YBC_API void ybc_remove(const struct ybc_config *config);
 
+/*
+ * Cache statistics.
+ *
+ * All the counters are accumulated since the cache has been opened.
+ * Counters aren't persisted across ybc_close() / ybc_open() calls.
+ */
+struct ybc_stats
+{
+  /*
+   * The number of successfully acquired items.
+   */
+  uint64_t get_hits;
+
+  /*
+   * The number of failed attempts to acquire items. Includes failed
+   * payload and metadata checks.
+   */
+  uint64_t get_misses;
+
+  /*
+   * The number of items found in the index, which were outdated, expired
+   * or had invalid location in the storage.
+   */
+  uint64_t payload_check_failures;
+
+  /*
+   * The number of items found in the index, which had mismatched key
+   * in the storage. This usually means key digest collision
+   * or torn index read.
+   */
+  uint64_t metadata_check_failures;
+
+  /*
+   * The number of live index slots overwritten due to full index bucket.
+   */
+  uint64_t map_victim_overwrites;
+
+  /*
+   * The number of items found in the hot items cache.
+   */
+  uint64_t map_cache_hits;
+
+  /*
+   * The number of items missing in the hot items cache, which have been found
+   * in the index.
+   */
+  uint64_t map_cache_misses;
+
+  /*
+   * The number of storage arena wraps, i.e. the number of times
+   * the storage has been completely overwritten with new items.
+   */
+  uint64_t storage_wraps;
+
+  /*
+   * The number of frequently accessed items moved to the head
+   * of the storage by working set defragmentation.
+   */
+  uint64_t defragmentation_moves;
+
+  /*
+   * The number of times ybc_item_get_de*() suggested waiting for another
+   * thread, which is obtaining the item.
+   */
+  uint64_t de_waits;
+
+  /*
+   * The number of data sync runs.
+   */
+  uint64_t syncs;
+
+  /*
+   * The number of bytes synced to the data file.
+   */
+  uint64_t sync_bytes;
+
+  /*
+   * Total duration of data sync runs in nanoseconds.
+   */
+  uint64_t sync_time_ns;
+
+  /*
+   * The number of times threads had to wait for storage arena locks.
+   */
+  uint64_t lock_contentions;
+
+  /*
+   * Total time spent waiting for storage arena locks in nanoseconds.
+   */
+  uint64_t lock_wait_time_ns;
+
+  /*
+   * The size of data in bytes, which isn't synced to the data file yet.
+   *
+   * Unlike other fields, this is a momentary value rather than a counter.
+   */
+  uint64_t sync_backlog_bytes;
+
+  /*
+   * The size of index file data in bytes, which isn't cached in RAM yet
+   * by background index warm-up.
+   *
+   * This is a momentary value. It drops to 0 when the warm-up completes.
+   * See ybc_config_enable_background_index_warmup().
+   */
+  uint64_t index_warmup_pending_bytes;
+
+  /*
+   * The size of hot data in bytes, which isn't prefetched yet.
+   *
+   * This is a momentary value. It drops to 0 when the prefetch completes.
+   * See ybc_config_enable_hot_data_prefetch().
+   */
+  uint64_t hot_data_prefetch_pending_bytes;
+};
+
+/*
+ * Obtains statistics for the given cache.
+ *
+ * Counters are maintained in per-thread shards with relaxed atomic updates.
+ * Shards are summed while other threads may update them, so the obtained
+ * values are approximate under concurrent access.
+ */
+YBC_API void ybc_get_stats(struct ybc *cache, struct ybc_stats *stats);
+
+/*
+ * Returns the current number of hot items, which may be cached
+ * in hot items' cache.
+ *
+ * The number may change in runtime if auto-sizing is enabled
+ * via ybc_config_set_max_hot_items_count().
+ */
+YBC_API size_t ybc_get_hot_items_count(struct ybc *cache);
+
+/*
+ * Returns the current hot data size in bytes.
+ *
+ * The size may change in runtime if auto-sizing is enabled
+ * via ybc_config_set_max_hot_data_size().
+ */
+YBC_API size_t ybc_get_hot_data_size(struct ybc *cache);
+
 
 /*******************************************************************************
  * 'Add' transaction API.
@@ -583,6 +967,30 @@ struct ybc_value
   uint64_t ttl;
 };
 
+/*
+ * Location of item's value in the data file.
+ */
+struct ybc_value_location
+{
+  /*
+   * Data file descriptor.
+   *
+   * The descriptor is owned by the cache, so it mustn't be closed
+   * by the caller. It remains valid until the cache is closed.
+   */
+  int fd;
+
+  /*
+   * Value offset in the data file.
+   */
+  size_t offset;
+
+  /*
+   * Value size in bytes.
+   */
+  size_t size;
+};
+
 /*
  * Status returned by ybc_item_get_de*().
  */
@@ -591,6 +999,12 @@ enum ybc_de_status
   YBC_DE_NOTFOUND,
   YBC_DE_SUCCESS,
   YBC_DE_WOULDBLOCK,
+
+  /*
+   * The item is found, but it is about to expire, so the caller is elected
+   * for refreshing it. Returned only by ybc_item_get_de_refresh*().
+   */
+  YBC_DE_REFRESH,
 };
 
 /*
@@ -656,6 +1070,23 @@ YBC_API int ybc_item_set(struct ybc *cache, const struct ybc_key *key,
 YBC_API int ybc_item_set_item(struct ybc *cache, struct ybc_item *item,
     const struct ybc_key *key, const struct ybc_value *value);
 
+/*
+ * Adds the given items with the given keys to the cache.
+ *
+ * This function is equivalent to calling ybc_item_set() for each
+ * (keys[i], values[i]) pair, but it is faster for bulk loads, since space
+ * for a batch of items is allocated under a single lock hold. Values
+ * are copied into the cache without holding the lock.
+ *
+ * Items with the same key are stored in the order they appear in keys,
+ * i.e. the last one wins.
+ *
+ * Returns the number of items stored in the cache. Items, which couldn't
+ * be stored due to lack of space, are silently skipped.
+ */
+YBC_API size_t ybc_item_set_multi(struct ybc *cache,
+    const struct ybc_key *keys, const struct ybc_value *values, size_t count);
+
 /*
  * Removes an item with the given key from the cache.
  *
@@ -679,6 +1110,35 @@ YBC_API int ybc_item_remove(struct ybc *cache, const struct ybc_key *key);
 YBC_API int ybc_item_get(struct ybc *cache, struct ybc_item *item,
     const struct ybc_key *key);
 
+/*
+ * Acquires items with the given keys.
+ *
+ * This function is equivalent to calling ybc_item_get() for each key,
+ * but it may be much faster for big caches, since it overlaps memory loads
+ * for distinct keys. Keys are hashed at first, then index buckets
+ * for all the keys are prefetched, then storage metadata for all the found
+ * items is prefetched. Items are validated and acquired only after that.
+ *
+ * items must point to a buffer with keys_count * ybc_item_get_size() bytes.
+ * Use YBC_ITEM_GET() for accessing individual items in the buffer.
+ *
+ * Sets is_found[i] to non-zero if an item with keys[i] is acquired,
+ * otherwise sets is_found[i] to zero.
+ *
+ * Returns the number of acquired items.
+ *
+ * Each acquired item MUST be released via ybc_item_release() call.
+ */
+YBC_API size_t ybc_item_get_multi(struct ybc *cache, struct ybc_item *items,
+    int *is_found, const struct ybc_key *keys, size_t keys_count);
+
+/*
+ * Returns a pointer to the item with the given index in the given
+ * array of items.
+ */
+#define YBC_ITEM_GET(items, index)  \
+    ((struct ybc_item *)((char *)(items) + (index) * ybc_item_get_size()))
+
 /*
  * Acquires an item with automatic dogpile effect (de) handling.
  *
@@ -748,6 +1208,86 @@ YBC_API enum ybc_de_status ybc_item_get_de(struct ybc *cache,
 YBC_API enum ybc_de_status ybc_item_get_de_async(struct ybc *cache,
     struct ybc_item *item, const struct ybc_key *key, uint64_t grace_ttl);
 
+/*
+ * This function is almost equivalent to ybc_item_get_de(), except that
+ * it serves stale items while they are refreshed.
+ *
+ * When item's ttl becomes smaller than grace_ttl, then the function returns
+ * YBC_DE_REFRESH together with not-yet-expired item to a single caller, which
+ * is elected for refreshing the item. Other callers receive the same item
+ * with YBC_DE_SUCCESS status until the item is refreshed or expired.
+ * So the item remains available for all the callers during the refresh.
+ *
+ * Acquired items MUST be released with ybc_item_release() for both
+ * YBC_DE_SUCCESS and YBC_DE_REFRESH statuses.
+ */
+YBC_API enum ybc_de_status ybc_item_get_de_refresh(struct ybc *cache,
+    struct ybc_item *item, const struct ybc_key *key, uint64_t grace_ttl);
+
+/*
+ * This function is almost equivalent to ybc_item_get_de_refresh(), except
+ * that it never blocks. See ybc_item_get_de_async() for details.
+ */
+YBC_API enum ybc_de_status ybc_item_get_de_refresh_async(struct ybc *cache,
+    struct ybc_item *item, const struct ybc_key *key, uint64_t grace_ttl);
+
+/*
+ * Dogpile effect waiter handler.
+ *
+ * The waiter is registered by ybc_item_get_de_notify().
+ */
+struct ybc_de_waiter;
+
+/*
+ * Returns the size of ybc_de_waiter structure in bytes.
+ *
+ * The caller is responsible for allocating this amount of memory
+ * for the structure before passing it into ybc_item_get_de_notify().
+ */
+YBC_API size_t ybc_de_waiter_get_size(void);
+
+/*
+ * Callback, which is called when the item the waiter waits for is added
+ * into the cache or its' grace ttl expires.
+ */
+typedef void (*ybc_de_notify_func)(void *ctx);
+
+/*
+ * This function is almost equivalent to ybc_item_get_de_async(), except that
+ * it registers the given waiter if YBC_DE_WOULDBLOCK is returned.
+ *
+ * notify_func is called with notify_ctx exactly once for the registered waiter
+ * when the item is added into the cache, when the grace ttl of the pending
+ * item expires or when the cache is closed. After that the waiter may be
+ * reused and the caller should call ybc_item_get_de_notify() again.
+ * notify_func is never called if another status is returned.
+ *
+ * notify_func is called from arbitrary thread, including the thread adding
+ * the item into the cache, so it must be fast. A typical notify_func writes
+ * to an eventfd or a pipe watched by an event loop.
+ *
+ * This function is intended for apps based on event loop, which can't afford
+ * blocking in ybc_item_get_de() or polling ybc_item_get_de_async().
+ *
+ * Waiter's memory must remain valid until notify_func is called or
+ * the waiter is canceled via ybc_de_waiter_cancel().
+ */
+YBC_API enum ybc_de_status ybc_item_get_de_notify(struct ybc *cache,
+    struct ybc_item *item, const struct ybc_key *key, uint64_t grace_ttl,
+    struct ybc_de_waiter *waiter, ybc_de_notify_func notify_func,
+    void *notify_ctx);
+
+/*
+ * Cancels the waiter registered by ybc_item_get_de_notify().
+ *
+ * Returns 1 if the waiter has been canceled, i.e. notify_func won't be called.
+ * Returns 0 if notify_func has been already called or is being called
+ * for the waiter. In this case the waiter may be reused only after
+ * notify_func returns.
+ */
+YBC_API int ybc_de_waiter_cancel(struct ybc *cache,
+    struct ybc_de_waiter *waiter);
+
 /*
  * Releases acquired item.
  *
@@ -775,6 +1315,69 @@ YBC_API void ybc_item_release(struct ybc_item *item);
 YBC_API void ybc_item_get_value(const struct ybc_item *item,
     struct ybc_value *value);
 
+/*
+ * Returns 1 if item's value is resident in RAM. Otherwise returns 0.
+ *
+ * The item must be acquired while calling this function!
+ *
+ * Accessing non-resident value results in synchronous reading from the data
+ * file, which may block the calling thread for a long time if the data file
+ * is much larger than RAM. Applications serving many clients from a few
+ * threads may avoid such stalls in the following way:
+ *
+ * if (ybc_item_get(cache, item, &key)) {
+ *   if (!ybc_item_is_resident(item)) {
+ *     ybc_item_prefetch_value(item);
+ *     // Serve other clients and check the item later.
+ *     defer_item_processing(item);
+ *   } else {
+ *     ybc_item_get_value(item, &value);
+ *     // Access the value without major page faults.
+ *     ...
+ *     ybc_item_release(item);
+ *   }
+ * }
+ *
+ * Residency may change at any time, so the value may be evicted from RAM
+ * right after the function returns 1. This is unlikely for recently
+ * accessed values though.
+ */
+YBC_API int ybc_item_is_resident(const struct ybc_item *item);
+
+/*
+ * Starts asynchronous reading of item's value from the data file into RAM.
+ *
+ * The item must be acquired while calling this function!
+ *
+ * The function returns immediately. Use ybc_item_is_resident() for determining
+ * whether the value has been read.
+ */
+YBC_API void ybc_item_prefetch_value(const struct ybc_item *item);
+
+/*
+ * Returns location of item's value in the data file.
+ *
+ * The item must be acquired while calling this function!
+ *
+ * This allows sending large values to sockets directly from the data file
+ * via sendfile() or splice() without copying them into user-space buffers:
+ *
+ * if (ybc_item_get(cache, item, &key)) {
+ *   ybc_item_get_value_location(item, &location);
+ *   off_t offset = location.offset;
+ *   sendfile(socket_fd, location.fd, &offset, location.size);
+ *   ybc_item_release(item);
+ * }
+ *
+ * The location remains valid only while the item is acquired. The kernel
+ * may read the data file after sendfile() returns, so the item's value
+ * may be overwritten before it is actually sent if the item is released
+ * too early. Release the item only after the data is sent and do not disable
+ * overwrite protection (see ybc_config_disable_overwrite_protection()).
+ */
+YBC_API void ybc_item_get_value_location(const struct ybc_item *item,
+    struct ybc_value_location *location);
+
 
 /*******************************************************************************
  * Cache cluster API.
@@ -106,6 +106,51 @@ static struct go_ret_value go_get_item_and_value(struct ybc *const cache,
   return rv;
 }
 
+/*
+ * The maximum number of keys passed to a single ybc_item_get_multi() call
+ * by go_get_items().
+ */
+#define GO_GET_ITEMS_CHUNK_SIZE 64
+
+/*
+ * Keys are passed in a single buffer with concatenated keys, since Go
+ * mustn't pass Go pointers to memory containing other Go pointers to C.
+ */
+static size_t go_get_items(struct ybc *const cache,
+    struct ybc_item *const items, int *const is_found,
+    struct ybc_value *const values, const char *const keys_buf,
+    const size_t *const key_sizes, const size_t keys_count)
+{
+  struct ybc_key keys[GO_GET_ITEMS_CHUNK_SIZE];
+  const char *key_ptr = keys_buf;
+  size_t found_count = 0;
+
+  for (size_t start = 0; start < keys_count;
+      start += GO_GET_ITEMS_CHUNK_SIZE) {
+    size_t chunk_size = keys_count - start;
+    if (chunk_size > GO_GET_ITEMS_CHUNK_SIZE) {
+      chunk_size = GO_GET_ITEMS_CHUNK_SIZE;
+    }
+
+    for (size_t i = 0; i < chunk_size; ++i) {
+      keys[i].ptr = key_ptr;
+      keys[i].size = key_sizes[start + i];
+      key_ptr += keys[i].size;
+    }
+
+    found_count += ybc_item_get_multi(cache, YBC_ITEM_GET(items, start),
+        &is_found[start], keys, chunk_size);
+  }
+
+  for (size_t i = 0; i < keys_count; ++i) {
+    if (is_found[i]) {
+      ybc_item_get_value(YBC_ITEM_GET(items, i), &values[i]);
+    }
+  }
+
+  return found_count;
+}
+
 struct go_ret_de_value {
   struct ybc_value value;
   enum ybc_de_status status;
@@ -130,6 +175,25 @@ static struct go_ret_de_value go_get_item_and_value_de_async(
   return rv;
 }
 
+static struct go_ret_de_value go_get_item_and_value_de_refresh_async(
+    struct ybc *const cache, struct ybc_item *const item,
+    const void *const key_ptr, const size_t key_size,
+    const uint64_t grace_ttl)
+{
+  struct go_ret_de_value rv;
+  const struct ybc_key key = {
+    .ptr = key_ptr,
+    .size = key_size,
+  };
+
+  rv.status = ybc_item_get_de_refresh_async(cache, item, &key, grace_ttl);
+  if (rv.status == YBC_DE_SUCCESS || rv.status == YBC_DE_REFRESH) {
+    ybc_item_get_value(item, &rv.value);
+  }
+
+  return rv;
+}
+
 static struct go_ret_value go_set_item_and_value(struct ybc *const cache,
     struct ybc_item *const item,
     const void *const key_ptr, const size_t key_size,
@@ -4,6 +4,7 @@ import (
 	"bytes"
 	"fmt"
 	"io"
+	"syscall"
 	"testing"
 	"time"
 )
@@ -83,6 +84,20 @@ func TestConfig_OpenCache_Existing(t *testing.T) {
 	}
 }
 
+func TestConfig_OpenCache_MapCacheFile(t *testing.T) {
+	config := newConfig()
+	config.DataFile = "foobar.data.map_cache_file"
+	config.IndexFile = "foobar.index.map_cache_file"
+	config.MapCacheFile = "foobar.map_cache.map_cache_file"
+	config.HotItemsCount = config.MaxItemsCount / 10
+	expectOpenCacheSuccess(config, true, t)
+	defer config.RemoveCache()
+
+	for i := 1; i < 10; i++ {
+		expectOpenCacheSuccess(config, false, t)
+	}
+}
+
 func TestConfig_OpenCache_EnabledHotItems(t *testing.T) {
 	config := newConfig()
 	config.HotItemsCount = config.MaxItemsCount / 10
@@ -95,12 +110,64 @@ func TestConfig_OpenCache_EnabledHotData(t *testing.T) {
 	expectOpenCacheSuccess(config, true, t)
 }
 
+func TestConfig_OpenCache_AutoSizing(t *testing.T) {
+	config := newConfig()
+	config.HotItemsCount = config.MaxItemsCount / 100
+	config.MaxHotItemsCount = config.MaxItemsCount / 10
+	config.HotDataSize = config.DataFileSize / 100
+	config.MaxHotDataSize = config.DataFileSize / 10
+	cache, err := config.OpenCache(true)
+	if err != nil {
+		t.Fatalf("cannot open cache with auto-sizing: [%s]", err)
+	}
+	defer cache.Close()
+
+	if cache.HotItemsCount() == 0 || cache.HotItemsCount() > config.MaxHotItemsCount {
+		t.Fatalf("unexpected hot items count=%d", cache.HotItemsCount())
+	}
+	if cache.HotDataSize() == 0 || cache.HotDataSize() > config.MaxHotDataSize {
+		t.Fatalf("unexpected hot data size=%d", cache.HotDataSize())
+	}
+}
+
 func TestConfig_OpenCache_DisabledSync(t *testing.T) {
 	config := newConfig()
 	config.SyncInterval = ConfigDisableSync
 	expectOpenCacheSuccess(config, true, t)
 }
 
+func TestConfig_OpenCache_SyncBandwidth(t *testing.T) {
+	config := newConfig()
+	config.SyncBandwidth = 1024 * 1024
+	expectOpenCacheSuccess(config, true, t)
+}
+
+func TestConfig_OpenCache_ClockEviction(t *testing.T) {
+	config := newConfig()
+	config.ClockEviction = true
+	expectOpenCacheSuccess(config, true, t)
+}
+
+func TestConfig_OpenCache_HugePages(t *testing.T) {
+	config := newConfig()
+	config.HugePages = true
+	expectOpenCacheSuccess(config, true, t)
+}
+
+func TestConfig_OpenCache_BackgroundIndexWarmup(t *testing.T) {
+	config := newConfig()
+	config.IndexWarmupThreadsCount = 4
+	config.BackgroundIndexWarmup = true
+	expectOpenCacheSuccess(config, true, t)
+}
+
+func TestConfig_OpenCache_HotDataPrefetch(t *testing.T) {
+	config := newConfig()
+	config.HotDataPrefetch = true
+	config.HotDataPrefetchBandwidth = 1024 * 1024
+	expectOpenCacheSuccess(config, true, t)
+}
+
 func TestConfig_OpenSimpleCache(t *testing.T) {
 	config := newConfig()
 	c, err := config.OpenSimpleCache(true)
@@ -337,6 +404,87 @@ func TestCache_GetItem(t *testing.T) {
 	cacher_GetItem(cache, t)
 }
 
+func cacher_GetItems(cache Cacher, t *testing.T) {
+	defer cache.Close()
+
+	if items := cache.GetItems(nil); len(items) != 0 {
+		t.Fatalf("Unexpected items returned for empty keys: %v", items)
+	}
+
+	keys := make([][]byte, 1000)
+	for i := range keys {
+		keys[i] = []byte(fmt.Sprintf("key_%d", i))
+		if i%2 != 0 {
+			continue
+		}
+		value := []byte(fmt.Sprintf("value_%d", i))
+		if err := cache.Set(keys[i], value, MaxTtl); err != nil {
+			t.Fatal(err)
+		}
+	}
+
+	items := cache.GetItems(keys)
+	if len(items) != len(keys) {
+		t.Fatalf("Unexpected number of items returned: %d. Expected %d", len(items), len(keys))
+	}
+	for i, item := range items {
+		if i%2 != 0 {
+			if item != nil {
+				t.Fatalf("Unexpected item found for key=[%s]", keys[i])
+			}
+			continue
+		}
+		if item == nil {
+			t.Fatalf("Cannot find item for key=[%s]", keys[i])
+		}
+		checkValue(t, []byte(fmt.Sprintf("value_%d", i)), item.Value())
+		item.Close()
+	}
+}
+
+func cacher_Stats(cache Cacher, t *testing.T) {
+	defer cache.Close()
+
+	key := []byte("key")
+	value := []byte("value")
+	if _, err := cache.Get(key); err != ErrCacheMiss {
+		t.Fatalf("Unexpected error: [%v]. Expected ErrCacheMiss", err)
+	}
+	if err := cache.Set(key, value, MaxTtl); err != nil {
+		t.Fatal(err)
+	}
+	for i := 0; i < 10; i++ {
+		v, err := cache.Get(key)
+		if err != nil {
+			t.Fatal(err)
+		}
+		checkValue(t, value, v)
+	}
+
+	stats := cache.Stats()
+	if stats.GetHits != 10 {
+		t.Fatalf("Unexpected GetHits=%d. Expected 10", stats.GetHits)
+	}
+	if stats.GetMisses != 1 {
+		t.Fatalf("Unexpected GetMisses=%d. Expected 1", stats.GetMisses)
+	}
+}
+
+func TestCache_Stats(t *testing.T) {
+	cache := newCache(t)
+	cacher_Stats(cache, t)
+}
+
+func TestCluster_Stats(t *testing.T) {
+	cluster := newCluster(t)
+	cacher_Stats(cluster, t)
+}
+
+func TestCache_GetItems(t *testing.T) {
+	cache := newCache(t)
+	cacher_GetItems(cache, t)
+}
+
 func cacher_GetDeItem(cache Cacher, t *testing.T) {
 	defer cache.Close()
 	for i := 0; i < 1000; i++ {
@@ -373,6 +521,31 @@ func TestCache_GetDeItem(t *testing.T) {
 	cacher_GetDeItem(cache, t)
 }
 
+func TestCache_GetDeRefreshAsyncItem(t *testing.T) {
+	cache := newCache(t)
+	defer cache.Close()
+
+	key := []byte("key")
+	value := []byte("value")
+	if err := cache.Set(key, value, time.Minute); err != nil {
+		t.Fatal(err)
+	}
+
+	// The first caller must be elected for refreshing the item, which is about
+	// to expire, while other callers must receive the item as is.
+	for i := 0; i < 10; i++ {
+		item, isRefresher, err := cache.GetDeRefreshAsyncItem(key, 5*time.Minute)
+		if err != nil {
+			t.Fatal(err)
+		}
+		checkValue(t, value, item.Value())
+		item.Close()
+		if isRefresher != (i == 0) {
+			t.Fatalf("unexpected isRefresher=%v at iteration %d", isRefresher, i)
+		}
+	}
+}
+
 func cacher_NewSetTxn(cache Cacher, t *testing.T) {
 	defer cache.Close()
 	for i := 0; i < 1000; i++ {
@@ -702,6 +875,54 @@ func TestItem_Available(t *testing.T) {
 	}
 }
 
+func TestItem_IsResident(t *testing.T) {
+	cache := newCache(t)
+	defer cache.Close()
+
+	key := []byte("key")
+	value := []byte("value")
+
+	item, err := cache.SetItem(key, value, MaxTtl)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer item.Close()
+
+	item.Prefetch()
+	if !item.IsResident() {
+		t.Fatalf("Just added item must be resident")
+	}
+	checkValue(t, value, item.Value())
+}
+
+func TestItem_ValueLocation(t *testing.T) {
+	cache := newCache(t)
+	defer cache.Close()
+
+	key := []byte("key")
+	value := []byte("value")
+
+	item, err := cache.SetItem(key, value, MaxTtl)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer item.Close()
+
+	fd, offset, size := item.ValueLocation()
+	if size != len(value) {
+		t.Fatalf("unexpected value size=%d. Expected %d", size, len(value))
+	}
+	buf := make([]byte, size)
+	n, err := syscall.Pread(int(fd), buf, offset)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if n != size {
+		t.Fatalf("unexpected number of bytes read=%d. Expected %d", n, size)
+	}
+	checkValue(t, value, buf)
+}
+
 func TestItem_Ttl(t *testing.T) {
 	cache := newCache(t)
 	defer cache.Close()
@@ -1022,6 +1243,11 @@ func TestCluster_GetItem(t *testing.T) {
 	cacher_GetItem(cluster, t)
 }
 
+func TestCluster_GetItems(t *testing.T) {
+	cluster := newCluster(t)
+	cacher_GetItems(cluster, t)
+}
+
 func TestCluster_GetDeItem(t *testing.T) {
 	cluster := newCluster(t)
 	cacher_GetDeItem(cluster, t)
@@ -40,14 +40,26 @@ class Config(object):
     data_file = str(data_file)
     _ybc.ybc_config_set_data_file(self._buf, data_file)
 
+  def set_map_cache_file(self, map_cache_file):
+    map_cache_file = str(map_cache_file)
+    _ybc.ybc_config_set_map_cache_file(self._buf, map_cache_file)
+
   def set_hot_items_count(self, hot_items_count):
     hot_items_count = ctypes.c_size_t(hot_items_count)
     _ybc.ybc_config_set_hot_items_count(self._buf, hot_items_count)
 
+  def set_max_hot_items_count(self, max_hot_items_count):
+    max_hot_items_count = ctypes.c_size_t(max_hot_items_count)
+    _ybc.ybc_config_set_max_hot_items_count(self._buf, max_hot_items_count)
+
   def set_hot_data_size(self, hot_data_size):
     hot_data_size = ctypes.c_size_t(hot_data_size)
     _ybc.ybc_config_set_hot_data_size(self._buf, hot_data_size)
 
+  def set_max_hot_data_size(self, max_hot_data_size):
+    max_hot_data_size = ctypes.c_size_t(max_hot_data_size)
+    _ybc.ybc_config_set_max_hot_data_size(self._buf, max_hot_data_size)
+
   def set_de_hashtable_size(self, de_hashtable_size):
     de_hashtable_size = ctypes.c_size_t(de_hashtable_size)
     _ybc.ybc_config_set_de_hashtable_size(self._buf, de_hashtable_size)
@@ -61,6 +73,51 @@ class Config(object):
     sync_interval = ctypes.c_uint64(sync_interval)
     _ybc.ybc_config_set_sync_interval(self._buf, sync_interval)
 
+  def set_sync_bandwidth(self, sync_bandwidth):
+    """Sets the maximum write-back bandwidth for data syncing.
+
+    Args:
+      sync_bandwidth: bandwidth in bytes per second. 0 means unlimited.
+    """
+    sync_bandwidth = ctypes.c_uint64(sync_bandwidth)
+    _ybc.ybc_config_set_sync_bandwidth(self._buf, sync_bandwidth)
+
+  def set_storage_arenas_count(self, storage_arenas_count):
+    storage_arenas_count = ctypes.c_size_t(storage_arenas_count)
+    _ybc.ybc_config_set_storage_arenas_count(self._buf, storage_arenas_count)
+
+  def set_item_slots_count(self, item_slots_count):
+    item_slots_count = ctypes.c_size_t(item_slots_count)
+    _ybc.ybc_config_set_item_slots_count(self._buf, item_slots_count)
+
+  def enable_clock_eviction(self):
+    _ybc.ybc_config_enable_clock_eviction(self._buf)
+
+  def enable_huge_pages(self):
+    _ybc.ybc_config_enable_huge_pages(self._buf)
+
+  def set_index_warmup_threads_count(self, index_warmup_threads_count):
+    index_warmup_threads_count = ctypes.c_size_t(index_warmup_threads_count)
+    _ybc.ybc_config_set_index_warmup_threads_count(self._buf,
+        index_warmup_threads_count)
+
+  def enable_background_index_warmup(self):
+    _ybc.ybc_config_enable_background_index_warmup(self._buf)
+
+  def enable_hot_data_prefetch(self):
+    _ybc.ybc_config_enable_hot_data_prefetch(self._buf)
+
+  def set_hot_data_prefetch_bandwidth(self, hot_data_prefetch_bandwidth):
+    """Sets the maximum read bandwidth for hot data prefetch.
+
+    Args:
+      hot_data_prefetch_bandwidth: bandwidth in bytes per second.
+          0 means unlimited.
+    """
+    hot_data_prefetch_bandwidth = ctypes.c_uint64(hot_data_prefetch_bandwidth)
+    _ybc.ybc_config_set_hot_data_prefetch_bandwidth(self._buf,
+        hot_data_prefetch_bandwidth)
+
   def open_cache(self, force):
     return _Cache(self._buf, force)
 
@@ -102,6 +159,29 @@ class _Value(ctypes.Structure):
     return v
 
 
+class _Stats(ctypes.Structure):
+  _fields_ = (
+      ("get_hits", ctypes.c_uint64),
+      ("get_misses", ctypes.c_uint64),
+      ("payload_check_failures", ctypes.c_uint64),
+      ("metadata_check_failures", ctypes.c_uint64),
+      ("map_victim_overwrites", ctypes.c_uint64),
+      ("map_cache_hits", ctypes.c_uint64),
+      ("map_cache_misses", ctypes.c_uint64),
+      ("storage_wraps", ctypes.c_uint64),
+      ("defragmentation_moves", ctypes.c_uint64),
+      ("de_waits", ctypes.c_uint64),
+      ("syncs", ctypes.c_uint64),
+      ("sync_bytes", ctypes.c_uint64),
+      ("sync_time_ns", ctypes.c_uint64),
+      ("lock_contentions", ctypes.c_uint64),
+      ("lock_wait_time_ns", ctypes.c_uint64),
+      ("sync_backlog_bytes", ctypes.c_uint64),
+      ("index_warmup_pending_bytes", ctypes.c_uint64),
+      ("hot_data_prefetch_pending_bytes", ctypes.c_uint64),
+  )
+
+
 class _Item(object):
   _BUF_SIZE = _ybc.ybc_item_get_size()
 
@@ -136,6 +216,9 @@ class _SimpleCache(object):
   def remove(self, key):
     return self._cache.remove(key)
 
+  def get_stats(self):
+    return self._cache.get_stats()
+
 
 class _Cache(object):
   _BUF_SIZE = _ybc.ybc_get_size()
@@ -188,6 +271,17 @@ class _Cache(object):
     key = _Key.create(key)
     return (_ybc.ybc_item_remove(self._buf, ctypes.byref(key)) == 1)
 
+  def get_stats(self):
+    """Returns cache statistics.
+
+    Returns:
+      a dict with counter names as keys. See struct ybc_stats in ybc.h
+      for details.
+    """
+    stats = _Stats()
+    _ybc.ybc_get_stats(self._buf, ctypes.byref(stats))
+    return dict((name, getattr(stats, name)) for name, _ in stats._fields_)
+
 
 def f():
   c = Config()
@@ -57,6 +57,8 @@ var (
 	strOkCrLf              = []byte("OK\r\n")
 	strQuit                = []byte("quit")
 	strSet                 = []byte("set ")
+	strStat                = []byte("STAT ")
+	strStats               = []byte("stats")
 	strStored              = []byte("STORED")
 	strStoredCrLf          = []byte("STORED\r\n")
 	strValue               = []byte("VALUE ")
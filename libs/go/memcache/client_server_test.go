@@ -1,6 +1,7 @@
 package memcache
 
 import (
+	"bufio"
 	"bytes"
 	"fmt"
 	"github.com/valyala/ybc/bindings/go/ybc"
@@ -65,6 +66,53 @@ func TestServer_Quit(t *testing.T) {
 	conn.Close()
 }
 
+func TestServer_Stats(t *testing.T) {
+	s, cache := newServerCache(t)
+	defer cache.Close()
+
+	s.Start()
+	defer s.Stop()
+	conn, err := net.Dial("tcp", testAddr)
+	if err != nil {
+		t.Fatalf("Cannot connect to test server at %s: [%s]\n", testAddr, err)
+	}
+	defer conn.Close()
+
+	if _, err = conn.Write([]byte("get foo bar\r\nstats\r\n")); err != nil {
+		t.Fatalf("error when sending 'stats' command to the server: [%s]\n", err)
+	}
+	r := bufio.NewReader(conn)
+	line, err := r.ReadString('\n')
+	if err != nil {
+		t.Fatalf("error when reading 'get' response: [%s]\n", err)
+	}
+	if line != "END\r\n" {
+		t.Fatalf("Unexpected response to 'get' command: [%s]\n", line)
+	}
+
+	stats := make(map[string]string)
+	for {
+		line, err = r.ReadString('\n')
+		if err != nil {
+			t.Fatalf("error when reading 'stats' response: [%s]\n", err)
+		}
+		if line == "END\r\n" {
+			break
+		}
+		var name, value string
+		if _, err = fmt.Sscanf(line, "STAT %s %s\r\n", &name, &value); err != nil {
+			t.Fatalf("Unexpected line in 'stats' response: [%s]: [%s]\n", line, err)
+		}
+		stats[name] = value
+	}
+	if stats["get_misses"] != "2" {
+		t.Fatalf("Unexpected get_misses=[%s]. Expected 2\n", stats["get_misses"])
+	}
+	if stats["get_hits"] != "0" {
+		t.Fatalf("Unexpected get_hits=[%s]. Expected 0\n", stats["get_hits"])
+	}
+}
+
 func TestServer_StartStop(t *testing.T) {
 	s, cache := newServerCache(t)
 	defer cache.Close()
@@ -94,7 +94,42 @@ func writeEndCrLf(w *bufio.Writer) bool {
 	return writeStr(w, strEndCrLf)
 }
 
-func processGetCmd(c *bufio.ReadWriter, cache ybc.Cacher, line []byte, scratchBuf *[]byte, shouldWriteCasid bool) bool {
+// Per-connection buffers for multi-key get requests.
+//
+// They are reused across requests, so multi-key gets don't allocate
+// new buffers on each request.
+type getMultiBuffers struct {
+	// Keys parsed from the request line.
+	keys [][]byte
+
+	// Keys point to the request line stored in the connection's scratchBuf,
+	// so a distinct buffer is used for formatting numbers in order to keep
+	// not yet written keys intact.
+	scratchBuf []byte
+}
+
+func getItemsAndWriteResponse(w *bufio.Writer, cache ybc.Cacher, keys [][]byte, shouldWriteCasid bool, scratchBuf *[]byte) bool {
+	items := cache.GetItems(keys)
+
+	ok := true
+	for i, item := range items {
+		if item == nil {
+			continue
+		}
+		if ok {
+			ok = writeGetResponse(w, keys[i], item, shouldWriteCasid, scratchBuf)
+		}
+		// All the items must be closed even if writing the response failed.
+		item.Close()
+	}
+	return ok
+}
+
+func processGetCmd(c *bufio.ReadWriter, cache ybc.Cacher, line []byte, scratchBuf *[]byte, getMultiBuf *getMultiBuffers, shouldWriteCasid bool) bool {
+	// The first key is kept aside, so the most common single-key case
+	// doesn't touch the keys slice.
+	var firstKey []byte
+	keys := getMultiBuf.keys[:0]
 	last := -1
 	lineSize := len(line)
 	for last < lineSize {
@@ -109,7 +144,28 @@ func processGetCmd(c *bufio.ReadWriter, cache ybc.Cacher, line []byte, scratchBu
 			continue
 		}
 		key := line[first:last]
-		if !getItemAndWriteResponse(c.Writer, cache, key, shouldWriteCasid, scratchBuf) {
+		if firstKey == nil {
+			firstKey = key
+			continue
+		}
+		if len(keys) == 0 {
+			keys = append(keys, firstKey)
+		}
+		keys = append(keys, key)
+	}
+
+	switch {
+	case firstKey == nil:
+	case len(keys) == 0:
+		// Avoid batching overhead for the most common case.
+		if !getItemAndWriteResponse(c.Writer, cache, firstKey, shouldWriteCasid, scratchBuf) {
+			return false
+		}
+	default:
+		// Look up all the keys at once, so memory accesses for distinct keys
+		// overlap.
+		getMultiBuf.keys = keys
+		if !getItemsAndWriteResponse(c.Writer, cache, keys, shouldWriteCasid, &getMultiBuf.scratchBuf) {
 			return false
 		}
 	}
@@ -596,7 +652,36 @@ func processFlushAllCmd(c *bufio.ReadWriter, cache ybc.Cacher, line []byte, flus
 	return writeStr(c.Writer, strOkCrLf)
 }
 
-func processRequest(c *bufio.ReadWriter, cache ybc.Cacher, scratchBuf *[]byte, flushAllTimer **time.Timer) bool {
+func writeStat(w *bufio.Writer, name string, value uint64, scratchBuf *[]byte) bool {
+	return writeStr(w, strStat) && writeStr(w, []byte(name)) && writeWs(w) &&
+		writeUint64(w, value, scratchBuf) && writeCrLf(w)
+}
+
+func processStatsCmd(c *bufio.ReadWriter, cache ybc.Cacher, scratchBuf *[]byte) bool {
+	stats := cache.Stats()
+	w := c.Writer
+	return writeStat(w, "get_hits", stats.GetHits, scratchBuf) &&
+		writeStat(w, "get_misses", stats.GetMisses, scratchBuf) &&
+		writeStat(w, "payload_check_failures", stats.PayloadCheckFailures, scratchBuf) &&
+		writeStat(w, "metadata_check_failures", stats.MetadataCheckFailures, scratchBuf) &&
+		writeStat(w, "map_victim_overwrites", stats.MapVictimOverwrites, scratchBuf) &&
+		writeStat(w, "map_cache_hits", stats.MapCacheHits, scratchBuf) &&
+		writeStat(w, "map_cache_misses", stats.MapCacheMisses, scratchBuf) &&
+		writeStat(w, "storage_wraps", stats.StorageWraps, scratchBuf) &&
+		writeStat(w, "defragmentation_moves", stats.DefragmentationMoves, scratchBuf) &&
+		writeStat(w, "de_waits", stats.DeWaits, scratchBuf) &&
+		writeStat(w, "syncs", stats.Syncs, scratchBuf) &&
+		writeStat(w, "sync_bytes", stats.SyncBytes, scratchBuf) &&
+		writeStat(w, "sync_time_us", uint64(stats.SyncDuration/time.Microsecond), scratchBuf) &&
+		writeStat(w, "lock_contentions", stats.LockContentions, scratchBuf) &&
+		writeStat(w, "lock_wait_time_us", uint64(stats.LockWaitDuration/time.Microsecond), scratchBuf) &&
+		writeStat(w, "sync_backlog_bytes", stats.SyncBacklogBytes, scratchBuf) &&
+		writeStat(w, "index_warmup_pending_bytes", stats.IndexWarmupPendingBytes, scratchBuf) &&
+		writeStat(w, "hot_data_prefetch_pending_bytes", stats.HotDataPrefetchPendingBytes, scratchBuf) &&
+		writeEndCrLf(w)
+}
+
+func processRequest(c *bufio.ReadWriter, cache ybc.Cacher, scratchBuf *[]byte, getMultiBuf *getMultiBuffers, flushAllTimer **time.Timer) bool {
 	if !readLine(c.Reader, scratchBuf) {
 		return false
 	}
@@ -605,10 +690,10 @@ func processRequest(c *bufio.ReadWriter, cache ybc.Cacher, scratchBuf *[]byte, f
 		return false
 	}
 	if bytes.HasPrefix(line, strGet) {
-		return processGetCmd(c, cache, line[len(strGet):], scratchBuf, false)
+		return processGetCmd(c, cache, line[len(strGet):], scratchBuf, getMultiBuf, false)
 	}
 	if bytes.HasPrefix(line, strGets) {
-		return processGetCmd(c, cache, line[len(strGets):], scratchBuf, true)
+		return processGetCmd(c, cache, line[len(strGets):], scratchBuf, getMultiBuf, true)
 	}
 	if bytes.HasPrefix(line, strGetDe) {
 		return processGetDeCmd(c, cache, line[len(strGetDe):], scratchBuf)
@@ -634,6 +719,9 @@ func processRequest(c *bufio.ReadWriter, cache ybc.Cacher, scratchBuf *[]byte, f
 	if bytes.HasPrefix(line, strFlushAll) {
 		return processFlushAllCmd(c, cache, line[len(strFlushAll):], flushAllTimer)
 	}
+	if bytes.Equal(line, strStats) {
+		return processStatsCmd(c, cache, scratchBuf)
+	}
 	if bytes.HasPrefix(line, strQuit) {
 		return false
 	}
@@ -653,8 +741,11 @@ func handleConn(conn net.Conn, cache ybc.Cacher, readBufferSize, writeBufferSize
 	defer flushAllTimer.Stop()
 
 	scratchBuf := make([]byte, 0, 1024)
+	getMultiBuf := getMultiBuffers{
+		scratchBuf: make([]byte, 0, 32),
+	}
 	for {
-		if !processRequest(c, cache, &scratchBuf, &flushAllTimer) {
+		if !processRequest(c, cache, &scratchBuf, &getMultiBuf, &flushAllTimer) {
 			break
 		}
 		if r.Buffered() == 0 {
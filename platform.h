@@ -64,9 +64,12 @@ static void p_strdup(char **dst, const char *src);
 static uint64_t p_get_current_time(void);
 
 /*
- * Suspends the current thread for the given number of milliseconds.
+ * Returns monotonic time in nanoseconds since an arbitrary point in the past.
+ *
+ * Use it for measuring durations. Unlike p_get_current_time(), the returned
+ * time never jumps backwards.
  */
-static void p_sleep(uint64_t milliseconds);
+static uint64_t p_get_monotonic_time_ns(void);
 
 /*
  * Prototype for a function, which can be executed in a thread.
@@ -91,6 +94,124 @@ static void p_thread_init_and_start(struct p_thread *t, p_thread_func func,
  */
 static void p_thread_join_and_destroy(struct p_thread *t);
 
+/*
+ * Yields CPU to other threads.
+ */
+static void p_thread_yield(void);
+
+/*
+ * Returns 1 if the CPU supports AVX2 instructions, otherwise returns 0.
+ */
+static int p_cpu_has_avx2(void);
+
+/*
+ * Returns 1 if the CPU supports SSE4.1 instructions, otherwise returns 0.
+ */
+static int p_cpu_has_sse41(void);
+
+/*
+ * Returns a small index of the current thread.
+ *
+ * The index is assigned on the first call in each thread. Indexes are assigned
+ * sequentially starting from 0, so concurrently running threads usually
+ * obtain distinct small indexes. Indexes of exited threads aren't reused.
+ */
+static size_t p_thread_get_self_index(void);
+
+/*
+ * Returns a pseudo-random 64-bit value.
+ *
+ * Generator state is kept per thread, so concurrently running threads
+ * don't contend for a lock or a shared cache line. The returned values
+ * mustn't be used for cryptographic purposes.
+ */
+static uint64_t p_rand(void);
+
+/*
+ * Atomically loads the value from *ptr with acquire semantics.
+ */
+static size_t p_atomic_load(const size_t *ptr);
+
+/*
+ * Atomically stores v to *ptr with release semantics.
+ */
+static void p_atomic_store(size_t *ptr, size_t v);
+
+/*
+ * Atomically replaces *ptr by desired if *ptr is equal to expected.
+ *
+ * Acts as a full memory barrier.
+ *
+ * Returns 1 if *ptr has been replaced, otherwise returns 0.
+ */
+static int p_atomic_cas(size_t *ptr, size_t expected, size_t desired);
+
+/*
+ * Atomically adds v to *ptr.
+ *
+ * Acts as a full memory barrier.
+ *
+ * Returns the new value of *ptr.
+ */
+static size_t p_atomic_add(size_t *ptr, size_t v);
+
+/*
+ * Atomically adds v to the 64-bit counter at *ptr.
+ *
+ * Doesn't order other memory accesses, so it is suitable only
+ * for statistics counters.
+ */
+static void p_atomic_counter_add(uint64_t *ptr, uint64_t v);
+
+/*
+ * Atomically loads the 64-bit counter from *ptr.
+ *
+ * Doesn't order other memory accesses. See p_atomic_counter_add().
+ */
+static uint64_t p_atomic_counter_load(const uint64_t *ptr);
+
+/*
+ * Atomically replaces the 64-bit counter at *ptr by desired if it is equal
+ * to expected.
+ *
+ * Doesn't order other memory accesses. See p_atomic_counter_add().
+ *
+ * Returns 1 if *ptr has been replaced, otherwise returns 0.
+ */
+static int p_atomic_counter_cas(uint64_t *ptr, uint64_t expected,
+    uint64_t desired);
+
+/*
+ * Full memory barrier.
+ *
+ * Neither loads nor stores can be reordered across the barrier.
+ */
+static void p_memory_barrier(void);
+
+/*
+ * Acquire memory barrier.
+ *
+ * Loads before the barrier cannot be reordered with loads and stores
+ * after the barrier.
+ */
+static void p_memory_acquire_barrier(void);
+
+/*
+ * Release memory barrier.
+ *
+ * Loads and stores before the barrier cannot be reordered with stores
+ * after the barrier.
+ */
+static void p_memory_release_barrier(void);
+
+/*
+ * Hints the CPU to load the cache line containing the given address.
+ *
+ * This is just a hint - the ptr may point to arbitrary memory,
+ * which isn't dereferenced.
+ */
+static void p_memory_prefetch(const void *ptr);
+
 /*
  * Lock structure. Each platform may define arbitrary contents
  * for this structure.
@@ -112,6 +233,13 @@ static void p_lock_destroy(struct p_lock *lock);
  */
 static void p_lock_lock(struct p_lock *lock);
 
+/*
+ * Tries locking the given lock without blocking.
+ *
+ * Returns 1 if the lock has been acquired, otherwise returns 0.
+ */
+static int p_lock_trylock(struct p_lock *lock);
+
 /*
  * Unlocks the given lock.
  */
@@ -149,6 +277,30 @@ static void p_event_set(struct p_event *e);
  */
 static int p_event_wait_with_timeout(struct p_event *e, uint64_t timeout);
 
+/*
+ * Returns the current value of the given wait word.
+ *
+ * Acts as an acquire memory barrier.
+ */
+static uint32_t p_wait_word_get(const uint32_t *ptr);
+
+/*
+ * Suspends the current thread while the wait word contains the given value,
+ * but no longer than timeout milliseconds. UINT64_MAX timeout means
+ * no timeout.
+ *
+ * Spurious wakeups are possible, so callers must re-check their condition.
+ */
+static void p_wait_word_wait(uint32_t *ptr, uint32_t value, uint64_t timeout);
+
+/*
+ * Changes the value of the given wait word and wakes up all the threads
+ * blocked on it in p_wait_word_wait().
+ *
+ * Acts as a full memory barrier.
+ */
+static void p_wait_word_wake_all(uint32_t *ptr);
+
 /*
  * File structure. Each platform may define arbitrary contents
  * for this structure.
@@ -207,9 +359,33 @@ static void p_file_resize_and_preallocate(const struct p_file *file,
 static void p_file_advise_random_access(const struct p_file *file, size_t size);
 
 /*
- * Tries caching the given file contents in RAM.
+ * Tries caching the given file contents in the range [offset ... offset+size)
+ * in RAM. Returns after the contents is read.
+ *
+ * The function may be called concurrently for distinct ranges
+ * of the same file.
+ */
+static void p_file_cache_in_ram(const struct p_file *file, size_t offset,
+    size_t size);
+
+/*
+ * Writes back dirty pages of the given file in the range
+ * [offset ... offset+size) and waits until the write-out completes.
+ *
+ * Works for pages dirtied via memory mappings of the file. Doesn't flush
+ * file metadata and disk write caches, so it doesn't guarantee durability -
+ * use p_memory_sync() for this.
+ */
+static void p_file_writeback(const struct p_file *file, size_t offset,
+    size_t size);
+
+/*
+ * Returns OS-level descriptor for the given file.
+ *
+ * The descriptor is owned by the file, so it mustn't be closed
+ * by the caller. It remains valid until the file is closed.
  */
-static void p_file_cache_in_ram(const struct p_file *file);
+static int p_file_get_descriptor(const struct p_file *file);
 
 /*
  * Initializes memory API.
@@ -240,6 +416,71 @@ static void p_memory_unmap(void *ptr, size_t size);
  */
 static void p_memory_sync(void *ptr, size_t size);
 
+/*
+ * Returns 1 if all the memory pages in the range [ptr ... ptr+size)
+ * are resident in RAM, i.e. accessing them won't result in major page faults.
+ * Otherwise returns 0.
+ *
+ * The result may become stale immediately after the call, since the OS
+ * is free to evict pages at any time.
+ */
+static int p_memory_is_resident(const void *ptr, size_t size);
+
+/*
+ * Asynchronously reads memory pages in the range [ptr ... ptr+size)
+ * from backing storage into RAM.
+ *
+ * The function doesn't wait until the pages are read.
+ */
+static void p_memory_advise_willneed(const void *ptr, size_t size);
+
+/*
+ * Allocates zeroed memory of the given size, preferably backed by huge pages.
+ * Always returns non-NULL.
+ *
+ * Huge pages reduce TLB misses during random access to large memory regions.
+ * Falls back to regular pages if huge pages are unavailable.
+ *
+ * Allocated memory must be freed with p_memory_free_huge().
+ */
+static void *p_memory_alloc_huge(size_t size);
+
+/*
+ * Frees memory allocated with p_memory_alloc_huge().
+ *
+ * size must match the size passed to p_memory_alloc_huge().
+ */
+static void p_memory_free_huge(void *ptr, size_t size);
+
+/*
+ * Hints the OS about backing the given memory region with huge pages.
+ *
+ * This is just a hint - it is silently ignored if the OS doesn't support
+ * huge pages for the given memory region.
+ */
+static void p_memory_advise_huge_pages(void *ptr, size_t size);
+
+/*
+ * Allocates zeroed memory of the given size. Always returns non-NULL.
+ *
+ * Unlike p_malloc(), physical memory is attached to the allocated region
+ * lazily on the first access, so untouched parts of the region don't occupy
+ * RAM.
+ *
+ * Allocated memory must be freed with p_memory_unmap().
+ */
+static void *p_memory_alloc_anonymous(size_t size);
+
+/*
+ * Returns physical memory backing whole pages inside the memory region
+ * [ptr ... ptr+size) allocated via p_memory_alloc_anonymous()
+ * or p_memory_alloc_huge() to the OS if possible.
+ *
+ * Returned pages read back as zeroes. Contents of other pages in the region
+ * are left intact, so the caller mustn't rely on the region being zeroed.
+ */
+static void p_memory_discard(void *ptr, size_t size);
+
 
 #ifdef YBC_PLATFORM_LINUX
   #include "platform/linux.c"
@@ -19,19 +19,23 @@
 #include <assert.h>     /* assert */
 #include <errno.h>      /* errno */
 #include <error.h>      /* error */
-#include <fcntl.h>      /* open, posix_fadvise, fcntl */
+#include <fcntl.h>      /* open, posix_fadvise, fcntl, sync_file_range */
+#include <limits.h>     /* INT_MAX */
+#include <linux/futex.h>  /* FUTEX_* */
 #include <pthread.h>    /* pthread_* */
+#include <sched.h>      /* sched_yield */
 #include <stddef.h>     /* size_t */
 #include <stdint.h>     /* uint*_t */
 #include <stdio.h>      /* tmpfile, fileno, fclose */
 #include <stdlib.h>     /* malloc, free, EXIT_FAILURE */
-#include <string.h>     /* strdup */
-#include <sys/mman.h>   /* mmap, munmap, msync */
+#include <string.h>     /* strdup, memset */
+#include <sys/mman.h>   /* mmap, munmap, msync, mincore, madvise */
 #include <sys/stat.h>   /* open, fstat */
+#include <sys/syscall.h>  /* SYS_futex */
 #include <sys/types.h>  /* pthread_*_t, open, stat, lseek */
-#include <time.h>       /* clock_gettime, timespec, nanosleep */
+#include <time.h>       /* clock_gettime, timespec */
 #include <unistd.h>     /* close, fstat, access, unlink, dup, fcntl, sysconf, read,
-                         * lseek, read, write
+                         * lseek, read, write, pread, syscall
                          */
 
 #ifndef O_CLOEXEC
@@ -109,25 +113,15 @@ static uint64_t p_get_current_time(void)
   return ((uint64_t)t.tv_sec) * 1000 + t.tv_nsec / (1000 * 1000);
 }
 
-static void p_sleep(const uint64_t milliseconds)
+static uint64_t p_get_monotonic_time_ns(void)
 {
-  struct timespec req = {
-      .tv_sec = milliseconds / 1000,
-      .tv_nsec = (milliseconds % 1000) * 1000 * 1000,
-  };
-  struct timespec rem;
-
-  for (;;) {
-    if (nanosleep(&req, &rem) != -1) {
-      return;
-    }
+  struct timespec t;
 
-    if (errno != EINTR) {
-      error(EXIT_FAILURE, errno, "nanosleep(milliseconds=%d)", (int)milliseconds);
-    }
+  const int rv = clock_gettime(CLOCK_MONOTONIC, &t);
+  assert(rv == 0);
+  (void)rv;
 
-    req = rem;
-  }
+  return ((uint64_t)t.tv_sec) * 1000 * 1000 * 1000 + t.tv_nsec;
 }
 
 struct p_thread
@@ -165,6 +159,141 @@ static void p_thread_join_and_destroy(struct p_thread *const t)
   (void)rv;
 }
 
+static void p_thread_yield(void)
+{
+  const int rv = sched_yield();
+  assert(rv == 0);
+  (void)rv;
+}
+
+static int m_cpu_has_avx2 = -1;
+static int m_cpu_has_sse41 = -1;
+
+static void m_cpu_init_features(void)
+{
+  /*
+   * Race condition is possible here, but it is harmless, since all
+   * the threads obtain the same values.
+   */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  m_cpu_has_sse41 = __builtin_cpu_supports("sse4.1") ? 1 : 0;
+  m_cpu_has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+  m_cpu_has_sse41 = 0;
+  m_cpu_has_avx2 = 0;
+#endif
+}
+
+static int p_cpu_has_avx2(void)
+{
+  if (m_cpu_has_avx2 == -1) {
+    m_cpu_init_features();
+  }
+  return m_cpu_has_avx2;
+}
+
+static int p_cpu_has_sse41(void)
+{
+  if (m_cpu_has_sse41 == -1) {
+    m_cpu_init_features();
+  }
+  return m_cpu_has_sse41;
+}
+
+static size_t m_thread_next_index = 0;
+
+static __thread size_t m_thread_self_index = SIZE_MAX;
+
+static size_t p_thread_get_self_index(void)
+{
+  if (m_thread_self_index == SIZE_MAX) {
+    m_thread_self_index = __atomic_fetch_add(&m_thread_next_index, 1,
+        __ATOMIC_RELAXED);
+  }
+  return m_thread_self_index;
+}
+
+static __thread uint64_t m_rand_state;
+static __thread int m_rand_is_seeded = 0;
+
+static uint64_t p_rand(void)
+{
+  if (!m_rand_is_seeded) {
+    m_rand_state = p_get_monotonic_time_ns() ^
+        ((uint64_t)p_thread_get_self_index() << 48);
+    m_rand_is_seeded = 1;
+  }
+
+  /*
+   * SplitMix64 ( http://xorshift.di.unimi.it/splitmix64.c ).
+   */
+  m_rand_state += 0x9e3779b97f4a7c15;
+  uint64_t z = m_rand_state;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+static size_t p_atomic_load(const size_t *const ptr)
+{
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static void p_atomic_store(size_t *const ptr, const size_t v)
+{
+  __atomic_store_n(ptr, v, __ATOMIC_RELEASE);
+}
+
+static int p_atomic_cas(size_t *const ptr, size_t expected,
+    const size_t desired)
+{
+  return __atomic_compare_exchange_n(ptr, &expected, desired, 0,
+      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static size_t p_atomic_add(size_t *const ptr, const size_t v)
+{
+  return __atomic_add_fetch(ptr, v, __ATOMIC_SEQ_CST);
+}
+
+static void p_atomic_counter_add(uint64_t *const ptr, const uint64_t v)
+{
+  (void)__atomic_add_fetch(ptr, v, __ATOMIC_RELAXED);
+}
+
+static uint64_t p_atomic_counter_load(const uint64_t *const ptr)
+{
+  return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+static int p_atomic_counter_cas(uint64_t *const ptr, uint64_t expected,
+    const uint64_t desired)
+{
+  return __atomic_compare_exchange_n(ptr, &expected, desired, 0,
+      __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+static void p_memory_barrier(void)
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void p_memory_acquire_barrier(void)
+{
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+static void p_memory_release_barrier(void)
+{
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void p_memory_prefetch(const void *const ptr)
+{
+  __builtin_prefetch(ptr, 0, 3);
+}
+
 struct p_lock
 {
   pthread_mutex_t mutex;
@@ -212,6 +341,13 @@ static void p_lock_lock(struct p_lock *const lock)
   (void)rv;
 }
 
+static int p_lock_trylock(struct p_lock *const lock)
+{
+  const int rv = pthread_mutex_trylock(&lock->mutex);
+  assert(rv == 0 || rv == EBUSY);
+  return rv == 0;
+}
+
 static void p_lock_unlock(struct p_lock *const lock)
 {
   const int rv = pthread_mutex_unlock(&lock->mutex);
@@ -302,6 +438,42 @@ static int p_event_wait_with_timeout(struct p_event *const e,
   return is_set;
 }
 
+static uint32_t p_wait_word_get(const uint32_t *const ptr)
+{
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static void p_wait_word_wait(uint32_t *const ptr, const uint32_t value,
+    const uint64_t timeout)
+{
+  const struct timespec t = {
+      .tv_sec = timeout / 1000,
+      .tv_nsec = (timeout % 1000) * 1000 * 1000,
+  };
+
+  /*
+   * The futex returns immediately with EAGAIN if *ptr doesn't contain
+   * the value anymore, so wakeups between p_wait_word_get()
+   * and p_wait_word_wait() aren't lost.
+   */
+  const long rv = syscall(SYS_futex, ptr, FUTEX_WAIT_PRIVATE, value,
+      (timeout == UINT64_MAX) ? NULL : &t, NULL, 0);
+  if (rv == -1 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
+    error(EXIT_FAILURE, errno, "futex(wait)");
+  }
+}
+
+static void p_wait_word_wake_all(uint32_t *const ptr)
+{
+  (void)__atomic_add_fetch(ptr, 1, __ATOMIC_SEQ_CST);
+
+  const long rv = syscall(SYS_futex, ptr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL,
+      NULL, 0);
+  if (rv == -1) {
+    error(EXIT_FAILURE, errno, "futex(wake)");
+  }
+}
+
 struct p_file
 {
   int fd;
@@ -461,13 +633,15 @@ static void p_file_resize_and_preallocate(const struct p_file *const file,
    * Do not use posix_fallocate(), since it cheats and doesn't really
    * allocate pyhsical space on the storage.
    *
-   * Just fill the file with garbage.
+   * Fill the file with zeroes, since newly extended index files must read
+   * back as zeroes, i.e. as empty map slots.
    */
 
   m_file_seek_zero(file);
 
   const size_t buf_size = 1024 * 1024;
   char *const buf = p_malloc(buf_size);
+  memset(buf, 0, buf_size);
 
   size_t remain = size;
   while (remain) {
@@ -498,32 +672,58 @@ static void p_file_advise_random_access(const struct p_file *const file,
   }
 }
 
-static void p_file_cache_in_ram(const struct p_file *const file)
+static void p_file_cache_in_ram(const struct p_file *const file,
+    size_t offset, size_t size)
 {
   /*
    * Do not use readahead(), since it returns immediately instead of waiting
    * until the file is read into RAM.
+   *
+   * Use pread() instead of read(), since it doesn't touch the file position
+   * shared among concurrent callers.
    */
 
-  m_file_seek_zero(file);
-
   const size_t buf_size = 1024 * 1024;
   char *const buf = p_malloc(buf_size);
 
-  for (;;) {
-    const ssize_t rv = read(file->fd, buf, buf_size);
-    if (rv == -1 && errno != EINTR) {
-      error(EXIT_FAILURE, rv, "read(fd=%d, size=%zu)", file->fd, sizeof(buf));
+  while (size > 0) {
+    const size_t n = size < buf_size ? size : buf_size;
+    const ssize_t rv = pread(file->fd, buf, n, offset);
+    if (rv == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error(EXIT_FAILURE, errno, "pread(fd=%d, size=%zu, offset=%zu)",
+          file->fd, n, offset);
     }
     if (rv == 0) {
       /* end of file */
       break;
     }
+    offset += (size_t)rv;
+    size -= (size_t)rv;
   }
 
   p_free(buf);
+}
 
-  m_file_seek_zero(file);
+static void p_file_writeback(const struct p_file *const file,
+    const size_t offset, const size_t size)
+{
+  const unsigned int flags = SYNC_FILE_RANGE_WAIT_BEFORE |
+      SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER;
+
+  while (sync_file_range(file->fd, offset, size, flags) == -1) {
+    if (errno != EINTR) {
+      error(EXIT_FAILURE, errno, "sync_file_range(fd=%d, offset=%zu, "
+          "size=%zu)", file->fd, offset, size);
+    }
+  }
+}
+
+static int p_file_get_descriptor(const struct p_file *const file)
+{
+  return file->fd;
 }
 
 /*
@@ -597,3 +797,148 @@ static void p_memory_sync(void *const ptr, const size_t size)
         adjusted_ptr, adjusted_size);
   }
 }
+
+static int p_memory_is_resident(const void *const ptr, const size_t size)
+{
+  assert(m_memory_page_mask != 0);
+
+  const size_t page_size = m_memory_page_mask + 1;
+  const size_t delta = ((uintptr_t)ptr) & m_memory_page_mask;
+  const char *const adjusted_ptr = ((const char *)ptr) - delta;
+  const size_t pages_count = (size + delta + m_memory_page_mask) / page_size;
+
+  /*
+   * Check residency in small batches, so large memory ranges don't require
+   * large buffers, and non-resident pages are detected early.
+   */
+  unsigned char vec[64];
+  const size_t batch_size = sizeof(vec) / sizeof(vec[0]);
+
+  for (size_t i = 0; i < pages_count; i += batch_size) {
+    const size_t n = (pages_count - i < batch_size) ? (pages_count - i) :
+        batch_size;
+    void *const batch_ptr = (void *)(adjusted_ptr + i * page_size);
+
+    if (mincore(batch_ptr, n * page_size, vec) == -1) {
+      error(EXIT_FAILURE, errno, "mincore(ptr=%p, size=%zu)", batch_ptr,
+          n * page_size);
+    }
+    for (size_t j = 0; j < n; ++j) {
+      if (!(vec[j] & 1)) {
+        return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
+static void p_memory_advise_willneed(const void *const ptr, const size_t size)
+{
+  assert(m_memory_page_mask != 0);
+
+  /*
+   * Adjust ptr to the nearest floor page boundary, because madvise()
+   * accepts only pointers to page boundaries.
+   */
+  const size_t delta = ((uintptr_t)ptr) & m_memory_page_mask;
+  void *const adjusted_ptr = (void *)(((const char *)ptr) - delta);
+  const size_t adjusted_size = size + delta;
+
+  if (madvise(adjusted_ptr, adjusted_size, MADV_WILLNEED) == -1) {
+    error(EXIT_FAILURE, errno, "madvise(ptr=%p, size=%zu, willneed)",
+        adjusted_ptr, adjusted_size);
+  }
+}
+
+/*
+ * The size of huge pages used by p_memory_alloc_huge().
+ */
+#define M_MEMORY_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+static size_t m_memory_get_huge_size(const size_t size)
+{
+  assert(size <= SIZE_MAX - M_MEMORY_HUGE_PAGE_SIZE);
+  return (size + M_MEMORY_HUGE_PAGE_SIZE - 1) & ~(M_MEMORY_HUGE_PAGE_SIZE - 1);
+}
+
+static void *p_memory_alloc_huge(const size_t size)
+{
+  const size_t huge_size = m_memory_get_huge_size(size);
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void *ptr;
+
+  /*
+   * Try explicitly reserved huge pages first. This fails if the huge page
+   * pool is empty, which is the default.
+   */
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+  ptr = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+      flags | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+  if (ptr != MAP_FAILED) {
+    return ptr;
+  }
+#endif
+
+  /*
+   * Fall back to transparent huge pages.
+   */
+  ptr = mmap(NULL, huge_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (ptr == MAP_FAILED) {
+    error(EXIT_FAILURE, errno, "mmap(size=%zu, anonymous)", huge_size);
+  }
+  p_memory_advise_huge_pages(ptr, huge_size);
+
+  return ptr;
+}
+
+static void p_memory_free_huge(void *const ptr, const size_t size)
+{
+  p_memory_unmap(ptr, m_memory_get_huge_size(size));
+}
+
+static void p_memory_advise_huge_pages(void *const ptr, const size_t size)
+{
+#ifdef MADV_HUGEPAGE
+  /*
+   * Ignore errors, since transparent huge pages may be disabled
+   * or unsupported for the given mapping.
+   */
+  (void)madvise(ptr, size, MADV_HUGEPAGE);
+#else
+  (void)ptr;
+  (void)size;
+#endif
+}
+
+static void *p_memory_alloc_anonymous(const size_t size)
+{
+  void *const ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    error(EXIT_FAILURE, errno, "mmap(size=%zu, anonymous)", size);
+  }
+  return ptr;
+}
+
+static void p_memory_discard(void *const ptr, const size_t size)
+{
+  assert(m_memory_page_mask != 0);
+  assert((uintptr_t)ptr <= UINTPTR_MAX - size);
+
+  const uintptr_t start = ((uintptr_t)ptr + m_memory_page_mask) &
+      ~(uintptr_t)m_memory_page_mask;
+  const uintptr_t end = ((uintptr_t)ptr + size) &
+      ~(uintptr_t)m_memory_page_mask;
+  if (start >= end) {
+    return;
+  }
+
+  /*
+   * MADV_DONTNEED zeroes private anonymous mappings. Ignore errors, since
+   * it may fail for huge pages on older kernels. Do not fall back to explicit
+   * zeroing, since it would attach physical memory to the whole region
+   * instead of returning it to the OS.
+   */
+  (void)madvise((void *)start, end - start, MADV_DONTNEED);
+}
@@ -9,12 +9,33 @@
 #undef NDEBUG
 
 #include <assert.h>
+#include <errno.h>   /* errno, EINTR */
 #include <stdio.h>   /* printf, fopen, fclose, fwrite */
 #include <stdlib.h>  /* free, rand */
 #include <string.h>  /* memcmp, memcpy, memset */
+#include <time.h>    /* nanosleep, timespec */
 
 #define M_ERROR(error_message)  assert(0 && (error_message))
 
+/*
+ * Suspends the current thread for the given number of milliseconds.
+ */
+static void m_sleep(const uint64_t milliseconds)
+{
+  struct timespec req = {
+      .tv_sec = milliseconds / 1000,
+      .tv_nsec = (milliseconds % 1000) * 1000 * 1000,
+  };
+  struct timespec rem;
+
+  while (nanosleep(&req, &rem) == -1) {
+    if (errno != EINTR) {
+      M_ERROR("nanosleep() failed");
+    }
+    req = rem;
+  }
+}
+
 static void test_anonymous_cache_create(struct ybc *const cache)
 {
   /* Non-forced open must fail. */
@@ -367,7 +388,7 @@ static void test_expiration(struct ybc *const cache)
   };
   expect_item_set(cache, &key, &value);
 
-  p_sleep(300);
+  m_sleep(300);
 
   /* The item should expire now. */
   expect_item_miss(cache, &key);
@@ -419,6 +440,67 @@ static void test_dogpile_effect_ops(struct ybc *const cache)
   ybc_close(cache);
 }
 
+static void test_dogpile_effect_refresh(struct ybc *const cache)
+{
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+
+  m_open_anonymous(cache);
+
+  struct ybc_key key = {
+      .ptr = "foo",
+      .size = 3,
+  };
+  const struct ybc_value value = {
+      .ptr = "bar",
+      .size = 3,
+      .ttl = 60 * 1000,
+  };
+
+  /* Missing item must be registered as pending. */
+  if (ybc_item_get_de_refresh_async(cache, item, &key, 200) !=
+      YBC_DE_NOTFOUND) {
+    M_ERROR("unexpected status for missing item");
+  }
+  if (ybc_item_get_de_refresh_async(cache, item, &key, 200) !=
+      YBC_DE_WOULDBLOCK) {
+    M_ERROR("pending item must block");
+  }
+
+  key.ptr = "bar";
+  expect_item_set(cache, &key, &value);
+
+  /* Fresh item must be returned to all the callers. */
+  if (ybc_item_get_de_refresh(cache, item, &key, value.ttl / 10) !=
+      YBC_DE_SUCCESS) {
+    M_ERROR("cannot obtain fresh item");
+  }
+  expect_value(item, &value);
+  ybc_item_release(item);
+
+  /*
+   * The item, which is about to expire, must be returned to all the callers,
+   * while only the first caller must be elected for refreshing it.
+   */
+  if (ybc_item_get_de_refresh(cache, item, &key, value.ttl * 5) !=
+      YBC_DE_REFRESH) {
+    M_ERROR("the first caller must refresh the item");
+  }
+  expect_value(item, &value);
+  ybc_item_release(item);
+
+  for (size_t i = 0; i < 10; ++i) {
+    if (ybc_item_get_de_refresh_async(cache, item, &key, value.ttl * 5) !=
+        YBC_DE_SUCCESS) {
+      M_ERROR("stale item must be returned to other callers");
+    }
+    expect_value(item, &value);
+    ybc_item_release(item);
+  }
+
+  ybc_close(cache);
+}
+
 static void test_dogpile_effect_ops_async(struct ybc *const cache)
 {
   char item_buf[ybc_item_get_size()];
@@ -485,6 +567,81 @@ static void test_dogpile_effect_ops_async(struct ybc *const cache)
   ybc_close(cache);
 }
 
+static void test_dogpile_effect_refresh_full_hashtable(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+
+  ybc_config_init(config);
+
+  /*
+   * A tiny hashtable is filled up by the first pending item, so the rest
+   * of pending items don't fit it.
+   */
+  ybc_config_set_de_hashtable_size(config, 1);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create an anonymous cache");
+  }
+
+  ybc_config_destroy(config);
+
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+
+  const size_t items_count = 100;
+  size_t i;
+  struct ybc_key key = {
+      .ptr = &i,
+      .size = sizeof(i),
+  };
+  const struct ybc_value value = {
+      .ptr = "bar",
+      .size = 3,
+      .ttl = 60 * 1000,
+  };
+
+  for (i = 0; i < items_count; ++i) {
+    expect_item_set(cache, &key, &value);
+  }
+
+  /*
+   * Exactly one caller must be elected for refreshing each item, which is
+   * about to expire, even if the hashtable is full.
+   */
+  for (i = 0; i < items_count; ++i) {
+    if (ybc_item_get_de_refresh_async(cache, item, &key, value.ttl * 5) !=
+        YBC_DE_REFRESH) {
+      M_ERROR("the first caller must refresh the item");
+    }
+    expect_value(item, &value);
+    ybc_item_release(item);
+
+    for (size_t j = 0; j < 3; ++j) {
+      if (ybc_item_get_de_refresh_async(cache, item, &key, value.ttl * 5) !=
+          YBC_DE_SUCCESS) {
+        M_ERROR("stale item must be returned to other callers");
+      }
+      expect_value(item, &value);
+      ybc_item_release(item);
+    }
+  }
+
+  /* Missing items must be protected from dogpile effect as well. */
+  for (i = items_count; i < 2 * items_count; ++i) {
+    if (ybc_item_get_de_refresh_async(cache, item, &key, 1000) !=
+        YBC_DE_NOTFOUND) {
+      M_ERROR("unexpected status for missing item");
+    }
+    if (ybc_item_get_de_refresh_async(cache, item, &key, 1000) !=
+        YBC_DE_WOULDBLOCK) {
+      M_ERROR("pending item must block");
+    }
+  }
+
+  ybc_close(cache);
+}
+
 static void m_test_de_hashtable(struct ybc *const cache,
     const size_t hashtable_size, const size_t pending_items_count)
 {
@@ -534,6 +691,156 @@ static void test_dogpile_effect_hashtable(struct ybc *const cache)
   }
 }
 
+struct de_setter_task
+{
+  struct ybc *cache;
+  const struct ybc_key *key;
+  const struct ybc_value *value;
+};
+
+static void de_setter_thread_func(void *const ctx)
+{
+  const struct de_setter_task *const task = ctx;
+
+  m_sleep(50);
+  expect_item_set(task->cache, task->key, task->value);
+}
+
+static void test_dogpile_effect_wakeup(struct ybc *const cache)
+{
+  m_open_anonymous(cache);
+
+  const struct ybc_key key = {
+      .ptr = "foo",
+      .size = 3,
+  };
+  const struct ybc_value value = {
+      .ptr = "bar",
+      .size = 3,
+      .ttl = YBC_MAX_TTL,
+  };
+  const uint64_t grace_ttl = 10 * 1000;
+
+  /* The first miss registers the pending item. */
+  expect_item_miss_de(cache, &key, grace_ttl);
+
+  /*
+   * Subsequent requests must be resumed as soon as the item is added,
+   * not after grace ttl expiration.
+   */
+  struct de_setter_task task = {
+      .cache = cache,
+      .key = &key,
+      .value = &value,
+  };
+  struct p_thread setter;
+  p_thread_init_and_start(&setter, de_setter_thread_func, &task);
+
+  const uint64_t start_time = p_get_current_time();
+  expect_item_hit_de(cache, &key, &value, grace_ttl);
+  if (p_get_current_time() - start_time >= grace_ttl / 2) {
+    M_ERROR("dogpile effect waiter hasn't been woken up");
+  }
+
+  p_thread_join_and_destroy(&setter);
+
+  ybc_close(cache);
+}
+
+static void m_de_notify_func(void *const ctx)
+{
+  size_t *const notifications_count = ctx;
+
+  (void)p_atomic_add(notifications_count, 1);
+}
+
+static void m_expect_notifications_count(size_t *const notifications_count,
+    const size_t expected_count)
+{
+  for (size_t i = 0; i < 1000; ++i) {
+    if (p_atomic_load(notifications_count) == expected_count) {
+      return;
+    }
+    m_sleep(10);
+  }
+  M_ERROR("unexpected notifications count");
+}
+
+static void test_dogpile_effect_notify(struct ybc *const cache)
+{
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+  char waiter_buf[ybc_de_waiter_get_size()];
+  struct ybc_de_waiter *const waiter = (struct ybc_de_waiter *)waiter_buf;
+  size_t notifications_count = 0;
+
+  m_open_anonymous(cache);
+
+  struct ybc_key key = {
+      .ptr = "foo",
+      .size = 3,
+  };
+  const struct ybc_value value = {
+      .ptr = "bar",
+      .size = 3,
+      .ttl = YBC_MAX_TTL,
+  };
+  const uint64_t grace_ttl = 10 * 1000;
+
+  /* The first miss registers the pending item. */
+  if (ybc_item_get_de_notify(cache, item, &key, grace_ttl, waiter,
+      &m_de_notify_func, &notifications_count) != YBC_DE_NOTFOUND) {
+    M_ERROR("unexpected status for the first miss");
+  }
+
+  /* Canceled waiter mustn't be notified. */
+  if (ybc_item_get_de_notify(cache, item, &key, grace_ttl, waiter,
+      &m_de_notify_func, &notifications_count) != YBC_DE_WOULDBLOCK) {
+    M_ERROR("pending item must block");
+  }
+  if (!ybc_de_waiter_cancel(cache, waiter)) {
+    M_ERROR("cannot cancel the waiter");
+  }
+
+  /* The waiter must be notified when the item is added. */
+  if (ybc_item_get_de_notify(cache, item, &key, grace_ttl, waiter,
+      &m_de_notify_func, &notifications_count) != YBC_DE_WOULDBLOCK) {
+    M_ERROR("pending item must block");
+  }
+  expect_item_set(cache, &key, &value);
+  m_expect_notifications_count(&notifications_count, 1);
+  if (ybc_de_waiter_cancel(cache, waiter)) {
+    M_ERROR("notified waiter mustn't be canceled");
+  }
+
+  if (ybc_item_get_de_notify(cache, item, &key, grace_ttl, waiter,
+      &m_de_notify_func, &notifications_count) != YBC_DE_SUCCESS) {
+    M_ERROR("cannot find the added item");
+  }
+  ybc_item_release(item);
+
+  /* The waiter must be notified when the pending item expires. */
+  key.ptr = "baz";
+  expect_item_miss_de(cache, &key, 200);
+  if (ybc_item_get_de_notify(cache, item, &key, 200, waiter,
+      &m_de_notify_func, &notifications_count) != YBC_DE_WOULDBLOCK) {
+    M_ERROR("pending item must block");
+  }
+  m_expect_notifications_count(&notifications_count, 2);
+
+  /* The waiter must be notified when the cache is closed. */
+  key.ptr = "qux";
+  expect_item_miss_de(cache, &key, grace_ttl);
+  if (ybc_item_get_de_notify(cache, item, &key, grace_ttl, waiter,
+      &m_de_notify_func, &notifications_count) != YBC_DE_WOULDBLOCK) {
+    M_ERROR("pending item must block");
+  }
+
+  ybc_close(cache);
+
+  m_expect_notifications_count(&notifications_count, 3);
+}
+
 static void test_cluster_ops(const size_t cluster_size,
     const size_t iterations_count)
 {
@@ -642,84 +949,326 @@ static struct ybc_item *m_get_item(struct ybc_item *const items, const size_t i)
   return (struct ybc_item *)(((char *)items) + ybc_item_get_size() * i);
 }
 
-static void test_overlapped_acquirements(struct ybc *const cache,
-    const size_t items_count)
+static void test_various_key_sizes(struct ybc *const cache)
 {
   m_open_anonymous(cache);
 
-  char added_items_buf[ybc_item_get_size() * items_count];
-  struct ybc_item *const added_items = (struct ybc_item *)added_items_buf;
-
-  char obtained_items_buf[ybc_item_get_size() * items_count];
-  struct ybc_item *const obtained_items = (struct ybc_item *)obtained_items_buf;
+  /*
+   * Keys with various sizes are hashed by distinct code paths.
+   */
+  const size_t max_key_size = 1200;
+  char *const key_buf = p_malloc(max_key_size);
+  for (size_t i = 0; i < max_key_size; ++i) {
+    key_buf[i] = (char)(i * 131 + 7);
+  }
 
-  size_t i;
-  const struct ybc_key key = {
-      .ptr = &i,
-      .size = sizeof(i),
+  struct ybc_key key = {
+      .ptr = key_buf,
   };
-  const struct ybc_value value = {
-      .ptr = &i,
-      .size = sizeof(i),
+  struct ybc_value value = {
+      .ptr = &key.size,
+      .size = sizeof(key.size),
       .ttl = YBC_MAX_TTL,
   };
 
-  const struct ybc_key static_key = {
-      .ptr = "aaaabbb",
-      .size = 7,
-  };
-  for (i = 0; i < items_count; ++i) {
-    ybc_item_set_item(cache, m_get_item(added_items, i), &static_key, &value);
+  for (key.size = 0; key.size <= max_key_size; ++key.size) {
+    expect_item_set(cache, &key, &value);
   }
-  for (i = 0; i < items_count; ++i) {
-    ybc_item_get(cache, m_get_item(obtained_items, i), &static_key);
+
+  size_t size;
+  value.ptr = &size;
+  for (size = 0; size <= max_key_size; ++size) {
+    key.size = size;
+    expect_item_hit(cache, &key, &value);
   }
-  for (i = 0; i < items_count; ++i) {
-    ybc_item_release(m_get_item(obtained_items, i));
-    ybc_item_release(m_get_item(added_items, i));
+
+  p_free(key_buf);
+
+  ybc_close(cache);
+}
+
+static void test_item_get_multi(struct ybc *const cache,
+    const size_t keys_count)
+{
+  m_open_anonymous(cache);
+
+  size_t key_values[keys_count];
+  struct ybc_key keys[keys_count];
+  for (size_t i = 0; i < keys_count; ++i) {
+    key_values[i] = i;
+    keys[i].ptr = &key_values[i];
+    keys[i].size = sizeof(key_values[i]);
   }
 
-  for (i = 0; i < items_count; ++i) {
-    ybc_item_set_item(cache, m_get_item(added_items, i), &key, &value);
+  struct ybc_value value = {
+      .size = sizeof(size_t),
+      .ttl = YBC_MAX_TTL,
+  };
+
+  /* Store only items with even keys. */
+  for (size_t i = 0; i < keys_count; i += 2) {
+    value.ptr = &key_values[i];
+    expect_item_set(cache, &keys[i], &value);
   }
 
-  for (i = 0; i < items_count; ++i) {
-    ybc_item_get(cache, m_get_item(obtained_items, i), &key);
-    expect_value(m_get_item(obtained_items, i), &value);
+  char items_buf[ybc_item_get_size() * keys_count];
+  struct ybc_item *const items = (struct ybc_item *)items_buf;
+  int is_found[keys_count];
+
+  const size_t found_count = ybc_item_get_multi(cache, items, is_found, keys,
+      keys_count);
+  if (found_count != (keys_count + 1) / 2) {
+    M_ERROR("unexpected number of items found");
   }
 
-  for (i = 0; i < items_count; ++i) {
-    ybc_item_release(m_get_item(obtained_items, items_count - i - 1));
+  for (size_t i = 0; i < keys_count; ++i) {
+    if (i % 2) {
+      if (is_found[i]) {
+        M_ERROR("unexpected item found");
+      }
+      continue;
+    }
+    if (!is_found[i]) {
+      M_ERROR("cannot find item");
+    }
+    value.ptr = &key_values[i];
+    expect_value(YBC_ITEM_GET(items, i), &value);
+    ybc_item_release(YBC_ITEM_GET(items, i));
   }
 
-  for (i = 0; i < items_count; ++i) {
-    ybc_item_release(m_get_item(added_items, i));
+  /* Empty key list must be handled gracefully. */
+  if (ybc_item_get_multi(cache, items, is_found, keys, 0) != 0) {
+    M_ERROR("unexpected items found for empty key list");
   }
 
   ybc_close(cache);
 }
 
-static void test_interleaved_sets(struct ybc *const cache)
+static void test_item_set_multi(struct ybc *const cache,
+    const size_t keys_count)
 {
-  m_open_anonymous(cache);
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
 
-  char set_txn1_buf[ybc_set_txn_get_size()];
-  char set_txn2_buf[ybc_set_txn_get_size()];
-  struct ybc_set_txn *const txn1 = (struct ybc_set_txn *)set_txn1_buf;
-  struct ybc_set_txn *const txn2 = (struct ybc_set_txn *)set_txn2_buf;
+  ybc_config_init(config);
 
-  char item1_buf[ybc_item_get_size()];
-  char item2_buf[ybc_item_get_size()];
-  struct ybc_item *const item1 = (struct ybc_item *)item1_buf;
-  struct ybc_item *const item2 = (struct ybc_item *)item2_buf;
+  ybc_config_set_max_items_count(config, keys_count * 2);
+  ybc_config_set_data_file_size(config, 1024 * 1024);
+  ybc_config_set_storage_arenas_count(config, 4);
 
-  const struct ybc_key key1 = {
-      .ptr = "foo",
-      .size = 3,
-  };
-  const struct ybc_key key2 = {
-      .ptr = "barz",
-      .size = 4,
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache with storage arenas");
+  }
+
+  ybc_config_destroy(config);
+
+  size_t key_values[keys_count];
+  struct ybc_key keys[keys_count];
+  struct ybc_value values[keys_count];
+  for (size_t i = 0; i < keys_count; ++i) {
+    key_values[i] = i;
+    keys[i].ptr = &key_values[i];
+    keys[i].size = sizeof(key_values[i]);
+    values[i].ptr = &key_values[i];
+    values[i].size = sizeof(key_values[i]);
+    values[i].ttl = YBC_MAX_TTL;
+  }
+
+  if (ybc_item_set_multi(cache, keys, values, keys_count) != keys_count) {
+    M_ERROR("cannot store all the items");
+  }
+  for (size_t i = 0; i < keys_count; ++i) {
+    expect_item_hit(cache, &keys[i], &values[i]);
+  }
+
+  /* The last value wins for duplicate keys. */
+  const size_t dup_key = 12345;
+  const struct ybc_value dup_values[] = {
+      {
+          .ptr = "foo",
+          .size = 3,
+          .ttl = YBC_MAX_TTL,
+      },
+      {
+          .ptr = "barbaz",
+          .size = 6,
+          .ttl = YBC_MAX_TTL,
+      },
+  };
+  const struct ybc_key dup_keys[] = {
+      {
+          .ptr = &dup_key,
+          .size = sizeof(dup_key),
+      },
+      {
+          .ptr = &dup_key,
+          .size = sizeof(dup_key),
+      },
+  };
+  if (ybc_item_set_multi(cache, dup_keys, dup_values, 2) != 2) {
+    M_ERROR("cannot store items with duplicate keys");
+  }
+  expect_item_hit(cache, &dup_keys[0], &dup_values[1]);
+
+  /*
+   * Values larger than a single arena cannot be stored, but they mustn't
+   * prevent storing other items from the batch.
+   */
+  char large_value_buf[512 * 1024];
+  memset(large_value_buf, 'a', sizeof(large_value_buf));
+  values[0].ptr = large_value_buf;
+  values[0].size = sizeof(large_value_buf);
+  if (ybc_item_set_multi(cache, keys, values, keys_count) != keys_count - 1) {
+    M_ERROR("unexpected number of stored items");
+  }
+  for (size_t i = 1; i < keys_count; ++i) {
+    expect_item_hit(cache, &keys[i], &values[i]);
+  }
+
+  ybc_close(cache);
+}
+
+static void test_stats(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+
+  ybc_config_init(config);
+
+  ybc_config_set_max_items_count(config, 100);
+  ybc_config_set_data_file_size(config, 4000);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache");
+  }
+
+  ybc_config_destroy(config);
+
+  struct ybc_stats stats;
+  ybc_get_stats(cache, &stats);
+  if (stats.get_hits != 0 || stats.get_misses != 0 ||
+      stats.storage_wraps != 0) {
+    M_ERROR("unexpected stats for empty cache");
+  }
+
+  size_t i;
+  const struct ybc_key key = {
+      .ptr = &i,
+      .size = sizeof(i),
+  };
+  const struct ybc_value value = {
+      .ptr = &i,
+      .size = sizeof(i),
+      .ttl = YBC_MAX_TTL,
+  };
+
+  i = 0;
+  if (!ybc_item_set(cache, &key, &value)) {
+    M_ERROR("error when storing item in the cache");
+  }
+  expect_item_hit(cache, &key, &value);
+  i = 1;
+  expect_item_miss(cache, &key);
+
+  ybc_get_stats(cache, &stats);
+  if (stats.get_hits != 1) {
+    M_ERROR("unexpected get_hits");
+  }
+  if (stats.get_misses != 1) {
+    M_ERROR("unexpected get_misses");
+  }
+
+  /* Provoke storage wrapping. */
+  for (i = 0; i < 1000; ++i) {
+    expect_item_set_no_acquire(cache, &key, &value);
+  }
+
+  ybc_get_stats(cache, &stats);
+  if (stats.storage_wraps == 0) {
+    M_ERROR("storage wraps must be accounted");
+  }
+
+  ybc_close(cache);
+}
+
+static void test_overlapped_acquirements(struct ybc *const cache,
+    const size_t items_count)
+{
+  m_open_anonymous(cache);
+
+  char added_items_buf[ybc_item_get_size() * items_count];
+  struct ybc_item *const added_items = (struct ybc_item *)added_items_buf;
+
+  char obtained_items_buf[ybc_item_get_size() * items_count];
+  struct ybc_item *const obtained_items = (struct ybc_item *)obtained_items_buf;
+
+  size_t i;
+  const struct ybc_key key = {
+      .ptr = &i,
+      .size = sizeof(i),
+  };
+  const struct ybc_value value = {
+      .ptr = &i,
+      .size = sizeof(i),
+      .ttl = YBC_MAX_TTL,
+  };
+
+  const struct ybc_key static_key = {
+      .ptr = "aaaabbb",
+      .size = 7,
+  };
+  for (i = 0; i < items_count; ++i) {
+    ybc_item_set_item(cache, m_get_item(added_items, i), &static_key, &value);
+  }
+  for (i = 0; i < items_count; ++i) {
+    ybc_item_get(cache, m_get_item(obtained_items, i), &static_key);
+  }
+  for (i = 0; i < items_count; ++i) {
+    ybc_item_release(m_get_item(obtained_items, i));
+    ybc_item_release(m_get_item(added_items, i));
+  }
+
+  for (i = 0; i < items_count; ++i) {
+    ybc_item_set_item(cache, m_get_item(added_items, i), &key, &value);
+  }
+
+  for (i = 0; i < items_count; ++i) {
+    ybc_item_get(cache, m_get_item(obtained_items, i), &key);
+    expect_value(m_get_item(obtained_items, i), &value);
+  }
+
+  for (i = 0; i < items_count; ++i) {
+    ybc_item_release(m_get_item(obtained_items, items_count - i - 1));
+  }
+
+  for (i = 0; i < items_count; ++i) {
+    ybc_item_release(m_get_item(added_items, i));
+  }
+
+  ybc_close(cache);
+}
+
+static void test_interleaved_sets(struct ybc *const cache)
+{
+  m_open_anonymous(cache);
+
+  char set_txn1_buf[ybc_set_txn_get_size()];
+  char set_txn2_buf[ybc_set_txn_get_size()];
+  struct ybc_set_txn *const txn1 = (struct ybc_set_txn *)set_txn1_buf;
+  struct ybc_set_txn *const txn2 = (struct ybc_set_txn *)set_txn2_buf;
+
+  char item1_buf[ybc_item_get_size()];
+  char item2_buf[ybc_item_get_size()];
+  struct ybc_item *const item1 = (struct ybc_item *)item1_buf;
+  struct ybc_item *const item2 = (struct ybc_item *)item2_buf;
+
+  const struct ybc_key key1 = {
+      .ptr = "foo",
+      .size = 3,
+  };
+  const struct ybc_key key2 = {
+      .ptr = "barz",
+      .size = 4,
   };
 
   const struct ybc_value value1 = {
@@ -1230,101 +1779,961 @@ static void test_small_sync_interval(struct ybc *const cache)
       key.size = sizeof(j);
       expect_item_set(cache, &key, &value);
     }
-    p_sleep(31);
+    m_sleep(31);
   }
 
   ybc_close(cache);
 }
 
-static void test_disabled_hot_items_cache(struct ybc *const cache)
+static void fill_cache_for_sync(struct ybc *const cache)
 {
-  const size_t items_count = 1000;
-  const size_t expected_hits_count = 900;
-  const size_t hot_items_count = 0;
-  const size_t hot_data_size = 100 * 1024;
-  const uint64_t sync_interval = 10 * 1000;
+  char buf[1000];
+  size_t i;
+  const struct ybc_key key = {
+      .ptr = &i,
+      .size = sizeof(i),
+  };
+  const struct ybc_value value = {
+      .ptr = buf,
+      .size = sizeof(buf),
+      .ttl = YBC_MAX_TTL,
+  };
 
-  expect_cache_works(cache, items_count, expected_hits_count, hot_items_count,
-      hot_data_size, sync_interval);
+  memset(buf, 'a', sizeof(buf));
+  for (i = 0; i < 100; ++i) {
+    expect_item_set_no_acquire(cache, &key, &value);
+  }
 }
 
-static void test_disabled_data_compaction(struct ybc *const cache)
+static void test_sync_backlog(struct ybc *const cache)
 {
-  const size_t items_count = 1000;
-  const size_t expected_hits_count = 900;
-  const size_t hot_items_count = 100;
-  const size_t hot_data_size = 0;
-  const uint64_t sync_interval = 10 * 1000;
-
-  expect_cache_works(cache, items_count, expected_hits_count, hot_items_count,
-      hot_data_size, sync_interval);
-}
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+  struct ybc_stats stats;
 
-static void test_disabled_syncing(struct ybc *const cache)
-{
-  const size_t items_count = 1000;
-  const size_t expected_hits_count = 900;
-  const size_t hot_items_count = 100;
-  const size_t hot_data_size = 10 * 1024;
-  const uint64_t sync_interval = 0;
+  ybc_config_init(config);
+  ybc_config_set_max_items_count(config, 100);
+  ybc_config_set_data_file_size(config, 64 * 1024);
+  ybc_config_set_sync_interval(config, 0);
 
-  expect_cache_works(cache, items_count, expected_hits_count, hot_items_count,
-      hot_data_size, sync_interval);
-}
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache");
+  }
 
-struct thread_task
-{
-  struct ybc *const cache;
-  int should_exit;
-};
+  fill_cache_for_sync(cache);
+  ybc_get_stats(cache, &stats);
+  if (stats.sync_backlog_bytes == 0 ||
+      stats.sync_backlog_bytes > 64 * 1024) {
+    M_ERROR("unexpected sync_backlog_bytes with disabled syncing");
+  }
+  ybc_close(cache);
 
-static void thread_func(void *const ctx)
-{
-  struct thread_task *const task = ctx;
+  ybc_config_set_sync_interval(config, 10);
 
-  char item_buf[ybc_item_get_size()];
-  struct ybc_item *const item = (struct ybc_item *)item_buf;
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache");
+  }
 
-  struct ybc_key key;
-  struct ybc_value value;
-  int tmp;
+  fill_cache_for_sync(cache);
+  m_sleep(200);
+  ybc_get_stats(cache, &stats);
+  if (stats.sync_backlog_bytes != 0) {
+    M_ERROR("unexpected sync_backlog_bytes after syncing");
+  }
+  if (stats.sync_bytes == 0) {
+    M_ERROR("unexpected sync_bytes after syncing");
+  }
+  ybc_close(cache);
 
-  key.size = sizeof(tmp);
-  value.size = sizeof(tmp);
-  value.ttl = YBC_MAX_TTL;
+  /*
+   * Close mustn't wait for throttled syncing.
+   */
+  ybc_config_set_sync_bandwidth(config, 1);
 
-  while (!task->should_exit) {
-    /*
-     * It is OK using non-threadsafe rand() function here.
-     */
-    tmp = rand() % 100;
-    key.ptr = &tmp;
-    value.ptr = &tmp;
-    switch (rand() % 5) {
-    case 0: case 1:
-      if (!ybc_item_set_item(task->cache, item, &key, &value)) {
-        M_ERROR("error when storing item in the cache");
-      }
-      expect_value(item, &value);
-      ybc_item_release(item);
-      break;
-    case 2:
-      (void)ybc_item_remove(task->cache, &key);
-      break;
-    default:
-      if (ybc_item_get(task->cache, item, &key)) {
-        expect_value(item, &value);
-        ybc_item_release(item);
-      }
-    }
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache");
   }
+
+  ybc_config_destroy(config);
+
+  fill_cache_for_sync(cache);
+  m_sleep(50);
+  ybc_close(cache);
 }
 
-static void test_multithreaded_access(struct ybc *const cache,
-    const size_t threads_count)
+static void test_item_residency(struct ybc *const cache)
 {
-  m_open_anonymous(cache);
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+
+  ybc_config_init(config);
+  ybc_config_set_max_items_count(config, 100);
+  ybc_config_set_data_file_size(config, 1024 * 1024);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache");
+  }
+
+  ybc_config_destroy(config);
 
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+
+  static char buf[64 * 1024];
+  const struct ybc_key key = {
+      .ptr = "resident",
+      .size = 8,
+  };
+  const struct ybc_value value = {
+      .ptr = buf,
+      .size = sizeof(buf),
+      .ttl = YBC_MAX_TTL,
+  };
+
+  memset(buf, 'r', sizeof(buf));
+  expect_item_set(cache, &key, &value);
+
+  if (!ybc_item_get(cache, item, &key)) {
+    M_ERROR("cannot find just added item");
+  }
+  /* The value has been just written, so it must be in RAM. */
+  if (!ybc_item_is_resident(item)) {
+    M_ERROR("just added item isn't resident");
+  }
+  ybc_item_prefetch_value(item);
+  expect_value(item, &value);
+  ybc_item_release(item);
+
+  const struct ybc_value empty_value = {
+      .ptr = NULL,
+      .size = 0,
+      .ttl = YBC_MAX_TTL,
+  };
+  expect_item_set(cache, &key, &empty_value);
+  if (!ybc_item_get(cache, item, &key)) {
+    M_ERROR("cannot find just added item");
+  }
+  if (!ybc_item_is_resident(item)) {
+    M_ERROR("empty item isn't resident");
+  }
+  ybc_item_prefetch_value(item);
+  ybc_item_release(item);
+
+  ybc_close(cache);
+}
+
+static void test_item_value_location(struct ybc *const cache)
+{
+  m_open_anonymous(cache);
+
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+
+  static char buf[64 * 1024];
+  static char file_buf[sizeof(buf)];
+  const struct ybc_key key = {
+      .ptr = "location",
+      .size = 8,
+  };
+  const struct ybc_value value = {
+      .ptr = buf,
+      .size = sizeof(buf),
+      .ttl = YBC_MAX_TTL,
+  };
+
+  for (size_t i = 0; i < sizeof(buf); ++i) {
+    buf[i] = (char)i;
+  }
+  expect_item_set(cache, &key, &value);
+
+  if (!ybc_item_get(cache, item, &key)) {
+    M_ERROR("cannot find just added item");
+  }
+
+  /* The value read from the data file must match the item's value. */
+  struct ybc_value_location location;
+  ybc_item_get_value_location(item, &location);
+  if (location.size != value.size) {
+    M_ERROR("unexpected value size in the location");
+  }
+  if (pread(location.fd, file_buf, location.size, location.offset) !=
+      (ssize_t)location.size) {
+    M_ERROR("cannot read the value from the data file");
+  }
+  if (memcmp(file_buf, buf, sizeof(buf))) {
+    M_ERROR("unexpected value in the data file");
+  }
+  ybc_item_release(item);
+
+  ybc_close(cache);
+}
+
+static void test_huge_pages(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+
+  const size_t items_count = 1000;
+
+  ybc_config_init(config);
+  ybc_config_set_max_items_count(config, items_count * 2);
+  ybc_config_set_data_file_size(config, items_count * 100);
+  ybc_config_set_hot_items_count(config, items_count);
+  ybc_config_enable_huge_pages(config);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache with huge pages");
+  }
+
+  ybc_config_destroy(config);
+
+  struct ybc_key key;
+  struct ybc_value value;
+
+  value.ttl = YBC_MAX_TTL;
+
+  for (size_t i = 0; i < items_count; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    value.ptr = &i;
+    value.size = sizeof(i);
+    expect_item_set(cache, &key, &value);
+  }
+
+  expect_cache_with_data(cache, items_count, 900, &key, &value);
+
+  ybc_close(cache);
+}
+
+struct warmup_progress
+{
+  size_t calls_count;
+  size_t warmed_size;
+  size_t total_size;
+};
+
+static void warmup_progress_func(void *const ctx, const size_t warmed_size,
+    const size_t total_size)
+{
+  struct warmup_progress *const wp = ctx;
+
+  if (warmed_size <= wp->warmed_size || warmed_size > total_size) {
+    M_ERROR("unexpected index warm-up progress");
+  }
+  ++wp->calls_count;
+  wp->warmed_size = warmed_size;
+  wp->total_size = total_size;
+}
+
+static void test_index_warmup(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+  struct warmup_progress wp;
+  struct ybc_stats stats;
+
+  ybc_config_init(config);
+
+  ybc_config_set_index_file(config, "./tmp_cache.index");
+  ybc_config_set_data_file(config, "./tmp_cache.data");
+  /* The index file must span multiple warm-up chunks. */
+  ybc_config_set_max_items_count(config, 1000 * 1000);
+  ybc_config_set_data_file_size(config, 1024 * 1024);
+  ybc_config_set_index_warmup_threads_count(config, 4);
+  ybc_config_set_index_warmup_progress_callback(config,
+      &warmup_progress_func, &wp);
+
+  /* Foreground warm-up must complete before ybc_open() returns. */
+  memset(&wp, 0, sizeof(wp));
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create persistent cache with index warm-up");
+  }
+  if (wp.calls_count < 2 || wp.warmed_size != wp.total_size) {
+    M_ERROR("index warm-up isn't complete after ybc_open()");
+  }
+  ybc_get_stats(cache, &stats);
+  if (stats.index_warmup_pending_bytes != 0) {
+    M_ERROR("unexpected pending index warm-up bytes");
+  }
+  ybc_close(cache);
+
+  /* Background warm-up must eventually complete. */
+  ybc_config_enable_background_index_warmup(config);
+  memset(&wp, 0, sizeof(wp));
+  if (!ybc_open(cache, config, 0)) {
+    M_ERROR("cannot open persistent cache with background index warm-up");
+  }
+  for (;;) {
+    ybc_get_stats(cache, &stats);
+    if (stats.index_warmup_pending_bytes == 0) {
+      break;
+    }
+    m_sleep(10);
+  }
+  ybc_close(cache);
+  if (wp.warmed_size != wp.total_size) {
+    M_ERROR("background index warm-up isn't complete");
+  }
+
+  /* ybc_close() must stop unfinished warm-up. */
+  memset(&wp, 0, sizeof(wp));
+  if (!ybc_open(cache, config, 0)) {
+    M_ERROR("cannot open persistent cache with background index warm-up");
+  }
+  ybc_close(cache);
+
+  /* Warm-up may be disabled. */
+  ybc_config_set_index_warmup_threads_count(config, 0);
+  memset(&wp, 0, sizeof(wp));
+  if (!ybc_open(cache, config, 0)) {
+    M_ERROR("cannot open persistent cache without index warm-up");
+  }
+  if (wp.calls_count != 0) {
+    M_ERROR("unexpected index warm-up");
+  }
+  ybc_close(cache);
+
+  ybc_remove(config);
+
+  ybc_config_destroy(config);
+}
+
+static void test_hot_data_prefetch(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+  struct ybc_stats stats;
+
+  ybc_config_init(config);
+
+  ybc_config_set_index_file(config, "./tmp_cache.index");
+  ybc_config_set_data_file(config, "./tmp_cache.data");
+  ybc_config_set_max_items_count(config, 10 * 1000);
+  ybc_config_set_data_file_size(config, 4 * 1024 * 1024);
+  ybc_config_set_hot_data_size(config, 1024 * 1024);
+  ybc_config_set_storage_arenas_count(config, 2);
+  ybc_config_enable_hot_data_prefetch(config);
+  ybc_config_set_hot_data_prefetch_bandwidth(config, 0);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create persistent cache with hot data prefetch");
+  }
+
+  /* Newly created cache has nothing to prefetch. */
+  ybc_get_stats(cache, &stats);
+  if (stats.hot_data_prefetch_pending_bytes != 0) {
+    M_ERROR("unexpected pending hot data in new cache");
+  }
+
+  static char buf[4 * 1024];
+  struct ybc_key key;
+  const struct ybc_value value = {
+      .ptr = buf,
+      .size = sizeof(buf),
+      .ttl = YBC_MAX_TTL,
+  };
+
+  /* Wrap storage arenas, so hot data wraps the end of arenas. */
+  for (size_t i = 0; i < 1500; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    memset(buf, (int)i, sizeof(buf));
+    expect_item_set(cache, &key, &value);
+  }
+
+  ybc_close(cache);
+
+  if (!ybc_open(cache, config, 0)) {
+    M_ERROR("cannot open persistent cache with hot data prefetch");
+  }
+  for (;;) {
+    ybc_get_stats(cache, &stats);
+    if (stats.hot_data_prefetch_pending_bytes == 0) {
+      break;
+    }
+    m_sleep(10);
+  }
+
+  /* Recently added items must survive prefetch. */
+  for (size_t i = 1400; i < 1500; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    memset(buf, (int)i, sizeof(buf));
+    expect_item_hit(cache, &key, &value);
+  }
+
+  ybc_close(cache);
+
+  /* ybc_close() must stop unfinished prefetch. */
+  ybc_config_set_hot_data_prefetch_bandwidth(config, 1024);
+  if (!ybc_open(cache, config, 0)) {
+    M_ERROR("cannot open persistent cache with hot data prefetch");
+  }
+  ybc_get_stats(cache, &stats);
+  if (stats.hot_data_prefetch_pending_bytes == 0) {
+    M_ERROR("throttled hot data prefetch completed too early");
+  }
+  ybc_close(cache);
+
+  ybc_remove(config);
+
+  ybc_config_destroy(config);
+}
+
+static void test_map_cache_snapshot(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+
+  ybc_config_init(config);
+
+  ybc_config_set_index_file(config, "./tmp_cache.index");
+  ybc_config_set_data_file(config, "./tmp_cache.data");
+  ybc_config_set_map_cache_file(config, "./tmp_cache.map_cache");
+  ybc_config_set_max_items_count(config, 1000);
+  ybc_config_set_hot_items_count(config, 100);
+  ybc_config_set_data_file_size(config, 64 * 1024);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create persistent cache with map cache snapshot");
+  }
+
+  struct ybc_key key;
+  struct ybc_value value;
+  value.ttl = YBC_MAX_TTL;
+
+  for (size_t i = 0; i < 100; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    value.ptr = &i;
+    value.size = sizeof(i);
+    expect_item_set(cache, &key, &value);
+    /* Move the item into the map cache. */
+    expect_item_hit(cache, &key, &value);
+  }
+
+  ybc_close(cache);
+
+  if (!p_file_exists("./tmp_cache.map_cache")) {
+    M_ERROR("map cache snapshot hasn't been saved");
+  }
+
+  /* Loaded snapshot must be consistent with the index. */
+  if (!ybc_open(cache, config, 0)) {
+    M_ERROR("cannot open persistent cache with map cache snapshot");
+  }
+  if (p_file_exists("./tmp_cache.map_cache")) {
+    M_ERROR("map cache snapshot hasn't been removed after loading");
+  }
+  for (size_t i = 0; i < 100; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    value.ptr = &i;
+    value.size = sizeof(i);
+    expect_item_hit(cache, &key, &value);
+  }
+  ybc_close(cache);
+
+  /*
+   * Items removed after the snapshot has been saved mustn't be resurrected
+   * from the snapshot.
+   */
+  ybc_config_set_map_cache_file(config, NULL);
+  if (!ybc_open(cache, config, 0)) {
+    M_ERROR("cannot open persistent cache without map cache snapshot");
+  }
+  for (size_t i = 0; i < 50; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    if (!ybc_item_remove(cache, &key)) {
+      M_ERROR("cannot remove existing item");
+    }
+  }
+  ybc_close(cache);
+
+  ybc_config_set_map_cache_file(config, "./tmp_cache.map_cache");
+  if (!ybc_open(cache, config, 0)) {
+    M_ERROR("cannot open persistent cache with map cache snapshot");
+  }
+  for (size_t i = 0; i < 100; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    if (i < 50) {
+      if (ybc_item_get(cache, item, &key)) {
+        M_ERROR("removed item has been resurrected from map cache snapshot");
+      }
+      continue;
+    }
+    value.ptr = &i;
+    value.size = sizeof(i);
+    expect_item_hit(cache, &key, &value);
+  }
+  ybc_close(cache);
+
+  ybc_remove(config);
+  if (p_file_exists("./tmp_cache.map_cache")) {
+    M_ERROR("map cache snapshot hasn't been removed by ybc_remove()");
+  }
+
+  ybc_config_destroy(config);
+}
+
+static void test_autosize(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+
+  ybc_config_init(config);
+
+  ybc_config_set_max_items_count(config, 100 * 1000);
+  ybc_config_set_data_file_size(config, 16 * 1024 * 1024);
+  ybc_config_set_storage_arenas_count(config, 1);
+  ybc_config_set_hot_items_count(config, 100);
+  ybc_config_set_max_hot_items_count(config, 10 * 1000);
+  ybc_config_set_hot_data_size(config, 64 * 1024);
+  ybc_config_set_max_hot_data_size(config, 4 * 1024 * 1024);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache with auto-sizing");
+  }
+
+  const size_t initial_hot_items_count = ybc_get_hot_items_count(cache);
+  const size_t initial_hot_data_size = ybc_get_hot_data_size(cache);
+  if (initial_hot_data_size != 64 * 1024) {
+    M_ERROR("unexpected initial hot data size");
+  }
+
+  struct ybc_key key;
+  struct ybc_value value;
+  char buf[256];
+  memset(buf, 'a', sizeof(buf));
+  value.ptr = buf;
+  value.size = sizeof(buf);
+  value.ttl = YBC_MAX_TTL;
+
+  for (size_t i = 0; i < 4000; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    expect_item_set(cache, &key, &value);
+  }
+
+  /*
+   * Frequent access to a working set, which doesn't fit the initial
+   * hot items' cache and hot data size, must grow them.
+   */
+  const uint64_t end_time = p_get_current_time() + 10 * 1000;
+  while (ybc_get_hot_items_count(cache) <= initial_hot_items_count ||
+      ybc_get_hot_data_size(cache) <= initial_hot_data_size) {
+    if (p_get_current_time() > end_time) {
+      M_ERROR("auto-sizing didn't grow hot items' cache or hot data size");
+    }
+    for (size_t i = 0; i < 4000; ++i) {
+      key.ptr = &i;
+      key.size = sizeof(i);
+      if (ybc_item_get(cache, item, &key)) {
+        ybc_item_release(item);
+      }
+    }
+  }
+
+  if (ybc_get_hot_data_size(cache) > 4 * 1024 * 1024) {
+    M_ERROR("hot data size exceeds the maximum size");
+  }
+
+  struct ybc_stats stats;
+  ybc_get_stats(cache, &stats);
+  if (stats.map_cache_hits == 0 || stats.map_cache_misses == 0) {
+    M_ERROR("unexpected map cache stats");
+  }
+
+  ybc_close(cache);
+
+  ybc_config_destroy(config);
+}
+
+static void test_ws_one_off_items(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+  struct ybc_stats stats;
+
+  ybc_config_init(config);
+
+  ybc_config_set_max_items_count(config, 10 * 1000);
+  ybc_config_set_data_file_size(config, 4 * 1024 * 1024);
+  ybc_config_set_storage_arenas_count(config, 1);
+  ybc_config_set_hot_data_size(config, 64 * 1024);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache");
+  }
+
+  struct ybc_key key;
+  struct ybc_value value;
+  char buf[256];
+  memset(buf, 'a', sizeof(buf));
+  value.ptr = buf;
+  value.size = sizeof(buf);
+  value.ttl = YBC_MAX_TTL;
+
+  for (size_t i = 0; i < 2000; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    expect_item_set(cache, &key, &value);
+  }
+
+  /* Items accessed only once mustn't be moved into hot data space. */
+  for (size_t i = 0; i < 200; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    expect_item_hit(cache, &key, &value);
+  }
+  /* Give the deferred defragmentation a chance to run. */
+  m_sleep(100);
+  ybc_get_stats(cache, &stats);
+  if (stats.defragmentation_moves != 0) {
+    M_ERROR("one-off items have been defragmented");
+  }
+
+  /* Frequently accessed items must be eventually moved. */
+  for (size_t n = 0; n < 100; ++n) {
+    for (size_t i = 0; i < 10; ++i) {
+      key.ptr = &i;
+      key.size = sizeof(i);
+      if (!ybc_item_get(cache, item, &key)) {
+        M_ERROR("cannot find expected item");
+      }
+      ybc_item_release(item);
+    }
+  }
+  /* The defragmentation is deferred, so wait for it. */
+  for (size_t n = 0; n < 100; ++n) {
+    ybc_get_stats(cache, &stats);
+    if (stats.defragmentation_moves > 0) {
+      break;
+    }
+    m_sleep(10);
+  }
+  if (stats.defragmentation_moves == 0) {
+    M_ERROR("frequently accessed items haven't been defragmented");
+  }
+
+  ybc_close(cache);
+
+  ybc_config_destroy(config);
+}
+
+static void test_storage_arenas(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+
+  ybc_config_init(config);
+
+  ybc_config_set_index_file(config, "./tmp_cache.index");
+  ybc_config_set_data_file(config, "./tmp_cache.data");
+  ybc_config_set_max_items_count(config, 1000);
+  ybc_config_set_data_file_size(config, 64 * 1024);
+  ybc_config_set_storage_arenas_count(config, 4);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create persistent cache with storage arenas");
+  }
+
+  struct ybc_key key;
+  struct ybc_value value;
+  value.ttl = YBC_MAX_TTL;
+
+  for (size_t i = 0; i < 100; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    value.ptr = &i;
+    value.size = sizeof(i);
+    expect_item_set(cache, &key, &value);
+  }
+
+  /* Values larger than a single arena cannot be stored. */
+  char buf[20 * 1024];
+  memset(buf, 'a', sizeof(buf));
+  key.ptr = "large";
+  key.size = 5;
+  value.ptr = buf;
+  value.size = sizeof(buf);
+  if (ybc_item_set(cache, &key, &value)) {
+    M_ERROR("unexpected item set with size exceeding storage arena size");
+  }
+
+  ybc_close(cache);
+
+  /* Re-open the same cache and make sure the items exist there. */
+  if (!ybc_open(cache, config, 0)) {
+    M_ERROR("cannot open persistent cache with storage arenas");
+  }
+
+  for (size_t i = 0; i < 100; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    value.ptr = &i;
+    value.size = sizeof(i);
+    expect_item_hit(cache, &key, &value);
+  }
+
+  ybc_close(cache);
+
+  /* Non-forced open with distinct arenas count must fail. */
+  ybc_config_set_storage_arenas_count(config, 2);
+  if (ybc_open(cache, config, 0)) {
+    M_ERROR("cache with distinct storage arenas count shouldn't be opened "
+        "without force");
+  }
+
+  ybc_remove(config);
+
+  ybc_config_destroy(config);
+}
+
+static void test_clock_eviction(struct ybc *const cache)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+
+  ybc_config_init(config);
+
+  /* The index consists of a single bucket. */
+  ybc_config_set_max_items_count(config, 1);
+  ybc_config_set_hot_items_count(config, 0);
+  ybc_config_set_hot_data_size(config, 0);
+  ybc_config_set_data_file_size(config, 64 * 1024);
+  ybc_config_enable_clock_eviction(config);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache with CLOCK eviction");
+  }
+
+  ybc_config_destroy(config);
+
+  struct ybc_key key;
+  struct ybc_value value;
+  value.ttl = YBC_MAX_TTL;
+
+  /* Fill the bucket. */
+  for (size_t i = 0; i < 16; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    value.ptr = &i;
+    value.size = sizeof(i);
+    if (!ybc_item_set(cache, &key, &value)) {
+      M_ERROR("error when storing item in the cache");
+    }
+  }
+
+  /* Reference the first half of items. */
+  for (size_t i = 0; i < 8; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    value.ptr = &i;
+    value.size = sizeof(i);
+    expect_item_hit(cache, &key, &value);
+  }
+
+  /* New items must evict only unreferenced items. */
+  for (size_t i = 16; i < 24; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    value.ptr = &i;
+    value.size = sizeof(i);
+    if (!ybc_item_set(cache, &key, &value)) {
+      M_ERROR("error when storing item in the cache");
+    }
+  }
+
+  for (size_t i = 0; i < 8; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    value.ptr = &i;
+    value.size = sizeof(i);
+    expect_item_hit(cache, &key, &value);
+  }
+
+  for (size_t i = 8; i < 16; ++i) {
+    key.ptr = &i;
+    key.size = sizeof(i);
+    expect_item_miss(cache, &key);
+  }
+
+  ybc_close(cache);
+}
+
+static void test_disabled_hot_items_cache(struct ybc *const cache)
+{
+  const size_t items_count = 1000;
+  const size_t expected_hits_count = 900;
+  const size_t hot_items_count = 0;
+  const size_t hot_data_size = 100 * 1024;
+  const uint64_t sync_interval = 10 * 1000;
+
+  expect_cache_works(cache, items_count, expected_hits_count, hot_items_count,
+      hot_data_size, sync_interval);
+}
+
+static void test_disabled_data_compaction(struct ybc *const cache)
+{
+  const size_t items_count = 1000;
+  const size_t expected_hits_count = 900;
+  const size_t hot_items_count = 100;
+  const size_t hot_data_size = 0;
+  const uint64_t sync_interval = 10 * 1000;
+
+  expect_cache_works(cache, items_count, expected_hits_count, hot_items_count,
+      hot_data_size, sync_interval);
+}
+
+static void test_disabled_syncing(struct ybc *const cache)
+{
+  const size_t items_count = 1000;
+  const size_t expected_hits_count = 900;
+  const size_t hot_items_count = 100;
+  const size_t hot_data_size = 10 * 1024;
+  const uint64_t sync_interval = 0;
+
+  expect_cache_works(cache, items_count, expected_hits_count, hot_items_count,
+      hot_data_size, sync_interval);
+}
+
+struct thread_task
+{
+  struct ybc *const cache;
+  int should_exit;
+};
+
+static void thread_func(void *const ctx)
+{
+  struct thread_task *const task = ctx;
+
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+
+  struct ybc_key key;
+  struct ybc_value value;
+  int tmp;
+
+  key.size = sizeof(tmp);
+  value.size = sizeof(tmp);
+  value.ttl = YBC_MAX_TTL;
+
+  while (!task->should_exit) {
+    /*
+     * It is OK using non-threadsafe rand() function here.
+     */
+    tmp = rand() % 100;
+    key.ptr = &tmp;
+    value.ptr = &tmp;
+    switch (rand() % 5) {
+    case 0: case 1:
+      if (!ybc_item_set_item(task->cache, item, &key, &value)) {
+        M_ERROR("error when storing item in the cache");
+      }
+      expect_value(item, &value);
+      ybc_item_release(item);
+      break;
+    case 2:
+      (void)ybc_item_remove(task->cache, &key);
+      break;
+    default:
+      if (ybc_item_get(task->cache, item, &key)) {
+        expect_value(item, &value);
+        ybc_item_release(item);
+      }
+    }
+  }
+}
+
+static void test_multithreaded_access(struct ybc *const cache,
+    const size_t threads_count)
+{
+  m_open_anonymous(cache);
+
+  struct p_thread threads[threads_count];
+  struct thread_task task = {
+      .cache = cache,
+      .should_exit = 0,
+  };
+
+  for (size_t i = 0; i < threads_count; ++i) {
+    p_thread_init_and_start(&threads[i], thread_func, &task);
+  }
+
+  m_sleep(300);
+  task.should_exit = 1;
+
+  for (size_t i = 0; i < threads_count; ++i) {
+    p_thread_join_and_destroy(&threads[i]);
+  }
+
+  ybc_close(cache);
+}
+
+static void test_item_slots(struct ybc *const cache, const size_t threads_count)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config*)config_buf;
+
+  ybc_config_init(config);
+
+  ybc_config_set_max_items_count(config, 10 * 1000);
+  ybc_config_set_data_file_size(config, 1024 * 1024);
+  ybc_config_set_item_slots_count(config, 4);
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("cannot create anonymous cache");
+  }
+
+  ybc_config_destroy(config);
+
+  /*
+   * Acquire more items than slots, so some of them are registered
+   * in the skiplist.
+   */
+  const size_t items_count = 10;
+  char items_buf[ybc_item_get_size() * items_count];
+  struct ybc_item *const items = (struct ybc_item *)items_buf;
+
+  char key_buf[] = "survive_key_X";
+  const struct ybc_key key = {
+      .ptr = key_buf,
+      .size = sizeof(key_buf),
+  };
+  const struct ybc_value value = {
+      .ptr = key_buf,
+      .size = sizeof(key_buf),
+      .ttl = YBC_MAX_TTL,
+  };
+
+  for (size_t i = 0; i < items_count; ++i) {
+    key_buf[sizeof(key_buf) - 2] = 'a' + i;
+    expect_item_set(cache, &key, &value);
+    if (!ybc_item_get(cache, m_get_item(items, i), &key)) {
+      M_ERROR("cannot find just added item");
+    }
+  }
+
+  provoke_data_wrapping(cache);
+
+  for (size_t i = 0; i < items_count; ++i) {
+    key_buf[sizeof(key_buf) - 2] = 'a' + i;
+    expect_value(m_get_item(items, i), &value);
+    ybc_item_release(m_get_item(items, i));
+  }
+
+  /*
+   * Verify concurrent access with slots.
+   */
   struct p_thread threads[threads_count];
   struct thread_task task = {
       .cache = cache,
@@ -1335,7 +2744,7 @@ static void test_multithreaded_access(struct ybc *const cache,
     p_thread_init_and_start(&threads[i], thread_func, &task);
   }
 
-  p_sleep(300);
+  m_sleep(300);
   task.should_exit = 1;
 
   for (size_t i = 0; i < threads_count; ++i) {
@@ -1359,8 +2768,16 @@ int main(void)
   test_dogpile_effect_ops_async(cache);
   test_dogpile_effect_ops(cache);
   test_dogpile_effect_hashtable(cache);
+  test_dogpile_effect_refresh(cache);
+  test_dogpile_effect_refresh_full_hashtable(cache);
+  test_dogpile_effect_wakeup(cache);
+  test_dogpile_effect_notify(cache);
   test_cluster_ops(5, 1000);
   test_simple_ops(cache);
+  test_various_key_sizes(cache);
+  test_item_get_multi(cache, 1000);
+  test_item_set_multi(cache, 1000);
+  test_stats(cache);
 
   test_overlapped_acquirements(cache, 1000);
   test_interleaved_sets(cache);
@@ -1372,12 +2789,24 @@ int main(void)
   test_out_of_memory(cache);
   test_data_compaction(cache);
   test_small_sync_interval(cache);
+  test_sync_backlog(cache);
+  test_item_residency(cache);
+  test_item_value_location(cache);
+  test_storage_arenas(cache);
+  test_clock_eviction(cache);
+  test_huge_pages(cache);
+  test_index_warmup(cache);
+  test_hot_data_prefetch(cache);
+  test_map_cache_snapshot(cache);
+  test_autosize(cache);
+  test_ws_one_off_items(cache);
 
   test_disabled_hot_items_cache(cache);
   test_disabled_data_compaction(cache);
   test_disabled_syncing(cache);
 
   test_multithreaded_access(cache, 100);
+  test_item_slots(cache, 100);
 
   printf("All functional tests done\n");
   return 0;
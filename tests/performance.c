@@ -6,10 +6,17 @@
 #include "../ybc.h"
 
 #include <assert.h>
+#include <math.h>    /* pow */
 #include <stdint.h>  /* uint*_t */
 #include <stdio.h>   /* printf */
-#include <stdlib.h>  /* exit, free */
-#include <string.h>  /* memset, memcmp */
+#include <stdlib.h>  /* exit, free, strtoull, strtod */
+#include <string.h>  /* memset, memcmp, strchr, strcmp, strncmp, strlen */
+
+#ifdef YBC_PLATFORM_LINUX
+  #include <linux/perf_event.h>  /* perf_event_attr, PERF_* */
+  #include <sys/ioctl.h>         /* ioctl */
+  #include <sys/syscall.h>       /* SYS_perf_event_open */
+#endif
 
 
 #define M_ERROR(error_message)  do { \
@@ -27,6 +34,11 @@ static void m_rand_init(struct m_rand_state *const rs)
   rs->s = p_get_current_time();
 }
 
+static void m_rand_seed(struct m_rand_state *const rs, const uint64_t seed)
+{
+  rs->s = seed;
+}
+
 static uint64_t m_rand_next(struct m_rand_state *const rs)
 {
   /*
@@ -40,6 +52,71 @@ static uint64_t m_rand_next(struct m_rand_state *const rs)
   return rs->s;
 }
 
+static double m_rand_next_double(struct m_rand_state *const rs)
+{
+  /* Use the upper 53 bits, since lower bits of LCG aren't random enough. */
+  return (m_rand_next(rs) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Zipfian distribution generator.
+ *
+ * The algorithm is taken from "Quickly Generating Billion-Record Synthetic
+ * Databases" by Jim Gray et al. It is also used in YCSB.
+ * Rank 0 is the most popular item.
+ */
+struct m_zipf_state
+{
+  struct m_rand_state rand_state;
+  size_t items_count;
+  double theta;
+  double alpha;
+  double zetan;
+  double eta;
+};
+
+static double m_zipf_zeta(const size_t n, const double theta)
+{
+  double sum = 0;
+
+  for (size_t i = 1; i <= n; ++i) {
+    sum += 1.0 / pow((double)i, theta);
+  }
+  return sum;
+}
+
+static void m_zipf_init(struct m_zipf_state *const zs, const size_t items_count,
+    const double theta)
+{
+  assert(items_count > 1);
+  assert(theta > 0 && theta < 1);
+
+  m_rand_init(&zs->rand_state);
+  zs->items_count = items_count;
+  zs->theta = theta;
+  zs->alpha = 1.0 / (1.0 - theta);
+  zs->zetan = m_zipf_zeta(items_count, theta);
+  zs->eta = (1.0 - pow(2.0 / items_count, 1.0 - theta)) /
+      (1.0 - m_zipf_zeta(2, theta) / zs->zetan);
+}
+
+static size_t m_zipf_next(struct m_zipf_state *const zs)
+{
+  const double u = m_rand_next_double(&zs->rand_state);
+  const double uz = u * zs->zetan;
+
+  if (uz < 1.0) {
+    return 0;
+  }
+  if (uz < 1.0 + pow(0.5, zs->theta)) {
+    return 1;
+  }
+
+  const size_t rank = (size_t)(zs->items_count *
+      pow(zs->eta * u - zs->eta + 1.0, zs->alpha));
+  return (rank < zs->items_count) ? rank : (zs->items_count - 1);
+}
+
 /*
  * Use custom memset() implementation in order to avoid silly
  * "memset used with constant zero length parameter" warning in gcc.
@@ -68,8 +145,206 @@ static int m_memset_check(const void *const s, const char c, const size_t n)
   return 1;
 }
 
+/*
+ * Latency histogram with logarithmic buckets.
+ *
+ * Each power of two range is split into M_HIST_SUB_BUCKETS_COUNT linear
+ * sub-buckets, so the relative error of reported values doesn't exceed
+ * 1 / M_HIST_SUB_BUCKETS_COUNT. This is similar to HdrHistogram.
+ */
+#define M_HIST_SUB_BUCKETS_BITS 4
+#define M_HIST_SUB_BUCKETS_COUNT (1 << M_HIST_SUB_BUCKETS_BITS)
+#define M_HIST_BUCKETS_COUNT ((64 - M_HIST_SUB_BUCKETS_BITS + 1) * \
+    M_HIST_SUB_BUCKETS_COUNT)
+
+struct m_hist
+{
+  uint64_t counts[M_HIST_BUCKETS_COUNT];
+  uint64_t total_count;
+  uint64_t max_value;
+};
+
+static void m_hist_init(struct m_hist *const hist)
+{
+  memset(hist, 0, sizeof(*hist));
+}
+
+static size_t m_hist_get_bucket_index(const uint64_t value)
+{
+  if (value < M_HIST_SUB_BUCKETS_COUNT) {
+    return (size_t)value;
+  }
+
+  /* magnitude = floor(log2(value)) */
+  size_t magnitude = M_HIST_SUB_BUCKETS_BITS;
+  while ((value >> (magnitude + 1)) != 0) {
+    ++magnitude;
+  }
+
+  const size_t sub_index = (size_t)(value >>
+      (magnitude - M_HIST_SUB_BUCKETS_BITS)) & (M_HIST_SUB_BUCKETS_COUNT - 1);
+  return (magnitude - M_HIST_SUB_BUCKETS_BITS + 1) * M_HIST_SUB_BUCKETS_COUNT +
+      sub_index;
+}
+
+/*
+ * Returns the lower bound of values belonging to the given bucket.
+ */
+static uint64_t m_hist_get_bucket_value(const size_t index)
+{
+  if (index < M_HIST_SUB_BUCKETS_COUNT) {
+    return index;
+  }
+
+  const size_t magnitude = index / M_HIST_SUB_BUCKETS_COUNT +
+      M_HIST_SUB_BUCKETS_BITS - 1;
+  const uint64_t mantissa = M_HIST_SUB_BUCKETS_COUNT +
+      index % M_HIST_SUB_BUCKETS_COUNT;
+  return mantissa << (magnitude - M_HIST_SUB_BUCKETS_BITS);
+}
+
+static void m_hist_add(struct m_hist *const hist, const uint64_t value)
+{
+  ++hist->counts[m_hist_get_bucket_index(value)];
+  ++hist->total_count;
+  if (value > hist->max_value) {
+    hist->max_value = value;
+  }
+}
+
+static void m_hist_merge(struct m_hist *const dst,
+    const struct m_hist *const src)
+{
+  for (size_t i = 0; i < M_HIST_BUCKETS_COUNT; ++i) {
+    dst->counts[i] += src->counts[i];
+  }
+  dst->total_count += src->total_count;
+  if (src->max_value > dst->max_value) {
+    dst->max_value = src->max_value;
+  }
+}
+
+/*
+ * Returns the value at the given percentile in the range [0 .. 100].
+ */
+static uint64_t m_hist_get_percentile(const struct m_hist *const hist,
+    const double percentile)
+{
+  const uint64_t rank = (uint64_t)(hist->total_count * percentile / 100);
+  uint64_t count = 0;
+
+  for (size_t i = 0; i < M_HIST_BUCKETS_COUNT; ++i) {
+    count += hist->counts[i];
+    if (count > rank) {
+      const uint64_t value = m_hist_get_bucket_value(i);
+      return (value < hist->max_value) ? value : hist->max_value;
+    }
+  }
+  return hist->max_value;
+}
+
+static void m_hist_print(const struct m_hist *const hist,
+    const char *const name)
+{
+  if (hist->total_count == 0) {
+    return;
+  }
+  printf("  %-6s latency : p50=%lluns p99=%lluns p99.9=%lluns max=%lluns "
+      "(%llu ops)\n", name,
+      (unsigned long long)m_hist_get_percentile(hist, 50),
+      (unsigned long long)m_hist_get_percentile(hist, 99),
+      (unsigned long long)m_hist_get_percentile(hist, 99.9),
+      (unsigned long long)hist->max_value,
+      (unsigned long long)hist->total_count);
+}
+
+/*
+ * Cache operations tracked by workload and trace replay measurements.
+ */
+enum m_op
+{
+  M_OP_GET,
+  M_OP_SET,
+  M_OP_REMOVE,
+  M_OPS_COUNT,
+};
+
+static const char *const m_op_names[M_OPS_COUNT] = {
+  "get",
+  "set",
+  "remove",
+};
+
+/*
+ * Results of workload and trace replay measurements.
+ */
+struct m_op_results
+{
+  struct m_hist hists[M_OPS_COUNT];
+  uint64_t get_hits_count;
+};
+
+static void m_op_results_init(struct m_op_results *const results)
+{
+  for (size_t i = 0; i < M_OPS_COUNT; ++i) {
+    m_hist_init(&results->hists[i]);
+  }
+  results->get_hits_count = 0;
+}
+
+static void m_op_results_merge(struct m_op_results *const dst,
+    const struct m_op_results *const src)
+{
+  for (size_t i = 0; i < M_OPS_COUNT; ++i) {
+    m_hist_merge(&dst->hists[i], &src->hists[i]);
+  }
+  dst->get_hits_count += src->get_hits_count;
+}
+
+static void m_op_results_print_latencies(
+    const struct m_op_results *const results)
+{
+  for (size_t i = 0; i < M_OPS_COUNT; ++i) {
+    m_hist_print(&results->hists[i], m_op_names[i]);
+  }
+}
+
+static void m_op_results_print(const struct m_op_results *const results,
+    const uint64_t requests_count, const double duration_ms)
+{
+  const uint64_t gets_count = results->hists[M_OP_GET].total_count;
+
+  printf("  throughput     : %.2f qps\n",
+      requests_count / duration_ms * 1000);
+  if (gets_count > 0) {
+    printf("  hit_ratio      : %.2f%%\n",
+        100.0 * results->get_hits_count / gets_count);
+  }
+  m_op_results_print_latencies(results);
+}
+
+/*
+ * Helpers for measuring per-op latencies in loops.
+ *
+ * Latencies aren't measured if results is NULL, so single-threaded
+ * measurements aren't affected by clock reads.
+ */
+static uint64_t m_op_start(const struct m_op_results *const results)
+{
+  return (results == NULL) ? 0 : p_get_monotonic_time_ns();
+}
+
+static void m_op_end(struct m_op_results *const results, const enum m_op op,
+    const uint64_t start_time)
+{
+  if (results != NULL) {
+    m_hist_add(&results->hists[op], p_get_monotonic_time_ns() - start_time);
+  }
+}
+
 static void simple_set(struct ybc *const cache, const size_t requests_count,
-    const size_t items_count, const size_t max_item_size)
+    const size_t items_count, const size_t max_item_size,
+    struct m_op_results *const results)
 {
   struct m_rand_state rand_state;
   uint64_t tmp;
@@ -93,17 +368,60 @@ static void simple_set(struct ybc *const cache, const size_t requests_count,
     value.size = m_rand_next(&rand_state) % (max_item_size + 1);
     m_memset(buf, (char)value.size, value.size);
 
+    const uint64_t start_time = m_op_start(results);
     if (!ybc_item_set(cache, &key, &value)) {
       M_ERROR("Cannot store item in the cache");
     }
+    m_op_end(results, M_OP_SET, start_time);
   }
 
   p_free(buf);
 }
 
-static void simple_set_simple(struct ybc *const cache,
+static void simple_set_multi(struct ybc *const cache,
     const size_t requests_count, const size_t items_count,
     const size_t max_item_size)
+{
+  static const size_t batch_size = 64;
+
+  struct m_rand_state rand_state;
+  uint64_t tmps[batch_size];
+  struct ybc_key keys[batch_size];
+  struct ybc_value values[batch_size];
+
+  char *const buf = p_malloc(max_item_size * batch_size);
+
+  for (size_t i = 0; i < batch_size; ++i) {
+    keys[i].ptr = &tmps[i];
+    keys[i].size = sizeof(tmps[i]);
+    values[i].ptr = buf + max_item_size * i;
+    values[i].ttl = YBC_MAX_TTL;
+  }
+
+  m_rand_init(&rand_state);
+
+  for (size_t i = 0; i < requests_count; i += batch_size) {
+    size_t n = requests_count - i;
+    if (n > batch_size) {
+      n = batch_size;
+    }
+    for (size_t j = 0; j < n; ++j) {
+      tmps[j] = m_rand_next(&rand_state) % items_count;
+      values[j].size = m_rand_next(&rand_state) % (max_item_size + 1);
+      m_memset((char *)values[j].ptr, (char)values[j].size, values[j].size);
+    }
+
+    if (ybc_item_set_multi(cache, keys, values, n) != n) {
+      M_ERROR("Cannot store items in the cache");
+    }
+  }
+
+  p_free(buf);
+}
+
+static void simple_set_simple(struct ybc *const cache,
+    const size_t requests_count, const size_t items_count,
+    const size_t max_item_size, struct m_op_results *const results)
 {
   struct m_rand_state rand_state;
   uint64_t tmp;
@@ -127,16 +445,19 @@ static void simple_set_simple(struct ybc *const cache,
     value.size = m_rand_next(&rand_state) % (max_item_size + 1);
     m_memset(buf, (char)value.size, value.size);
 
+    const uint64_t start_time = m_op_start(results);
     if (!ybc_simple_set(cache, &key, &value)) {
       M_ERROR("Cannot store item in the cache");
     }
+    m_op_end(results, M_OP_SET, start_time);
   }
 
   p_free(buf);
 }
 
 static void simple_get_miss(struct ybc *const cache,
-    const size_t requests_count, const size_t items_count)
+    const size_t requests_count, const size_t items_count,
+    struct m_op_results *const results)
 {
   char item_buf[ybc_item_get_size()];
   struct ybc_item *const item = (struct ybc_item *)item_buf;
@@ -153,15 +474,20 @@ static void simple_get_miss(struct ybc *const cache,
   for (size_t i = 0; i < requests_count; ++i) {
     tmp = m_rand_next(&rand_state) % items_count;
 
+    const uint64_t start_time = m_op_start(results);
     if (ybc_item_get(cache, item, &key)) {
       M_ERROR("Unexpected item found");
     }
+    m_op_end(results, M_OP_GET, start_time);
   }
 }
 
-static void simple_get_hit(struct ybc *const cache,
+/*
+ * Returns the number of misses.
+ */
+static size_t simple_get_hit(struct ybc *const cache,
     const size_t requests_count, const size_t items_count,
-    const size_t max_item_size)
+    const size_t max_item_size, struct m_op_results *const results)
 {
   char item_buf[ybc_item_get_size()];
   struct ybc_item *const item = (struct ybc_item *)item_buf;
@@ -173,13 +499,21 @@ static void simple_get_hit(struct ybc *const cache,
       .size = sizeof(tmp),
   };
   struct ybc_value value;
+  size_t misses_count = 0;
 
   m_rand_init(&rand_state);
 
   for (size_t i = 0; i < requests_count; ++i) {
     tmp = m_rand_next(&rand_state) % items_count;
 
-    if (ybc_item_get(cache, item, &key)) {
+    const uint64_t start_time = m_op_start(results);
+    const int is_found = ybc_item_get(cache, item, &key);
+    m_op_end(results, M_OP_GET, start_time);
+
+    if (!is_found) {
+      ++misses_count;
+    }
+    else {
       /* Emulate access to the item */
       ybc_item_get_value(item, &value);
       if (value.size > max_item_size) {
@@ -192,11 +526,13 @@ static void simple_get_hit(struct ybc *const cache,
       ybc_item_release(item);
     }
   }
+
+  return misses_count;
 }
 
 static void simple_get_simple_hit(struct ybc *const cache,
     const size_t requests_count, const size_t items_count,
-    const size_t max_item_size)
+    const size_t max_item_size, struct m_op_results *const results)
 {
   struct m_rand_state rand_state;
   uint64_t tmp;
@@ -215,7 +551,9 @@ static void simple_get_simple_hit(struct ybc *const cache,
     tmp = m_rand_next(&rand_state) % items_count;
 
     value.size = max_item_size;
+    const uint64_t start_time = m_op_start(results);
     int rv = ybc_simple_get(cache, &key, &value);
+    m_op_end(results, M_OP_GET, start_time);
     if (rv == 0) {
       continue;
     }
@@ -233,9 +571,16 @@ static void simple_get_simple_hit(struct ybc *const cache,
   p_free((void *)value.ptr);
 }
 
+/*
+ * Pass it to m_open() for using the default sync interval.
+ */
+#define M_SYNC_INTERVAL_DEFAULT UINT64_MAX
+
 static void m_open(struct ybc *const cache, const int use_shm,
     const size_t items_count, const size_t hot_items_count,
-    const size_t max_item_size, const int has_overwrite_protection)
+    const size_t max_item_size, const int has_overwrite_protection,
+    const size_t storage_arenas_count, const size_t item_slots_count,
+    const uint64_t sync_interval)
 {
   char config_buf[ybc_config_get_size()];
   struct ybc_config *const config = (struct ybc_config *)config_buf;
@@ -252,6 +597,11 @@ static void m_open(struct ybc *const cache, const int use_shm,
   ybc_config_set_hot_items_count(config, hot_items_count);
   ybc_config_set_data_file_size(config, data_file_size);
   ybc_config_set_hot_data_size(config, hot_data_size);
+  ybc_config_set_storage_arenas_count(config, storage_arenas_count);
+  ybc_config_set_item_slots_count(config, item_slots_count);
+  if (sync_interval != M_SYNC_INTERVAL_DEFAULT) {
+    ybc_config_set_sync_interval(config, sync_interval);
+  }
   if (!has_overwrite_protection) {
     ybc_config_disable_overwrite_protection(config);
   }
@@ -293,7 +643,7 @@ static void measure_simple_ops(struct ybc *const cache, const int use_shm,
   double qps;
 
   m_open(cache, use_shm, items_count, hot_items_count, max_item_size,
-      has_overwrite_protection);
+      has_overwrite_protection, 1, 0, M_SYNC_INTERVAL_DEFAULT);
 
   printf("simple_ops(requests=%zu, items=%zu, "
       "hot_items=%zu, max_item_size=%zu, has_overwrite_protection=%d, use_shm=%d)\n",
@@ -301,13 +651,13 @@ static void measure_simple_ops(struct ybc *const cache, const int use_shm,
       has_overwrite_protection, use_shm);
 
   start_time = p_get_current_time();
-  simple_get_miss(cache, requests_count, items_count);
+  simple_get_miss(cache, requests_count, items_count, NULL);
   end_time = p_get_current_time();
   qps = requests_count / (end_time - start_time) * 1000;
   printf("  get_miss     : %.02f qps\n", qps);
 
   start_time = p_get_current_time();
-  simple_set(cache, requests_count, items_count, max_item_size);
+  simple_set(cache, requests_count, items_count, max_item_size, NULL);
   end_time = p_get_current_time();
   qps = requests_count / (end_time - start_time) * 1000;
   printf("  set          : %.02f qps\n", qps);
@@ -317,7 +667,25 @@ static void measure_simple_ops(struct ybc *const cache, const int use_shm,
 
   if (has_overwrite_protection) {
     start_time = p_get_current_time();
-    simple_get_hit(cache, requests_count, get_items_count, max_item_size);
+    (void)simple_get_hit(cache, requests_count, get_items_count,
+        max_item_size, NULL);
+    end_time = p_get_current_time();
+    qps = requests_count / (end_time - start_time) * 1000;
+    printf("  get_hit      : %.02f qps\n", qps);
+  }
+
+  ybc_clear(cache);
+
+  start_time = p_get_current_time();
+  simple_set_multi(cache, requests_count, items_count, max_item_size);
+  end_time = p_get_current_time();
+  qps = requests_count / (end_time - start_time) * 1000;
+  printf("  set_multi    : %.02f qps\n", qps);
+
+  if (has_overwrite_protection) {
+    start_time = p_get_current_time();
+    (void)simple_get_hit(cache, requests_count, get_items_count,
+        max_item_size, NULL);
     end_time = p_get_current_time();
     qps = requests_count / (end_time - start_time) * 1000;
     printf("  get_hit      : %.02f qps\n", qps);
@@ -326,13 +694,14 @@ static void measure_simple_ops(struct ybc *const cache, const int use_shm,
   ybc_clear(cache);
 
   start_time = p_get_current_time();
-  simple_set_simple(cache, requests_count, items_count, max_item_size);
+  simple_set_simple(cache, requests_count, items_count, max_item_size, NULL);
   end_time = p_get_current_time();
   qps = requests_count / (end_time - start_time) * 1000;
   printf("  set_simple     : %.02f qps\n", qps);
 
   start_time = p_get_current_time();
-  simple_get_simple_hit(cache, requests_count, get_items_count, max_item_size);
+  simple_get_simple_hit(cache, requests_count, get_items_count, max_item_size,
+      NULL);
   end_time = p_get_current_time();
   qps = requests_count / (end_time - start_time) * 1000;
   printf("  get_simple_hit : %.02f qps\n", qps);
@@ -348,6 +717,12 @@ struct thread_task
   size_t items_count;
   size_t get_items_count;
   size_t max_item_size;
+  size_t misses_count;
+
+  /*
+   * Per-op latencies merged from all the threads.
+   */
+  struct m_op_results results;
 };
 
 static size_t get_batch_requests_count(struct thread_task *const task)
@@ -365,47 +740,71 @@ static size_t get_batch_requests_count(struct thread_task *const task)
     return requests_count;
 }
 
+static void merge_thread_results(struct thread_task *const task,
+    const struct m_op_results *const results)
+{
+  p_lock_lock(&task->lock);
+  m_op_results_merge(&task->results, results);
+  p_lock_unlock(&task->lock);
+}
+
 static void thread_func_set(void *const ctx)
 {
   struct thread_task *const task = ctx;
+  struct m_op_results results;
+
+  m_op_results_init(&results);
   for (;;) {
     const size_t requests_count = get_batch_requests_count(task);
     if (requests_count == 0) {
       break;
     }
     simple_set(task->cache, requests_count, task->items_count,
-        task->max_item_size);
+        task->max_item_size, &results);
   }
+  merge_thread_results(task, &results);
 }
 
 static void thread_func_get_miss(void *const ctx)
 {
   struct thread_task *const task = ctx;
+  struct m_op_results results;
+
+  m_op_results_init(&results);
   for (;;) {
     const size_t requests_count = get_batch_requests_count(task);
     if (requests_count == 0) {
       break;
     }
-    simple_get_miss(task->cache, requests_count, task->get_items_count);
+    simple_get_miss(task->cache, requests_count, task->get_items_count,
+        &results);
   }
+  merge_thread_results(task, &results);
 }
 
 static void thread_func_get_hit(void *const ctx)
 {
   struct thread_task *const task = ctx;
+  struct m_op_results results;
+
+  m_op_results_init(&results);
   for (;;) {
     const size_t requests_count = get_batch_requests_count(task);
     if (requests_count == 0) {
       break;
     }
-    simple_get_hit(task->cache, requests_count, task->get_items_count,
-        task->max_item_size);
+    (void)simple_get_hit(task->cache, requests_count, task->get_items_count,
+        task->max_item_size, &results);
   }
+  merge_thread_results(task, &results);
 }
 
 static void thread_func_set_get(void *const ctx)
 {
   struct thread_task *const task = ctx;
+  struct m_op_results results;
+
+  m_op_results_init(&results);
   for (;;) {
     const size_t requests_count = get_batch_requests_count(task);
     if (requests_count == 0) {
@@ -415,44 +814,64 @@ static void thread_func_set_get(void *const ctx)
     const size_t get_requests_count = requests_count - set_requests_count;
 
     simple_set(task->cache, set_requests_count, task->items_count,
-        task->max_item_size);
-    simple_get_hit(task->cache, get_requests_count, task->get_items_count,
-        task->max_item_size);
+        task->max_item_size, &results);
+    const size_t misses_count = simple_get_hit(task->cache,
+        get_requests_count, task->get_items_count, task->max_item_size,
+        &results);
+
+    p_lock_lock(&task->lock);
+    task->misses_count += misses_count;
+    p_lock_unlock(&task->lock);
   }
+  merge_thread_results(task, &results);
 }
 
 static void thread_func_set_simple(void *const ctx)
 {
   struct thread_task *const task = ctx;
+  struct m_op_results results;
+
+  m_op_results_init(&results);
   for (;;) {
     const size_t requests_count = get_batch_requests_count(task);
     if (requests_count == 0) {
       break;
     }
     simple_set_simple(task->cache, requests_count, task->items_count,
-        task->max_item_size);
+        task->max_item_size, &results);
   }
+  merge_thread_results(task, &results);
 }
 
 static void thread_func_get_simple_hit(void *const ctx)
 {
   struct thread_task *const task = ctx;
+  struct m_op_results results;
+
+  m_op_results_init(&results);
   for (;;) {
     const size_t requests_count = get_batch_requests_count(task);
     if (requests_count == 0) {
       break;
     }
     simple_get_simple_hit(task->cache, requests_count, task->get_items_count,
-        task->max_item_size);
+        task->max_item_size, &results);
   }
+  merge_thread_results(task, &results);
 }
 
+/*
+ * Returns qps for the given thread_func.
+ *
+ * Per-op latencies are collected into task->results.
+ */
 static double measure_qps(struct thread_task *const task,
     const p_thread_func thread_func, const size_t threads_count,
     const size_t requests_count)
 {
   struct p_thread threads[threads_count];
   task->requests_count = requests_count;
+  m_op_results_init(&task->results);
 
   double start_time = p_get_current_time();
   for (size_t i = 0; i < threads_count; ++i) {
@@ -467,16 +886,25 @@ static double measure_qps(struct thread_task *const task,
   return requests_count / (end_time - start_time) * 1000;
 }
 
+/*
+ * Measures qps and per-op latencies for multiple threads.
+ *
+ * Short sync_interval allows measuring interference between cache accesses
+ * and data syncing.
+ */
 static void measure_multithreaded_ops(struct ybc *const cache,
     const int use_shm,
     const size_t threads_count, const size_t requests_count,
     const size_t items_count, const size_t hot_items_count,
-    const size_t max_item_size, const int has_overwrite_protection)
+    const size_t max_item_size, const int has_overwrite_protection,
+    const size_t storage_arenas_count, const size_t item_slots_count,
+    const uint64_t sync_interval)
 {
   double qps;
 
   m_open(cache, use_shm, items_count, hot_items_count, max_item_size,
-      has_overwrite_protection);
+      has_overwrite_protection, storage_arenas_count, item_slots_count,
+      sync_interval);
 
   struct thread_task task = {
       .cache = cache,
@@ -488,24 +916,33 @@ static void measure_multithreaded_ops(struct ybc *const cache,
   p_lock_init(&task.lock);
 
   printf("multithreaded_ops(requests=%zu, items=%zu, hot_items=%zu, "
-      "max_item_size=%zu, threads=%zu, has_overwrite_protection=%d, use_shm=%d)\n",
-      requests_count, items_count, hot_items_count, max_item_size,
-      threads_count, has_overwrite_protection, use_shm);
+      "max_item_size=%zu, threads=%zu, has_overwrite_protection=%d, use_shm=%d, "
+      "storage_arenas=%zu, item_slots=%zu", requests_count, items_count,
+      hot_items_count, max_item_size, threads_count, has_overwrite_protection,
+      use_shm, storage_arenas_count, item_slots_count);
+  if (sync_interval != M_SYNC_INTERVAL_DEFAULT) {
+    printf(", sync_interval=%llu", (unsigned long long)sync_interval);
+  }
+  printf(")\n");
 
   qps = measure_qps(&task, thread_func_get_miss, threads_count, requests_count);
   printf("  get_miss       : %.2f qps\n", qps);
+  m_op_results_print_latencies(&task.results);
 
   qps = measure_qps(&task, thread_func_set, threads_count, requests_count);
   printf("  set            : %.2f qps\n", qps);
+  m_op_results_print_latencies(&task.results);
 
   if (has_overwrite_protection) {
     qps = measure_qps(&task, thread_func_get_hit, threads_count,
         requests_count);
     printf("  get_hit        : %.2f qps\n", qps);
+    m_op_results_print_latencies(&task.results);
 
     qps = measure_qps(&task, thread_func_set_get, threads_count,
         requests_count);
     printf("  get_set        : %.2f qps\n", qps);
+    m_op_results_print_latencies(&task.results);
   }
 
   ybc_clear(cache);
@@ -513,44 +950,1168 @@ static void measure_multithreaded_ops(struct ybc *const cache,
   qps = measure_qps(&task, thread_func_set_simple, threads_count,
       requests_count);
   printf("  set_simple     : %.2f qps\n", qps);
+  m_op_results_print_latencies(&task.results);
 
   qps = measure_qps(&task, thread_func_get_simple_hit, threads_count,
       requests_count);
   printf("  get_simple_hit : %.2f qps\n", qps);
+  m_op_results_print_latencies(&task.results);
 
   p_lock_destroy(&task.lock);
 
   m_close(cache, use_shm);
 }
 
-int main(void)
+/*
+ * Measures the rate of false misses under concurrent sets and gets.
+ *
+ * All the items are stored in the cache before the measurement and the cache
+ * is large enough for avoiding storage wraps, so every miss during
+ * the measurement is caused by concurrent access to the index.
+ */
+static void measure_false_misses(struct ybc *const cache,
+    const size_t threads_count, const size_t requests_count,
+    const size_t items_count, const size_t max_item_size)
 {
-  char cache_buf[ybc_get_size()];
-  struct ybc *const cache = (struct ybc *)cache_buf;
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+  struct ybc_stats stats;
 
-  const size_t requests_count = 4 * 1000 * 1000;
-  const size_t items_count = 200 * 1000;
+  /* Leave enough room for each set request plus per-item overhead. */
+  const size_t data_file_size = (items_count + requests_count) *
+      (max_item_size + 64);
 
-  for (size_t max_item_size = 8; max_item_size <= 4096; max_item_size *= 2) {
-    measure_simple_ops(cache, 0, requests_count, items_count, 0, max_item_size, 0);
-    measure_simple_ops(cache, 0, requests_count, items_count, 0, max_item_size, 1);
-    measure_simple_ops(cache, 1, requests_count, items_count, 0, max_item_size, 0);
-    measure_simple_ops(cache, 1, requests_count, items_count, 0, max_item_size, 1);
-    for (size_t hot_items_count = 1000; hot_items_count <= items_count;
-        hot_items_count *= 10) {
-      measure_simple_ops(cache, 0, requests_count, items_count, hot_items_count, max_item_size, 0);
-      measure_simple_ops(cache, 0, requests_count, items_count, hot_items_count, max_item_size, 1);
-      measure_simple_ops(cache, 1, requests_count, items_count, hot_items_count, max_item_size, 0);
-      measure_simple_ops(cache, 1, requests_count, items_count, hot_items_count, max_item_size, 1);
-    }
+  ybc_config_init(config);
+  ybc_config_set_max_items_count(config, items_count * 4);
+  ybc_config_set_data_file_size(config, data_file_size);
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("Cannot create a cache");
+  }
+  ybc_config_destroy(config);
 
-    for (size_t threads_count = 1; threads_count <= 16; threads_count *= 2) {
-      measure_multithreaded_ops(cache, 0, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 0);
-      measure_multithreaded_ops(cache, 0, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 1);
-      measure_multithreaded_ops(cache, 1, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 0);
-      measure_multithreaded_ops(cache, 1, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 1);
+  char *const buf = p_malloc(max_item_size);
+  uint64_t tmp;
+  const struct ybc_key key = {
+      .ptr = &tmp,
+      .size = sizeof(tmp),
+  };
+  struct ybc_value value = {
+      .ptr = buf,
+      .size = 0,
+      .ttl = YBC_MAX_TTL,
+  };
+  for (tmp = 0; tmp < items_count; ++tmp) {
+    value.size = tmp % (max_item_size + 1);
+    m_memset(buf, (char)value.size, value.size);
+    if (!ybc_item_set(cache, &key, &value)) {
+      M_ERROR("Cannot store item in the cache");
     }
   }
+  p_free(buf);
+
+  struct thread_task task = {
+      .cache = cache,
+      .items_count = items_count,
+      .get_items_count = items_count,
+      .max_item_size = max_item_size,
+      .misses_count = 0,
+  };
+
+  p_lock_init(&task.lock);
+
+  const double qps = measure_qps(&task, thread_func_set_get, threads_count,
+      requests_count);
+
+  p_lock_destroy(&task.lock);
+
+  ybc_get_stats(cache, &stats);
+  ybc_close(cache);
+
+  const size_t get_requests_count = (size_t)(requests_count * 0.9);
+  printf("false_misses(requests=%zu, items=%zu, max_item_size=%zu, "
+      "threads=%zu)\n", requests_count, items_count, max_item_size,
+      threads_count);
+  printf("  get_set                 : %.2f qps\n", qps);
+  printf("  false_misses            : %zu (%.4f%%)\n", task.misses_count,
+      100.0 * task.misses_count / get_requests_count);
+  printf("  payload_check_failures  : %llu\n",
+      (unsigned long long)stats.payload_check_failures);
+  printf("  metadata_check_failures : %llu\n",
+      (unsigned long long)stats.metadata_check_failures);
+  printf("  map_victim_overwrites   : %llu\n",
+      (unsigned long long)stats.map_victim_overwrites);
+}
+
+/*
+ * Measures hit ratio for get-or-set workload with Zipfian key popularity.
+ *
+ * The index is much smaller than the number of distinct keys, while
+ * the storage is large enough for avoiding wraps. So the hit ratio depends
+ * only on items' eviction from the index.
+ */
+static void measure_zipf_hit_ratio(struct ybc *const cache,
+    const size_t requests_count, const size_t items_count,
+    const size_t max_items_count, const double theta,
+    const int has_clock_eviction)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+  struct m_zipf_state zipf_state;
+  size_t hits_count = 0;
+  uint64_t tmp;
+
+  ybc_config_init(config);
+  ybc_config_set_max_items_count(config, max_items_count);
+  ybc_config_set_hot_items_count(config, 0);
+  ybc_config_set_data_file_size(config, requests_count * 64);
+  if (has_clock_eviction) {
+    ybc_config_enable_clock_eviction(config);
+  }
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("Cannot create a cache");
+  }
+  ybc_config_destroy(config);
+
+  const struct ybc_key key = {
+      .ptr = &tmp,
+      .size = sizeof(tmp),
+  };
+  const struct ybc_value value = {
+      .ptr = &tmp,
+      .size = sizeof(tmp),
+      .ttl = YBC_MAX_TTL,
+  };
+
+  m_zipf_init(&zipf_state, items_count, theta);
+
+  double start_time = p_get_current_time();
+  for (size_t i = 0; i < requests_count; ++i) {
+    tmp = m_zipf_next(&zipf_state);
+
+    if (ybc_item_get(cache, item, &key)) {
+      ybc_item_release(item);
+      ++hits_count;
+    }
+    else if (!ybc_item_set(cache, &key, &value)) {
+      M_ERROR("Cannot store item in the cache");
+    }
+  }
+  double end_time = p_get_current_time();
+
+  ybc_close(cache);
+
+  printf("zipf_hit_ratio(requests=%zu, items=%zu, max_items=%zu, theta=%.2f, "
+      "has_clock_eviction=%d)\n", requests_count, items_count,
+      max_items_count, theta, has_clock_eviction);
+  printf("  get_or_set : %.2f qps\n",
+      requests_count / (end_time - start_time) * 1000);
+  printf("  hit_ratio  : %.2f%%\n", 100.0 * hits_count / requests_count);
+}
+
+static void run_suite(struct ybc *const cache, const size_t requests_count,
+    const size_t items_count)
+{
+  for (size_t max_item_size = 8; max_item_size <= 4096; max_item_size *= 2) {
+    measure_simple_ops(cache, 0, requests_count, items_count, 0, max_item_size, 0);
+    measure_simple_ops(cache, 0, requests_count, items_count, 0, max_item_size, 1);
+    measure_simple_ops(cache, 1, requests_count, items_count, 0, max_item_size, 0);
+    measure_simple_ops(cache, 1, requests_count, items_count, 0, max_item_size, 1);
+    for (size_t hot_items_count = 1000; hot_items_count <= items_count;
+        hot_items_count *= 10) {
+      measure_simple_ops(cache, 0, requests_count, items_count, hot_items_count, max_item_size, 0);
+      measure_simple_ops(cache, 0, requests_count, items_count, hot_items_count, max_item_size, 1);
+      measure_simple_ops(cache, 1, requests_count, items_count, hot_items_count, max_item_size, 0);
+      measure_simple_ops(cache, 1, requests_count, items_count, hot_items_count, max_item_size, 1);
+    }
+
+    for (size_t threads_count = 1; threads_count <= 32; threads_count *= 2) {
+      measure_multithreaded_ops(cache, 0, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 0, 1, 0, M_SYNC_INTERVAL_DEFAULT);
+      measure_multithreaded_ops(cache, 0, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 1, 1, 0, M_SYNC_INTERVAL_DEFAULT);
+      measure_multithreaded_ops(cache, 1, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 0, 1, 0, M_SYNC_INTERVAL_DEFAULT);
+      measure_multithreaded_ops(cache, 1, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 1, 1, 0, M_SYNC_INTERVAL_DEFAULT);
+      measure_multithreaded_ops(cache, 0, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 1, threads_count, 0, M_SYNC_INTERVAL_DEFAULT);
+      measure_multithreaded_ops(cache, 0, threads_count, requests_count, items_count, 10 * 1000, max_item_size, 1, 1, threads_count, M_SYNC_INTERVAL_DEFAULT);
+    }
+  }
+
+  /* Measure interference between cache accesses and data syncing. */
+  for (size_t threads_count = 1; threads_count <= 32; threads_count *= 2) {
+    measure_multithreaded_ops(cache, 0, threads_count, requests_count,
+        items_count, 10 * 1000, 1024, 1, 1, 0, 100);
+  }
+
+  for (size_t max_items_count = items_count / 100;
+      max_items_count <= items_count; max_items_count *= 10) {
+    measure_zipf_hit_ratio(cache, requests_count, items_count,
+        max_items_count, 0.99, 0);
+    measure_zipf_hit_ratio(cache, requests_count, items_count,
+        max_items_count, 0.99, 1);
+  }
+
+  for (size_t threads_count = 1; threads_count <= 32; threads_count *= 2) {
+    measure_false_misses(cache, threads_count, requests_count / 4,
+        items_count, 64);
+  }
+}
+
+/*
+ * Runs the given operation and registers its' latency in the results.
+ */
+static int m_op_get(struct ybc *const cache, struct ybc_item *const item,
+    const struct ybc_key *const key, struct m_op_results *const results)
+{
+  const uint64_t start_time = m_op_start(results);
+  const int is_found = ybc_item_get(cache, item, key);
+  if (is_found) {
+    ybc_item_release(item);
+  }
+  m_op_end(results, M_OP_GET, start_time);
+
+  if (is_found) {
+    ++results->get_hits_count;
+  }
+  return is_found;
+}
+
+static void m_op_set(struct ybc *const cache, const struct ybc_key *const key,
+    const struct ybc_value *const value, struct m_op_results *const results)
+{
+  const uint64_t start_time = m_op_start(results);
+  const int is_stored = ybc_item_set(cache, key, value);
+  m_op_end(results, M_OP_SET, start_time);
+
+  if (!is_stored) {
+    M_ERROR("Cannot store item in the cache");
+  }
+}
+
+static void m_op_remove(struct ybc *const cache,
+    const struct ybc_key *const key, struct m_op_results *const results)
+{
+  const uint64_t start_time = m_op_start(results);
+  (void)ybc_item_remove(cache, key);
+  m_op_end(results, M_OP_REMOVE, start_time);
+}
+
+/*
+ * Key distributions for workload measurements.
+ */
+enum m_distribution
+{
+  /* All the keys are equally popular. */
+  M_DISTRIBUTION_UNIFORM,
+
+  /* Key popularity follows Zipf's law. Key 0 is the most popular. */
+  M_DISTRIBUTION_ZIPF,
+
+  /*
+   * Zipfian popularity, but popular keys are scattered over the whole
+   * key space.
+   */
+  M_DISTRIBUTION_SCRAMBLED_ZIPF,
+
+  /*
+   * Recently inserted keys are the most popular. Sets insert new keys.
+   */
+  M_DISTRIBUTION_LATEST,
+};
+
+static const char *const m_distribution_names[] = {
+  "uniform",
+  "zipf",
+  "scrambled_zipf",
+  "latest",
+};
+
+struct m_key_gen
+{
+  enum m_distribution distribution;
+  struct m_rand_state rand_state;
+  struct m_zipf_state zipf_state;
+  size_t items_count;
+
+  /*
+   * The number of inserted keys shared among all the generators
+   * for M_DISTRIBUTION_LATEST.
+   */
+  size_t *latest_count_ptr;
+};
+
+static void m_key_gen_init(struct m_key_gen *const kg,
+    const enum m_distribution distribution, const size_t items_count,
+    const double theta, size_t *const latest_count_ptr)
+{
+  kg->distribution = distribution;
+  m_rand_init(&kg->rand_state);
+  kg->items_count = items_count;
+  kg->latest_count_ptr = latest_count_ptr;
+  if (distribution != M_DISTRIBUTION_UNIFORM) {
+    m_zipf_init(&kg->zipf_state, items_count, theta);
+  }
+}
+
+/*
+ * Initializes a generator for a thread from the prototype generator.
+ *
+ * This avoids expensive zeta calculations for each thread.
+ */
+static void m_key_gen_clone(struct m_key_gen *const kg,
+    const struct m_key_gen *const prototype, const uint64_t seed)
+{
+  *kg = *prototype;
+  m_rand_seed(&kg->rand_state, seed);
+  m_rand_seed(&kg->zipf_state.rand_state, m_rand_next(&kg->rand_state));
+}
+
+static uint64_t m_key_gen_scramble(const uint64_t v)
+{
+  /* FNV-1a over v bytes. */
+  uint64_t h = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < sizeof(v); ++i) {
+    h ^= (v >> (i * 8)) & 0xff;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static uint64_t m_key_gen_next(struct m_key_gen *const kg)
+{
+  switch (kg->distribution) {
+  case M_DISTRIBUTION_UNIFORM:
+    return m_rand_next(&kg->rand_state) % kg->items_count;
+  case M_DISTRIBUTION_ZIPF:
+    return m_zipf_next(&kg->zipf_state);
+  case M_DISTRIBUTION_SCRAMBLED_ZIPF:
+    return m_key_gen_scramble(m_zipf_next(&kg->zipf_state)) %
+        kg->items_count;
+  case M_DISTRIBUTION_LATEST:
+    {
+      const size_t latest_count = p_atomic_load(kg->latest_count_ptr);
+      const size_t rank = m_zipf_next(&kg->zipf_state);
+      return (rank < latest_count) ? (latest_count - 1 - rank) : 0;
+    }
+  default:
+    assert(0 && "unexpected distribution");
+    return 0;
+  }
+}
+
+/*
+ * Returns a key for a set operation.
+ */
+static uint64_t m_key_gen_next_set(struct m_key_gen *const kg)
+{
+  if (kg->distribution != M_DISTRIBUTION_LATEST) {
+    return m_key_gen_next(kg);
+  }
+
+  /* Insert a new key. */
+  for (;;) {
+    const size_t latest_count = p_atomic_load(kg->latest_count_ptr);
+    if (p_atomic_cas(kg->latest_count_ptr, latest_count, latest_count + 1)) {
+      return latest_count;
+    }
+  }
+}
+
+/*
+ * Command-line options.
+ */
+enum m_mode
+{
+  /* Run hardcoded measurements. */
+  M_MODE_SUITE,
+
+  /* Run a synthetic workload with the given key distribution. */
+  M_MODE_WORKLOAD,
+
+  /* Write a synthetic workload into a trace file. */
+  M_MODE_TRACE_GEN,
+
+  /* Replay a trace file. */
+  M_MODE_REPLAY,
+};
+
+static const char *const m_mode_names[] = {
+  "suite",
+  "workload",
+  "trace-gen",
+  "replay",
+};
+
+struct m_options
+{
+  enum m_mode mode;
+  enum m_distribution distribution;
+  double theta;
+  double set_ratio;
+  size_t requests_count;
+  size_t items_count;
+  size_t max_items_count;
+  size_t hot_items_count;
+  size_t max_item_size;
+  size_t data_file_size;
+  size_t hot_data_size;
+  size_t threads_count;
+  size_t storage_arenas_count;
+  size_t item_slots_count;
+  uint64_t sync_interval;
+  uint64_t sync_bandwidth;
+  int fill_on_miss;
+  int has_clock_eviction;
+  int has_huge_pages;
+  int has_overwrite_protection;
+  int use_shm;
+  const char *trace_file;
+};
+
+static void m_options_init(struct m_options *const opts)
+{
+  opts->mode = M_MODE_SUITE;
+  opts->distribution = M_DISTRIBUTION_ZIPF;
+  opts->theta = 0.99;
+  opts->set_ratio = 0.1;
+  opts->requests_count = 4 * 1000 * 1000;
+  opts->items_count = 200 * 1000;
+  opts->max_items_count = 0;
+  opts->hot_items_count = 0;
+  opts->max_item_size = 64;
+  opts->data_file_size = 0;
+  opts->hot_data_size = 0;
+  opts->threads_count = 1;
+  opts->storage_arenas_count = 1;
+  opts->item_slots_count = 0;
+  opts->sync_interval = M_SYNC_INTERVAL_DEFAULT;
+  opts->sync_bandwidth = 0;
+  opts->fill_on_miss = 1;
+  opts->has_clock_eviction = 0;
+  opts->has_huge_pages = 0;
+  opts->has_overwrite_protection = 1;
+  opts->use_shm = 0;
+  opts->trace_file = NULL;
+}
+
+static void m_usage(const char *const program_name)
+{
+  fprintf(stderr,
+      "Usage: %s [--name=value ...]\n"
+      "\n"
+      "  --mode=suite|workload|trace-gen|replay  (default suite)\n"
+      "      suite runs hardcoded measurements with the given requests\n"
+      "      and items; workload runs a synthetic workload; trace-gen\n"
+      "      writes the synthetic workload into trace_file; replay replays\n"
+      "      trace_file.\n"
+      "  --distribution=uniform|zipf|scrambled_zipf|latest  (default zipf)\n"
+      "  --theta=N               Zipf skew in the range (0 .. 1)\n"
+      "  --set_ratio=N           the share of set requests in the range [0 .. 1]\n"
+      "  --fill_on_miss=0|1      store missing items after get\n"
+      "  --requests=N\n"
+      "  --items=N               the number of distinct keys\n"
+      "  --max_items=N           index size; defaults to items\n"
+      "  --hot_items=N\n"
+      "  --max_item_size=N\n"
+      "  --data_file_size=N      defaults to items * (max_item_size + 64)\n"
+      "  --hot_data_size=N\n"
+      "  --threads=N\n"
+      "  --storage_arenas=N\n"
+      "  --item_slots=N\n"
+      "  --sync_interval=N       data sync interval in milliseconds; 0 disables\n"
+      "                          syncing\n"
+      "  --sync_bandwidth=N      data sync bandwidth in bytes per second;\n"
+      "                          0 means unlimited\n"
+      "  --clock_eviction=0|1\n"
+      "  --huge_pages=0|1\n"
+      "  --overwrite_protection=0|1\n"
+      "  --use_shm=0|1\n"
+      "  --trace_file=PATH\n"
+      "\n"
+      "Trace file is a sequence of struct trace_record in native byte order.\n"
+      "See tests/performance.c for details.\n",
+      program_name);
+}
+
+static int m_parse_enum(const char *const value,
+    const char *const *const names, const size_t names_count, int *const dst)
+{
+  for (size_t i = 0; i < names_count; ++i) {
+    if (strcmp(value, names[i]) == 0) {
+      *dst = (int)i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int m_parse_size(const char *const value, size_t *const dst)
+{
+  char *end;
+
+  const unsigned long long v = strtoull(value, &end, 10);
+  if (*value == '\0' || *end != '\0' || v > SIZE_MAX) {
+    return 0;
+  }
+  *dst = (size_t)v;
+  return 1;
+}
+
+static int m_parse_double(const char *const value, double *const dst)
+{
+  char *end;
+
+  *dst = strtod(value, &end);
+  return (*value != '\0' && *end == '\0');
+}
+
+static int m_parse_bool(const char *const value, int *const dst)
+{
+  size_t v;
+
+  if (!m_parse_size(value, &v) || v > 1) {
+    return 0;
+  }
+  *dst = (int)v;
+  return 1;
+}
+
+static int m_options_parse_arg(struct m_options *const opts,
+    const char *const arg)
+{
+  if (strncmp(arg, "--", 2) != 0) {
+    return 0;
+  }
+
+  const char *const name = arg + 2;
+  const char *const eq = strchr(name, '=');
+  if (eq == NULL) {
+    return 0;
+  }
+
+  const size_t name_size = eq - name;
+  const char *const value = eq + 1;
+  int tmp;
+
+#define M_OPTION_IS(s) (name_size == strlen(s) && strncmp(name, s, name_size) == 0)
+
+  if (M_OPTION_IS("mode")) {
+    if (!m_parse_enum(value, m_mode_names,
+        sizeof(m_mode_names) / sizeof(m_mode_names[0]), &tmp)) {
+      return 0;
+    }
+    opts->mode = (enum m_mode)tmp;
+    return 1;
+  }
+  if (M_OPTION_IS("distribution")) {
+    if (!m_parse_enum(value, m_distribution_names,
+        sizeof(m_distribution_names) / sizeof(m_distribution_names[0]),
+        &tmp)) {
+      return 0;
+    }
+    opts->distribution = (enum m_distribution)tmp;
+    return 1;
+  }
+  if (M_OPTION_IS("theta")) {
+    return m_parse_double(value, &opts->theta) && opts->theta > 0 &&
+        opts->theta < 1;
+  }
+  if (M_OPTION_IS("set_ratio")) {
+    return m_parse_double(value, &opts->set_ratio) && opts->set_ratio >= 0 &&
+        opts->set_ratio <= 1;
+  }
+  if (M_OPTION_IS("fill_on_miss")) {
+    return m_parse_bool(value, &opts->fill_on_miss);
+  }
+  if (M_OPTION_IS("requests")) {
+    return m_parse_size(value, &opts->requests_count);
+  }
+  if (M_OPTION_IS("items")) {
+    return m_parse_size(value, &opts->items_count) && opts->items_count > 1;
+  }
+  if (M_OPTION_IS("max_items")) {
+    return m_parse_size(value, &opts->max_items_count);
+  }
+  if (M_OPTION_IS("hot_items")) {
+    return m_parse_size(value, &opts->hot_items_count);
+  }
+  if (M_OPTION_IS("max_item_size")) {
+    return m_parse_size(value, &opts->max_item_size);
+  }
+  if (M_OPTION_IS("data_file_size")) {
+    return m_parse_size(value, &opts->data_file_size);
+  }
+  if (M_OPTION_IS("hot_data_size")) {
+    return m_parse_size(value, &opts->hot_data_size);
+  }
+  if (M_OPTION_IS("threads")) {
+    return m_parse_size(value, &opts->threads_count) &&
+        opts->threads_count > 0;
+  }
+  if (M_OPTION_IS("storage_arenas")) {
+    return m_parse_size(value, &opts->storage_arenas_count);
+  }
+  if (M_OPTION_IS("item_slots")) {
+    return m_parse_size(value, &opts->item_slots_count);
+  }
+  if (M_OPTION_IS("sync_interval")) {
+    size_t sync_interval;
+    if (!m_parse_size(value, &sync_interval)) {
+      return 0;
+    }
+    opts->sync_interval = sync_interval;
+    return 1;
+  }
+  if (M_OPTION_IS("sync_bandwidth")) {
+    size_t sync_bandwidth;
+    if (!m_parse_size(value, &sync_bandwidth)) {
+      return 0;
+    }
+    opts->sync_bandwidth = sync_bandwidth;
+    return 1;
+  }
+  if (M_OPTION_IS("clock_eviction")) {
+    return m_parse_bool(value, &opts->has_clock_eviction);
+  }
+  if (M_OPTION_IS("huge_pages")) {
+    return m_parse_bool(value, &opts->has_huge_pages);
+  }
+  if (M_OPTION_IS("overwrite_protection")) {
+    return m_parse_bool(value, &opts->has_overwrite_protection);
+  }
+  if (M_OPTION_IS("use_shm")) {
+    return m_parse_bool(value, &opts->use_shm);
+  }
+  if (M_OPTION_IS("trace_file")) {
+    opts->trace_file = value;
+    return 1;
+  }
+
+#undef M_OPTION_IS
+
+  return 0;
+}
+
+static int m_options_parse(struct m_options *const opts, const int argc,
+    char **const argv)
+{
+  for (int i = 1; i < argc; ++i) {
+    if (!m_options_parse_arg(opts, argv[i])) {
+      fprintf(stderr, "Invalid option: [%s]\n", argv[i]);
+      return 0;
+    }
+  }
+
+  if ((opts->mode == M_MODE_TRACE_GEN || opts->mode == M_MODE_REPLAY) &&
+      opts->trace_file == NULL) {
+    fprintf(stderr, "trace_file must be set for mode=%s\n",
+        m_mode_names[opts->mode]);
+    return 0;
+  }
+
+  if (opts->max_items_count == 0) {
+    opts->max_items_count = opts->items_count;
+  }
+  if (opts->data_file_size == 0) {
+    opts->data_file_size = opts->items_count * (opts->max_item_size + 64);
+  }
+  return 1;
+}
+
+static void m_open_with_options(struct ybc *const cache,
+    const struct m_options *const opts)
+{
+  char config_buf[ybc_config_get_size()];
+  struct ybc_config *const config = (struct ybc_config *)config_buf;
+
+  ybc_config_init(config);
+  if (opts->use_shm) {
+      ybc_config_set_data_file(config, "/dev/shm/ybc-perftest-cache.data");
+      ybc_config_set_index_file(config, "/dev/shm/ybc-perftest-cache.index");
+  }
+  ybc_config_set_max_items_count(config, opts->max_items_count);
+  ybc_config_set_hot_items_count(config, opts->hot_items_count);
+  ybc_config_set_data_file_size(config, opts->data_file_size);
+  ybc_config_set_hot_data_size(config, opts->hot_data_size);
+  ybc_config_set_storage_arenas_count(config, opts->storage_arenas_count);
+  ybc_config_set_item_slots_count(config, opts->item_slots_count);
+  if (opts->sync_interval != M_SYNC_INTERVAL_DEFAULT) {
+    ybc_config_set_sync_interval(config, opts->sync_interval);
+  }
+  ybc_config_set_sync_bandwidth(config, opts->sync_bandwidth);
+  if (opts->has_clock_eviction) {
+    ybc_config_enable_clock_eviction(config);
+  }
+  if (opts->has_huge_pages) {
+    ybc_config_enable_huge_pages(config);
+  }
+  if (!opts->has_overwrite_protection) {
+    ybc_config_disable_overwrite_protection(config);
+  }
+
+  if (!ybc_open(cache, config, 1)) {
+    M_ERROR("Cannot create a cache");
+  }
+
+  ybc_config_destroy(config);
+
+  if (opts->use_shm) {
+      ybc_clear(cache);
+  }
+}
+
+static void m_print_cache_options(const struct m_options *const opts)
+{
+  printf("max_items=%zu, hot_items=%zu, data_file_size=%zu, "
+      "hot_data_size=%zu, storage_arenas=%zu, item_slots=%zu, "
+      "clock_eviction=%d, huge_pages=%d, overwrite_protection=%d, use_shm=%d",
+      opts->max_items_count, opts->hot_items_count, opts->data_file_size,
+      opts->hot_data_size, opts->storage_arenas_count, opts->item_slots_count,
+      opts->has_clock_eviction, opts->has_huge_pages,
+      opts->has_overwrite_protection,
+      opts->use_shm);
+  if (opts->sync_interval != M_SYNC_INTERVAL_DEFAULT) {
+    printf(", sync_interval=%llu", (unsigned long long)opts->sync_interval);
+  }
+  if (opts->sync_bandwidth != 0) {
+    printf(", sync_bandwidth=%llu", (unsigned long long)opts->sync_bandwidth);
+  }
+  printf(")\n");
+}
+
+/*
+ * Synthetic workload shared among threads.
+ */
+struct workload
+{
+  struct ybc *cache;
+  const struct m_options *opts;
+  struct m_key_gen key_gen;
+  size_t latest_count;
+};
+
+struct workload_thread
+{
+  struct p_thread thread;
+  struct workload *w;
+  size_t requests_count;
+  uint64_t seed;
+  struct m_op_results results;
+};
+
+static void m_workload_set(struct ybc *const cache, const uint64_t key_id,
+    struct m_rand_state *const rand_state, char *const buf,
+    const size_t max_item_size, struct m_op_results *const results)
+{
+  const struct ybc_key key = {
+      .ptr = &key_id,
+      .size = sizeof(key_id),
+  };
+  const struct ybc_value value = {
+      .ptr = buf,
+      .size = m_rand_next(rand_state) % (max_item_size + 1),
+      .ttl = YBC_MAX_TTL,
+  };
+  m_op_set(cache, &key, &value, results);
+}
+
+static void thread_func_workload(void *const ctx)
+{
+  struct workload_thread *const wt = ctx;
+  struct workload *const w = wt->w;
+  const struct m_options *const opts = w->opts;
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+  struct m_key_gen key_gen;
+  struct m_rand_state rand_state;
+  uint64_t key_id;
+
+  const struct ybc_key key = {
+      .ptr = &key_id,
+      .size = sizeof(key_id),
+  };
+
+  char *const buf = p_malloc(opts->max_item_size + 1);
+  m_memset(buf, 'x', opts->max_item_size);
+
+  m_key_gen_clone(&key_gen, &w->key_gen, wt->seed);
+  m_rand_seed(&rand_state, wt->seed + 1);
+
+  const uint64_t set_threshold = (uint64_t)(opts->set_ratio * UINT32_MAX);
+
+  for (size_t i = 0; i < wt->requests_count; ++i) {
+    if ((m_rand_next(&rand_state) >> 32) < set_threshold) {
+      m_workload_set(w->cache, m_key_gen_next_set(&key_gen), &rand_state, buf,
+          opts->max_item_size, &wt->results);
+      continue;
+    }
+
+    key_id = m_key_gen_next(&key_gen);
+    if (!m_op_get(w->cache, item, &key, &wt->results) && opts->fill_on_miss) {
+      m_workload_set(w->cache, key_id, &rand_state, buf, opts->max_item_size,
+          &wt->results);
+    }
+  }
+
+  p_free(buf);
+}
+
+/*
+ * Returns the number of distinct keys, which must be stored in the cache
+ * before the measurement.
+ */
+static size_t m_workload_get_prepopulate_count(
+    const struct m_options *const opts)
+{
+  if (opts->distribution == M_DISTRIBUTION_LATEST) {
+    /* 'latest' distribution requires existing keys. */
+    return opts->items_count;
+  }
+  return 0;
+}
+
+/*
+ * Data TLB miss counter for the current process, including threads started
+ * after m_dtlb_counter_start().
+ *
+ * The counter is unavailable if the OS or the CPU doesn't expose it,
+ * for instance inside containers with restricted perf_event_paranoid.
+ */
+struct m_dtlb_counter
+{
+  int fd;
+};
+
+static void m_dtlb_counter_start(struct m_dtlb_counter *const dc)
+{
+  dc->fd = -1;
+#ifdef YBC_PLATFORM_LINUX
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_DTLB |
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  dc->fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if (dc->fd != -1) {
+    ioctl(dc->fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(dc->fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+/*
+ * Stops the counter and returns the number of data TLB misses.
+ * Returns 0 if the counter is unavailable.
+ */
+static int m_dtlb_counter_stop(struct m_dtlb_counter *const dc,
+    uint64_t *const misses_count)
+{
+  int is_available = 0;
+
+  *misses_count = 0;
+#ifdef YBC_PLATFORM_LINUX
+  if (dc->fd != -1) {
+    ioctl(dc->fd, PERF_EVENT_IOC_DISABLE, 0);
+    is_available = (read(dc->fd, misses_count, sizeof(*misses_count)) ==
+        sizeof(*misses_count));
+    close(dc->fd);
+  }
+#endif
+  return is_available;
+}
+
+static void run_workload(struct ybc *const cache,
+    const struct m_options *const opts)
+{
+  const size_t threads_count = opts->threads_count;
+  struct workload w = {
+      .cache = cache,
+      .opts = opts,
+      .latest_count = 0,
+  };
+  struct m_op_results results;
+  struct m_rand_state rand_state;
+  struct m_dtlb_counter dtlb_counter;
+  uint64_t dtlb_misses_count;
+
+  printf("workload(distribution=%s, theta=%.2f, set_ratio=%.2f, "
+      "fill_on_miss=%d, requests=%zu, items=%zu, max_item_size=%zu, "
+      "threads=%zu, ", m_distribution_names[opts->distribution], opts->theta,
+      opts->set_ratio, opts->fill_on_miss, opts->requests_count,
+      opts->items_count, opts->max_item_size, opts->threads_count);
+  m_print_cache_options(opts);
+
+  m_open_with_options(cache, opts);
+
+  m_key_gen_init(&w.key_gen, opts->distribution, opts->items_count,
+      opts->theta, &w.latest_count);
+
+  const size_t prepopulate_count = m_workload_get_prepopulate_count(opts);
+  if (prepopulate_count > 0) {
+    char *const buf = p_malloc(opts->max_item_size + 1);
+    m_op_results_init(&results);
+    m_rand_init(&rand_state);
+    for (size_t i = 0; i < prepopulate_count; ++i) {
+      m_workload_set(cache, i, &rand_state, buf, opts->max_item_size,
+          &results);
+    }
+    w.latest_count = prepopulate_count;
+    p_free(buf);
+  }
+
+  struct workload_thread *const threads = p_malloc(
+      sizeof(threads[0]) * threads_count);
+
+  m_rand_init(&rand_state);
+  for (size_t i = 0; i < threads_count; ++i) {
+    struct workload_thread *const wt = &threads[i];
+    wt->w = &w;
+    wt->requests_count = opts->requests_count / threads_count;
+    if (i < opts->requests_count % threads_count) {
+      ++wt->requests_count;
+    }
+    wt->seed = m_rand_next(&rand_state);
+    m_op_results_init(&wt->results);
+  }
+
+  m_dtlb_counter_start(&dtlb_counter);
+  const double start_time = p_get_current_time();
+  for (size_t i = 0; i < threads_count; ++i) {
+    p_thread_init_and_start(&threads[i].thread, thread_func_workload,
+        &threads[i]);
+  }
+  for (size_t i = 0; i < threads_count; ++i) {
+    p_thread_join_and_destroy(&threads[i].thread);
+  }
+  const double end_time = p_get_current_time();
+  const int has_dtlb_misses = m_dtlb_counter_stop(&dtlb_counter,
+      &dtlb_misses_count);
+
+  m_op_results_init(&results);
+  for (size_t i = 0; i < threads_count; ++i) {
+    m_op_results_merge(&results, &threads[i].results);
+  }
+  p_free(threads);
+
+  m_op_results_print(&results, opts->requests_count, end_time - start_time);
+  if (has_dtlb_misses) {
+    printf("  dtlb_misses    : %.2f per request\n",
+        (double)dtlb_misses_count / opts->requests_count);
+  }
+  else {
+    printf("  dtlb_misses    : n/a\n");
+  }
+
+  m_close(cache, opts->use_shm);
+}
+
+/*
+ * Trace file record.
+ *
+ * Trace file is a sequence of records in native byte order without
+ * any header.
+ */
+struct trace_record
+{
+  /* One of TRACE_OP_* values. */
+  uint32_t op;
+
+  /* Value size for TRACE_OP_SET and TRACE_OP_GET_OR_SET. */
+  uint32_t size;
+
+  /* Key identifier. It is used as an 8-byte cache key. */
+  uint64_t key;
+
+  /* Value ttl in milliseconds for TRACE_OP_SET and TRACE_OP_GET_OR_SET. */
+  uint64_t ttl;
+};
+
+enum
+{
+  TRACE_OP_GET = 0,
+  TRACE_OP_SET = 1,
+  TRACE_OP_REMOVE = 2,
+
+  /* Get the item and store it on miss. This is typical for caching proxies. */
+  TRACE_OP_GET_OR_SET = 3,
+};
+
+static void run_trace_gen(const struct m_options *const opts)
+{
+  struct m_key_gen key_gen;
+  struct m_rand_state rand_state;
+  size_t latest_count = opts->items_count;
+
+  FILE *const fp = fopen(opts->trace_file, "wb");
+  if (fp == NULL) {
+    M_ERROR("Cannot create trace file");
+  }
+
+  m_key_gen_init(&key_gen, opts->distribution, opts->items_count,
+      opts->theta, &latest_count);
+  m_rand_init(&rand_state);
+
+  const uint64_t set_threshold = (uint64_t)(opts->set_ratio * UINT32_MAX);
+
+  for (size_t i = 0; i < opts->requests_count; ++i) {
+    struct trace_record r;
+
+    if ((m_rand_next(&rand_state) >> 32) < set_threshold) {
+      r.op = TRACE_OP_SET;
+      r.key = m_key_gen_next_set(&key_gen);
+    }
+    else {
+      r.op = opts->fill_on_miss ? TRACE_OP_GET_OR_SET : TRACE_OP_GET;
+      r.key = m_key_gen_next(&key_gen);
+    }
+    r.size = (uint32_t)(m_rand_next(&rand_state) % (opts->max_item_size + 1));
+    r.ttl = YBC_MAX_TTL;
+
+    if (fwrite(&r, sizeof(r), 1, fp) != 1) {
+      M_ERROR("Cannot write trace record");
+    }
+  }
+
+  if (fclose(fp) != 0) {
+    M_ERROR("Cannot close trace file");
+  }
+
+  printf("trace-gen(distribution=%s, theta=%.2f, set_ratio=%.2f, "
+      "requests=%zu, items=%zu, max_item_size=%zu, trace_file=%s)\n",
+      m_distribution_names[opts->distribution], opts->theta, opts->set_ratio,
+      opts->requests_count, opts->items_count, opts->max_item_size,
+      opts->trace_file);
+}
+
+static void run_replay(struct ybc *const cache,
+    const struct m_options *const opts)
+{
+  char item_buf[ybc_item_get_size()];
+  struct ybc_item *const item = (struct ybc_item *)item_buf;
+  struct m_op_results results;
+  struct trace_record r;
+  uint64_t requests_count = 0;
+  size_t buf_size = opts->max_item_size;
+  double duration = 0;
+
+  FILE *const fp = fopen(opts->trace_file, "rb");
+  if (fp == NULL) {
+    M_ERROR("Cannot open trace file");
+  }
+
+  printf("replay(trace_file=%s, ", opts->trace_file);
+  m_print_cache_options(opts);
+
+  m_open_with_options(cache, opts);
+  m_op_results_init(&results);
+
+  char *buf = p_malloc(buf_size + 1);
+  m_memset(buf, 'x', buf_size);
+
+  const struct ybc_key key = {
+      .ptr = &r.key,
+      .size = sizeof(r.key),
+  };
+
+  for (;;) {
+    /*
+     * Read the trace in batches outside measured time, so trace I/O
+     * doesn't affect throughput.
+     */
+    struct trace_record batch[1024];
+    const size_t batch_size = fread(batch, sizeof(batch[0]),
+        sizeof(batch) / sizeof(batch[0]), fp);
+    if (batch_size == 0) {
+      break;
+    }
+
+    for (size_t i = 0; i < batch_size; ++i) {
+      if (batch[i].size > buf_size) {
+        buf_size = batch[i].size;
+        p_free(buf);
+        buf = p_malloc(buf_size + 1);
+        m_memset(buf, 'x', buf_size);
+      }
+    }
+
+    const double start_time = p_get_current_time();
+    for (size_t i = 0; i < batch_size; ++i) {
+      r = batch[i];
+      const struct ybc_value value = {
+          .ptr = buf,
+          .size = r.size,
+          .ttl = r.ttl,
+      };
+
+      switch (r.op) {
+      case TRACE_OP_GET:
+        (void)m_op_get(cache, item, &key, &results);
+        break;
+      case TRACE_OP_SET:
+        m_op_set(cache, &key, &value, &results);
+        break;
+      case TRACE_OP_REMOVE:
+        m_op_remove(cache, &key, &results);
+        break;
+      case TRACE_OP_GET_OR_SET:
+        if (!m_op_get(cache, item, &key, &results)) {
+          m_op_set(cache, &key, &value, &results);
+        }
+        break;
+      default:
+        M_ERROR("Unexpected operation in trace record");
+      }
+    }
+    duration += p_get_current_time() - start_time;
+    requests_count += batch_size;
+  }
+
+  if (ferror(fp)) {
+    M_ERROR("Cannot read trace file");
+  }
+  fclose(fp);
+  p_free(buf);
+
+  printf("  requests       : %llu\n", (unsigned long long)requests_count);
+  m_op_results_print(&results, requests_count, duration);
+
+  m_close(cache, opts->use_shm);
+}
+
+int main(int argc, char **argv)
+{
+  char cache_buf[ybc_get_size()];
+  struct ybc *const cache = (struct ybc *)cache_buf;
+  struct m_options opts;
+
+  m_options_init(&opts);
+  if (!m_options_parse(&opts, argc, argv)) {
+    m_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  switch (opts.mode) {
+  case M_MODE_SUITE:
+    run_suite(cache, opts.requests_count, opts.items_count);
+    break;
+  case M_MODE_WORKLOAD:
+    run_workload(cache, &opts);
+    break;
+  case M_MODE_TRACE_GEN:
+    run_trace_gen(&opts);
+    break;
+  case M_MODE_REPLAY:
+    run_replay(cache, &opts);
+    break;
+  }
 
   printf("All performance tests done\n");
   return 0;